@@ -0,0 +1,112 @@
+#ifndef ADMISSION_CONTROL_H
+#define ADMISSION_CONTROL_H
+
+#include <stdint.h>
+
+// Heap-aware admission control (arc42 TR-1).
+// Tracks free heap and the largest free block and sheds load in a fixed
+// order before the allocator fails: first new WebSocket clients are refused,
+// then non-essential HTTP endpoints answer 503, then status broadcasts are
+// slowed down. Output control and effects are never shed.
+// Levels escalate as soon as a threshold is crossed and only relax once the
+// heap has recovered by a hysteresis margin, so the level doesn't flap.
+// Free of Arduino headers so the native tests can exercise it.
+
+enum AdmissionLevel : uint8_t {
+    AdmissionNormal = 0,
+    AdmissionRejectWebSocket = 1,  // New WebSocket clients are disconnected
+    AdmissionShedNonEssential = 2, // ...and non-essential endpoints return 503
+    AdmissionThrottleBroadcast = 3 // ...and status broadcasts run at a reduced rate
+};
+
+const uint8_t ADMISSION_LEVEL_COUNT = 4;
+
+struct AdmissionThresholds {
+    // Index 0 applies at AdmissionRejectWebSocket, 1 at AdmissionShedNonEssential,
+    // 2 at AdmissionThrottleBroadcast; each must be lower than the one before
+    uint32_t freeHeap[ADMISSION_LEVEL_COUNT - 1];
+    uint32_t maxBlock[ADMISSION_LEVEL_COUNT - 1];
+    uint32_t hysteresis;        // Bytes of recovery needed before relaxing a level
+    uint8_t broadcastSlowdown;  // Broadcast interval multiplier at AdmissionThrottleBroadcast
+};
+
+struct AdmissionMetrics {
+    uint32_t webSocketRejected;
+    uint32_t requestsShed;
+    uint32_t broadcastsDeferred;
+    uint32_t escalations;
+    uint32_t minFreeHeap;
+    uint32_t minMaxBlock;
+};
+
+class AdmissionController {
+public:
+    explicit AdmissionController(const AdmissionThresholds& thresholds)
+        : thresholds_(thresholds), level_(AdmissionNormal) {
+        metrics_.webSocketRejected = 0;
+        metrics_.requestsShed = 0;
+        metrics_.broadcastsDeferred = 0;
+        metrics_.escalations = 0;
+        metrics_.minFreeHeap = UINT32_MAX;
+        metrics_.minMaxBlock = UINT32_MAX;
+    }
+
+    // Feed a heap sample; returns the (possibly changed) level
+    AdmissionLevel update(uint32_t freeHeap, uint32_t maxBlock) {
+        if (freeHeap < metrics_.minFreeHeap) metrics_.minFreeHeap = freeHeap;
+        if (maxBlock < metrics_.minMaxBlock) metrics_.minMaxBlock = maxBlock;
+
+        const AdmissionLevel pressure = levelFor(freeHeap, maxBlock, 0);
+        if (pressure > level_) {
+            level_ = pressure;
+            metrics_.escalations++;
+        } else if (pressure < level_) {
+            // Relax only as far as the heap clears the thresholds plus hysteresis
+            const AdmissionLevel relaxed = levelFor(freeHeap, maxBlock, thresholds_.hysteresis);
+            if (relaxed < level_) level_ = relaxed;
+        }
+        return level_;
+    }
+
+    AdmissionLevel level() const { return level_; }
+
+    bool admitWebSocketClient() {
+        if (level_ < AdmissionRejectWebSocket) return true;
+        metrics_.webSocketRejected++;
+        return false;
+    }
+
+    bool admitRequest(bool essential) {
+        if (essential || level_ < AdmissionShedNonEssential) return true;
+        metrics_.requestsShed++;
+        return false;
+    }
+
+    bool throttlingBroadcasts() const { return level_ >= AdmissionThrottleBroadcast; }
+
+    unsigned long broadcastInterval(unsigned long normalIntervalMs) const {
+        return throttlingBroadcasts() ? normalIntervalMs * thresholds_.broadcastSlowdown : normalIntervalMs;
+    }
+
+    // A state-change broadcast was folded into the next throttled one
+    void recordDeferredBroadcast() { metrics_.broadcastsDeferred++; }
+
+    const AdmissionMetrics& metrics() const { return metrics_; }
+
+private:
+    AdmissionLevel levelFor(uint32_t freeHeap, uint32_t maxBlock, uint32_t margin) const {
+        uint8_t level = AdmissionNormal;
+        for (uint8_t i = 0; i < ADMISSION_LEVEL_COUNT - 1; i++) {
+            if (freeHeap < thresholds_.freeHeap[i] + margin || maxBlock < thresholds_.maxBlock[i] + margin) {
+                level = static_cast<uint8_t>(i + 1);
+            }
+        }
+        return static_cast<AdmissionLevel>(level);
+    }
+
+    AdmissionThresholds thresholds_;
+    AdmissionLevel level_;
+    AdmissionMetrics metrics_;
+};
+
+#endif // ADMISSION_CONTROL_H
@@ -0,0 +1,117 @@
+#ifndef BUMP_ARENA_H
+#define BUMP_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Fixed-capacity bump allocator backing the JSON documents.
+// Every block carries a small size header so reallocate() can copy when the
+// block isn't the most recent one. deallocate() only reclaims the most recent
+// block; everything else is reclaimed when the owner rewinds to a mark.
+// Free of Arduino/ArduinoJson headers so the native tests can exercise it.
+
+template <size_t Capacity>
+class BumpArena {
+public:
+    static const size_t ALIGNMENT = sizeof(void*) < 4 ? 4 : sizeof(void*);
+
+    BumpArena() : top_(0), lastBlock_(NO_BLOCK), highWater_(0), failures_(0) {}
+
+    void* allocate(size_t size) {
+        const size_t blockSize = HEADER_SIZE + alignUp(size);
+        if (blockSize > Capacity - top_) {
+            failures_++;
+            return nullptr;
+        }
+        uint8_t* block = buffer_ + top_;
+        *reinterpret_cast<uint32_t*>(block) = static_cast<uint32_t>(size);
+        lastBlock_ = top_;
+        top_ += blockSize;
+        if (top_ > highWater_) highWater_ = top_;
+        return block + HEADER_SIZE;
+    }
+
+    void deallocate(void* ptr) {
+        if (!owns(ptr)) return;
+        if (offsetOf(ptr) == lastBlock_) {
+            top_ = lastBlock_;
+            lastBlock_ = NO_BLOCK; // Only one level of undo; older blocks wait for rewind()
+        }
+    }
+
+    void* reallocate(void* ptr, size_t newSize) {
+        if (ptr == nullptr) return allocate(newSize);
+        if (!owns(ptr)) return nullptr;
+
+        const size_t offset = offsetOf(ptr);
+        uint32_t* sizeField = reinterpret_cast<uint32_t*>(buffer_ + offset);
+        const size_t oldSize = *sizeField;
+
+        // Most recent block: grow or shrink in place
+        if (offset == lastBlock_) {
+            const size_t blockSize = HEADER_SIZE + alignUp(newSize);
+            if (blockSize > Capacity - offset) {
+                failures_++;
+                return nullptr;
+            }
+            *sizeField = static_cast<uint32_t>(newSize);
+            top_ = offset + blockSize;
+            if (top_ > highWater_) highWater_ = top_;
+            return ptr;
+        }
+
+        // Older block: shrinking is free, growing needs a copy
+        if (newSize <= oldSize) {
+            *sizeField = static_cast<uint32_t>(newSize);
+            return ptr;
+        }
+        void* moved = allocate(newSize);
+        if (moved != nullptr) {
+            memcpy(moved, ptr, oldSize);
+        }
+        return moved;
+    }
+
+    // Marks let a scope release everything it allocated in one step
+    size_t mark() const { return top_; }
+
+    void rewind(size_t mark) {
+        if (mark <= top_) {
+            top_ = mark;
+            lastBlock_ = NO_BLOCK;
+        }
+    }
+
+    void reset() { rewind(0); }
+
+    size_t capacity() const { return Capacity; }
+    size_t used() const { return top_; }
+    size_t highWater() const { return highWater_; }
+    uint32_t failures() const { return failures_; }
+
+private:
+    static const size_t HEADER_SIZE = ALIGNMENT;
+    static const size_t NO_BLOCK = static_cast<size_t>(-1);
+
+    static size_t alignUp(size_t size) {
+        return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    }
+
+    bool owns(const void* ptr) const {
+        const uint8_t* p = static_cast<const uint8_t*>(ptr);
+        return p >= buffer_ + HEADER_SIZE && p < buffer_ + top_;
+    }
+
+    size_t offsetOf(const void* ptr) const {
+        return static_cast<size_t>(static_cast<const uint8_t*>(ptr) - buffer_) - HEADER_SIZE;
+    }
+
+    alignas(8) uint8_t buffer_[Capacity];
+    size_t top_;
+    size_t lastBlock_;
+    size_t highWater_;
+    uint32_t failures_;
+};
+
+#endif // BUMP_ARENA_H
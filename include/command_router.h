@@ -0,0 +1,511 @@
+#ifndef COMMAND_ROUTER_H
+#define COMMAND_ROUTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "text_buffer.h"
+#include "output_map.h"
+
+// Transport-agnostic command dispatch.
+// Every state-changing request - HTTP POST /api/<command>, a WebSocket text
+// frame or a serial console line - is a named command with a few fields. A
+// constant table declares each command's fields (type, range, required,
+// output addressing); the router validates them in one place and hands the
+// handler typed values, so handlers contain no parsing or error replies of
+// their own. Transports only adapt their input format (CommandInput) and turn
+// the CommandResult into their kind of reply.
+// Free of Arduino headers so the native tests can exercise it.
+
+const uint8_t COMMAND_MAX_FIELDS = 4;
+const uint8_t COMMAND_MAX_LIST = 8;       // Outputs named by one Outputs field
+const size_t COMMAND_TEXT_SIZE = 21;      // Text fields: 20 chars + NUL (names)
+const size_t COMMAND_REPLY_SIZE = 64;     // formatCommandReply() output
+
+enum class CommandFieldType : uint8_t {
+    Integer,     // min..max
+    Boolean,     // JSON true/false or 0/1, serial also on/off
+    Text,        // Trimmed and truncated to COMMAND_TEXT_SIZE - 1; absent = empty
+    Output,      // One output: "id", or its GPIO under the field's name; the value is the ID
+    Outputs      // min..max distinct outputs: "ids", "mask", "id", or GPIO pins under the
+                 // field's name; IDs in CommandArgs::list, in the order given
+};
+
+// Keys that address outputs by ID, besides the field's own GPIO key
+const char* const COMMAND_OUTPUT_ID_KEY = "id";      // One output
+const char* const COMMAND_OUTPUT_IDS_KEY = "ids";    // ID list, JSON array or ranges "0-3,6"
+const char* const COMMAND_OUTPUT_MASK_KEY = "mask";  // Bit n set = output ID n
+
+struct CommandField {
+    const char* name;
+    CommandFieldType type;
+    bool required;
+    int32_t min;
+    int32_t max;
+    int32_t fallback;  // Value of an absent optional Integer/Boolean
+};
+
+enum class CommandStatus : uint8_t {
+    Ok,
+    Invalid,      // HTTP 400
+    NotFound,     // HTTP 404: unknown command, output or group
+    Unavailable   // HTTP 503: shed by admission control
+};
+
+// Outcome of a command. Messages and field names are string literals, so a
+// result can be passed around and formatted without buffers.
+struct CommandResult {
+    CommandStatus status;
+    const char* message;  // Ok: optional status word, otherwise the error
+    const char* field;    // Field that failed validation, or nullptr
+
+    static CommandResult ok(const char* status = nullptr) {
+        CommandResult result = {CommandStatus::Ok, status, nullptr};
+        return result;
+    }
+    static CommandResult invalid(const char* message, const char* field = nullptr) {
+        CommandResult result = {CommandStatus::Invalid, message, field};
+        return result;
+    }
+    static CommandResult notFound(const char* message, const char* field = nullptr) {
+        CommandResult result = {CommandStatus::NotFound, message, field};
+        return result;
+    }
+
+    static CommandResult unavailable(const char* message) {
+        CommandResult result = {CommandStatus::Unavailable, message, nullptr};
+        return result;
+    }
+
+    bool succeeded() const { return status == CommandStatus::Ok; }
+
+    uint16_t httpStatus() const {
+        switch (status) {
+            case CommandStatus::Ok: return 200;
+            case CommandStatus::NotFound: return 404;
+            case CommandStatus::Unavailable: return 503;
+            default: return 400;
+        }
+    }
+};
+
+// Validated field values, indexed like the command's field table
+struct CommandArgs {
+    struct Value {
+        bool present;
+        int32_t number;                 // Integer, Boolean (0/1), Output (ID), Outputs (count)
+        char text[COMMAND_TEXT_SIZE];   // Text
+    };
+
+    Value values[COMMAND_MAX_FIELDS];
+    uint8_t list[COMMAND_MAX_LIST];     // Outputs: output IDs
+    uint8_t listCount;
+
+    bool has(uint8_t field) const { return values[field].present; }
+    int32_t number(uint8_t field) const { return values[field].number; }
+    bool flag(uint8_t field) const { return values[field].number != 0; }
+    const char* text(uint8_t field) const { return values[field].text; }
+};
+
+typedef CommandResult (*CommandHandler)(const CommandArgs& args);
+
+// Size of a field table, checked against COMMAND_MAX_FIELDS at compile time:
+//   {"control", "/api/control", commandControl, COMMAND_FIELDS(CONTROL_FIELDS), true}
+template <size_t N>
+struct CommandFieldCount {
+    static_assert(N <= COMMAND_MAX_FIELDS, "Too many fields for one command - raise COMMAND_MAX_FIELDS");
+    static const uint8_t value = static_cast<uint8_t>(N);
+};
+#define COMMAND_FIELDS(table) table, CommandFieldCount<sizeof(table) / sizeof(CommandField)>::value
+
+struct CommandSpec {
+    const char* name;           // Command name (WebSocket "command", serial first word)
+    const char* httpPath;       // POST route
+    CommandHandler handler;
+    const CommandField* fields;
+    uint8_t fieldCount;
+    bool essential;             // Still served while the admission controller sheds load
+};
+
+// Every key a field reads, for request filters and help: visit(key)
+template <typename Visit>
+inline void forEachCommandFieldKey(const CommandField& field, Visit visit) {
+    visit(field.name);
+    if (field.type == CommandFieldType::Outputs) {
+        visit(COMMAND_OUTPUT_IDS_KEY);
+        visit(COMMAND_OUTPUT_MASK_KEY);
+    }
+    if (field.type == CommandFieldType::Output || field.type == CommandFieldType::Outputs) {
+        visit(COMMAND_OUTPUT_ID_KEY);
+    }
+}
+
+enum class CommandInputStatus : uint8_t {
+    Missing,
+    Invalid,  // Present but not of the requested type
+    Ok
+};
+
+// Field access for one transport's request format
+class CommandInput {
+public:
+    virtual ~CommandInput() {}
+
+    virtual CommandInputStatus integer(const char* name, int32_t& value) const = 0;
+    virtual CommandInputStatus boolean(const char* name, bool& value) const = 0;
+    virtual CommandInputStatus text(const char* name, TextView& value) const = 0;
+    // Stores up to 'capacity' values; 'count' is the full length of the list
+    virtual CommandInputStatus integers(const char* name, int32_t* values, uint8_t capacity, uint8_t& count) const = 0;
+};
+
+// Signed decimal; false on empty input, junk or more than 9 digits
+inline bool parseCommandInteger(TextView text, int32_t& value) {
+    bool negative = false;
+    if (!text.empty() && (text.data[0] == '-' || text.data[0] == '+')) {
+        negative = text.data[0] == '-';
+        text = TextView(text.data + 1, text.length - 1);
+    }
+    if (text.empty() || text.length > 9) return false;
+    int32_t result = 0;
+    for (size_t i = 0; i < text.length; i++) {
+        const char c = text.data[i];
+        if (c < '0' || c > '9') return false;
+        result = result * 10 + (c - '0');
+    }
+    value = negative ? -result : result;
+    return true;
+}
+
+// Serial console arguments: name=value pairs separated by spaces, values with
+// spaces in double quotes, lists comma-separated:
+//   chasing/create groupId=1 interval=200 outputs=4,5,12 name="Yard lights"
+class KeyValueCommandInput : public CommandInput {
+public:
+    static const uint8_t MAX_PAIRS = COMMAND_MAX_FIELDS + 2;
+
+    explicit KeyValueCommandInput(TextView arguments) : count_(0), valid_(true) {
+        size_t pos = 0;
+        while (pos < arguments.length) {
+            while (pos < arguments.length && isTextWhitespace(arguments.data[pos])) pos++;
+            if (pos >= arguments.length) break;
+            const size_t keyStart = pos;
+            while (pos < arguments.length && arguments.data[pos] != '=' && !isTextWhitespace(arguments.data[pos])) pos++;
+            if (pos >= arguments.length || arguments.data[pos] != '=' || count_ >= MAX_PAIRS) {
+                valid_ = false;
+                return;
+            }
+            Pair& pair = pairs_[count_++];
+            pair.key = TextView(arguments.data + keyStart, pos - keyStart);
+            pos++; // '='
+            if (pos < arguments.length && arguments.data[pos] == '"') {
+                const size_t valueStart = ++pos;
+                while (pos < arguments.length && arguments.data[pos] != '"') pos++;
+                if (pos >= arguments.length) {
+                    valid_ = false;
+                    return;
+                }
+                pair.value = TextView(arguments.data + valueStart, pos - valueStart);
+                pos++; // Closing quote
+            } else {
+                const size_t valueStart = pos;
+                while (pos < arguments.length && !isTextWhitespace(arguments.data[pos])) pos++;
+                pair.value = TextView(arguments.data + valueStart, pos - valueStart);
+            }
+        }
+    }
+
+    // False if the line could not be split into name=value pairs
+    bool valid() const { return valid_; }
+
+    CommandInputStatus integer(const char* name, int32_t& value) const override {
+        TextView raw;
+        if (!find(name, raw)) return CommandInputStatus::Missing;
+        return parseCommandInteger(raw, value) ? CommandInputStatus::Ok : CommandInputStatus::Invalid;
+    }
+
+    CommandInputStatus boolean(const char* name, bool& value) const override {
+        TextView raw;
+        if (!find(name, raw)) return CommandInputStatus::Missing;
+        if (raw.equals("1") || raw.equals("true") || raw.equals("on")) value = true;
+        else if (raw.equals("0") || raw.equals("false") || raw.equals("off")) value = false;
+        else return CommandInputStatus::Invalid;
+        return CommandInputStatus::Ok;
+    }
+
+    CommandInputStatus text(const char* name, TextView& value) const override {
+        return find(name, value) ? CommandInputStatus::Ok : CommandInputStatus::Missing;
+    }
+
+    CommandInputStatus integers(const char* name, int32_t* values, uint8_t capacity, uint8_t& count) const override {
+        TextView raw;
+        if (!find(name, raw)) return CommandInputStatus::Missing;
+        count = 0;
+        size_t pos = 0;
+        while (pos < raw.length) {
+            size_t end = pos;
+            while (end < raw.length && raw.data[end] != ',') end++;
+            int32_t value = 0;
+            if (!parseCommandInteger(TextView(raw.data + pos, end - pos), value)) return CommandInputStatus::Invalid;
+            if (count < capacity) values[count] = value;
+            if (count < 255) count++;
+            pos = end + 1;
+        }
+        return CommandInputStatus::Ok;
+    }
+
+private:
+    struct Pair {
+        TextView key;
+        TextView value;
+    };
+
+    bool find(const char* name, TextView& value) const {
+        for (uint8_t i = 0; i < count_; i++) {
+            if (pairs_[i].key.equals(name)) {
+                value = pairs_[i].value;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    Pair pairs_[MAX_PAIRS];
+    uint8_t count_;
+    bool valid_;
+};
+
+// Split a console line into the command name and its arguments
+inline void splitCommandLine(TextView line, TextView& name, TextView& arguments) {
+    line = trimText(line);
+    size_t end = 0;
+    while (end < line.length && !isTextWhitespace(line.data[end])) end++;
+    name = TextView(line.data, end);
+    arguments = TextView(line.data + end, line.length - end);
+}
+
+struct CommandMetrics {
+    uint32_t dispatched;  // Handler called
+    uint32_t rejected;    // Failed validation
+    uint32_t unknown;     // No such command
+};
+
+class CommandRouter {
+public:
+    CommandRouter(const CommandSpec* commands, uint8_t commandCount, const OutputPinMap& outputs)
+        : commands_(commands), commandCount_(commandCount), outputs_(outputs) {
+        metrics_.dispatched = 0;
+        metrics_.rejected = 0;
+        metrics_.unknown = 0;
+    }
+
+    const CommandSpec* find(TextView name) const {
+        for (uint8_t i = 0; i < commandCount_; i++) {
+            if (name.equals(commands_[i].name)) return &commands_[i];
+        }
+        return nullptr;
+    }
+
+    const CommandSpec* findByPath(TextView path) const {
+        for (uint8_t i = 0; i < commandCount_; i++) {
+            if (path.equals(commands_[i].httpPath)) return &commands_[i];
+        }
+        return nullptr;
+    }
+
+    uint8_t commandCount() const { return commandCount_; }
+    const CommandSpec& command(uint8_t index) const { return commands_[index]; }
+
+    CommandResult dispatch(TextView name, const CommandInput& input) {
+        const CommandSpec* command = find(name);
+        if (command == nullptr) {
+            metrics_.unknown++;
+            return CommandResult::notFound("Unknown command");
+        }
+        return dispatch(*command, input);
+    }
+
+    // Validate every field of 'command', then run its handler
+    CommandResult dispatch(const CommandSpec& command, const CommandInput& input) {
+        CommandArgs args;
+        args.listCount = 0;
+        for (uint8_t i = 0; i < command.fieldCount && i < COMMAND_MAX_FIELDS; i++) {
+            const CommandResult result = readField(command.fields[i], input, args.values[i], args);
+            if (!result.succeeded()) {
+                metrics_.rejected++;
+                return result;
+            }
+        }
+        metrics_.dispatched++;
+        return command.handler(args);
+    }
+
+    const CommandMetrics& metrics() const { return metrics_; }
+
+private:
+    static CommandResult missing(const CommandField& field, CommandArgs::Value& value, CommandInputStatus status,
+                                 const char* key = nullptr) {
+        if (status == CommandInputStatus::Invalid) return CommandResult::invalid("Invalid value", key ? key : field.name);
+        if (field.required) return CommandResult::invalid("Missing field", field.name);
+        value.number = field.fallback;
+        return CommandResult::ok();
+    }
+
+    // Outputs named by an Outputs field, tried key by key: GPIO pins under the
+    // field's name (a list, or one pin), then "id", "ids" and "mask". 'key' is
+    // the key found, 'byPin' whether 'raw' holds GPIO pins rather than IDs.
+    CommandInputStatus readOutputList(const CommandField& field, const CommandInput& input, int32_t* raw, uint8_t& count,
+                                      const char*& key, bool& byPin) const {
+        byPin = true;
+        key = field.name;
+        CommandInputStatus status = input.integers(key, raw, COMMAND_MAX_LIST, count);
+        if (status == CommandInputStatus::Invalid) { // Not a list: one pin ("pin": 4)
+            count = 1;
+            status = input.integer(key, raw[0]);
+        }
+        if (status != CommandInputStatus::Missing) return status;
+
+        byPin = false;
+        key = COMMAND_OUTPUT_ID_KEY;
+        count = 1;
+        status = input.integer(key, raw[0]);
+        if (status != CommandInputStatus::Missing) return status;
+
+        key = COMMAND_OUTPUT_IDS_KEY;
+        TextView ranges;
+        status = input.text(key, ranges);
+        if (status == CommandInputStatus::Ok) {
+            return parseOutputIdRanges(ranges, raw, COMMAND_MAX_LIST, count) ? status : CommandInputStatus::Invalid;
+        }
+        if (status == CommandInputStatus::Invalid) return input.integers(key, raw, COMMAND_MAX_LIST, count); // JSON array
+
+        key = COMMAND_OUTPUT_MASK_KEY;
+        int32_t mask = 0;
+        status = input.integer(key, mask);
+        if (status != CommandInputStatus::Ok) return status;
+        if (mask < 0) return CommandInputStatus::Invalid;
+        count = 0;
+        for (uint8_t id = 0; id < 31; id++) {
+            if ((mask & (static_cast<int32_t>(1) << id)) == 0) continue;
+            if (count < COMMAND_MAX_LIST) raw[count] = id;
+            count++;
+        }
+        return status;
+    }
+
+    // An unknown output is a 404 when it was the only one named (as for an
+    // Output field), a 400 within a list
+    CommandResult readOutputs(const CommandField& field, const CommandInput& input, CommandArgs::Value& value, CommandArgs& args) const {
+        int32_t raw[COMMAND_MAX_LIST];
+        uint8_t count = 0;
+        const char* key = nullptr;
+        bool byPin = false;
+        const CommandInputStatus status = readOutputList(field, input, raw, count, key, byPin);
+        if (status != CommandInputStatus::Ok) return missing(field, value, status, key);
+        if (count < field.min || count > field.max || count > COMMAND_MAX_LIST) {
+            return CommandResult::invalid("Wrong number of outputs", key);
+        }
+        for (uint8_t i = 0; i < count; i++) {
+            const int id = byPin ? outputs_.idOf(raw[i]) : (outputs_.validId(raw[i]) ? raw[i] : -1);
+            if (id < 0) {
+                if (count == 1) return CommandResult::notFound("Output not found", key);
+                return CommandResult::invalid(byPin ? "Invalid GPIO pin" : "Invalid output id", key);
+            }
+            for (uint8_t j = 0; j < i; j++) {
+                if (args.list[j] == id) return CommandResult::invalid(byPin ? "Duplicate GPIO pin" : "Duplicate output id", key);
+            }
+            args.list[i] = static_cast<uint8_t>(id);
+        }
+        args.listCount = count;
+        value.number = count;
+        value.present = true;
+        return CommandResult::ok();
+    }
+
+    CommandResult readField(const CommandField& field, const CommandInput& input, CommandArgs::Value& value, CommandArgs& args) const {
+        value.present = false;
+        value.number = 0;
+        value.text[0] = '\0';
+        CommandInputStatus status = CommandInputStatus::Missing;
+
+        switch (field.type) {
+            case CommandFieldType::Integer: {
+                int32_t number = 0;
+                status = input.integer(field.name, number);
+                if (status != CommandInputStatus::Ok) return missing(field, value, status);
+                if (number < field.min || number > field.max) return CommandResult::invalid("Out of range", field.name);
+                value.number = number;
+                break;
+            }
+            case CommandFieldType::Output: {
+                int32_t number = 0;
+                const char* key = COMMAND_OUTPUT_ID_KEY;
+                status = input.integer(key, number);
+                int id = outputs_.validId(number) ? number : -1;
+                if (status == CommandInputStatus::Missing) {
+                    key = field.name;
+                    status = input.integer(key, number);
+                    id = outputs_.idOf(number);
+                }
+                if (status != CommandInputStatus::Ok) return missing(field, value, status, key);
+                if (id < 0) return CommandResult::notFound("Output not found", key);
+                value.number = id;
+                break;
+            }
+            case CommandFieldType::Boolean: {
+                bool flag = false;
+                status = input.boolean(field.name, flag);
+                if (status != CommandInputStatus::Ok) return missing(field, value, status);
+                value.number = flag ? 1 : 0;
+                break;
+            }
+            case CommandFieldType::Text: {
+                TextView text;
+                status = input.text(field.name, text);
+                if (status != CommandInputStatus::Ok) return missing(field, value, status);
+                copyTrimmed(value.text, sizeof(value.text), text);
+                break;
+            }
+            case CommandFieldType::Outputs:
+                return readOutputs(field, input, value, args); // Sets 'present' itself
+        }
+        value.present = true;
+        return CommandResult::ok();
+    }
+
+    const CommandSpec* commands_;
+    uint8_t commandCount_;
+    const OutputPinMap& outputs_;
+    CommandMetrics metrics_;
+};
+
+// 'reply' into 'dest' if it fits, else an empty string. Returns the length.
+inline size_t copyCommandReply(char* dest, size_t size, const char* reply) {
+    const size_t length = strlen(reply);
+    if (length >= size) {
+        if (size > 0) dest[0] = '\0';
+        return 0;
+    }
+    memcpy(dest, reply, length + 1);
+    return length;
+}
+
+// JSON reply shared by HTTP and WebSocket: {"success":true}, {"status":"ok"}
+// or {"error":"Out of range","field":"groupId"}. A reply too long for 'size'
+// becomes {"success":true} or {"error":"Command failed"} instead of being
+// cut into invalid JSON. Returns the length.
+inline size_t formatCommandReply(char* dest, size_t size, const CommandResult& result) {
+    if (result.succeeded() && !result.message) return copyCommandReply(dest, size, "{\"success\":true}");
+    int length;
+    if (result.succeeded()) {
+        length = snprintf(dest, size, "{\"status\":\"%s\"}", result.message);
+    } else if (result.field) {
+        length = snprintf(dest, size, "{\"error\":\"%s\",\"field\":\"%s\"}", result.message, result.field);
+    } else {
+        length = snprintf(dest, size, "{\"error\":\"%s\"}", result.message);
+    }
+    if (length >= 0 && static_cast<size_t>(length) < size) return static_cast<size_t>(length);
+    return copyCommandReply(dest, size, result.succeeded() ? "{\"success\":true}" : "{\"error\":\"Command failed\"}");
+}
+
+#endif // COMMAND_ROUTER_H
@@ -20,7 +20,12 @@
 // WiFiManager Configuration
 #define WIFIMANAGER_AP_SSID "RailHub8266-Setup"  // Configuration portal AP name
 #define WIFIMANAGER_AP_PASSWORD "12345678"       // AP password (min 8 characters)
-#define WIFIMANAGER_TIMEOUT 180                   // Configuration portal timeout in seconds (3 min)
+#define WIFIMANAGER_TIMEOUT 300                   // Configuration portal timeout in seconds (5 min), then fallback AP
+#define WIFI_CONNECT_TIMEOUT_MS 30000             // Saved credentials get this long before the portal opens
+#define WIFI_RECONNECT_MIN_MS 1000                // Pause after the first failed reconnect attempt, doubling...
+#define WIFI_RECONNECT_MAX_MS 60000               // ...up to this
+#define WIFI_RECONNECT_ATTEMPT_MS 15000           // A reconnect attempt is given up after this
+#define WIFI_RECONNECT_JITTER_PERCENT 25          // Pauses vary by +/- this much
 #define PORTAL_TRIGGER_PIN 0                      // GPIO pin to trigger config portal (boot button)
 #define PORTAL_TRIGGER_DURATION 3000              // Hold duration in ms to trigger portal
 
@@ -36,4 +41,77 @@
 // EEPROM Configuration
 #define EEPROM_SIZE 512   // Allocate 512 bytes for configuration storage
 
+// JSON Arena Configuration (static, preallocated - no heap traffic per request)
+// Build fails if MAX_OUTPUTS / MAX_CHASING_GROUPS outgrow these (see main.cpp)
+#define JSON_REQUEST_ARENA_SIZE 3072     // Request parsing (one document at a time)
+#define JSON_STATUS_ARENA_SIZE 6912      // Status serialization (/api/status + WebSocket broadcast)
+#define JSON_REQUEST_NESTING_LIMIT 2     // Request bodies are an object holding at most a flat array
+
+// HTTP Server Configuration (polled from loop(), never blocks)
+#define HTTP_PORT 80
+#define HTTP_MAX_CONNECTIONS 4           // Concurrent connections; further clients wait in the accept backlog
+#define HTTP_REQUEST_BUFFER_SIZE 1024    // Per connection: request line + headers + body
+#define HTTP_MAX_BODY_SIZE 512           // Larger Content-Length is refused with 413 before the body is read
+#define HTTP_REQUEST_TIMEOUT_MS 5000     // Close if a request isn't complete within this time
+#define HTTP_WRITE_TIMEOUT_MS 10000      // Close if the client stops accepting response data
+#define HTTP_KEEPALIVE_TIMEOUT_MS 15000  // Idle keep-alive connections are closed after this
+#define HTTP_MAX_IDLE_CONNECTIONS 2      // Bounded idle pool; further clients get "Connection: close"
+#define HTTP_MAX_REQUESTS_PER_CONNECTION 100
+#define HTTP_LOW_HEAP_BYTES 8192         // Below this, idle connections are reclaimed and keep-alive refused
+
+// Admission Control (shed load before the heap runs out - arc42 TR-1)
+// Each stage applies below its free-heap OR largest-block threshold
+#define ADMISSION_WS_REJECT_HEAP 16384          // Refuse new WebSocket clients
+#define ADMISSION_WS_REJECT_BLOCK 6144
+#define ADMISSION_SHED_HEAP 12288               // 503 on non-essential endpoints (UI page, status, renames)
+#define ADMISSION_SHED_BLOCK 4096
+#define ADMISSION_THROTTLE_HEAP 9216            // Broadcast status at a reduced rate
+#define ADMISSION_THROTTLE_BLOCK 3072
+#define ADMISSION_HYSTERESIS_BYTES 2048         // Recovery needed before relaxing a stage
+#define ADMISSION_BROADCAST_SLOWDOWN 4          // Broadcast interval multiplier while throttled
+#define ADMISSION_SAMPLE_INTERVAL_MS 100
+
+// WebSocket Status Server (port 81)
+// Each client holds at most the newest status frame; it is written only when
+// the client's TCP send buffer has room, so a stalled client never blocks loop()
+#define WS_PORT 81
+#define WS_MAX_CLIENTS 4                 // Further clients are disconnected (<= WEBSOCKETS_SERVER_CLIENT_MAX)
+#define WS_SLOW_CLIENT_TIMEOUT_MS 3000   // Disconnect a client that can't take a new status for this long
+#define WS_TCP_SEND_BUFFER 2920          // TCP_SND_BUF of the lwIP variant platformio.ini selects (2 * 1460 MSS);
+                                         // status frames and events are written whole, so each must fit it
+
+// Server-Sent Events (GET /api/events) - status push for clients without WebSocket
+// Same queues, slow-client deadline and admission stage as the WebSocket clients
+#define SSE_MAX_STREAMS 2                // Each stream holds one of the HTTP_MAX_CONNECTIONS
+#define SSE_HEARTBEAT_MS 15000           // Comment line on quiet streams, detects vanished clients
+#define SSE_RETRY_MS 3000                // Reconnect delay suggested to EventSource clients
+
+// Status Snapshots (serialized once, shared by WebSocket frames and /api/status)
+#define STATUS_SNAPSHOT_SLOTS 2          // Current snapshot + one to build while HTTP responses send the old one
+#define STATUS_TELEMETRY_INTERVAL_MS 5000 // Rebuild this often for heap/uptime/diagnostics; state changes push at once
+#define STATUS_MAX_SUBSCRIPTION_CLASSES 4 // Distinct filtered documents (incl. the full one); extra filters get the full document
+
+// Output Engine
+#define OUTPUT_COMMAND_QUEUE_SIZE 8      // Commands between two engine ticks (power of two); more get 503
+#define FLIGHT_RECORDER_SIZE 2048        // Bytes of RAM for the input trace behind GET /api/trace (see flight_recorder.h), 0 = off
+
+// Cooperative Scheduler (loop() runs the task table in main.cpp by priority, see task_scheduler.h)
+#define SCHEDULER_PASS_BUDGET_US 4000    // Due network/telemetry tasks wait for the next pass once a pass has run this long
+#define SCHEDULER_MAX_DEFERRALS 8        // ...but run anyway after waiting this many passes in a row
+#define SCHEDULER_EFFECT_DEADLINE_MS 20  // Effect tick gap counted as a deadline miss
+
+// Idle Power Management (see idle_governor.h)
+// No clients and no work for POWER_IDLE_AFTER_MS: modem sleep while effects
+// or dimmed outputs need the CPU, light sleep otherwise. Requests to a
+// sleeping board wait for its next DTIM wakeup.
+#define POWER_IDLE_AFTER_MS 3000         // Quiet this long before the radio sleeps
+#define POWER_MAX_IDLE_MS 100            // Longest idle per loop() pass (button and serial console latency)
+#define POWER_DTIM_LISTEN_INTERVAL 3     // Wake every 3rd DTIM beacon while sleeping (1-10)
+#define POWER_LIGHT_SLEEP true           // false: modem sleep at most (serial input can be lost in light sleep)
+#define POWER_BOOST_PASS_US 2000         // A loop() pass longer than this switches the CPU to 160 MHz...
+#define POWER_BOOST_HOLD_MS 2000         // ...for this long after the last one, then back to 80 MHz
+
+// Serial Command Console (same commands as the HTTP API, "help" lists them)
+#define SERIAL_COMMAND_LINE_SIZE 96      // Longer lines are discarded
+
 #endif
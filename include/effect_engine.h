@@ -0,0 +1,307 @@
+#ifndef EFFECT_ENGINE_H
+#define EFFECT_ENGINE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "rtc_snapshot.h"
+
+// The output engine's state changes: commands, blink and chase steps, and
+// the snapshot capture/restore. The firmware and the trace replay
+// (trace_replay.h) both run them, so a replayed trace drives the outputs
+// through the code the device runs.
+// The clock is an argument everywhere and pins are written through the
+// OutputDriver passed in. Validation, logging, persistence and status
+// broadcasts stay with the callers in main.cpp.
+// Free of Arduino headers so the native tests can exercise it.
+
+const uint8_t CHASING_GROUP_MAX_OUTPUTS = 8;
+const uint8_t ENGINE_NAME_LENGTH = 20;
+
+// Chasing group structure
+struct ChasingGroup {
+    uint8_t groupId;
+    bool active;
+    char name[ENGINE_NAME_LENGTH + 1];
+    uint8_t outputIndices[CHASING_GROUP_MAX_OUTPUTS];
+    uint8_t outputCount;
+    uint16_t interval;     // Step interval in ms
+    uint8_t currentStep;   // Current active output in sequence
+    uint32_t lastStepTime;
+};
+
+// A change to the engine state, queued by a command handler and applied at
+// the start of the engine's next tick (see outputCommands in main.cpp)
+enum class OutputCommandType : uint8_t {
+    SetOutput,     // outputs[] = output IDs
+    SetInterval,   // outputs[] = output IDs
+    CreateGroup,   // target = group id, outputs[] = chase order
+    DeleteGroup,
+    RenameGroup,
+    RenameOutput   // target = output ID
+};
+
+struct OutputCommand {
+    OutputCommandType type;
+    uint8_t target;                                // Group commands
+    bool active;                                   // SetOutput
+    uint8_t brightness;                            // SetOutput, percent
+    uint16_t interval;                             // SetInterval, CreateGroup (ms)
+    uint8_t outputCount;                           // SetOutput, SetInterval, CreateGroup
+    uint8_t outputs[CHASING_GROUP_MAX_OUTPUTS];    // Output IDs
+    char name[ENGINE_NAME_LENGTH + 1];             // CreateGroup, RenameGroup, RenameOutput (empty = default)
+};
+
+// PWM duty for a brightness in percent, rounded like map() in the ESP8266 core
+inline uint8_t brightnessDuty(uint8_t percent) {
+    return static_cast<uint8_t>((static_cast<uint16_t>(percent) * 255 + 50) / 100);
+}
+
+// Brightness in percent for a PWM duty, the inverse of brightnessDuty()
+inline uint8_t brightnessPercent(uint8_t duty) {
+    return static_cast<uint8_t>((static_cast<uint16_t>(duty) * 100 + 127) / 255);
+}
+
+// Switch an output on at 'duty', or off
+template <typename Table, typename Driver>
+inline void setOutputLevel(Table& table, Driver& driver, uint8_t index, bool active, uint8_t duty) {
+    table.setOn(index, active);
+    table.setLit(index, active);
+    table.brightness[index] = duty;
+    driver.write(index, active ? duty : 0);
+}
+
+// New blink interval (0 = steady); an output that is on restarts lit
+template <typename Table, typename Driver>
+inline void setOutputBlink(Table& table, Driver& driver, uint8_t index, uint16_t intervalMs, uint32_t now) {
+    table.interval[index] = intervalMs;
+    table.lastToggleMs[index] = now;
+    if (table.isOn(index)) {
+        driver.write(index, table.brightness[index]);
+        table.setLit(index, true);
+    }
+}
+
+// Toggle the blinking outputs that are due and light steady ones not yet
+// written. True when an output changed.
+template <typename Table, typename Driver>
+inline bool stepBlinkingOutputs(Table& table, Driver& driver, uint32_t now) {
+    // Nothing on: nothing to step (one test of the on bitset)
+    if (table.on == 0) return false;
+
+    bool changed = false;
+    for (uint8_t i = 0; i < table.size(); i++) {
+        if (!table.isOn(i)) continue;
+        if (table.inGroup(i)) continue; // Driven by its chasing group
+
+        if (table.interval[i] > 0) {
+            if (now - table.lastToggleMs[i] >= table.interval[i]) {
+                table.lastToggleMs[i] = now;
+                driver.write(i, table.toggleLit(i) ? table.brightness[i] : 0);
+                changed = true;
+            }
+        } else if (!table.isLit(i)) {
+            driver.write(i, table.brightness[i]);
+            table.setLit(i, true);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// Advance every chasing group that is due by one output. 'onStep(group,
+// index, lit)' follows each write, for the serial trace. True when a group
+// stepped.
+template <typename Table, typename Driver, typename StepHook>
+inline bool stepChasingGroups(Table& table, Driver& driver, ChasingGroup* groups, uint8_t groupCount, uint32_t now,
+                              StepHook onStep) {
+    bool stepped = false;
+    for (uint8_t g = 0; g < groupCount; g++) {
+        ChasingGroup& group = groups[g];
+        if (!group.active || group.outputCount == 0) continue;
+        if (now - group.lastStepTime < group.interval) continue;
+
+        const uint8_t current = group.outputIndices[group.currentStep];
+        if (current < table.size()) {
+            driver.write(current, 0);
+            onStep(group, current, false);
+        }
+
+        group.currentStep = static_cast<uint8_t>((group.currentStep + 1) % group.outputCount);
+        group.lastStepTime = now;
+        stepped = true;
+
+        // The next output lights regardless of its own on flag
+        const uint8_t next = group.outputIndices[group.currentStep];
+        if (next < table.size()) {
+            driver.write(next, table.brightness[next]);
+            onStep(group, next, true);
+        }
+    }
+    return stepped;
+}
+
+// Slot of the active group 'groupId', else the first free slot, else -1
+inline int findChasingGroupSlot(const ChasingGroup* groups, uint8_t groupCount, uint8_t groupId) {
+    for (uint8_t i = 0; i < groupCount; i++) {
+        if (groups[i].active && groups[i].groupId == groupId) return i;
+    }
+    for (uint8_t i = 0; i < groupCount; i++) {
+        if (!groups[i].active) return i;
+    }
+    return -1;
+}
+
+// Custom name, or "Group <id>" when empty
+inline void setChasingGroupName(ChasingGroup& group, uint8_t groupId, const char* name) {
+    if (name != nullptr && name[0]) {
+        strncpy(group.name, name, ENGINE_NAME_LENGTH);
+        group.name[ENGINE_NAME_LENGTH] = '\0';
+    } else {
+        snprintf(group.name, sizeof(group.name), "Group %d", groupId);
+    }
+}
+
+// Set up 'group' to chase 'outputs' (already validated) from the first one
+template <typename Table, typename Driver>
+inline void startChasingGroup(Table& table, Driver& driver, ChasingGroup& group, uint8_t groupId,
+                              const uint8_t* outputs, uint8_t count, uint16_t intervalMs, const char* name,
+                              uint32_t now) {
+    // Clear old group memberships for these outputs (before setting new ones)
+    for (uint8_t i = 0; i < count; i++) table.group[outputs[i]] = Table::NO_GROUP;
+
+    group.groupId = groupId;
+    group.active = true;
+    setChasingGroupName(group, groupId, name);
+    group.outputCount = count;
+    group.interval = intervalMs;
+    group.currentStep = 0;
+    group.lastStepTime = now;
+
+    for (uint8_t i = 0; i < count; i++) {
+        const uint8_t index = outputs[i];
+        group.outputIndices[i] = index;
+        table.group[index] = groupId;
+        table.setOn(index, true);
+    }
+
+    // First output on, the rest off
+    for (uint8_t i = 0; i < count; i++) {
+        const uint8_t index = outputs[i];
+        driver.write(index, i == 0 ? table.brightness[index] : 0);
+    }
+}
+
+// Free the group's outputs, switched off, and the slot
+template <typename Table, typename Driver>
+inline void stopChasingGroup(Table& table, Driver& driver, ChasingGroup& group) {
+    for (uint8_t j = 0; j < group.outputCount; j++) {
+        const uint8_t index = group.outputIndices[j];
+        if (index >= table.size()) continue;
+        table.group[index] = Table::NO_GROUP;
+        driver.write(index, 0);
+        table.setOn(index, false);
+        table.setLit(index, false);
+    }
+    group.active = false;
+    group.outputCount = 0;
+}
+
+// Engine state into 'snapshot' (see rtc_snapshot.h), timers as ages at 'now'.
+// The RTC fields and the seal are the caller's.
+template <typename Snapshot, typename Table>
+inline void captureEffectState(Snapshot& snapshot, const Table& table, const ChasingGroup* groups, uint8_t groupCount,
+                               uint32_t now) {
+    snapshot.on = table.on;
+    snapshot.lit = table.lit;
+    for (uint8_t i = 0; i < table.size(); i++) {
+        snapshot.brightness[i] = table.brightness[i];
+        snapshot.group[i] = table.group[i];
+        snapshot.interval[i] = table.interval[i];
+        snapshot.toggleAgeMs[i] = now - table.lastToggleMs[i];
+    }
+    for (uint8_t g = 0; g < groupCount; g++) {
+        const ChasingGroup& group = groups[g];
+        typename Snapshot::Group& record = snapshot.groups[g];
+        record.groupId = group.groupId;
+        record.outputCount = group.active ? group.outputCount : 0;
+        record.currentStep = group.currentStep;
+        record.reserved = 0;
+        record.interval = group.interval;
+        memcpy(record.outputIndices, group.outputIndices, sizeof(record.outputIndices));
+        record.stepAgeMs = now - group.lastStepTime;
+    }
+}
+
+// Engine state from 'snapshot' at 'now', every blink and chase advanced by
+// 'gapMs' on top of the ages it stores. Group names become "Group <id>".
+// The pins are left alone (see driveEffectOutputs()).
+template <typename Snapshot, typename Table>
+inline void restoreEffectState(const Snapshot& snapshot, Table& table, ChasingGroup* groups, uint8_t groupCount,
+                               uint32_t now, uint32_t gapMs) {
+    table.on = static_cast<typename Table::Mask>(snapshot.on);
+    table.lit = static_cast<typename Table::Mask>(snapshot.lit);
+    for (uint8_t i = 0; i < table.size(); i++) {
+        table.brightness[i] = snapshot.brightness[i];
+        table.group[i] = snapshot.group[i];
+        table.interval[i] = snapshot.interval[i];
+        const EffectPhase phase = continuePhase(snapshot.toggleAgeMs[i] + gapMs, table.interval[i]);
+        if (table.isOn(i) && !table.inGroup(i) && (phase.steps & 1)) table.toggleLit(i);
+        table.lastToggleMs[i] = now - phase.intoStepMs;
+    }
+    for (uint8_t g = 0; g < groupCount; g++) {
+        const typename Snapshot::Group& record = snapshot.groups[g];
+        ChasingGroup& group = groups[g];
+        group.active = record.outputCount > 0 && record.outputCount <= sizeof(record.outputIndices);
+        group.outputCount = group.active ? record.outputCount : 0;
+        if (!group.active) continue;
+        group.groupId = record.groupId;
+        group.interval = record.interval;
+        memcpy(group.outputIndices, record.outputIndices, sizeof(group.outputIndices));
+        setChasingGroupName(group, group.groupId, nullptr);
+        const EffectPhase phase = continuePhase(record.stepAgeMs + gapMs, group.interval);
+        group.currentStep = static_cast<uint8_t>((record.currentStep + phase.steps) % group.outputCount);
+        group.lastStepTime = now - phase.intoStepMs;
+    }
+}
+
+// Warm-restart snapshot of the engine at 'now', stamped with the RTC clock
+// ('rtcTicks', one tick = 'rtcPeriodQ12' / 4096 us) and sealed
+template <typename Snapshot, typename Table>
+inline void captureEffectSnapshot(Snapshot& snapshot, const Table& table, const ChasingGroup* groups, uint8_t groupCount,
+                                  uint32_t now, uint32_t rtcTicks, uint32_t rtcPeriodQ12) {
+    snapshot.rtcTime = rtcTicks;
+    snapshot.rtcPeriodQ12 = rtcPeriodQ12;
+    snapshot.captures++;
+    captureEffectState(snapshot, table, groups, groupCount, now);
+    snapshot.seal();
+}
+
+// Engine state from a sealed warm-restart snapshot, continued across the
+// time the RTC clock counted since the capture (returned in 'gapMs').
+// False, with the engine and 'gapMs' untouched, when the seal does not match.
+template <typename Snapshot, typename Table>
+inline bool restoreEffectSnapshot(const Snapshot& snapshot, Table& table, ChasingGroup* groups, uint8_t groupCount,
+                                  uint32_t now, uint32_t rtcTicks, uint32_t& gapMs) {
+    if (!snapshot.valid()) return false;
+    gapMs = rtcElapsedMs(snapshot.rtcTime, rtcTicks, snapshot.rtcPeriodQ12);
+    restoreEffectState(snapshot, table, groups, groupCount, now, gapMs);
+    return true;
+}
+
+// Drive every pin from the engine state: free outputs at their blink phase,
+// each chasing group's current output lit
+template <typename Table, typename Driver>
+inline void driveEffectOutputs(const Table& table, Driver& driver, const ChasingGroup* groups, uint8_t groupCount) {
+    for (uint8_t i = 0; i < table.size(); i++) {
+        const bool lit = !table.inGroup(i) && table.isOn(i) && table.isLit(i);
+        driver.write(i, lit ? table.brightness[i] : 0);
+    }
+    for (uint8_t g = 0; g < groupCount; g++) {
+        const ChasingGroup& group = groups[g];
+        const uint8_t index = group.outputIndices[group.currentStep];
+        if (group.active && index < table.size()) driver.write(index, table.brightness[index]);
+    }
+}
+
+#endif // EFFECT_ENGINE_H
@@ -0,0 +1,423 @@
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "effect_engine.h"
+
+// Flight recorder: the device's inputs as a compact binary trace in a RAM
+// ring. It logs commands, the engine commands they post, WebSocket connects
+// and disconnects, and loop passes over budget, each with its millis() time.
+// It also periodically logs a keyframe of the engine state.
+// GET /api/trace downloads the ring, and trace_replay.h replays it on the
+// host with a virtual clock, so a stutter seen in the field can be
+// reproduced and profiled on a workstation.
+//
+// Record: [event u8][payload length u8][ms since the previous record, LEB128][payload]
+// When the ring is full the oldest records are evicted whole. The time of the
+// oldest record is kept as an absolute value, since its delta refers to an
+// evicted one. A keyframe is written once half the ring has been filled since
+// the last one, so a dump always starts from a known engine state as long as
+// a keyframe takes at most 1/8 of the ring.
+//
+// Download: trace header (formatTraceHeader()) followed by the records
+// oldest first, as two spans of the ring (span()). All values are
+// little-endian.
+// Free of Arduino headers so the native tests can exercise it.
+
+enum class TraceEvent : uint8_t {
+    Keyframe = 1,          // Engine state: the EffectSnapshot (rtc_snapshot.h) as laid out in memory
+    Command = 2,           // Command handled: [source << 6 | client][command index][CommandStatus]
+    OutputCommand = 3,     // Posted to the engine queue: encodeOutputCommand()
+    ClientConnect = 4,     // WebSocket client: [client][IPv4 address, 4 bytes]
+    ClientDisconnect = 5,  // [client]
+    PassOverrun = 6        // Loop pass over the pass budget, at its end: [duration us, u32]
+};
+
+enum class TraceSource : uint8_t {
+    Http,
+    WebSocket,
+    Serial
+};
+
+const uint8_t TRACE_UNKNOWN_COMMAND = 0xFF;     // Command index of a name the router didn't know
+const uint8_t TRACE_MAX_OUTPUT_COMMAND = 3 + 2 + 1 + CHASING_GROUP_MAX_OUTPUTS + 1 + ENGINE_NAME_LENGTH;
+const uint8_t TRACE_VERSION = 1;
+const size_t TRACE_HEADER_FIXED_SIZE = 32;      // Before the pin list and command names
+
+// Engine command as a record payload: [type | active << 7][target][brightness],
+// then the interval (u16), the output list ([count][ids]) and the name
+// ([length][chars]) for the types that use them. Returns the length.
+inline uint8_t encodeOutputCommand(const OutputCommand& command, uint8_t* dest) {
+    const OutputCommandType type = command.type;
+    uint8_t length = 0;
+    dest[length++] = static_cast<uint8_t>(static_cast<uint8_t>(type) | (command.active ? 0x80 : 0));
+    dest[length++] = command.target;
+    dest[length++] = command.brightness;
+    if (type == OutputCommandType::SetInterval || type == OutputCommandType::CreateGroup) {
+        dest[length++] = static_cast<uint8_t>(command.interval);
+        dest[length++] = static_cast<uint8_t>(command.interval >> 8);
+    }
+    if (type == OutputCommandType::SetOutput || type == OutputCommandType::SetInterval ||
+        type == OutputCommandType::CreateGroup) {
+        const uint8_t count = command.outputCount > CHASING_GROUP_MAX_OUTPUTS ? CHASING_GROUP_MAX_OUTPUTS
+                                                                                : command.outputCount;
+        dest[length++] = count;
+        memcpy(dest + length, command.outputs, count);
+        length = static_cast<uint8_t>(length + count);
+    }
+    if (type == OutputCommandType::CreateGroup || type == OutputCommandType::RenameGroup ||
+        type == OutputCommandType::RenameOutput) {
+        const uint8_t nameLength = static_cast<uint8_t>(strnlen(command.name, ENGINE_NAME_LENGTH));
+        dest[length++] = nameLength;
+        memcpy(dest + length, command.name, nameLength);
+        length = static_cast<uint8_t>(length + nameLength);
+    }
+    return length;
+}
+
+// False on a truncated or malformed payload
+inline bool decodeOutputCommand(const uint8_t* data, uint8_t length, OutputCommand& command) {
+    memset(&command, 0, sizeof(command));
+    if (length < 3) return false;
+    const uint8_t rawType = data[0] & 0x7F;
+    if (rawType > static_cast<uint8_t>(OutputCommandType::RenameOutput)) return false;
+    const OutputCommandType type = static_cast<OutputCommandType>(rawType);
+    command.type = type;
+    command.active = (data[0] & 0x80) != 0;
+    command.target = data[1];
+    command.brightness = data[2];
+    uint8_t at = 3;
+    if (type == OutputCommandType::SetInterval || type == OutputCommandType::CreateGroup) {
+        if (at + 2 > length) return false;
+        command.interval = static_cast<uint16_t>(data[at] | (data[at + 1] << 8));
+        at = static_cast<uint8_t>(at + 2);
+    }
+    if (type == OutputCommandType::SetOutput || type == OutputCommandType::SetInterval ||
+        type == OutputCommandType::CreateGroup) {
+        if (at >= length || data[at] > CHASING_GROUP_MAX_OUTPUTS || at + 1 + data[at] > length) return false;
+        command.outputCount = data[at];
+        memcpy(command.outputs, data + at + 1, command.outputCount);
+        at = static_cast<uint8_t>(at + 1 + command.outputCount);
+    }
+    if (type == OutputCommandType::CreateGroup || type == OutputCommandType::RenameGroup ||
+        type == OutputCommandType::RenameOutput) {
+        if (at >= length || data[at] > ENGINE_NAME_LENGTH || at + 1 + data[at] > length) return false;
+        memcpy(command.name, data + at + 1, data[at]);
+        at = static_cast<uint8_t>(at + 1 + data[at]);
+    }
+    return at == length;
+}
+
+inline void putTraceU32(uint8_t* dest, uint32_t value) {
+    for (uint8_t i = 0; i < 4; i++) dest[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+inline uint32_t getTraceU32(const uint8_t* data) {
+    return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+           (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+struct FlightRecorderMetrics {
+    uint32_t recorded;    // Records written since boot
+    uint32_t evicted;     // Oldest records overwritten
+    uint32_t dropped;     // Not recorded: held for a download, or too large
+    uint32_t keyframes;
+    uint32_t bytes;       // In the ring now
+};
+
+template <size_t Capacity>
+class FlightRecorder {
+    static_assert(Capacity == 0 || Capacity >= 64, "A flight recorder ring below 64 bytes holds next to nothing");
+
+public:
+    static const size_t HEADER_MAX = 7;   // Event, length, 5-byte LEB128 delta
+
+    FlightRecorder()
+        : head_(0), used_(0), firstMs_(0), lastMs_(0), sinceKeyframe_(Capacity), held_(false) {
+        memset(&metrics_, 0, sizeof(metrics_));
+    }
+
+    static size_t capacity() { return Capacity; }
+    static bool enabled() { return Capacity > 0; }
+
+    bool record(TraceEvent event, uint32_t nowMs, const uint8_t* payload, uint8_t length) {
+        if (Capacity == 0) return false;
+        if (held_ || HEADER_MAX + length > Capacity) {
+            metrics_.dropped++;
+            return false;
+        }
+        // Evict until the record fits; the delta of a record into an empty ring is 0
+        uint8_t header[HEADER_MAX];
+        size_t headerLength = encodeHeader(event, length, used_ ? nowMs - lastMs_ : 0, header);
+        while (Capacity - used_ < headerLength + length) {
+            evictOldest();
+            if (used_ == 0) headerLength = encodeHeader(event, length, 0, header);
+        }
+        if (used_ == 0) firstMs_ = nowMs;
+        write(header, headerLength);
+        write(payload, length);
+        lastMs_ = nowMs;
+        metrics_.recorded++;
+        if (event == TraceEvent::Keyframe) {
+            metrics_.keyframes++;
+            sinceKeyframe_ = 0;
+        } else {
+            sinceKeyframe_ += headerLength + length;
+        }
+        return true;
+    }
+
+    // Typed records (see TraceEvent)
+    bool recordCommand(uint32_t nowMs, TraceSource source, uint8_t client, uint8_t commandIndex, uint8_t status) {
+        const uint8_t payload[3] = {static_cast<uint8_t>((static_cast<uint8_t>(source) << 6) | (client & 0x3F)),
+                                    commandIndex, status};
+        return record(TraceEvent::Command, nowMs, payload, sizeof(payload));
+    }
+
+    bool recordOutputCommand(uint32_t nowMs, const OutputCommand& command) {
+        uint8_t payload[TRACE_MAX_OUTPUT_COMMAND];
+        return record(TraceEvent::OutputCommand, nowMs, payload, encodeOutputCommand(command, payload));
+    }
+
+    bool recordConnect(uint32_t nowMs, uint8_t client, const uint8_t (&address)[4]) {
+        const uint8_t payload[5] = {client, address[0], address[1], address[2], address[3]};
+        return record(TraceEvent::ClientConnect, nowMs, payload, sizeof(payload));
+    }
+
+    bool recordDisconnect(uint32_t nowMs, uint8_t client) {
+        return record(TraceEvent::ClientDisconnect, nowMs, &client, 1);
+    }
+
+    bool recordOverrun(uint32_t nowMs, uint32_t passUs) {
+        uint8_t payload[4];
+        putTraceU32(payload, passUs);
+        return record(TraceEvent::PassOverrun, nowMs, payload, sizeof(payload));
+    }
+
+    // Half the ring written since the last keyframe (or none yet)
+    bool keyframeDue() const { return Capacity > 0 && !held_ && sinceKeyframe_ >= Capacity / 2; }
+
+    // Freeze the ring while a download sends it; records arriving meanwhile are dropped
+    void hold() { held_ = true; }
+    void release() { held_ = false; }
+    bool held() const { return held_; }
+
+    // The records oldest first: span 0 up to the end of the buffer, span 1 from its start
+    size_t span(uint8_t index, const uint8_t*& data) const {
+        const size_t tail = tailIndex();
+        const size_t first = tail + used_ > Capacity ? Capacity - tail : used_;
+        data = index == 0 ? buffer_ + tail : buffer_;
+        return index == 0 ? first : used_ - first;
+    }
+
+    size_t size() const { return used_; }
+    uint32_t firstMs() const { return firstMs_; }
+
+    FlightRecorderMetrics metrics() const {
+        FlightRecorderMetrics metrics = metrics_;
+        metrics.bytes = static_cast<uint32_t>(used_);
+        return metrics;
+    }
+
+private:
+    static size_t encodeHeader(TraceEvent event, uint8_t length, uint32_t deltaMs, uint8_t* dest) {
+        size_t at = 0;
+        dest[at++] = static_cast<uint8_t>(event);
+        dest[at++] = length;
+        do {
+            const uint8_t low = static_cast<uint8_t>(deltaMs & 0x7F);
+            deltaMs >>= 7;
+            dest[at++] = static_cast<uint8_t>(low | (deltaMs ? 0x80 : 0));
+        } while (deltaMs);
+        return at;
+    }
+
+    size_t tailIndex() const { return (head_ + Capacity - used_) % (Capacity ? Capacity : 1); }
+
+    uint8_t byteAt(size_t offset) const { return buffer_[(tailIndex() + offset) % (Capacity ? Capacity : 1)]; }
+
+    // Delta and total length of the record at 'offset' bytes from the tail
+    size_t recordAt(size_t offset, uint32_t& deltaMs) const {
+        size_t at = offset + 2;
+        deltaMs = 0;
+        for (uint8_t shift = 0; shift < 35; shift = static_cast<uint8_t>(shift + 7)) {
+            const uint8_t byte = byteAt(at++);
+            deltaMs |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) break;
+        }
+        return at - offset + byteAt(offset + 1);
+    }
+
+    void evictOldest() {
+        uint32_t deltaMs;
+        used_ -= recordAt(0, deltaMs);
+        metrics_.evicted++;
+        if (used_ > 0) {
+            recordAt(0, deltaMs);
+            firstMs_ += deltaMs;
+        }
+    }
+
+    void write(const uint8_t* data, size_t length) {
+        for (size_t i = 0; i < length; i++) {
+            buffer_[head_] = data[i];
+            head_ = head_ + 1 == Capacity ? 0 : head_ + 1;
+        }
+        used_ += length;
+    }
+
+    uint8_t buffer_[Capacity ? Capacity : 1];
+    size_t head_;             // Next byte to write
+    size_t used_;
+    uint32_t firstMs_;        // Time of the oldest record
+    uint32_t lastMs_;         // Time of the newest record
+    size_t sinceKeyframe_;    // Bytes recorded since the last keyframe
+    bool held_;
+    FlightRecorderMetrics metrics_;
+};
+
+// Trace header, TRACE_HEADER_FIXED_SIZE bytes then the variable part:
+//   0  "RHT" + TRACE_VERSION    16 records since boot
+//   4  outputs, groups,         20 evicted
+//      outputs per group,       24 dropped
+//      command count            28 record bytes that follow the header
+//   8  time of the oldest record (ms)
+//  12  time of the download (ms)
+//  32  GPIO of each output, then the command names, each NUL-terminated.
+// 'nameOf(index)' gives the name of command 'index'. Returns the header
+// length, 0 when it doesn't fit 'size'.
+template <size_t Capacity, typename NameOf>
+inline size_t formatTraceHeader(uint8_t* dest, size_t size, const FlightRecorder<Capacity>& recorder,
+                                const uint8_t* pins, uint8_t outputs, uint8_t groups, uint8_t commandCount,
+                                NameOf nameOf, uint32_t nowMs) {
+    size_t length = TRACE_HEADER_FIXED_SIZE + outputs;
+    for (uint8_t i = 0; i < commandCount; i++) length += strlen(nameOf(i)) + 1;
+    if (length > size) return 0;
+
+    const FlightRecorderMetrics metrics = recorder.metrics();
+    dest[0] = 'R';
+    dest[1] = 'H';
+    dest[2] = 'T';
+    dest[3] = TRACE_VERSION;
+    dest[4] = outputs;
+    dest[5] = groups;
+    dest[6] = CHASING_GROUP_MAX_OUTPUTS;
+    dest[7] = commandCount;
+    putTraceU32(dest + 8, recorder.firstMs());
+    putTraceU32(dest + 12, nowMs);
+    putTraceU32(dest + 16, metrics.recorded);
+    putTraceU32(dest + 20, metrics.evicted);
+    putTraceU32(dest + 24, metrics.dropped);
+    putTraceU32(dest + 28, metrics.bytes);
+    memcpy(dest + TRACE_HEADER_FIXED_SIZE, pins, outputs);
+    size_t at = TRACE_HEADER_FIXED_SIZE + outputs;
+    for (uint8_t i = 0; i < commandCount; i++) {
+        const size_t nameLength = strlen(nameOf(i)) + 1;
+        memcpy(dest + at, nameOf(i), nameLength);
+        at += nameLength;
+    }
+    return at;
+}
+
+struct TraceRecord {
+    TraceEvent event;
+    uint32_t timeMs;
+    const uint8_t* payload;
+    uint8_t length;
+};
+
+// Reads a downloaded trace: header fields, then the records in order
+class TraceReader {
+public:
+    TraceReader() : data_(nullptr), length_(0), records_(0), at_(0), timeMs_(0), first_(true), malformed_(false) {}
+
+    // False when 'data' isn't a complete trace of this version
+    bool open(const uint8_t* data, size_t length) {
+        data_ = data;
+        length_ = length;
+        malformed_ = true;
+        if (length < TRACE_HEADER_FIXED_SIZE || data[0] != 'R' || data[1] != 'H' || data[2] != 'T' ||
+            data[3] != TRACE_VERSION) {
+            return false;
+        }
+        size_t at = TRACE_HEADER_FIXED_SIZE + outputs();
+        for (uint8_t i = 0; i < commandCount(); i++) {
+            while (at < length && data[at] != '\0') at++;
+            if (at++ >= length) return false;
+        }
+        if (at > length || length - at != getTraceU32(data + 28)) return false;
+        records_ = at;
+        malformed_ = false;
+        rewind();
+        return true;
+    }
+
+    void rewind() {
+        at_ = records_;
+        timeMs_ = firstMs();
+        first_ = true;
+    }
+
+    uint8_t outputs() const { return data_[4]; }
+    uint8_t groups() const { return data_[5]; }
+    uint8_t outputsPerGroup() const { return data_[6]; }
+    uint8_t commandCount() const { return data_[7]; }
+    uint32_t firstMs() const { return getTraceU32(data_ + 8); }
+    uint32_t endMs() const { return getTraceU32(data_ + 12); }
+    uint32_t recorded() const { return getTraceU32(data_ + 16); }
+    uint32_t evicted() const { return getTraceU32(data_ + 20); }
+    uint32_t dropped() const { return getTraceU32(data_ + 24); }
+    const uint8_t* pins() const { return data_ + TRACE_HEADER_FIXED_SIZE; }
+
+    // Name of command 'index', "?" for TRACE_UNKNOWN_COMMAND or out of range
+    const char* commandName(uint8_t index) const {
+        if (index >= commandCount()) return "?";
+        const char* name = reinterpret_cast<const char*>(data_ + TRACE_HEADER_FIXED_SIZE + outputs());
+        for (uint8_t i = 0; i < index; i++) name += strlen(name) + 1;
+        return name;
+    }
+
+    // False at the end, or at a record running past it (malformed())
+    bool next(TraceRecord& record) {
+        if (malformed_ || at_ >= length_) return false;
+        if (length_ - at_ < 3) return fail();
+        record.event = static_cast<TraceEvent>(data_[at_]);
+        record.length = data_[at_ + 1];
+        size_t at = at_ + 2;
+        uint32_t deltaMs = 0;
+        for (uint8_t shift = 0;; shift = static_cast<uint8_t>(shift + 7)) {
+            if (at >= length_ || shift >= 35) return fail();
+            const uint8_t byte = data_[at++];
+            deltaMs |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) break;
+        }
+        if (length_ - at < record.length) return fail();
+        // The oldest record's delta refers to an evicted one: firstMs() is its time
+        timeMs_ = first_ ? firstMs() : timeMs_ + deltaMs;
+        first_ = false;
+        record.timeMs = timeMs_;
+        record.payload = data_ + at;
+        at_ = at + record.length;
+        return true;
+    }
+
+    bool malformed() const { return malformed_; }
+
+private:
+    bool fail() {
+        malformed_ = true;
+        return false;
+    }
+
+    const uint8_t* data_;
+    size_t length_;
+    size_t records_;   // Offset of the first record
+    size_t at_;
+    uint32_t timeMs_;
+    bool first_;
+    bool malformed_;
+};
+
+#endif // FLIGHT_RECORDER_H
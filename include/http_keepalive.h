@@ -0,0 +1,36 @@
+#ifndef HTTP_KEEPALIVE_H
+#define HTTP_KEEPALIVE_H
+
+#include <stdint.h>
+
+// Keep-alive policy for the HTTP server.
+// Reusing a connection saves the lwIP PCB allocation, the TIME_WAIT entry and
+// the heap dip of a fresh TCP handshake per request, but every idle connection
+// still pins a PCB and its receive window. The pool of idle connections is
+// therefore bounded and given up first when the heap runs low.
+// Free of Arduino headers so the native tests can exercise it.
+
+struct HttpKeepAliveLimits {
+    uint16_t maxRequestsPerConnection;
+    uint8_t maxIdleConnections;
+    uint32_t lowHeapBytes;        // Below this: no new keep-alive, reclaim idle connections
+};
+
+// Decide whether a connection stays open once its current response is written.
+// 'streamInSync' is false when the request could not be parsed, because the
+// position of the next request in the byte stream is then unknown.
+inline bool httpKeepConnection(bool clientWantsKeepAlive, bool streamInSync, uint16_t requestsServed,
+                               uint8_t otherIdleConnections, uint32_t freeHeap,
+                               const HttpKeepAliveLimits& limits) {
+    if (!clientWantsKeepAlive || !streamInSync) return false;
+    if (requestsServed >= limits.maxRequestsPerConnection) return false;
+    if (otherIdleConnections >= limits.maxIdleConnections) return false;
+    return freeHeap >= limits.lowHeapBytes;
+}
+
+// Idle connections are reclaimed immediately under memory pressure
+inline bool httpReclaimIdle(uint32_t freeHeap, const HttpKeepAliveLimits& limits) {
+    return freeHeap < limits.lowHeapBytes;
+}
+
+#endif // HTTP_KEEPALIVE_H
@@ -0,0 +1,290 @@
+#ifndef HTTP_PARSER_H
+#define HTTP_PARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "text_buffer.h"
+
+// Incremental HTTP/1.x request parser working in a fixed per-connection buffer.
+// Bytes are appended as they arrive (writePtr()/commit()); the request line,
+// headers and body are exposed as TextViews into the buffer once complete.
+// Bytes past the end of the current request stay buffered for the next one.
+// Bodies are capped at MaxBodySize: a larger Content-Length is refused with
+// 413 as soon as the head is parsed, before any of the body is read.
+// Free of Arduino headers so the native tests can exercise it.
+
+enum class HttpMethod : uint8_t {
+    Unknown,
+    Get,
+    Post,
+    Head,
+    Options
+};
+
+inline bool asciiEqualsIgnoreCase(TextView text, const char* other) {
+    const size_t otherLength = strlen(other);
+    if (otherLength != text.length) return false;
+    for (size_t i = 0; i < otherLength; i++) {
+        char a = text.data[i];
+        char b = other[i];
+        if (a >= 'A' && a <= 'Z') a = static_cast<char>(a - 'A' + 'a');
+        if (b >= 'A' && b <= 'Z') b = static_cast<char>(b - 'A' + 'a');
+        if (a != b) return false;
+    }
+    return true;
+}
+
+// Parse an unsigned decimal number; false on empty input, junk or overflow
+inline bool parseDecimal(TextView text, uint32_t& value) {
+    if (text.empty() || text.length > 9) return false;
+    uint32_t result = 0;
+    for (size_t i = 0; i < text.length; i++) {
+        const char c = text.data[i];
+        if (c < '0' || c > '9') return false;
+        result = result * 10 + static_cast<uint32_t>(c - '0');
+    }
+    value = result;
+    return true;
+}
+
+// Value of 'name' in a query string ("a=1&b=2"), without percent-decoding.
+// Returns false if the parameter is absent; "flag" and "flag=" yield an empty value.
+inline bool httpQueryParam(TextView query, const char* name, TextView& value) {
+    const size_t nameLength = strlen(name);
+    size_t pos = 0;
+    while (pos < query.length) {
+        size_t end = pos;
+        while (end < query.length && query.data[end] != '&') end++;
+        const char* pair = query.data + pos;
+        const size_t pairLength = end - pos;
+        if (pairLength >= nameLength && memcmp(pair, name, nameLength) == 0 &&
+            (pairLength == nameLength || pair[nameLength] == '=')) {
+            value = pairLength == nameLength ? TextView()
+                                             : TextView(pair + nameLength + 1, pairLength - nameLength - 1);
+            return true;
+        }
+        pos = end + 1;
+    }
+    return false;
+}
+
+// If-None-Match check with weak comparison (RFC 9110 13.1.2): the header is
+// "*" or a comma-separated list of entity tags, each optionally prefixed "W/"
+inline bool httpETagMatches(TextView ifNoneMatch, const char* etag) {
+    TextView wanted = TextView::fromCString(etag);
+    if (wanted.length >= 2 && wanted.data[0] == 'W' && wanted.data[1] == '/') {
+        wanted = TextView(wanted.data + 2, wanted.length - 2);
+    }
+    size_t pos = 0;
+    while (pos < ifNoneMatch.length) {
+        size_t end = pos;
+        while (end < ifNoneMatch.length && ifNoneMatch.data[end] != ',') end++;
+        TextView tag = trimText(TextView(ifNoneMatch.data + pos, end - pos));
+        if (tag.equals("*")) return true;
+        if (tag.length >= 2 && tag.data[0] == 'W' && tag.data[1] == '/') {
+            tag = TextView(tag.data + 2, tag.length - 2);
+        }
+        if (tag.length == wanted.length && memcmp(tag.data, wanted.data, tag.length) == 0) return true;
+        pos = end + 1;
+    }
+    return false;
+}
+
+template <size_t BufferSize, size_t MaxBodySize = BufferSize>
+class HttpRequestParser {
+public:
+    enum State : uint8_t {
+        ReadingHead,
+        ReadingBody,
+        Complete,
+        Failed
+    };
+
+    HttpRequestParser() { reset(); }
+
+    // Drop everything, including pipelined bytes
+    void reset() {
+        received_ = 0;
+        clearRequest();
+    }
+
+    // Discard the completed request, keep any bytes that followed it
+    void nextRequest() {
+        if (state_ != Complete) {
+            reset();
+            return;
+        }
+        const size_t requestEnd = bodyStart_ + contentLength_;
+        const size_t leftover = received_ - requestEnd;
+        if (leftover > 0) {
+            memmove(buffer_, buffer_ + requestEnd, leftover);
+        }
+        received_ = leftover;
+        clearRequest();
+        parse();
+    }
+
+    char* writePtr() { return buffer_ + received_; }
+    size_t writableSpace() const { return state_ == Failed ? 0 : BufferSize - received_; }
+    bool hasBufferedData() const { return received_ > 0; }
+
+    // Account for bytes written to writePtr() and advance the parser
+    State commit(size_t count) {
+        if (count > writableSpace()) count = writableSpace();
+        received_ += count;
+        return parse();
+    }
+
+    State state() const { return state_; }
+    uint16_t errorStatus() const { return errorStatus_; }
+
+    HttpMethod method() const { return method_; }
+    TextView path() const { return path_; }
+    TextView query() const { return query_; }
+    TextView body() const { return TextView(buffer_ + bodyStart_, contentLength_); }
+    uint32_t contentLength() const { return contentLength_; }
+    uint8_t versionMinor() const { return versionMinor_; }
+
+    // HTTP/1.1 defaults to persistent connections, HTTP/1.0 must opt in
+    bool keepAlive() const {
+        const TextView connection = header("Connection");
+        if (asciiEqualsIgnoreCase(connection, "close")) return false;
+        if (versionMinor_ == 0) return asciiEqualsIgnoreCase(connection, "keep-alive");
+        return true;
+    }
+
+    // Case-insensitive header lookup in the raw head (empty until the head is complete)
+    TextView header(const char* name) const {
+        if (headEnd_ == 0) return TextView();
+        size_t pos = headersStart_;
+        while (pos < headEnd_) {
+            const size_t lineEnd = findLineEnd(pos, headEnd_);
+            if (lineEnd == pos || lineEnd >= headEnd_) break;
+            const char* line = buffer_ + pos;
+            const char* colon = static_cast<const char*>(memchr(line, ':', lineEnd - pos));
+            if (colon != nullptr && asciiEqualsIgnoreCase(TextView(line, colon - line), name)) {
+                return trimText(TextView(colon + 1, buffer_ + lineEnd - (colon + 1)));
+            }
+            pos = lineEnd + 2;
+        }
+        return TextView();
+    }
+
+    static size_t capacity() { return BufferSize; }
+    static size_t maxBodySize() { return MaxBodySize; }
+
+private:
+    void clearRequest() {
+        state_ = ReadingHead;
+        errorStatus_ = 0;
+        method_ = HttpMethod::Unknown;
+        path_ = TextView();
+        query_ = TextView();
+        headersStart_ = 0;
+        headEnd_ = 0;
+        bodyStart_ = 0;
+        contentLength_ = 0;
+        versionMinor_ = 1;
+        scanned_ = 0;
+    }
+
+    State fail(uint16_t status) {
+        state_ = Failed;
+        errorStatus_ = status;
+        return state_;
+    }
+
+    // Index of the next CRLF at or after 'from' (limit if there is none before it)
+    size_t findLineEnd(size_t from, size_t limit) const {
+        for (size_t i = from; i + 1 < limit; i++) {
+            if (buffer_[i] == '\r' && buffer_[i + 1] == '\n') return i;
+        }
+        return limit;
+    }
+
+    State parse() {
+        if (state_ == ReadingHead) {
+            // Look for the blank line terminating the head, resuming where we left off
+            size_t i = scanned_ >= 3 ? scanned_ - 3 : 0;
+            for (; i + 3 < received_; i++) {
+                if (buffer_[i] == '\r' && buffer_[i + 1] == '\n' && buffer_[i + 2] == '\r' && buffer_[i + 3] == '\n') {
+                    break;
+                }
+            }
+            scanned_ = received_;
+            if (i + 3 >= received_) {
+                return received_ >= BufferSize ? fail(431) : state_;
+            }
+            headEnd_ = i + 2;      // Points at the terminating empty line
+            bodyStart_ = i + 4;
+            if (!parseHead()) return state_;
+            state_ = ReadingBody;
+        }
+        if (state_ == ReadingBody && received_ - bodyStart_ >= contentLength_) {
+            state_ = Complete;
+        }
+        return state_;
+    }
+
+    bool parseHead() {
+        const size_t lineEnd = findLineEnd(0, headEnd_);
+        const TextView line(buffer_, lineEnd);
+        headersStart_ = lineEnd + 2;
+
+        // METHOD SP request-target SP HTTP/1.x
+        const char* sp1 = static_cast<const char*>(memchr(line.data, ' ', line.length));
+        if (sp1 == nullptr) { fail(400); return false; }
+        const char* targetStart = sp1 + 1;
+        const char* lineEndPtr = line.data + line.length;
+        const char* sp2 = static_cast<const char*>(memchr(targetStart, ' ', lineEndPtr - targetStart));
+        if (sp2 == nullptr || sp2 == targetStart) { fail(400); return false; }
+
+        const TextView methodText(line.data, sp1 - line.data);
+        if (methodText.equals("GET")) method_ = HttpMethod::Get;
+        else if (methodText.equals("POST")) method_ = HttpMethod::Post;
+        else if (methodText.equals("HEAD")) method_ = HttpMethod::Head;
+        else if (methodText.equals("OPTIONS")) method_ = HttpMethod::Options;
+        else { fail(501); return false; }
+
+        const TextView version(sp2 + 1, lineEndPtr - (sp2 + 1));
+        if (version.length != 8 || memcmp(version.data, "HTTP/1.", 7) != 0) { fail(505); return false; }
+        versionMinor_ = version.data[7] == '0' ? 0 : 1;
+
+        const TextView target(targetStart, sp2 - targetStart);
+        const char* question = static_cast<const char*>(memchr(target.data, '?', target.length));
+        if (question != nullptr) {
+            path_ = TextView(target.data, question - target.data);
+            query_ = TextView(question + 1, target.data + target.length - (question + 1));
+        } else {
+            path_ = target;
+        }
+
+        if (!header("Transfer-Encoding").empty()) { fail(501); return false; } // Chunked uploads not supported
+
+        const TextView lengthText = header("Content-Length");
+        if (!lengthText.empty()) {
+            uint32_t length = 0;
+            if (!parseDecimal(lengthText, length)) { fail(400); return false; }
+            if (length > MaxBodySize || length > BufferSize - bodyStart_) { fail(413); return false; }
+            contentLength_ = length;
+        }
+        return true;
+    }
+
+    char buffer_[BufferSize];
+    size_t received_;
+    size_t scanned_;
+    State state_;
+    uint16_t errorStatus_;
+    HttpMethod method_;
+    TextView path_;
+    TextView query_;
+    size_t headersStart_;
+    size_t headEnd_;
+    size_t bodyStart_;
+    uint32_t contentLength_;
+    uint8_t versionMinor_;
+};
+
+#endif // HTTP_PARSER_H
@@ -0,0 +1,259 @@
+#ifndef HTTP_SERVER_H
+#define HTTP_SERVER_H
+
+#include <ESP8266WiFi.h>
+#include "config.h"
+#include "http_parser.h"
+#include "http_keepalive.h"
+#include "admission_control.h"
+
+// Polled, non-blocking HTTP/1.1 server replacing ESP8266WebServer.
+// ESP8266WebServer serves one client at a time and blocks loop() while it
+// reads the request and writes the response. Here every connection is a small
+// state machine advanced by poll(): requests are parsed incrementally as bytes
+// arrive and responses are written only as far as the TCP send buffer has room,
+// so a slow client never stalls effects, WebSocket pumping or other clients.
+// HTTP/1.1 connections are kept alive and may pipeline requests; the idle
+// pool is bounded and reclaimed under memory pressure (http_keepalive.h).
+// Streamed responses (Server-Sent Events) keep their connection after the
+// head; the application writes to them through the stream* methods.
+// All buffers are fixed-size and allocated once with the server.
+
+typedef HttpRequestParser<HTTP_REQUEST_BUFFER_SIZE, HTTP_MAX_BODY_SIZE> HttpConnectionParser;
+
+// Read-only view of a complete request, valid for the duration of the handler
+class HttpRequest {
+public:
+    HttpRequest(const HttpConnectionParser& parser, const IPAddress& remoteIP, uint8_t connectionId)
+        : parser_(parser), remoteIP_(remoteIP), connectionId_(connectionId) {}
+
+    HttpMethod method() const { return parser_.method(); }
+    TextView path() const { return parser_.path(); }
+    TextView query() const { return parser_.query(); }
+    TextView body() const { return parser_.body(); }
+    TextView header(const char* name) const { return parser_.header(name); }
+    const IPAddress& remoteIP() const { return remoteIP_; }
+
+    // Identifies the connection for HttpServer::stream*() after beginStream()
+    uint8_t connectionId() const { return connectionId_; }
+
+private:
+    const HttpConnectionParser& parser_;
+    IPAddress remoteIP_;
+    uint8_t connectionId_;
+};
+
+typedef void (*HttpReleaseCallback)(void* context);
+
+// Response assembled by a handler: status, content type and up to
+// HTTP_MAX_BODY_SEGMENTS body segments in RAM or flash. Segments are
+// referenced, not copied, so their memory must stay valid until the response
+// has been written (string literals, PROGMEM, static buffers). Buffers that
+// may change in the meantime are protected with onRelease().
+class HttpResponse {
+public:
+    static const uint8_t HTTP_MAX_BODY_SEGMENTS = 4;
+
+    struct Segment {
+        const char* data;
+        size_t length;
+        bool inFlash;
+    };
+
+    HttpResponse() { clear(); }
+
+    void clear() {
+        status_ = 0;
+        contentType_ = nullptr;
+        segmentCount_ = 0;
+        contentLength_ = 0;
+        headers_ = nullptr;
+        streaming_ = false;
+        release_ = nullptr;
+        releaseContext_ = nullptr;
+    }
+
+    void begin(uint16_t status, const char* contentType) {
+        status_ = status;
+        contentType_ = contentType;
+    }
+
+    bool add(const char* data, size_t length) { return addSegment(data, length, false); }
+    bool add(const char* text) { return add(text, strlen(text)); }
+    bool add_P(PGM_P data, size_t length) { return addSegment(data, length, true); }
+
+    // Long-lived 200 response without Content-Length: after the head and any
+    // added segments the connection stays open for HttpServer::streamWrite()
+    // until either side closes it (then the release callback runs)
+    void beginStream(const char* contentType) {
+        begin(200, contentType);
+        streaming_ = true;
+    }
+
+    void send(uint16_t status, const char* contentType, const char* body) {
+        begin(status, contentType);
+        add(body);
+    }
+
+    void send(uint16_t status, const char* contentType, const char* body, size_t length) {
+        begin(status, contentType);
+        add(body, length);
+    }
+
+    // Extra header lines, each ending in CRLF. Copied into the response head
+    // as soon as the handler returns, so a shared static buffer is fine.
+    void setHeaders(const char* headers) { headers_ = headers; }
+
+    // Called exactly once when the segments are no longer referenced
+    // (response written, connection aborted or HEAD request answered)
+    void onRelease(HttpReleaseCallback callback, void* context = nullptr) {
+        release_ = callback;
+        releaseContext_ = context;
+    }
+
+    void release() {
+        HttpReleaseCallback callback = release_;
+        release_ = nullptr;
+        if (callback) callback(releaseContext_);
+    }
+
+    bool started() const { return status_ != 0; }
+    bool streaming() const { return streaming_; }
+    uint16_t status() const { return status_; }
+    const char* contentType() const { return contentType_; }
+    const char* headers() const { return headers_; }
+    size_t contentLength() const { return contentLength_; }
+    uint8_t segmentCount() const { return segmentCount_; }
+    const Segment& segment(uint8_t index) const { return segments_[index]; }
+
+private:
+    bool addSegment(const char* data, size_t length, bool inFlash) {
+        if (segmentCount_ >= HTTP_MAX_BODY_SEGMENTS) return false;
+        if (length == 0) return true;
+        segments_[segmentCount_].data = data;
+        segments_[segmentCount_].length = length;
+        segments_[segmentCount_].inFlash = inFlash;
+        segmentCount_++;
+        contentLength_ += length;
+        return true;
+    }
+
+    uint16_t status_;
+    const char* contentType_;
+    Segment segments_[HTTP_MAX_BODY_SEGMENTS];
+    uint8_t segmentCount_;
+    size_t contentLength_;
+    const char* headers_;
+    bool streaming_;
+    HttpReleaseCallback release_;
+    void* releaseContext_;
+};
+
+typedef void (*HttpHandler)(const HttpRequest& request, HttpResponse& response);
+
+// Non-essential routes are answered with 503 while the admission controller
+// sheds load; essential ones (output control, effects) are always served
+enum class HttpRouteClass : uint8_t {
+    Essential,
+    NonEssential
+};
+
+class HttpServer {
+public:
+    static const uint8_t HTTP_MAX_ROUTES = 16;
+    static const size_t HTTP_RESPONSE_HEAD_SIZE = 256;
+
+    explicit HttpServer(uint16_t port);
+
+    // Register a handler for an exact path; GET routes also answer HEAD
+    bool on(const char* path, HttpMethod method, HttpHandler handler,
+            HttpRouteClass routeClass = HttpRouteClass::Essential);
+
+    void setAdmissionController(AdmissionController* admission) { admission_ = admission; }
+
+    void begin();
+
+    // Accept, read, dispatch and write without blocking; call every loop()
+    void poll();
+
+    uint8_t activeConnections() const;
+    uint8_t idleConnections() const;
+
+    // Streamed responses: bytes the stream takes without blocking (0 until
+    // the head and initial segments are written), a write of at most that
+    // many bytes, and closing it from the server side
+    size_t streamWriteRoom(uint8_t connectionId);
+    size_t streamWrite(uint8_t connectionId, const char* data, size_t length);
+    void closeStream(uint8_t connectionId);
+
+    // Drop every connection, e.g. after the station address changed and the
+    // sockets went stale; routes, counters and the listener stay. Returns
+    // how many were open.
+    uint8_t closeAll();
+
+    // Counters since boot; requests - connectionsAccepted = requests served on reused connections
+    uint32_t connectionsAccepted() const { return connectionsAccepted_; }
+    uint32_t requestsServed() const { return requestsServed_; }
+    uint32_t idleReclaimed() const { return idleReclaimed_; }
+
+private:
+    enum ConnectionPhase : uint8_t {
+        ConnectionFree,
+        ConnectionReading,
+        ConnectionWriting,
+        ConnectionStreaming         // Streamed response, written by the application
+    };
+
+    struct Route {
+        const char* path;
+        HttpMethod method;
+        HttpHandler handler;
+        HttpRouteClass routeClass;
+    };
+
+    struct Connection {
+        WiFiClient client;
+        HttpConnectionParser parser;
+        HttpResponse response;
+        char head[HTTP_RESPONSE_HEAD_SIZE];
+        size_t headLength;
+        size_t headSent;
+        uint8_t segmentIndex;
+        size_t segmentSent;
+        bool headOnly;
+        bool keepAlive;             // Decided per response
+        uint16_t requestsServed;
+        ConnectionPhase phase;
+        unsigned long phaseStartMs; // Request start (or idle start) while reading, last progress while writing
+    };
+
+    static bool isIdle(const Connection& connection) {
+        return connection.phase == ConnectionReading && connection.requestsServed > 0 &&
+               !connection.parser.hasBufferedData();
+    }
+
+    void acceptClients(unsigned long now);
+    void serviceReading(Connection& connection, unsigned long now);
+    void serviceWriting(Connection& connection, unsigned long now);
+    void serviceStreaming(Connection& connection);
+    void dispatch(Connection& connection);
+    void respondWithError(Connection& connection, uint16_t status, bool streamInSync);
+    void startResponse(Connection& connection, bool headOnly, bool keepAlive);
+    void finishResponse(Connection& connection, unsigned long now);
+    bool decideKeepAlive(const Connection& connection, bool streamInSync) const;
+    bool reclaimOldestIdle();
+    void reclaimIdleUnderPressure();
+    void closeConnection(Connection& connection);
+
+    WiFiServer listener_;
+    Route routes_[HTTP_MAX_ROUTES];
+    uint8_t routeCount_;
+    Connection connections_[HTTP_MAX_CONNECTIONS];
+    HttpKeepAliveLimits keepAliveLimits_;
+    AdmissionController* admission_;
+    uint32_t connectionsAccepted_;
+    uint32_t requestsServed_;
+    uint32_t idleReclaimed_;
+};
+
+#endif // HTTP_SERVER_H
@@ -0,0 +1,138 @@
+#ifndef IDLE_GOVERNOR_H
+#define IDLE_GOVERNOR_H
+
+#include <stdint.h>
+
+// Idle power management, decided once per loop() pass.
+// While clients are connected or work keeps coming in, the radio stays
+// awake. After a quiet spell the station drops to modem sleep (radio off
+// between the access point's DTIM beacons, CPU and PWM keep running), or to
+// light sleep when nothing needs the CPU either: no blink or chase running
+// and no dimmed output on the PWM generator (GPIO levels hold in light
+// sleep, the waveform does not). In both sleep modes loop() idles until the
+// next effect step is due, at most maxIdleMs, which lets the SDK doze.
+// The CPU runs at 80 MHz and is boosted to 160 MHz for a while after a
+// loop() pass that took longer than boostPassUs.
+// The caller reports how long it actually idled; from that come the wake
+// count and the estimated duty cycle (share of time the CPU was busy).
+// Free of Arduino headers so the native tests can exercise it.
+
+enum class PowerMode : uint8_t {
+    Awake = 0,       // Radio always on, no idling
+    ModemSleep = 1,
+    LightSleep = 2
+};
+
+const uint8_t POWER_MODE_COUNT = 3;
+
+struct PowerPolicy {
+    uint32_t idleAfterMs;    // Quiet this long before sleeping
+    uint32_t boostHoldMs;    // Stay at 160 MHz this long after the last heavy pass
+    uint32_t boostPassUs;    // A pass longer than this is load
+    uint16_t maxIdleMs;      // Longest single idle (button and serial console latency)
+    bool allowLightSleep;
+};
+
+// What the firmware sees this pass
+struct PowerInputs {
+    bool networkBusy;        // Clients connected, requests open, portal or link (re)connecting
+    bool effectsRunning;     // A blink or chase is stepping
+    bool pwmActive;          // A dimmed output needs the waveform generator
+    uint32_t passUs;         // Duration of the pass just run
+    uint32_t nextEffectMs;   // Until the next effect step, NO_EFFECT_DEADLINE if none
+};
+
+const uint32_t NO_EFFECT_DEADLINE = UINT32_MAX;
+
+struct PowerPlan {
+    PowerMode mode;
+    bool boost;              // 160 MHz
+    uint32_t idleMs;         // Idle this long before the next pass (0 = just yield)
+};
+
+struct PowerMetrics {
+    uint32_t idles;              // Idle periods: each ends in a wake
+    uint32_t activityWakes;      // Sleep left because of activity
+    uint32_t boosts;             // Switches to 160 MHz
+    uint64_t idleMs;             // Time spent idling
+    uint64_t modeMs[POWER_MODE_COUNT];
+    uint64_t boostMs;
+};
+
+class IdleGovernor {
+public:
+    explicit IdleGovernor(const PowerPolicy& policy)
+        : policy_(policy), mode_(PowerMode::Awake), boost_(false), started_(false), lastUpdateMs_(0),
+          lastActivityMs_(0), lastLoadMs_(0), startMs_(0), metrics_() {}
+
+    PowerPlan update(uint32_t nowMs, const PowerInputs& inputs) {
+        if (!started_) {
+            started_ = true;
+            startMs_ = lastUpdateMs_ = lastActivityMs_ = nowMs;
+            lastLoadMs_ = nowMs - policy_.boostHoldMs; // Start unboosted
+        }
+        const uint32_t elapsedMs = nowMs - lastUpdateMs_;
+        metrics_.modeMs[static_cast<uint8_t>(mode_)] += elapsedMs;
+        if (boost_) metrics_.boostMs += elapsedMs;
+        lastUpdateMs_ = nowMs;
+
+        const bool load = inputs.passUs > policy_.boostPassUs;
+        if (load) lastLoadMs_ = nowMs;
+        if (load || inputs.networkBusy) lastActivityMs_ = nowMs;
+
+        PowerMode mode = PowerMode::Awake;
+        if (nowMs - lastActivityMs_ >= policy_.idleAfterMs) {
+            const bool needsCpu = inputs.effectsRunning || inputs.pwmActive;
+            mode = policy_.allowLightSleep && !needsCpu ? PowerMode::LightSleep : PowerMode::ModemSleep;
+        }
+        if (mode == PowerMode::Awake && mode_ != PowerMode::Awake) metrics_.activityWakes++;
+        mode_ = mode;
+
+        const bool boost = nowMs - lastLoadMs_ < policy_.boostHoldMs;
+        if (boost && !boost_) metrics_.boosts++;
+        boost_ = boost;
+
+        PowerPlan plan;
+        plan.mode = mode_;
+        plan.boost = boost_;
+        plan.idleMs = 0;
+        if (mode_ != PowerMode::Awake) {
+            plan.idleMs = inputs.nextEffectMs < policy_.maxIdleMs ? inputs.nextEffectMs : policy_.maxIdleMs;
+        }
+        return plan;
+    }
+
+    // After idling for a plan: how long it actually took
+    void idled(uint32_t ms) {
+        metrics_.idles++;
+        metrics_.idleMs += ms;
+    }
+
+    PowerMode mode() const { return mode_; }
+    bool boosted() const { return boost_; }
+    const PowerMetrics& metrics() const { return metrics_; }
+
+    // Share of the time since the first update the CPU was not idling, in 0.1 %
+    uint16_t dutyCyclePermille(uint32_t nowMs) const {
+        const uint64_t totalMs = nowMs - startMs_;
+        if (totalMs == 0 || metrics_.idleMs >= totalMs) return totalMs == 0 ? 1000 : 0;
+        return static_cast<uint16_t>((totalMs - metrics_.idleMs) * 1000 / totalMs);
+    }
+
+    static const char* modeName(PowerMode mode) {
+        return mode == PowerMode::Awake ? "awake" : mode == PowerMode::ModemSleep ? "modem-sleep" : "light-sleep";
+    }
+
+private:
+    PowerPolicy policy_;
+    PowerMode mode_;
+    bool boost_;
+    bool started_;
+    uint32_t lastUpdateMs_;
+    uint32_t lastActivityMs_;
+    uint32_t lastLoadMs_;
+    uint32_t startMs_;
+    PowerMetrics metrics_;
+};
+
+#endif // IDLE_GOVERNOR_H
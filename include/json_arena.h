@@ -0,0 +1,43 @@
+#ifndef JSON_ARENA_H
+#define JSON_ARENA_H
+
+#include <ArduinoJson.h>
+#include "bump_arena.h"
+
+// ArduinoJson Allocator backed by a static BumpArena.
+// Documents bound to one of these never touch the heap; when the arena is
+// exhausted ArduinoJson reports NoMemory / overflowed() as usual.
+template <size_t Capacity>
+class JsonArenaAllocator : public ArduinoJson::Allocator {
+public:
+    void* allocate(size_t size) override { return arena_.allocate(size); }
+    void deallocate(void* ptr) override { arena_.deallocate(ptr); }
+    void* reallocate(void* ptr, size_t newSize) override { return arena_.reallocate(ptr, newSize); }
+
+    BumpArena<Capacity>& arena() { return arena_; }
+    const BumpArena<Capacity>& arena() const { return arena_; }
+
+private:
+    BumpArena<Capacity> arena_;
+};
+
+// Rewinds an arena when the enclosing scope ends. Declare it before the
+// JsonDocument so the document is destroyed first:
+//     JsonArenaScope<N> scope(requestJsonAllocator);
+//     JsonDocument doc(&requestJsonAllocator);
+template <size_t Capacity>
+class JsonArenaScope {
+public:
+    explicit JsonArenaScope(JsonArenaAllocator<Capacity>& allocator)
+        : arena_(allocator.arena()), mark_(allocator.arena().mark()) {}
+    ~JsonArenaScope() { arena_.rewind(mark_); }
+
+private:
+    JsonArenaScope(const JsonArenaScope&);
+    JsonArenaScope& operator=(const JsonArenaScope&);
+
+    BumpArena<Capacity>& arena_;
+    size_t mark_;
+};
+
+#endif // JSON_ARENA_H
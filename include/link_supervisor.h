@@ -0,0 +1,132 @@
+#ifndef LINK_SUPERVISOR_H
+#define LINK_SUPERVISOR_H
+
+#include <stdint.h>
+
+// Station link supervision after bring-up (see wifi_bringup.h).
+// Notices when the link drops and reconnects in attempts of bounded length.
+// Each failed attempt doubles the pause before the next one, up to a cap,
+// and the pause is jittered so controllers on the same layout that lost
+// the same access point don't all retry in step. Stepped from loop() with
+// the clock, the link state and a random number; the caller runs the
+// radio calls the returned action asks for, so nothing here waits.
+// Free of Arduino headers so the native tests can exercise it.
+
+struct LinkBackoffPolicy {
+    uint32_t initialDelayMs;   // Pause after the first failed attempt
+    uint32_t maxDelayMs;       // Cap on the pause
+    uint32_t attemptMs;        // An attempt that hasn't linked by then is ended
+    uint8_t jitterPercent;     // Pause varies by +/- this much
+};
+
+// Pause before the next attempt after 'failures' failed ones (>= 1).
+// 'random' is any uniformly distributed 32-bit value.
+inline uint32_t linkBackoffDelayMs(const LinkBackoffPolicy& policy, uint8_t failures, uint32_t random) {
+    uint32_t delay = policy.initialDelayMs;
+    for (uint8_t i = 1; i < failures && delay < policy.maxDelayMs; i++) delay *= 2;
+    if (delay > policy.maxDelayMs) delay = policy.maxDelayMs;
+    const uint32_t spread = static_cast<uint32_t>(static_cast<uint64_t>(delay) * policy.jitterPercent / 100);
+    return delay - spread + random % (2 * spread + 1);
+}
+
+enum class LinkState : uint8_t {
+    Idle,        // Not supervising (bring-up not connected yet)
+    Up,
+    Attempting,  // Reconnect attempt running
+    Waiting      // Backing off before the next attempt
+};
+
+enum class LinkAction : uint8_t {
+    None,
+    Lost,        // Link just dropped
+    Reconnect,   // Start a connect attempt
+    EndAttempt,  // Stop the running attempt (the radio stops searching)
+    Restored     // Link back: restart the services that need it
+};
+
+struct LinkMetrics {
+    uint32_t outages;
+    uint32_t attempts;          // Connect attempts, all outages
+    uint32_t lastOutageMs;      // Link lost -> restored
+    uint32_t longestOutageMs;
+    uint32_t totalOutageMs;
+    uint32_t lastReconnectMs;   // Start of the successful attempt -> link
+};
+
+class LinkSupervisor {
+public:
+    explicit LinkSupervisor(const LinkBackoffPolicy& policy)
+        : policy_(policy), state_(LinkState::Idle), failures_(0), lostAtMs_(0), attemptAtMs_(0), nextAttemptMs_(0) {
+        metrics_.outages = 0;
+        metrics_.attempts = 0;
+        metrics_.lastOutageMs = 0;
+        metrics_.longestOutageMs = 0;
+        metrics_.totalOutageMs = 0;
+        metrics_.lastReconnectMs = 0;
+    }
+
+    // Start supervising a link that is up
+    void begin() { state_ = LinkState::Up; }
+
+    LinkAction update(uint32_t nowMs, bool connected, uint32_t random) {
+        switch (state_) {
+            case LinkState::Up:
+                if (connected) return LinkAction::None;
+                state_ = LinkState::Waiting;
+                failures_ = 0;
+                lostAtMs_ = nowMs;
+                nextAttemptMs_ = nowMs; // First attempt right away
+                metrics_.outages++;
+                return LinkAction::Lost;
+
+            case LinkState::Attempting:
+                if (connected) return restore(nowMs, nowMs - attemptAtMs_);
+                if (nowMs - attemptAtMs_ < policy_.attemptMs) return LinkAction::None;
+                if (failures_ < UINT8_MAX) failures_++;
+                state_ = LinkState::Waiting;
+                nextAttemptMs_ = nowMs + linkBackoffDelayMs(policy_, failures_, random);
+                return LinkAction::EndAttempt;
+
+            case LinkState::Waiting:
+                if (connected) return restore(nowMs, 0); // Came back between attempts
+                if (static_cast<int32_t>(nowMs - nextAttemptMs_) < 0) return LinkAction::None;
+                state_ = LinkState::Attempting;
+                attemptAtMs_ = nowMs;
+                metrics_.attempts++;
+                return LinkAction::Reconnect;
+
+            default:
+                return LinkAction::None;
+        }
+    }
+
+    LinkState state() const { return state_; }
+    bool up() const { return state_ == LinkState::Up; }
+    uint8_t failures() const { return failures_; }  // Failed attempts in the current outage
+    uint32_t nextAttemptInMs(uint32_t nowMs) const {
+        return state_ == LinkState::Waiting && static_cast<int32_t>(nextAttemptMs_ - nowMs) > 0 ? nextAttemptMs_ - nowMs : 0;
+    }
+    const LinkMetrics& metrics() const { return metrics_; }
+
+private:
+    LinkAction restore(uint32_t nowMs, uint32_t reconnectMs) {
+        const uint32_t outageMs = nowMs - lostAtMs_;
+        metrics_.lastOutageMs = outageMs;
+        metrics_.totalOutageMs += outageMs;
+        if (outageMs > metrics_.longestOutageMs) metrics_.longestOutageMs = outageMs;
+        metrics_.lastReconnectMs = reconnectMs;
+        state_ = LinkState::Up;
+        failures_ = 0;
+        return LinkAction::Restored;
+    }
+
+    LinkBackoffPolicy policy_;
+    LinkState state_;
+    uint8_t failures_;
+    uint32_t lostAtMs_;
+    uint32_t attemptAtMs_;
+    uint32_t nextAttemptMs_;
+    LinkMetrics metrics_;
+};
+
+#endif // LINK_SUPERVISOR_H
@@ -0,0 +1,22 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <pgmspace.h>
+
+// printf-style logging through a static line buffer (defined in main.cpp).
+// Use instead of Serial.printf(), which allocates for lines over 64 bytes.
+void logPrintf(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+// Same, with the format string in flash
+void logPrintf_P(PGM_P format, ...);
+
+// Log with a literal format kept in flash (PSTR) instead of RAM. The format
+// is still checked against the arguments at compile time: the compiler
+// can't see through PSTR, so it checks a logPrintf() call that never runs.
+#define LOG_PRINTF(format, ...)                          \
+    do {                                                 \
+        if (false) logPrintf(format, ##__VA_ARGS__);     \
+        logPrintf_P(PSTR(format), ##__VA_ARGS__);        \
+    } while (0)
+
+#endif // LOG_H
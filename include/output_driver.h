@@ -0,0 +1,77 @@
+#ifndef OUTPUT_DRIVER_H
+#define OUTPUT_DRIVER_H
+
+#include <stdint.h>
+#include "output_table.h"
+
+// Drives the output pins for the output engine.
+// Only a duty between 0 and 255 needs the PWM waveform generator; fully off
+// and fully on are plain GPIO levels. Those are written straight to the GPIO
+// set/clear registers, and a pin leaves the waveform generator the first time
+// it goes to 0 or 255, so steady and blinking outputs at full brightness cost
+// no PWM interrupts at all. A pin returns to PWM only when dimmed.
+// 'Pins' is the hardware access, static functions only:
+//   pwm(pin, duty)   start or update the PWM waveform
+//   detachPwm(pin)   stop the waveform, leaving the pin a GPIO output
+//   set(pin)         drive high
+//   clear(pin)       drive low
+// The firmware maps them to analogWrite() and GPOS/GPOC; the native tests
+// record the calls.
+// Free of Arduino headers so the native tests can exercise it.
+
+struct OutputDriverMetrics {
+    uint32_t gpioWrites;   // Register writes for 0% / 100%
+    uint32_t pwmWrites;    // Dimmed writes through the waveform generator
+    uint32_t pwmDetaches;  // Pins taken off the waveform generator
+    uint8_t pwmPins;       // Pins on the waveform generator right now
+};
+
+template <typename Pins, uint8_t Count>
+class OutputDriver {
+public:
+    typedef typename OutputMask<Count>::Type Mask;
+    static const uint8_t FULL_DUTY = 255;
+
+    explicit OutputDriver(const uint8_t (&pins)[Count]) : pins_(pins), pwm_(0), gpioWrites_(0), pwmWrites_(0), pwmDetaches_(0) {}
+
+    // Drive output 'index' at 'duty' (0-255)
+    void write(uint8_t index, uint8_t duty) {
+        const uint8_t pin = pins_[index];
+        const Mask bit = static_cast<Mask>(static_cast<Mask>(1) << index);
+        if (duty != 0 && duty != FULL_DUTY) {
+            Pins::pwm(pin, duty);
+            pwm_ = static_cast<Mask>(pwm_ | bit);
+            pwmWrites_++;
+            return;
+        }
+        if (pwm_ & bit) {
+            Pins::detachPwm(pin);
+            pwm_ = static_cast<Mask>(pwm_ & ~bit);
+            pwmDetaches_++;
+        }
+        if (duty) Pins::set(pin);
+        else Pins::clear(pin);
+        gpioWrites_++;
+    }
+
+    bool onPwm(uint8_t index) const { return (pwm_ & (static_cast<Mask>(1) << index)) != 0; }
+
+    OutputDriverMetrics metrics() const {
+        OutputDriverMetrics metrics;
+        metrics.gpioWrites = gpioWrites_;
+        metrics.pwmWrites = pwmWrites_;
+        metrics.pwmDetaches = pwmDetaches_;
+        metrics.pwmPins = 0;
+        for (Mask bits = pwm_; bits != 0; bits = static_cast<Mask>(bits & (bits - 1))) metrics.pwmPins++;
+        return metrics;
+    }
+
+private:
+    const uint8_t (&pins_)[Count];
+    Mask pwm_;             // Pins currently on the waveform generator
+    uint32_t gpioWrites_;
+    uint32_t pwmWrites_;
+    uint32_t pwmDetaches_;
+};
+
+#endif // OUTPUT_DRIVER_H
@@ -0,0 +1,133 @@
+#ifndef OUTPUT_MAP_H
+#define OUTPUT_MAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "text_buffer.h"
+
+// Output addressing.
+// Every output has a stable logical ID, its position in the pin list
+// (LED_PINS), so clients don't depend on the wiring. The GPIO number is still
+// accepted for compatibility: the pin -> ID table is generated at compile time
+// from the pin list, making the lookup a single array read, and the build
+// fails on a pin list with duplicates or pins the chip doesn't have.
+// Several outputs can be named as an ID list with ranges ("0-3,6") or a mask.
+// Free of Arduino headers so the native tests can exercise it.
+
+const uint8_t OUTPUT_GPIO_COUNT = 17;   // ESP8266 GPIO 0-16
+const uint8_t NO_OUTPUT = 0xFF;
+
+struct OutputPinMap {
+    uint8_t outputCount;
+    uint8_t idOfPin[OUTPUT_GPIO_COUNT];  // Output ID driven by each GPIO, NO_OUTPUT if none
+
+    // Output ID of a GPIO pin, -1 if it isn't an output
+    constexpr int idOf(int32_t pin) const {
+        return (pin >= 0 && pin < OUTPUT_GPIO_COUNT && idOfPin[pin] != NO_OUTPUT) ? idOfPin[pin] : -1;
+    }
+
+    constexpr bool validId(int32_t id) const { return id >= 0 && id < outputCount; }
+};
+
+// Compile-time construction (C++11 constexpr: one expression per function)
+template <size_t... I>
+struct OutputGpioSequence {};
+
+template <size_t N, size_t... I>
+struct MakeOutputGpioSequence : MakeOutputGpioSequence<N - 1, N - 1, I...> {};
+
+template <size_t... I>
+struct MakeOutputGpioSequence<0, I...> {
+    typedef OutputGpioSequence<I...> Type;
+};
+
+// Position of 'pin' in 'pins' (first match), NO_OUTPUT if absent
+template <size_t N>
+constexpr uint8_t outputIdOfPin(const uint8_t (&pins)[N], size_t pin, size_t id = 0) {
+    return id == N ? NO_OUTPUT : pins[id] == pin ? static_cast<uint8_t>(id) : outputIdOfPin(pins, pin, id + 1);
+}
+
+// Every pin exists on the chip and appears once
+template <size_t N>
+constexpr bool outputPinsValid(const uint8_t (&pins)[N], size_t id = 0) {
+    return id == N || (pins[id] < OUTPUT_GPIO_COUNT && outputIdOfPin(pins, pins[id]) == id && outputPinsValid(pins, id + 1));
+}
+
+template <size_t N, size_t... Gpio>
+constexpr OutputPinMap buildOutputPinMap(const uint8_t (&pins)[N], OutputGpioSequence<Gpio...>) {
+    return OutputPinMap{static_cast<uint8_t>(N), {outputIdOfPin(pins, Gpio)...}};
+}
+
+template <size_t N>
+constexpr OutputPinMap makeOutputPinMap(const uint8_t (&pins)[N]) {
+    static_assert(N >= 1 && N < NO_OUTPUT, "Output pin list must hold 1-254 pins");
+    return buildOutputPinMap(pins, typename MakeOutputGpioSequence<OUTPUT_GPIO_COUNT>::Type());
+}
+
+// One ID of an ID list: 1-3 digits
+inline bool parseOutputId(TextView text, uint32_t& id) {
+    text = trimText(text);
+    if (text.empty() || text.length > 3) return false;
+    id = 0;
+    for (size_t i = 0; i < text.length; i++) {
+        if (text.data[i] < '0' || text.data[i] > '9') return false;
+        id = id * 10 + static_cast<uint32_t>(text.data[i] - '0');
+    }
+    return true;
+}
+
+// Expand an ID list with ranges: "0-3,6" is 0,1,2,3,6 and "3-1" counts down
+// (a chase runs in list order). Stores up to 'capacity' IDs in order; 'count'
+// is the full length. False on malformed input or a list over 255 IDs. IDs
+// are not checked against the outputs here.
+inline bool parseOutputIdRanges(TextView text, int32_t* ids, uint8_t capacity, uint8_t& count) {
+    count = 0;
+    size_t total = 0;
+    size_t pos = 0;
+    while (pos <= text.length) {
+        size_t end = pos;
+        while (end < text.length && text.data[end] != ',') end++;
+        const TextView item(text.data + pos, end - pos);
+        size_t dash = 0;
+        while (dash < item.length && item.data[dash] != '-') dash++;
+
+        uint32_t first = 0;
+        uint32_t last = 0;
+        if (!parseOutputId(TextView(item.data, dash), first)) return false;
+        if (dash == item.length) last = first;
+        else if (!parseOutputId(TextView(item.data + dash + 1, item.length - dash - 1), last)) return false;
+
+        const size_t span = (first <= last ? last - first : first - last) + 1;
+        if (total + span > 255) return false;
+        for (size_t i = 0; i < span; i++) {
+            if (total < capacity) ids[total] = static_cast<int32_t>(first <= last ? first + i : first - i);
+            total++;
+        }
+        pos = end + 1;
+    }
+    count = static_cast<uint8_t>(total);
+    return true;
+}
+
+// GET /api/outputs body, the ID -> GPIO directory: {"outputs":[{"id":0,"pin":4},...]}
+constexpr size_t outputDirectorySize(size_t outputCount) {
+    return sizeof("{\"outputs\":[]}") + outputCount * sizeof("{\"id\":255,\"pin\":16},");
+}
+
+// Returns the length, 0 if 'size' is too small
+inline size_t formatOutputDirectory(char* dest, size_t size, const uint8_t* pins, uint8_t outputCount) {
+    int length = snprintf(dest, size, "{\"outputs\":[");
+    for (uint8_t id = 0; id < outputCount && length > 0 && static_cast<size_t>(length) < size; id++) {
+        const int written = snprintf(dest + length, size - length, "%s{\"id\":%u,\"pin\":%u}", id ? "," : "",
+                                     static_cast<unsigned>(id), static_cast<unsigned>(pins[id]));
+        if (written < 0) return 0;
+        length += written;
+    }
+    if (length < 0 || static_cast<size_t>(length) >= size) return 0;
+    const int closing = snprintf(dest + length, size - length, "]}");
+    if (closing < 0 || static_cast<size_t>(length + closing) >= size) return 0;
+    return static_cast<size_t>(length + closing);
+}
+
+#endif // OUTPUT_MAP_H
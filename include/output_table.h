@@ -0,0 +1,77 @@
+#ifndef OUTPUT_TABLE_H
+#define OUTPUT_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+
+// State of every output in one struct-of-arrays block, sized at compile time.
+// The fields the engine reads on every tick (flags, pins, duty, group,
+// interval, blink timer) come first and together take a few dozen bytes;
+// names, only needed for the status document and persistence, follow.
+// On/lit flags are bitsets in the smallest unsigned type that holds Count
+// bits. Nothing is allocated: names have fixed NameLength + 1 slots.
+// Free of Arduino headers so the native tests can exercise it.
+
+template <uint8_t Count>
+struct OutputMask {
+    typedef typename std::conditional<(Count <= 8), uint8_t,
+            typename std::conditional<(Count <= 16), uint16_t, uint32_t>::type>::type Type;
+};
+
+template <uint8_t Count, uint8_t NameLength>
+class OutputTable {
+    static_assert(Count >= 1 && Count <= 32, "OutputTable holds 1-32 outputs");
+
+public:
+    typedef typename OutputMask<Count>::Type Mask;
+    static const uint8_t NO_GROUP = 0;   // Chasing group ids are 1-255
+
+    explicit OutputTable(const uint8_t (&outputPins)[Count]) : on(0), lit(0) {
+        for (uint8_t i = 0; i < Count; i++) {
+            pins[i] = outputPins[i];
+            brightness[i] = 255;
+            group[i] = NO_GROUP;
+            interval[i] = 0;
+            lastToggleMs[i] = 0;
+            names[i][0] = '\0';
+        }
+    }
+
+    // Hot: read by every engine tick
+    Mask on;                           // Switched on (by a command or a chasing group)
+    Mask lit;                          // Currently driven: blink phase, or a steady output that was written
+    uint8_t pins[Count];               // GPIO
+    uint8_t brightness[Count];         // PWM duty 0-255 while on
+    uint8_t group[Count];              // Owning chasing group id, NO_GROUP = free
+    uint16_t interval[Count];          // Blink period in ms, 0 = steady
+    uint32_t lastToggleMs[Count];      // Last blink toggle
+
+    // Cold: status document and persistence
+    char names[Count][NameLength + 1]; // Custom name, empty = default
+
+    static uint8_t size() { return Count; }
+
+    bool isOn(uint8_t index) const { return (on & bit(index)) != 0; }
+    void setOn(uint8_t index, bool value) { on = value ? static_cast<Mask>(on | bit(index)) : static_cast<Mask>(on & ~bit(index)); }
+
+    bool isLit(uint8_t index) const { return (lit & bit(index)) != 0; }
+    void setLit(uint8_t index, bool value) { lit = value ? static_cast<Mask>(lit | bit(index)) : static_cast<Mask>(lit & ~bit(index)); }
+    bool toggleLit(uint8_t index) {
+        lit = static_cast<Mask>(lit ^ bit(index));
+        return isLit(index);
+    }
+
+    bool inGroup(uint8_t index) const { return group[index] != NO_GROUP; }
+
+    uint8_t onCount() const {
+        uint8_t count = 0;
+        for (Mask bits = on; bits != 0; bits = static_cast<Mask>(bits & (bits - 1))) count++;
+        return count;
+    }
+
+private:
+    static Mask bit(uint8_t index) { return static_cast<Mask>(static_cast<Mask>(1) << index); }
+};
+
+#endif // OUTPUT_TABLE_H
@@ -0,0 +1,96 @@
+#ifndef RTC_SNAPSHOT_H
+#define RTC_SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Live output and effect state kept in RTC user memory, which survives
+// watchdog resets and ESP.restart() but not a power cycle.
+// On a warm boot the outputs are driven from it before anything else runs,
+// and blinks and chases continue in phase instead of restarting: each
+// blink timer and chase step is stored as its age, and the RTC clock, which
+// keeps counting through the reset, tells how much time to add. The
+// snapshot holds everything needed to drive the pins; names stay in EEPROM.
+// A CRC over the whole record and a magic number that encodes the layout
+// reject power-on garbage and snapshots written by a different build.
+// Free of Arduino headers so the native tests can exercise it.
+
+// CRC-32 (IEEE), bitwise: no table in RAM
+inline uint32_t snapshotCrc32(const void* data, size_t length) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint32_t crc = 0xFFFFFFFFUL;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= bytes[i];
+        for (uint8_t bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+    }
+    return ~crc;
+}
+
+template <uint8_t Outputs, uint8_t Groups, uint8_t PerGroup>
+struct EffectSnapshot {
+    static_assert(Outputs <= 32, "Snapshot keeps output flags in 32-bit masks");
+
+    struct Group {
+        uint8_t groupId;
+        uint8_t outputCount;           // 0 = slot unused
+        uint8_t currentStep;
+        uint8_t reserved;
+        uint16_t interval;
+        uint8_t outputIndices[PerGroup];
+        uint32_t stepAgeMs;            // Time since the last step, at capture
+    };
+
+    // Layout tag: a build with other sizes never accepts this snapshot
+    static const uint32_t MAGIC = 0x52480000UL ^ (static_cast<uint32_t>(Outputs) << 16) ^
+                                  (static_cast<uint32_t>(Groups) << 8) ^ PerGroup;
+
+    uint32_t magic;
+    uint32_t crc;                      // Over everything after this field
+    uint32_t rtcTime;                  // RTC clock at capture (ticks)
+    uint32_t rtcPeriodQ12;             // Microseconds per RTC tick, 12 fractional bits
+    uint32_t captures;                 // Writes since the snapshot was started
+    uint32_t on;
+    uint32_t lit;
+    uint8_t brightness[Outputs];
+    uint8_t group[Outputs];
+    uint16_t interval[Outputs];
+    uint32_t toggleAgeMs[Outputs];     // Time since the last blink toggle, at capture
+    Group groups[Groups];
+
+    // Set the magic and CRC once the fields are filled in
+    void seal() {
+        magic = MAGIC;
+        crc = computeCrc();
+    }
+
+    bool valid() const { return magic == MAGIC && crc == computeCrc(); }
+
+    void invalidate() { magic = 0; }
+
+private:
+    uint32_t computeCrc() const {
+        const uint8_t* start = reinterpret_cast<const uint8_t*>(&crc) + sizeof(crc);
+        return snapshotCrc32(start, sizeof(*this) - offsetof(EffectSnapshot, crc) - sizeof(crc));
+    }
+};
+
+// Time between two RTC clock readings; the clock wraps after about 6.8 hours
+inline uint32_t rtcElapsedMs(uint32_t thenTicks, uint32_t nowTicks, uint32_t periodQ12) {
+    return static_cast<uint32_t>(((static_cast<uint64_t>(nowTicks - thenTicks) * periodQ12) >> 12) / 1000);
+}
+
+// Where a periodic effect stands 'ageMs' after its last step: how many steps
+// it missed and how far it is into the current one
+struct EffectPhase {
+    uint32_t steps;
+    uint32_t intoStepMs;
+};
+
+inline EffectPhase continuePhase(uint32_t ageMs, uint16_t intervalMs) {
+    EffectPhase phase;
+    phase.steps = intervalMs ? ageMs / intervalMs : 0;
+    phase.intoStepMs = intervalMs ? ageMs % intervalMs : 0;
+    return phase;
+}
+
+#endif // RTC_SNAPSHOT_H
@@ -0,0 +1,101 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stdint.h>
+#include <atomic>
+
+// Lock-free single-producer/single-consumer ring.
+// The producer (network handlers) and the consumer (output engine tick) each
+// own one index; they only meet through acquire/release on those indices, so
+// neither side ever waits or disables interrupts. A full ring refuses the new
+// item (counted as dropped) rather than overwriting one not yet applied.
+// Every counter has a single writer, so plain atomic loads/stores suffice -
+// no read-modify-write, which the ESP8266 would emulate with interrupt locks.
+// Free of Arduino headers so the native tests can exercise it.
+
+struct SpscQueueMetrics {
+    uint32_t pushed;     // Accepted by push()
+    uint32_t dropped;    // Refused, ring full
+    uint32_t popped;     // Handed to the consumer
+    uint8_t depth;       // Waiting right now
+    uint8_t highWater;   // Deepest the ring has been
+};
+
+template <typename T, uint8_t Capacity>
+class SpscQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+    SpscQueue() : head_(0), tail_(0), dropped_(0), highWater_(0) {}
+
+    // Producer side. False (and counted) when the ring is full.
+    bool push(const T& item) {
+        const uint32_t tail = tail_.load(std::memory_order_relaxed);
+        const uint32_t depth = tail - head_.load(std::memory_order_acquire);
+        if (depth >= Capacity) {
+            dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+        slots_[tail & MASK] = item;
+        tail_.store(tail + 1, std::memory_order_release); // Publishes the slot
+        if (depth + 1 > highWater_.load(std::memory_order_relaxed)) {
+            highWater_.store(static_cast<uint8_t>(depth + 1), std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    // Consumer side. False when the ring is empty.
+    bool pop(T& item) {
+        const uint32_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) return false;
+        item = slots_[head & MASK];
+        head_.store(head + 1, std::memory_order_release); // Hands the slot back
+        return true;
+    }
+
+    // Consumer side: apply(item) for every item queued when the call starts.
+    // Items pushed meanwhile wait for the next drain, so one tick applies a
+    // fixed batch. Returns the number applied.
+    template <typename Apply>
+    uint8_t drain(Apply apply) {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        const uint32_t tail = tail_.load(std::memory_order_acquire);
+        const uint8_t count = static_cast<uint8_t>(tail - head);
+        for (; head != tail; head++) {
+            apply(static_cast<const T&>(slots_[head & MASK]));
+            head_.store(head + 1, std::memory_order_release);
+        }
+        return count;
+    }
+
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+    uint8_t capacity() const { return Capacity; }
+
+    // Consistent enough for reporting from either side
+    SpscQueueMetrics metrics() const {
+        const uint32_t head = head_.load(std::memory_order_acquire);
+        const uint32_t tail = tail_.load(std::memory_order_acquire);
+        const uint32_t depth = tail - head; // Both may move between the loads
+        SpscQueueMetrics metrics;
+        metrics.pushed = tail;
+        metrics.dropped = dropped_.load(std::memory_order_relaxed);
+        metrics.popped = head;
+        metrics.depth = static_cast<uint8_t>(depth > Capacity ? Capacity : depth);
+        metrics.highWater = highWater_.load(std::memory_order_relaxed);
+        return metrics;
+    }
+
+private:
+    static const uint32_t MASK = Capacity - 1;
+
+    T slots_[Capacity];
+    std::atomic<uint32_t> head_;      // Written by the consumer only
+    std::atomic<uint32_t> tail_;      // Written by the producer only
+    std::atomic<uint32_t> dropped_;   // Producer
+    std::atomic<uint8_t> highWater_;  // Producer
+};
+
+#endif // SPSC_QUEUE_H
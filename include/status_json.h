@@ -0,0 +1,48 @@
+#ifndef STATUS_JSON_H
+#define STATUS_JSON_H
+
+#include <ArduinoJson.h>
+#include "effect_engine.h"
+#include "status_subscription.h"
+
+// The engine sections of the status document (see serializeStatusToJson()
+// in main.cpp): the outputs and chasing groups a subscription asked for.
+// The device and metrics sections read the ESP SDK and stay in main.cpp.
+
+// "outputs": one object per subscribed output, with the stable ID the
+// commands take (see output_map.h) next to its GPIO
+template <typename Table>
+inline void serializeOutputsToJson(JsonArray outputs, const Table& table, const StatusSubscription& subscription) {
+    for (uint8_t i = 0; i < table.size(); i++) {
+        if (!subscription.includesOutput(i)) continue;
+        JsonObject output = outputs.add<JsonObject>();
+        output["id"] = i;
+        output["pin"] = table.pins[i];
+        output["active"] = table.isOn(i);
+        output["brightness"] = brightnessPercent(table.brightness[i]);
+        output["name"] = static_cast<const char*>(table.names[i]);
+        output["interval"] = table.interval[i];
+        output["chasingGroup"] = table.inGroup(i) ? static_cast<int>(table.group[i]) : -1;
+    }
+}
+
+// "chasingGroups": one object per active subscribed group, outputs as pins
+template <typename Table>
+inline void serializeChasingGroupsToJson(JsonArray groups, const Table& table, const ChasingGroup* chasing,
+                                         uint8_t groupCount, const StatusSubscription& subscription) {
+    for (uint8_t g = 0; g < groupCount; g++) {
+        const ChasingGroup& source = chasing[g];
+        if (!source.active || !subscription.includesGroup(source.groupId)) continue;
+        JsonObject group = groups.add<JsonObject>();
+        group["groupId"] = source.groupId;
+        group["name"] = source.name;
+        group["interval"] = source.interval;
+        group["outputCount"] = source.outputCount;
+        JsonArray groupOutputs = group["outputs"].to<JsonArray>();
+        for (uint8_t j = 0; j < source.outputCount; j++) {
+            groupOutputs.add(table.pins[source.outputIndices[j]]);
+        }
+    }
+}
+
+#endif // STATUS_JSON_H
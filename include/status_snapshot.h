@@ -0,0 +1,97 @@
+#ifndef STATUS_SNAPSHOT_H
+#define STATUS_SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Serialize-once status snapshots.
+// The status document is rendered into one of SlotCount fixed buffers and
+// becomes the current snapshot; every WebSocket frame and every /api/status
+// response is sent from that buffer instead of serializing its own copy.
+// A published snapshot is immutable: HTTP responses still streaming an older
+// one hold a reader reference, and the next build goes into a slot nobody is
+// reading. Each snapshot carries the state version it was built from, which
+// doubles as the /api/status ETag.
+// Free of Arduino headers so the native tests can exercise it.
+
+struct SnapshotMetrics {
+    uint32_t builds;
+    uint32_t buildsBlocked; // No free slot: every other snapshot was still being sent
+    uint32_t served;        // Responses sent from an existing snapshot
+};
+
+template <size_t BufferSize, uint8_t SlotCount>
+class SnapshotStore {
+public:
+    struct Snapshot {
+        char data[BufferSize];
+        size_t length;
+        uint32_t version;
+        unsigned long builtAtMs;
+        uint8_t readers;
+    };
+
+    SnapshotStore() : current_(nullptr) {
+        for (uint8_t i = 0; i < SlotCount; i++) {
+            slots_[i].length = 0;
+            slots_[i].version = 0;
+            slots_[i].builtAtMs = 0;
+            slots_[i].readers = 0;
+        }
+        metrics_.builds = 0;
+        metrics_.buildsBlocked = 0;
+        metrics_.served = 0;
+    }
+
+    // Slot to render the next snapshot into, or nullptr while every other
+    // slot is still referenced. Nothing changes until publish().
+    Snapshot* beginBuild() {
+        for (uint8_t i = 0; i < SlotCount; i++) {
+            if (&slots_[i] != current_ && slots_[i].readers == 0) return &slots_[i];
+        }
+        metrics_.buildsBlocked++;
+        return nullptr;
+    }
+
+    void publish(Snapshot* snapshot, size_t length, uint32_t version, unsigned long now) {
+        snapshot->length = length;
+        snapshot->version = version;
+        snapshot->builtAtMs = now;
+        current_ = snapshot;
+        metrics_.builds++;
+    }
+
+    const Snapshot* current() const { return current_; }
+
+    // True if the current snapshot reflects 'version'
+    bool isCurrent(uint32_t version) const { return current_ != nullptr && current_->version == version; }
+
+    // Reference the current snapshot for a response that outlives this call
+    Snapshot* acquire() {
+        if (current_ == nullptr) return nullptr;
+        current_->readers++;
+        metrics_.served++;
+        return current_;
+    }
+
+    void release(const Snapshot* snapshot) {
+        for (uint8_t i = 0; i < SlotCount; i++) {
+            if (&slots_[i] == snapshot && slots_[i].readers > 0) slots_[i].readers--;
+        }
+    }
+
+    uint8_t readers() const {
+        uint8_t count = 0;
+        for (uint8_t i = 0; i < SlotCount; i++) count += slots_[i].readers;
+        return count;
+    }
+
+    const SnapshotMetrics& metrics() const { return metrics_; }
+
+private:
+    Snapshot slots_[SlotCount];
+    Snapshot* current_;
+    SnapshotMetrics metrics_;
+};
+
+#endif // STATUS_SNAPSHOT_H
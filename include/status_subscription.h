@@ -0,0 +1,284 @@
+#ifndef STATUS_SUBSCRIPTION_H
+#define STATUS_SUBSCRIPTION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "http_parser.h"
+#include "output_map.h"
+
+// Per-client status subscriptions.
+// A WebSocket client (connection URL) or event stream (/api/events) can ask
+// for part of the status document only:
+//   ?sections=device,outputs,groups,metrics  sections to include (default: all)
+//   &ids=0-2,5                               outputs by ID, ranges allowed (default: all)
+//   &outputs=4,5                             outputs by GPIO pin (default: all)
+//   &groups=2,3                              chasing groups by id (default: all)
+//   &telemetry=0|1                           push periodic heap/uptime refreshes
+// Clients asking for the same document share a subscription class; the
+// broadcaster renders each class once per change and only pushes to clients
+// whose part of the state actually changed.
+// Free of Arduino headers so the native tests can exercise it.
+
+enum StatusSection : uint8_t {
+    StatusSectionDevice = 0x01,   // Name, network, heap, uptime, flash
+    StatusSectionOutputs = 0x02,
+    StatusSectionGroups = 0x04,
+    StatusSectionMetrics = 0x08,  // HTTP, admission, WebSocket, SSE and snapshot counters
+    StatusSectionAll = 0x0F
+};
+
+const uint32_t STATUS_ALL_OUTPUTS = 0xFFFFFFFFUL;
+const uint8_t STATUS_MAX_GROUP_FILTER = 4;
+
+// What changed since the last broadcast
+struct StatusChange {
+    uint8_t sections;
+    uint32_t outputs;     // Output indices that changed (StatusSectionOutputs)
+    bool telemetryOnly;   // Periodic refresh: only heap/uptime/counters moved
+
+    static StatusChange none() {
+        StatusChange change = {0, 0, false};
+        return change;
+    }
+    static StatusChange output(uint8_t index) {
+        StatusChange change = {StatusSectionOutputs, static_cast<uint32_t>(1) << index, false};
+        return change;
+    }
+    static StatusChange groups() {
+        StatusChange change = {StatusSectionGroups, 0, false};
+        return change;
+    }
+    static StatusChange groupMembership() {
+        // Shows up in the outputs' chasingGroup field too
+        StatusChange change = {static_cast<uint8_t>(StatusSectionGroups | StatusSectionOutputs), STATUS_ALL_OUTPUTS, false};
+        return change;
+    }
+    static StatusChange telemetry() {
+        StatusChange change = {static_cast<uint8_t>(StatusSectionDevice | StatusSectionMetrics), 0, true};
+        return change;
+    }
+
+    bool empty() const { return sections == 0; }
+
+    void add(const StatusChange& other) {
+        if (empty()) {
+            *this = other;
+            return;
+        }
+        sections |= other.sections;
+        outputs |= other.outputs;
+        telemetryOnly = telemetryOnly && other.telemetryOnly;
+    }
+};
+
+// Which part of the document a client receives
+struct StatusSubscription {
+    uint8_t sections;
+    uint32_t outputs;                            // Output index bits
+    uint8_t groupIds[STATUS_MAX_GROUP_FILTER];   // Group filter; empty = all groups
+    uint8_t groupCount;
+
+    static StatusSubscription all() {
+        StatusSubscription subscription;
+        subscription.sections = StatusSectionAll;
+        subscription.outputs = STATUS_ALL_OUTPUTS;
+        subscription.groupCount = 0;
+        for (uint8_t i = 0; i < STATUS_MAX_GROUP_FILTER; i++) subscription.groupIds[i] = 0;
+        return subscription;
+    }
+
+    bool isFull() const {
+        return sections == StatusSectionAll && outputs == STATUS_ALL_OUTPUTS && groupCount == 0;
+    }
+
+    bool includes(StatusSection section) const { return (sections & section) != 0; }
+
+    bool includesOutput(uint8_t index) const {
+        return includes(StatusSectionOutputs) && (outputs & (static_cast<uint32_t>(1) << index)) != 0;
+    }
+
+    bool includesGroup(uint8_t groupId) const {
+        return includes(StatusSectionGroups) && (groupCount == 0 || filtersGroup(groupId));
+    }
+
+    bool filtersGroup(uint8_t groupId) const {
+        for (uint8_t i = 0; i < groupCount; i++) {
+            if (groupIds[i] == groupId) return true;
+        }
+        return false;
+    }
+
+    // Does 'change' touch anything in this subscription? Telemetry-only
+    // refreshes reach only clients that asked for them. Group changes are not
+    // tracked per group: any of them reaches every groups subscriber.
+    bool wants(const StatusChange& change, bool telemetry) const {
+        if (change.telemetryOnly && !telemetry) return false;
+        if ((sections & change.sections & ~StatusSectionOutputs) != 0) return true;
+        return includes(StatusSectionOutputs) && (change.sections & StatusSectionOutputs) != 0 &&
+               (outputs & change.outputs) != 0;
+    }
+
+    // Same rendered document (the telemetry flag only affects when it is pushed)
+    bool sameDocument(const StatusSubscription& other) const {
+        if (sections != other.sections || outputs != other.outputs || groupCount != other.groupCount) return false;
+        for (uint8_t i = 0; i < groupCount; i++) {
+            if (!other.filtersGroup(groupIds[i])) return false;
+        }
+        return true;
+    }
+};
+
+// Iterate a comma-separated list, calling accept(item) for each entry;
+// false as soon as accept rejects one
+template <typename Accept>
+inline bool forEachListItem(TextView list, Accept accept) {
+    size_t pos = 0;
+    while (pos <= list.length) {
+        size_t end = pos;
+        while (end < list.length && list.data[end] != ',') end++;
+        const TextView item = trimText(TextView(list.data + pos, end - pos));
+        if (!item.empty() && !accept(item)) return false;
+        pos = end + 1;
+    }
+    return true;
+}
+
+// Parse the subscription query. Output filters name output IDs or GPIO pins
+// (mapped through 'outputs'); given both, the outputs of either are included.
+// False on an unknown section, an ID or pin that is not an output, a bad
+// group id or more than STATUS_MAX_GROUP_FILTER groups.
+inline bool parseStatusSubscription(TextView query, const OutputPinMap& outputs,
+                                    bool defaultTelemetry, StatusSubscription& subscription, bool& telemetry) {
+    subscription = StatusSubscription::all();
+    telemetry = defaultTelemetry;
+    TextView value;
+
+    if (httpQueryParam(query, "sections", value)) {
+        subscription.sections = 0;
+        const bool ok = forEachListItem(value, [&subscription](TextView item) {
+            if (item.equals("device")) subscription.sections |= StatusSectionDevice;
+            else if (item.equals("outputs")) subscription.sections |= StatusSectionOutputs;
+            else if (item.equals("groups")) subscription.sections |= StatusSectionGroups;
+            else if (item.equals("metrics")) subscription.sections |= StatusSectionMetrics;
+            else return false;
+            return true;
+        });
+        if (!ok || subscription.sections == 0) return false;
+    }
+
+    const bool byId = httpQueryParam(query, "ids", value);
+    if (byId) {
+        int32_t ids[32];
+        uint8_t count = 0;
+        if (!parseOutputIdRanges(value, ids, sizeof(ids) / sizeof(ids[0]), count) || count > 32) return false;
+        subscription.outputs = 0;
+        for (uint8_t i = 0; i < count; i++) {
+            if (!outputs.validId(ids[i])) return false;
+            subscription.outputs |= static_cast<uint32_t>(1) << ids[i];
+        }
+    }
+
+    if (httpQueryParam(query, "outputs", value)) {
+        if (!byId) subscription.outputs = 0;
+        const bool ok = forEachListItem(value, [&subscription, &outputs](TextView item) {
+            uint32_t pin = 0;
+            if (!parseDecimal(item, pin) || pin > 255) return false;
+            const int id = outputs.idOf(static_cast<int32_t>(pin));
+            if (id < 0) return false;
+            subscription.outputs |= static_cast<uint32_t>(1) << id;
+            return true;
+        });
+        if (!ok || subscription.outputs == 0) return false;
+    }
+
+    if (subscription.outputs != STATUS_ALL_OUTPUTS) {
+        // Every output listed: same document as no filter
+        const uint8_t count = outputs.outputCount;
+        if (subscription.outputs == (count >= 32 ? STATUS_ALL_OUTPUTS : (static_cast<uint32_t>(1) << count) - 1)) {
+            subscription.outputs = STATUS_ALL_OUTPUTS;
+        }
+    }
+
+    if (httpQueryParam(query, "groups", value)) {
+        const bool ok = forEachListItem(value, [&subscription](TextView item) {
+            uint32_t groupId = 0;
+            if (!parseDecimal(item, groupId) || groupId == 0 || groupId > 255) return false;
+            if (subscription.filtersGroup(static_cast<uint8_t>(groupId))) return true; // Listed twice
+            if (subscription.groupCount >= STATUS_MAX_GROUP_FILTER) return false;
+            subscription.groupIds[subscription.groupCount++] = static_cast<uint8_t>(groupId);
+            return true;
+        });
+        if (!ok || subscription.groupCount == 0) return false;
+    }
+
+    if (httpQueryParam(query, "telemetry", value)) {
+        if (value.equals("1")) telemetry = true;
+        else if (value.equals("0")) telemetry = false;
+        else return false;
+    }
+    return true;
+}
+
+// Table of distinct subscriptions currently in use. Class 0 is the full
+// document (the shared snapshot) and always exists; when the table is full
+// further clients fall back to it.
+template <uint8_t MaxClasses>
+class SubscriptionClasses {
+public:
+    static const uint8_t NO_CLASS = 0xFF;
+
+    SubscriptionClasses() {
+        classes_[0].subscription = StatusSubscription::all();
+        classes_[0].clients = 0;
+        for (uint8_t i = 1; i < MaxClasses; i++) {
+            classes_[i].clients = 0;
+        }
+    }
+
+    uint8_t acquire(const StatusSubscription& subscription) {
+        if (subscription.isFull()) return 0;
+        uint8_t free = NO_CLASS;
+        for (uint8_t i = 1; i < MaxClasses; i++) {
+            if (classes_[i].clients == 0) {
+                if (free == NO_CLASS) free = i;
+            } else if (classes_[i].subscription.sameDocument(subscription)) {
+                classes_[i].clients++;
+                return i;
+            }
+        }
+        if (free == NO_CLASS) return 0;
+        classes_[free].subscription = subscription;
+        classes_[free].clients = 1;
+        return free;
+    }
+
+    void release(uint8_t index) {
+        if (index == 0 || index >= MaxClasses) return;
+        if (classes_[index].clients > 0) classes_[index].clients--;
+    }
+
+    // Class 0 is always active; others while a client uses them
+    bool active(uint8_t index) const {
+        return index == 0 || (index < MaxClasses && classes_[index].clients > 0);
+    }
+
+    const StatusSubscription& subscription(uint8_t index) const { return classes_[index].subscription; }
+
+    uint8_t activeCount() const {
+        uint8_t count = 0;
+        for (uint8_t i = 0; i < MaxClasses; i++) {
+            if (active(i)) count++;
+        }
+        return count;
+    }
+
+private:
+    struct Class {
+        StatusSubscription subscription;
+        uint8_t clients;
+    };
+
+    Class classes_[MaxClasses];
+};
+
+#endif // STATUS_SUBSCRIPTION_H
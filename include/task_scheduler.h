@@ -0,0 +1,154 @@
+#ifndef TASK_SCHEDULER_H
+#define TASK_SCHEDULER_H
+
+#include <stdint.h>
+
+// Cooperative scheduler for loop().
+// Tasks are run-to-completion steps: each call does a bounded slice of work
+// and keeps its own state between calls (no stacks, no preemption), like
+// every poll/update function here already does. A task table lists them
+// with a priority, a period, a deadline and a time budget.
+// One pass runs the due tasks by priority, high first. High-priority tasks
+// (the effect tick) always run. Once the pass has used its time budget,
+// due medium and low tasks are deferred to a later pass, but a task that
+// has been deferred maxDeferrals times in a row runs anyway, so under load
+// every task still gets a turn at a bounded rate.
+// Per task: runs, run time, budget overruns, deadline misses (gap between
+// runs longer than the deadline) and deferrals. Time loop() spent idling on
+// purpose (see idle_governor.h) is reported with idled() and left out of
+// the gaps.
+// 'Clock' provides static nowMs() and nowUs(); the firmware maps them to
+// millis()/micros(), the native tests to a simulated clock.
+// Free of Arduino headers so the native tests can exercise it.
+
+enum class TaskPriority : uint8_t {
+    High = 0,    // Never deferred
+    Medium = 1,
+    Low = 2
+};
+
+const uint8_t TASK_PRIORITY_COUNT = 3;
+
+typedef void (*TaskFunction)();
+
+struct TaskSpec {
+    const char* name;
+    TaskFunction run;
+    TaskPriority priority;
+    uint16_t periodMs;    // Run at most this often, 0 = every pass
+    uint16_t deadlineMs;  // Longest acceptable gap between runs, 0 = none
+    uint16_t budgetUs;    // Expected run time; longer runs are counted
+};
+
+struct TaskStats {
+    uint32_t runs;
+    uint64_t totalUs;         // 32 bits would wrap after about 72 minutes of run time
+    uint32_t maxUs;
+    uint32_t overBudget;      // Runs longer than budgetUs
+    uint32_t deadlineMisses;  // Runs that started more than deadlineMs after the previous one
+    uint32_t deferrals;       // Due but deferred because the pass budget was used up
+    uint32_t maxGapMs;        // Longest gap between two runs, idling excluded
+};
+
+struct SchedulerStats {
+    uint32_t passes;
+    uint32_t overrunPasses;   // Passes longer than the pass budget
+    uint32_t maxPassUs;
+    uint32_t lastPassUs;
+};
+
+template <typename Clock, uint8_t MaxTasks>
+class TaskScheduler {
+public:
+    TaskScheduler(const TaskSpec* tasks, uint8_t count, uint32_t passBudgetUs, uint8_t maxDeferrals)
+        : tasks_(tasks), count_(count > MaxTasks ? MaxTasks : count), passBudgetUs_(passBudgetUs),
+          maxDeferrals_(maxDeferrals) {
+        for (uint8_t i = 0; i < MaxTasks; i++) {
+            stats_[i] = TaskStats();
+            lastStartMs_[i] = 0;
+            deferredPasses_[i] = 0;
+            idleMs_[i] = 0;
+            started_[i] = false;
+        }
+        schedulerStats_ = SchedulerStats();
+    }
+
+    // One loop() pass
+    void runPass() {
+        const uint32_t passStartUs = Clock::nowUs();
+        schedulerStats_.passes++;
+        for (uint8_t level = 0; level < TASK_PRIORITY_COUNT; level++) {
+            for (uint8_t i = 0; i < count_; i++) {
+                const TaskSpec& task = tasks_[i];
+                if (static_cast<uint8_t>(task.priority) != level) continue;
+
+                const uint32_t nowMs = Clock::nowMs();
+                if (started_[i] && nowMs - lastStartMs_[i] < task.periodMs) continue;
+
+                if (task.priority != TaskPriority::High && Clock::nowUs() - passStartUs >= passBudgetUs_ &&
+                    deferredPasses_[i] < maxDeferrals_) {
+                    deferredPasses_[i]++;
+                    stats_[i].deferrals++;
+                    continue;
+                }
+                run(i, nowMs);
+            }
+        }
+        const uint32_t passUs = Clock::nowUs() - passStartUs;
+        schedulerStats_.lastPassUs = passUs;
+        if (passUs > schedulerStats_.maxPassUs) schedulerStats_.maxPassUs = passUs;
+        if (passUs > passBudgetUs_) schedulerStats_.overrunPasses++;
+    }
+
+    // loop() idled for 'ms' between passes
+    void idled(uint32_t ms) {
+        for (uint8_t i = 0; i < count_; i++) idleMs_[i] += ms;
+    }
+
+    uint8_t count() const { return count_; }
+    const TaskSpec& task(uint8_t index) const { return tasks_[index]; }
+    const TaskStats& stats(uint8_t index) const { return stats_[index]; }
+    const SchedulerStats& schedulerStats() const { return schedulerStats_; }
+
+    static const char* priorityName(TaskPriority priority) {
+        return priority == TaskPriority::High ? "high" : priority == TaskPriority::Medium ? "medium" : "low";
+    }
+
+private:
+    void run(uint8_t index, uint32_t nowMs) {
+        const TaskSpec& task = tasks_[index];
+        TaskStats& stats = stats_[index];
+        if (started_[index]) {
+            const uint32_t sinceMs = nowMs - lastStartMs_[index];
+            const uint32_t gapMs = sinceMs - (idleMs_[index] < sinceMs ? idleMs_[index] : sinceMs);
+            if (gapMs > stats.maxGapMs) stats.maxGapMs = gapMs;
+            if (task.deadlineMs && gapMs > task.deadlineMs) stats.deadlineMisses++;
+        }
+        started_[index] = true;
+        lastStartMs_[index] = nowMs;
+        deferredPasses_[index] = 0;
+        idleMs_[index] = 0;
+
+        const uint32_t startUs = Clock::nowUs();
+        task.run();
+        const uint32_t elapsedUs = Clock::nowUs() - startUs;
+
+        stats.runs++;
+        stats.totalUs += elapsedUs;
+        if (elapsedUs > stats.maxUs) stats.maxUs = elapsedUs;
+        if (elapsedUs > task.budgetUs) stats.overBudget++;
+    }
+
+    const TaskSpec* tasks_;
+    uint8_t count_;
+    uint32_t passBudgetUs_;
+    uint8_t maxDeferrals_;
+    TaskStats stats_[MaxTasks];
+    uint32_t lastStartMs_[MaxTasks];
+    uint8_t deferredPasses_[MaxTasks];
+    uint32_t idleMs_[MaxTasks];       // Idled since the last run
+    bool started_[MaxTasks];
+    SchedulerStats schedulerStats_;
+};
+
+#endif // TASK_SCHEDULER_H
@@ -0,0 +1,89 @@
+#ifndef TEXT_BUFFER_H
+#define TEXT_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Heap-free text helpers for the request/log hot paths.
+// Arduino String allocates on every concatenation and fragments the ~50KB
+// ESP8266 heap (arc42 TR-1), so these helpers only ever touch caller-owned
+// fixed buffers. Kept free of Arduino headers so native tests can use them.
+
+// Non-owning view onto a character range (request body, JSON value, name)
+struct TextView {
+    const char* data;
+    size_t length;
+
+    TextView() : data(""), length(0) {}
+    TextView(const char* text, size_t len) : data(text ? text : ""), length(text ? len : 0) {}
+
+    static TextView fromCString(const char* text) {
+        return text ? TextView(text, strlen(text)) : TextView();
+    }
+
+    bool empty() const { return length == 0; }
+
+    bool equals(const char* other) const {
+        const size_t otherLength = strlen(other);
+        return otherLength == length && memcmp(data, other, length) == 0;
+    }
+};
+
+inline bool isTextWhitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Strip leading/trailing whitespace without copying
+inline TextView trimText(TextView text) {
+    size_t start = 0;
+    size_t end = text.length;
+    while (start < end && isTextWhitespace(text.data[start])) start++;
+    while (end > start && isTextWhitespace(text.data[end - 1])) end--;
+    return TextView(text.data + start, end - start);
+}
+
+// Copy a trimmed view into a fixed buffer (truncating, always NUL-terminated).
+// A cut never splits a UTF-8 sequence: it backs off to the sequence's lead
+// byte, so the copy stays valid in a JSON string. Returns the bytes stored.
+inline size_t copyTrimmed(char* dest, size_t destSize, TextView source) {
+    if (dest == nullptr || destSize == 0) return 0;
+    const TextView trimmed = trimText(source);
+    size_t count = trimmed.length < destSize - 1 ? trimmed.length : destSize - 1;
+    if (count < trimmed.length) {
+        // The first byte left out is a continuation byte (10xxxxxx): its character started before the cut
+        while (count > 0 && (static_cast<uint8_t>(trimmed.data[count]) & 0xC0) == 0x80) count--;
+    }
+    memcpy(dest, trimmed.data, count);
+    dest[count] = '\0';
+    return count;
+}
+
+inline size_t copyTrimmed(char* dest, size_t destSize, const char* source) {
+    return copyTrimmed(dest, destSize, TextView::fromCString(source));
+}
+
+// Dotted-quad formatting without IPAddress::toString() (which returns a String)
+const size_t IPV4_TEXT_SIZE = 16; // "255.255.255.255" + NUL
+
+inline const char* formatIPv4(char* dest, size_t destSize, uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+    if (dest == nullptr || destSize == 0) return "";
+    char* out = dest;
+    char* const last = dest + destSize - 1;
+    const uint8_t octets[4] = {a, b, c, d};
+    for (int i = 0; i < 4; i++) {
+        char digits[3];
+        int n = 0;
+        uint8_t value = octets[i];
+        do {
+            digits[n++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value > 0);
+        while (n > 0 && out < last) *out++ = digits[--n];
+        if (i < 3 && out < last) *out++ = '.';
+    }
+    *out = '\0';
+    return dest;
+}
+
+#endif // TEXT_BUFFER_H
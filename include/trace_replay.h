@@ -0,0 +1,375 @@
+#ifndef TRACE_REPLAY_H
+#define TRACE_REPLAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "effect_engine.h"
+#include "flight_recorder.h"
+#include "output_driver.h"
+#include "output_table.h"
+#include "rtc_snapshot.h"
+#include "spsc_queue.h"
+
+// Host replay of a flight recorder trace (flight_recorder.h): the output
+// engine of main.cpp fed with the recorded inputs on a virtual clock.
+// The replay starts from the first keyframe in the trace. Then the loop runs
+// a pass every passUs of virtual time, and the engine ticks once per pass as
+// in runEffectTask(): queued engine commands first, then the chase and blink
+// steps. A recorded pass overrun stalls the clock for its duration, so the
+// steps that fell due inside it come late by as much as they did on the
+// device. Every pin write goes to a callback with its virtual time, and each
+// later keyframe is compared with the replayed state.
+// Free of Arduino headers so the native tests can exercise it.
+
+typedef void (*ReplayWriteCallback)(void* context, uint64_t timeUs, uint8_t pin, uint8_t duty);
+
+// Pin access for the replayed OutputDriver: writes go to the replay running now
+template <typename Unused = void>
+struct ReplayPinsOf {
+    static ReplayWriteCallback callback;
+    static void* context;
+    static uint64_t timeUs;
+    static uint32_t writes;
+
+    static void pwm(uint8_t pin, uint8_t duty) { emit(pin, duty); }
+    static void detachPwm(uint8_t) {}
+    static void set(uint8_t pin) { emit(pin, 255); }
+    static void clear(uint8_t pin) { emit(pin, 0); }
+
+private:
+    static void emit(uint8_t pin, uint8_t duty) {
+        writes++;
+        if (callback != nullptr) callback(context, timeUs, pin, duty);
+    }
+};
+template <typename Unused> ReplayWriteCallback ReplayPinsOf<Unused>::callback = nullptr;
+template <typename Unused> void* ReplayPinsOf<Unused>::context = nullptr;
+template <typename Unused> uint64_t ReplayPinsOf<Unused>::timeUs = 0;
+template <typename Unused> uint32_t ReplayPinsOf<Unused>::writes = 0;
+typedef ReplayPinsOf<> ReplayPins;
+
+struct ReplayOptions {
+    uint32_t passUs;               // Virtual loop pass outside recorded overruns
+    uint16_t lateMs;               // A step later than this counts as late (SCHEDULER_EFFECT_DEADLINE_MS)
+    uint16_t minChaseIntervalMs;   // MIN_CHASING_INTERVAL_MS
+    ReplayWriteCallback onWrite;   // Every pin write, or nullptr
+    void* context;
+
+    static ReplayOptions defaults() {
+        ReplayOptions options = {1000, 20, 50, nullptr, nullptr};
+        return options;
+    }
+};
+
+struct ReplayStats {
+    uint32_t records;          // Read from the trace
+    uint32_t skipped;          // Before the first keyframe
+    uint32_t commands;         // Command records...
+    uint32_t rejected;         // ...answered with an error
+    uint32_t outputCommands;   // Applied to the engine
+    uint32_t invalidCommands;  // Malformed, or refused as createChasingGroup() refuses them
+    uint32_t connects;
+    uint32_t disconnects;
+    uint8_t maxClients;        // WebSocket clients connected at once
+    uint32_t overruns;
+    uint32_t maxOverrunUs;
+    uint32_t keyframes;        // After the first, compared with the replayed state...
+    uint32_t divergences;      // ...and outputs, groups or settings differed
+    uint32_t phaseDrifts;      // ...or only a blink phase or chase step did
+    uint32_t ticks;
+    uint32_t steps;            // Chase steps and blink toggles
+    uint32_t lateSteps;        // More than lateMs after they were due
+    uint32_t maxLateMs;
+    uint32_t maxTickGapUs;
+    uint32_t pinWrites;
+    uint64_t startUs;          // First keyframe
+    uint64_t endUs;            // Time of the download
+};
+
+// Replays one trace per instance, for a build with Outputs outputs and
+// Groups chasing groups (other traces are refused)
+template <uint8_t Outputs, uint8_t Groups>
+class TraceReplay {
+public:
+    typedef OutputTable<Outputs, ENGINE_NAME_LENGTH> Table;
+    typedef OutputDriver<ReplayPins, Outputs> Driver;
+    typedef EffectSnapshot<Outputs, Groups, CHASING_GROUP_MAX_OUTPUTS> Keyframe;
+    static const size_t QUEUE_SIZE = 16;   // Twice OUTPUT_COMMAND_QUEUE_SIZE
+
+    explicit TraceReplay(const ReplayOptions& options = ReplayOptions::defaults())
+        : options_(options), pins_(), table_(pins_.gpio), driver_(pins_.gpio), clockUs_(0), lastTickUs_(0), stallStartUs_(0),
+          stallEndUs_(0), clients_(0), started_(false) {
+        memset(&stats_, 0, sizeof(stats_));
+        memset(groups_, 0, sizeof(groups_));
+        if (options_.passUs == 0) options_.passUs = 1;
+    }
+
+    // False when the trace is not for this build, malformed or has no keyframe
+    bool run(const uint8_t* trace, size_t length) {
+        if (!reader_.open(trace, length) || reader_.outputs() != Outputs || reader_.groups() != Groups ||
+            reader_.outputsPerGroup() != CHASING_GROUP_MAX_OUTPUTS) {
+            return false;
+        }
+        memcpy(pins_.gpio, reader_.pins(), Outputs);
+        memcpy(table_.pins, pins_.gpio, Outputs);
+        ReplayPins::callback = options_.onWrite;
+        ReplayPins::context = options_.context;
+        const uint32_t writesBefore = ReplayPins::writes;
+
+        TraceRecord record;
+        while (reader_.next(record)) {
+            stats_.records++;
+            if (!started_) {
+                if (record.event != TraceEvent::Keyframe || !start(record)) stats_.skipped++;
+                continue;
+            }
+            runUntil(static_cast<uint64_t>(record.timeMs) * 1000);
+            handle(record);
+        }
+        if (started_) runUntil(static_cast<uint64_t>(reader_.endMs()) * 1000);
+        stats_.endUs = static_cast<uint64_t>(reader_.endMs()) * 1000;
+        stats_.pinWrites = ReplayPins::writes - writesBefore;
+        ReplayPins::callback = nullptr;
+        return started_ && !reader_.malformed();
+    }
+
+    const ReplayStats& stats() const { return stats_; }
+    const Table& table() const { return table_; }
+    const ChasingGroup& group(uint8_t slot) const { return groups_[slot]; }
+    const TraceReader& reader() const { return reader_; }
+
+private:
+    // First keyframe: the engine state it holds, pins driven, at its time
+    bool start(const TraceRecord& record) {
+        Keyframe keyframe;
+        if (!decodeKeyframe(record, keyframe)) return false;
+        restoreEffectState(keyframe, table_, groups_, Groups, record.timeMs, 0);
+        clockUs_ = static_cast<uint64_t>(record.timeMs) * 1000;
+        ReplayPins::timeUs = clockUs_;
+        driveEffectOutputs(table_, driver_, groups_, Groups);
+        stats_.startUs = clockUs_;
+        lastTickUs_ = clockUs_;
+        clockUs_ += options_.passUs; // The keyframe was taken by this pass's tick
+        findNextStall();
+        started_ = true;
+        return true;
+    }
+
+    static bool decodeKeyframe(const TraceRecord& record, Keyframe& keyframe) {
+        if (record.length != sizeof(Keyframe)) return false;
+        memcpy(&keyframe, record.payload, sizeof(keyframe));
+        return keyframe.valid();
+    }
+
+    void handle(const TraceRecord& record) {
+        switch (record.event) {
+            case TraceEvent::Keyframe:
+                checkKeyframe(record);
+                break;
+            case TraceEvent::Command:
+                stats_.commands++;
+                if (record.length >= 3 && record.payload[2] != 0) stats_.rejected++;
+                break;
+            case TraceEvent::OutputCommand: {
+                OutputCommand command;
+                if (!decodeOutputCommand(record.payload, record.length, command) || !queue_.push(command)) {
+                    stats_.invalidCommands++;
+                }
+                break;
+            }
+            case TraceEvent::ClientConnect:
+                stats_.connects++;
+                if (record.length >= 1 && record.payload[0] < 32) clients_ |= static_cast<uint32_t>(1) << record.payload[0];
+                if (clientCount() > stats_.maxClients) stats_.maxClients = clientCount();
+                break;
+            case TraceEvent::ClientDisconnect:
+                stats_.disconnects++;
+                if (record.length >= 1 && record.payload[0] < 32) clients_ &= ~(static_cast<uint32_t>(1) << record.payload[0]);
+                break;
+            case TraceEvent::PassOverrun:
+                stats_.overruns++;
+                if (record.length == 4 && getTraceU32(record.payload) > stats_.maxOverrunUs) {
+                    stats_.maxOverrunUs = getTraceU32(record.payload);
+                }
+                findNextStall();
+                break;
+        }
+    }
+
+    // The next overrun ahead of the reader: no tick runs inside the pass it describes
+    void findNextStall() {
+        TraceReader ahead = reader_;
+        TraceRecord record;
+        stallStartUs_ = stallEndUs_ = 0;
+        while (ahead.next(record)) {
+            if (record.event != TraceEvent::PassOverrun || record.length != 4) continue;
+            stallEndUs_ = static_cast<uint64_t>(record.timeMs) * 1000;
+            const uint32_t passUs = getTraceU32(record.payload);
+            stallStartUs_ = stallEndUs_ > passUs ? stallEndUs_ - passUs : 0;
+            return;
+        }
+    }
+
+    // Loop passes up to 'timeUs'
+    void runUntil(uint64_t timeUs) {
+        while (clockUs_ <= timeUs) {
+            // The pass that overran still ran its own tick, at its start
+            if (clockUs_ > stallStartUs_ && clockUs_ < stallEndUs_) {
+                clockUs_ = stallEndUs_;
+                continue;
+            }
+            tick();
+            clockUs_ += options_.passUs;
+        }
+    }
+
+    // runEffectTask()
+    void tick() {
+        const uint32_t now = static_cast<uint32_t>(clockUs_ / 1000);
+        ReplayPins::timeUs = clockUs_;
+        const uint64_t gapUs = clockUs_ - lastTickUs_;
+        if (gapUs > stats_.maxTickGapUs) stats_.maxTickGapUs = static_cast<uint32_t>(gapUs);
+        lastTickUs_ = clockUs_;
+        stats_.ticks++;
+
+        queue_.drain([this, now](const OutputCommand& command) { apply(command, now); });
+
+        for (uint8_t g = 0; g < Groups; g++) {
+            const ChasingGroup& group = groups_[g];
+            if (group.active && group.outputCount > 0) countStep(now, group.lastStepTime, group.interval);
+        }
+        for (uint8_t i = 0; i < Outputs; i++) {
+            if (table_.isOn(i) && !table_.inGroup(i) && table_.interval[i] > 0) {
+                countStep(now, table_.lastToggleMs[i], table_.interval[i]);
+            }
+        }
+        stepChasingGroups(table_, driver_, groups_, Groups, now, [](const ChasingGroup&, uint8_t, bool) {});
+        stepBlinkingOutputs(table_, driver_, now);
+    }
+
+    void countStep(uint32_t now, uint32_t lastMs, uint16_t intervalMs) {
+        if (now - lastMs < intervalMs) return;
+        const uint32_t lateMs = now - lastMs - intervalMs;
+        stats_.steps++;
+        if (lateMs > options_.lateMs) stats_.lateSteps++;
+        if (lateMs > stats_.maxLateMs) stats_.maxLateMs = lateMs;
+    }
+
+    // applyOutputCommand() without persistence and logging
+    void apply(const OutputCommand& command, uint32_t now) {
+        stats_.outputCommands++;
+        switch (command.type) {
+            case OutputCommandType::SetOutput:
+                for (uint8_t i = 0; i < command.outputCount; i++) {
+                    if (command.outputs[i] >= Outputs || command.brightness > 100) {
+                        stats_.invalidCommands++;
+                        continue;
+                    }
+                    setOutputLevel(table_, driver_, command.outputs[i], command.active, brightnessDuty(command.brightness));
+                }
+                break;
+            case OutputCommandType::SetInterval:
+                for (uint8_t i = 0; i < command.outputCount; i++) {
+                    if (command.outputs[i] >= Outputs) {
+                        stats_.invalidCommands++;
+                        continue;
+                    }
+                    setOutputBlink(table_, driver_, command.outputs[i], command.interval, now);
+                }
+                break;
+            case OutputCommandType::CreateGroup: {
+                bool valid = command.target != 0 && command.outputCount > 0 &&
+                             command.interval >= options_.minChaseIntervalMs;
+                for (uint8_t i = 0; i < command.outputCount; i++) valid = valid && command.outputs[i] < Outputs;
+                const int slot = valid ? findChasingGroupSlot(groups_, Groups, command.target) : -1;
+                if (slot < 0) {
+                    stats_.invalidCommands++;
+                    break;
+                }
+                startChasingGroup(table_, driver_, groups_[slot], command.target, command.outputs, command.outputCount,
+                                  command.interval, command.name, now);
+                break;
+            }
+            case OutputCommandType::DeleteGroup:
+                for (uint8_t g = 0; g < Groups; g++) {
+                    if (groups_[g].active && groups_[g].groupId == command.target) {
+                        stopChasingGroup(table_, driver_, groups_[g]);
+                        break;
+                    }
+                }
+                break;
+            case OutputCommandType::RenameGroup:
+                for (uint8_t g = 0; g < Groups; g++) {
+                    if (groups_[g].active && groups_[g].groupId == command.target) {
+                        setChasingGroupName(groups_[g], command.target, command.name);
+                        break;
+                    }
+                }
+                break;
+            case OutputCommandType::RenameOutput:
+                // Names drive no pins
+                if (command.target >= Outputs) stats_.invalidCommands++;
+                break;
+        }
+    }
+
+    // A later keyframe: the device's state at that time against the replayed one
+    void checkKeyframe(const TraceRecord& record) {
+        Keyframe recorded;
+        stats_.keyframes++;
+        if (!decodeKeyframe(record, recorded)) {
+            stats_.divergences++; // Nothing to confirm the replayed state with
+            return;
+        }
+        Keyframe replayed;
+        memset(&replayed, 0, sizeof(replayed));
+        captureEffectState(replayed, table_, groups_, Groups, record.timeMs);
+
+        bool same = recorded.on == replayed.on &&
+                    memcmp(recorded.brightness, replayed.brightness, sizeof(recorded.brightness)) == 0 &&
+                    memcmp(recorded.group, replayed.group, sizeof(recorded.group)) == 0 &&
+                    memcmp(recorded.interval, replayed.interval, sizeof(recorded.interval)) == 0;
+        bool inPhase = recorded.lit == replayed.lit;
+        for (uint8_t g = 0; g < Groups; g++) {
+            const typename Keyframe::Group& a = recorded.groups[g];
+            const typename Keyframe::Group& b = replayed.groups[g];
+            same = same && a.outputCount == b.outputCount;
+            if (a.outputCount == 0 || b.outputCount == 0) continue;
+            same = same && a.groupId == b.groupId && a.interval == b.interval &&
+                   memcmp(a.outputIndices, b.outputIndices, a.outputCount) == 0;
+            inPhase = inPhase && a.currentStep == b.currentStep;
+        }
+        if (!same) stats_.divergences++;
+        else if (!inPhase) stats_.phaseDrifts++;
+    }
+
+    uint8_t clientCount() const {
+        uint8_t count = 0;
+        for (uint32_t bits = clients_; bits != 0; bits &= bits - 1) count++;
+        return count;
+    }
+
+    // From the trace header; before table_ and driver_, which refer to it
+    struct Pins {
+        uint8_t gpio[Outputs];
+        Pins() : gpio() {}
+    };
+
+    ReplayOptions options_;
+    Pins pins_;
+    Table table_;
+    Driver driver_;
+    ChasingGroup groups_[Groups];
+    SpscQueue<OutputCommand, QUEUE_SIZE> queue_;
+    TraceReader reader_;
+    uint64_t clockUs_;        // Virtual time of the next pass
+    uint64_t lastTickUs_;
+    uint64_t stallStartUs_;   // Next recorded overrun, 0/0 = none
+    uint64_t stallEndUs_;
+    uint32_t clients_;        // Connected WebSocket clients, bit per client number
+    bool started_;
+    ReplayStats stats_;
+};
+
+#endif // TRACE_REPLAY_H
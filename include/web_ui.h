@@ -0,0 +1,16 @@
+#ifndef WEB_UI_H
+#define WEB_UI_H
+
+#include <stddef.h>
+
+// Control page in flash (PROGMEM), served as HEAD + device name + TAIL
+extern const char WEB_UI_PAGE_HEAD[];
+extern const char WEB_UI_PAGE_TAIL[];
+extern const size_t WEB_UI_PAGE_HEAD_LENGTH;
+extern const size_t WEB_UI_PAGE_TAIL_LENGTH;
+
+// Config portal stylesheet in flash (see attachPortalStyle in main.cpp)
+extern const char PORTAL_HEAD_ELEMENT[];
+extern const size_t PORTAL_HEAD_ELEMENT_LENGTH;
+
+#endif // WEB_UI_H
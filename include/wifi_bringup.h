@@ -0,0 +1,101 @@
+#ifndef WIFI_BRINGUP_H
+#define WIFI_BRINGUP_H
+
+#include <stdint.h>
+
+// WiFi bring-up as a non-blocking state machine, stepped from loop().
+// The station joins with the saved credentials; if there are none, or the
+// link isn't up within the connect timeout, the configuration portal opens;
+// if nobody configures the device before the portal timeout, the fallback
+// access point takes over. update() only looks at the clock and the link
+// state it is handed and tells the caller what to start, so no step ever
+// waits and the effects keep running while WiFi comes up.
+// Free of Arduino headers so the native tests can exercise it.
+
+enum class WifiBringupState : uint8_t {
+    Idle,        // begin() not called yet
+    Connecting,  // Station joining with the saved credentials
+    Portal,      // Configuration portal open
+    FallbackAp,  // Own access point (AP_SSID), after the portal timed out
+    Connected    // Station link up
+};
+
+enum class WifiBringupAction : uint8_t {
+    None,
+    StartPortal,      // Open the configuration portal
+    StartFallbackAp,  // Close the portal, start the fallback access point
+    LinkUp            // Station connected: start the network services
+};
+
+struct WifiBringupTimeouts {
+    uint32_t connectMs;  // Saved credentials get this long before the portal opens
+    uint32_t portalMs;   // Portal stays open this long before the fallback AP
+};
+
+class WifiBringup {
+public:
+    explicit WifiBringup(const WifiBringupTimeouts& timeouts)
+        : timeouts_(timeouts), state_(WifiBringupState::Idle), enteredAtMs_(0), startedAtMs_(0), linkUpMs_(0),
+          haveCredentials_(false) {}
+
+    void begin(uint32_t nowMs, bool haveCredentials) {
+        haveCredentials_ = haveCredentials;
+        startedAtMs_ = nowMs;
+        enter(WifiBringupState::Connecting, nowMs);
+    }
+
+    // One step; 'stationConnected' is the current station link state
+    WifiBringupAction update(uint32_t nowMs, bool stationConnected) {
+        switch (state_) {
+            case WifiBringupState::Connecting:
+            case WifiBringupState::Portal:
+                if (stationConnected) {
+                    linkUpMs_ = nowMs - startedAtMs_;
+                    enter(WifiBringupState::Connected, nowMs);
+                    return WifiBringupAction::LinkUp;
+                }
+                if (state_ == WifiBringupState::Connecting &&
+                    (!haveCredentials_ || nowMs - enteredAtMs_ >= timeouts_.connectMs)) {
+                    enter(WifiBringupState::Portal, nowMs);
+                    return WifiBringupAction::StartPortal;
+                }
+                if (state_ == WifiBringupState::Portal && nowMs - enteredAtMs_ >= timeouts_.portalMs) {
+                    enter(WifiBringupState::FallbackAp, nowMs);
+                    return WifiBringupAction::StartFallbackAp;
+                }
+                return WifiBringupAction::None;
+            default:
+                return WifiBringupAction::None;
+        }
+    }
+
+    WifiBringupState state() const { return state_; }
+    bool settled() const { return state_ == WifiBringupState::Connected || state_ == WifiBringupState::FallbackAp; }
+    uint32_t linkUpMs() const { return linkUpMs_; }   // begin() to station link, 0 until connected
+    uint32_t inStateMs(uint32_t nowMs) const { return nowMs - enteredAtMs_; }
+
+    static const char* stateName(WifiBringupState state) {
+        switch (state) {
+            case WifiBringupState::Connecting: return "connecting";
+            case WifiBringupState::Portal: return "portal";
+            case WifiBringupState::FallbackAp: return "fallback-ap";
+            case WifiBringupState::Connected: return "connected";
+            default: return "idle";
+        }
+    }
+
+private:
+    void enter(WifiBringupState state, uint32_t nowMs) {
+        state_ = state;
+        enteredAtMs_ = nowMs;
+    }
+
+    WifiBringupTimeouts timeouts_;
+    WifiBringupState state_;
+    uint32_t enteredAtMs_;
+    uint32_t startedAtMs_;
+    uint32_t linkUpMs_;
+    bool haveCredentials_;
+};
+
+#endif // WIFI_BRINGUP_H
@@ -0,0 +1,145 @@
+#ifndef WS_CLIENT_QUEUE_H
+#define WS_CLIENT_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Per-client outbound state for the status WebSocket.
+// broadcastTXT() writes to every client in turn and WiFiClient::write() waits
+// (up to its 5s timeout) for a client whose TCP send window is full, so one
+// tablet on bad WiFi used to stall the whole loop. Instead every client owns a
+// one-deep queue: publishing a new status only marks the client as pending
+// (latest state wins - older snapshots are never sent), and a pending client
+// is written to only once its send buffer can take the whole frame. A client
+// that stays backed up longer than the deadline is dropped. The Server-Sent
+// Events streams use the same queues.
+// Free of Arduino headers so the native tests can exercise it.
+
+struct WsQueueMetrics {
+    uint32_t framesSent;
+    uint32_t framesCoalesced;  // Snapshots replaced by a newer one before they were sent
+    uint32_t slowDisconnects;
+    uint32_t rejectedClients;  // Refused because WS_MAX_CLIENTS were connected
+    unsigned long maxBacklogMs;
+};
+
+template <uint8_t MaxClients>
+class WsClientQueues {
+public:
+    enum Action : uint8_t {
+        Idle,   // Nothing to send
+        Send,   // Frame fits into the send buffer now
+        Wait,   // Backed up, still within the deadline
+        Drop    // Backed up past the deadline - disconnect
+    };
+
+    explicit WsClientQueues(unsigned long slowClientTimeoutMs, uint8_t maxConnected = MaxClients)
+        : slowClientTimeoutMs_(slowClientTimeoutMs), maxConnected_(maxConnected < MaxClients ? maxConnected : MaxClients) {
+        for (uint8_t i = 0; i < MaxClients; i++) {
+            slots_[i].connected = false;
+            slots_[i].pending = false;
+            slots_[i].pendingSince = 0;
+        }
+        metrics_.framesSent = 0;
+        metrics_.framesCoalesced = 0;
+        metrics_.slowDisconnects = 0;
+        metrics_.rejectedClients = 0;
+        metrics_.maxBacklogMs = 0;
+    }
+
+    // Register a new client; false if the connection limit is reached.
+    // A new client starts pending so it receives the current state.
+    bool connect(uint8_t num, unsigned long now) {
+        if (num >= MaxClients) return false;
+        if (!slots_[num].connected && connectedCount() >= maxConnected_) {
+            metrics_.rejectedClients++;
+            return false;
+        }
+        slots_[num].connected = true;
+        slots_[num].pending = true;
+        slots_[num].pendingSince = now;
+        return true;
+    }
+
+    void disconnect(uint8_t num) {
+        if (num >= MaxClients) return;
+        slots_[num].connected = false;
+        slots_[num].pending = false;
+    }
+
+    // A new snapshot is available for every client
+    void publish(unsigned long now) {
+        for (uint8_t i = 0; i < MaxClients; i++) publish(i, now);
+    }
+
+    // ...or for one client (subscribers that only want some snapshots)
+    void publish(uint8_t num, unsigned long now) {
+        if (num >= MaxClients) return;
+        Slot& slot = slots_[num];
+        if (!slot.connected) return;
+        if (slot.pending) {
+            metrics_.framesCoalesced++; // Deadline keeps running from the oldest unsent state
+        } else {
+            slot.pending = true;
+            slot.pendingSince = now;
+        }
+    }
+
+    Action poll(uint8_t num, size_t writeRoom, size_t frameSize, unsigned long now) {
+        if (num >= MaxClients) return Idle;
+        Slot& slot = slots_[num];
+        if (!slot.connected || !slot.pending) return Idle;
+        if (writeRoom >= frameSize) return Send;
+        const unsigned long backlog = now - slot.pendingSince;
+        if (backlog > metrics_.maxBacklogMs) metrics_.maxBacklogMs = backlog;
+        if (backlog >= slowClientTimeoutMs_) {
+            metrics_.slowDisconnects++;
+            disconnect(num);
+            return Drop;
+        }
+        return Wait;
+    }
+
+    void markSent(uint8_t num, unsigned long now) {
+        if (num >= MaxClients) return;
+        const unsigned long backlog = now - slots_[num].pendingSince;
+        if (backlog > metrics_.maxBacklogMs) metrics_.maxBacklogMs = backlog;
+        slots_[num].pending = false;
+        metrics_.framesSent++;
+    }
+
+    bool pending(uint8_t num) const { return num < MaxClients && slots_[num].connected && slots_[num].pending; }
+
+    bool anyPending() const {
+        for (uint8_t i = 0; i < MaxClients; i++) {
+            if (slots_[i].connected && slots_[i].pending) return true;
+        }
+        return false;
+    }
+
+    uint8_t connectedCount() const {
+        uint8_t count = 0;
+        for (uint8_t i = 0; i < MaxClients; i++) {
+            if (slots_[i].connected) count++;
+        }
+        return count;
+    }
+
+    bool isConnected(uint8_t num) const { return num < MaxClients && slots_[num].connected; }
+
+    const WsQueueMetrics& metrics() const { return metrics_; }
+
+private:
+    struct Slot {
+        bool connected;
+        bool pending;
+        unsigned long pendingSince;
+    };
+
+    Slot slots_[MaxClients];
+    unsigned long slowClientTimeoutMs_;
+    uint8_t maxConnected_;
+    WsQueueMetrics metrics_;
+};
+
+#endif // WS_CLIENT_QUEUE_H
@@ -0,0 +1,543 @@
+"""Load generator and soak harness for the HTTP API and the status WebSocket.
+
+Drives a board over the LAN (or anything serving the same API, e.g. on
+localhost) with a configurable mix of clients, all running at once:
+
+  --ws-clients N     tablets: status WebSocket connections that only listen
+  --sliders N        tablets dragging a brightness slider: WebSocket control
+                     commands at --slider-rate per second each, one in flight
+  --control-rate R   automation scripts: POST /api/control per second, over
+                     one kept-alive HTTP connection
+  --poll-rate R      dashboards: GET /api/status per second with If-None-Match
+
+GET /api/metrics is sampled every --metrics-interval seconds for the heap
+floor, loop pass times and effect timing. The result is one JSON document:
+throughput, p50/p99/p999 latency per request kind, lost replies and
+disconnects, coalesced status versions, heap floor and effect jitter (longest
+gap between effect ticks and ticks past their deadline during the run),
+plus the metric samples. --output writes it to a file, --append adds it as
+one line to a JSON Lines file, which keeps a history across firmware
+releases (--label names the run).
+
+Usage: python scripts/loadgen.py railhub.local --duration 600 --ws-clients 3 --sliders 2 \\
+           --control-rate 5 --poll-rate 1 --append soak_history.jsonl --label v2.4.0
+Standard library only.
+"""
+
+import argparse
+import base64
+import http.client
+import json
+import math
+import os
+import socket
+import struct
+import sys
+import threading
+import time
+from datetime import datetime, timezone
+
+SCHEMA_VERSION = 1
+OUTPUT_IDS = 7            # MAX_OUTPUTS
+REPLY_TIMEOUT_S = 2.0     # A WebSocket reply later than this counts as lost
+RECONNECT_DELAY_S = 1.0
+
+
+class WebSocketClient:
+    """Just enough RFC 6455 for the status socket: text frames, ping, close."""
+
+    def __init__(self, host, port, path="/", timeout=5.0):
+        self.sock = socket.create_connection((host, port), timeout=timeout)
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.buffer = b""
+        key = base64.b64encode(os.urandom(16)).decode()
+        request = ("GET %s HTTP/1.1\r\nHost: %s:%d\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                   "Sec-WebSocket-Key: %s\r\nSec-WebSocket-Version: 13\r\n\r\n" % (path, host, port, key))
+        self.sock.sendall(request.encode())
+        while b"\r\n\r\n" not in self.buffer:
+            chunk = self.sock.recv(4096)
+            if not chunk:
+                raise ConnectionError("closed during handshake")
+            self.buffer += chunk
+        head, self.buffer = self.buffer.split(b"\r\n\r\n", 1)
+        status_line = head.split(b"\r\n", 1)[0]
+        if b" 101 " not in status_line + b" ":
+            raise ConnectionError("handshake refused: %s" % status_line.decode(errors="replace"))
+        self.fragments = b""
+
+    def send_text(self, text):
+        payload = text.encode()
+        mask = os.urandom(4)
+        length = len(payload)
+        if length < 126:
+            header = struct.pack("!BB", 0x81, 0x80 | length)
+        elif length < 65536:
+            header = struct.pack("!BBH", 0x81, 0x80 | 126, length)
+        else:
+            header = struct.pack("!BBQ", 0x81, 0x80 | 127, length)
+        self._send(header + mask + self._mask(payload, mask))
+
+    def _send(self, data):
+        self.sock.sendall(data)
+
+    @staticmethod
+    def _mask(payload, mask):
+        repeated = (mask * (len(payload) // 4 + 1))[:len(payload)]
+        return (int.from_bytes(payload, "big") ^ int.from_bytes(repeated, "big")).to_bytes(len(payload), "big")
+
+    def _parse(self):
+        """(opcode, fin, payload) of the first complete frame in the buffer, or None."""
+        if len(self.buffer) < 2:
+            return None
+        first, second = self.buffer[0], self.buffer[1]
+        length = second & 0x7F
+        offset = 2
+        if length == 126:
+            if len(self.buffer) < 4:
+                return None
+            length = struct.unpack("!H", self.buffer[2:4])[0]
+            offset = 4
+        elif length == 127:
+            if len(self.buffer) < 10:
+                return None
+            length = struct.unpack("!Q", self.buffer[2:10])[0]
+            offset = 10
+        mask = None
+        if second & 0x80:
+            mask = self.buffer[offset:offset + 4]
+            offset += 4
+        if len(self.buffer) < offset + length:
+            return None
+        payload = self.buffer[offset:offset + length]
+        self.buffer = self.buffer[offset + length:]
+        if mask:
+            payload = self._mask(payload, mask)
+        return first & 0x0F, bool(first & 0x80), payload
+
+    def receive(self, timeout):
+        """Next text message, or None when 'timeout' seconds pass without one."""
+        deadline = time.monotonic() + timeout
+        while True:
+            frame = self._parse()
+            if frame is not None:
+                opcode, fin, payload = frame
+                if opcode == 0x8:
+                    raise ConnectionError("closed by the server")
+                if opcode == 0x9:
+                    self._send(struct.pack("!BB", 0x8A, 0x80 | len(payload)) + b"\0\0\0\0" + payload)
+                    continue
+                if opcode in (0x1, 0x0):
+                    self.fragments += payload
+                    if fin:
+                        message, self.fragments = self.fragments, b""
+                        return message.decode(errors="replace")
+                continue
+            remaining = deadline - time.monotonic()
+            if remaining <= 0:
+                return None
+            self.sock.settimeout(remaining)
+            try:
+                chunk = self.sock.recv(8192)
+            except socket.timeout:
+                return None
+            if not chunk:
+                raise ConnectionError("connection closed")
+            self.buffer += chunk
+
+    def close(self):
+        try:
+            self._send(struct.pack("!BB", 0x88, 0x80) + b"\0\0\0\0")
+        except OSError:
+            pass
+        self.sock.close()
+
+
+class Recorder:
+    """Latencies and counters from every worker thread."""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.latencies = {}
+        self.counters = {}
+        self.samples = []
+
+    def latency(self, kind, seconds):
+        with self.lock:
+            self.latencies.setdefault(kind, []).append(seconds * 1000.0)
+
+    def count(self, name, amount=1):
+        with self.lock:
+            self.counters[name] = self.counters.get(name, 0) + amount
+
+
+def percentile(ordered, fraction):
+    """Nearest-rank percentile of an ascending list."""
+    if not ordered:
+        return None
+    rank = max(1, math.ceil(fraction * len(ordered)))
+    return ordered[min(rank, len(ordered)) - 1]
+
+
+def summarize(values):
+    ordered = sorted(values)
+    if not ordered:
+        return {"count": 0}
+    return {"count": len(ordered),
+            "p50": round(percentile(ordered, 0.50), 2),
+            "p99": round(percentile(ordered, 0.99), 2),
+            "p999": round(percentile(ordered, 0.999), 2),
+            "max": round(ordered[-1], 2),
+            "mean": round(sum(ordered) / len(ordered), 2)}
+
+
+def classify(message):
+    """'status' (has a version), 'reply' (command result) or None."""
+    try:
+        document = json.loads(message)
+    except ValueError:
+        return None, None
+    if not isinstance(document, dict):
+        return None, None
+    if "version" in document:
+        return "status", document
+    return "reply", document
+
+
+class StatusTracker:
+    """Status versions seen on one connection: gaps are states coalesced away."""
+
+    def __init__(self, recorder):
+        self.recorder = recorder
+        self.last_version = None
+
+    def frame(self, document, size):
+        self.recorder.count("status_frames")
+        self.recorder.count("status_bytes", size)
+        version = document.get("version")
+        if isinstance(version, int):
+            if self.last_version is not None and version > self.last_version + 1:
+                self.recorder.count("status_versions_coalesced", version - self.last_version - 1)
+            if self.last_version is None or version > self.last_version:
+                self.last_version = version
+
+
+def pace(next_due, interval, stop):
+    """Sleep until 'next_due'; returns the following due time. A worker that
+    fell behind by more than one interval skips ahead instead of bursting."""
+    delay = next_due - time.monotonic()
+    if delay > 0:
+        stop.wait(delay)
+    following = next_due + interval
+    return following if following > time.monotonic() - interval else time.monotonic() + interval
+
+
+def ws_listener(args, recorder, stop, index):
+    while not stop.is_set():
+        try:
+            client = WebSocketClient(args.host, args.ws_port, args.ws_path)
+        except (OSError, ConnectionError):
+            recorder.count("ws_connect_failures")
+            stop.wait(RECONNECT_DELAY_S)
+            continue
+        recorder.count("ws_connects")
+        tracker = StatusTracker(recorder)
+        try:
+            while not stop.is_set():
+                message = client.receive(0.5)
+                if message is None:
+                    continue
+                kind, document = classify(message)
+                if kind == "status":
+                    tracker.frame(document, len(message))
+        except (OSError, ConnectionError):
+            if not stop.is_set():
+                recorder.count("ws_disconnects")
+            stop.wait(RECONNECT_DELAY_S)
+        finally:
+            client.close()
+
+
+def ws_slider(args, recorder, stop, index):
+    """Drags output (index % 7) up and down, one command in flight."""
+    output_id = index % OUTPUT_IDS
+    level, step = 0, 5
+    interval = 1.0 / args.slider_rate
+    while not stop.is_set():
+        try:
+            client = WebSocketClient(args.host, args.ws_port, args.ws_path)
+        except (OSError, ConnectionError):
+            recorder.count("ws_connect_failures")
+            stop.wait(RECONNECT_DELAY_S)
+            continue
+        recorder.count("ws_connects")
+        tracker = StatusTracker(recorder)
+        next_due = time.monotonic()
+        try:
+            while not stop.is_set():
+                next_due = pace(next_due, interval, stop)
+                if stop.is_set():
+                    break
+                level += step
+                if level >= 100 or level <= 0:
+                    step = -step
+                    level = max(0, min(100, level))
+                sent = time.monotonic()
+                client.send_text(json.dumps({"command": "control", "id": output_id, "active": True,
+                                             "brightness": level}, separators=(",", ":")))
+                recorder.count("ws_commands")
+                while True:
+                    message = client.receive(max(0.0, sent + REPLY_TIMEOUT_S - time.monotonic()))
+                    if message is None:
+                        recorder.count("ws_replies_lost")
+                        break
+                    kind, document = classify(message)
+                    if kind == "status":
+                        tracker.frame(document, len(message))
+                    elif kind == "reply":
+                        recorder.latency("ws_command", time.monotonic() - sent)
+                        recorder.count("ws_replies_error" if "error" in document else "ws_replies_ok")
+                        break
+        except (OSError, ConnectionError):
+            if not stop.is_set():
+                recorder.count("ws_disconnects")
+            stop.wait(RECONNECT_DELAY_S)
+        finally:
+            client.close()
+
+
+def http_connection(args):
+    return http.client.HTTPConnection(args.host, args.http_port, timeout=5)
+
+
+def http_control(args, recorder, stop):
+    """Switches outputs on and off in turn, over one kept-alive connection."""
+    connection = http_connection(args)
+    interval = 1.0 / args.control_rate
+    next_due = time.monotonic()
+    sequence = 0
+    while not stop.is_set():
+        next_due = pace(next_due, interval, stop)
+        if stop.is_set():
+            break
+        body = json.dumps({"id": sequence % OUTPUT_IDS, "active": (sequence // OUTPUT_IDS) % 2 == 0})
+        sequence += 1
+        sent = time.monotonic()
+        try:
+            connection.request("POST", "/api/control", body, {"Content-Type": "application/json"})
+            response = connection.getresponse()
+            response.read()
+        except (OSError, http.client.HTTPException):
+            recorder.count("http_errors")
+            connection.close()
+            connection = http_connection(args)
+            continue
+        recorder.latency("http_control", time.monotonic() - sent)
+        recorder.count("http_control_%d" % response.status)
+    connection.close()
+
+
+def http_poller(args, recorder, stop):
+    """GET /api/status with the ETag of the last answer."""
+    connection = http_connection(args)
+    interval = 1.0 / args.poll_rate
+    next_due = time.monotonic()
+    etag = None
+    while not stop.is_set():
+        next_due = pace(next_due, interval, stop)
+        if stop.is_set():
+            break
+        headers = {"If-None-Match": etag} if etag else {}
+        sent = time.monotonic()
+        try:
+            connection.request("GET", "/api/status", headers=headers)
+            response = connection.getresponse()
+            body = response.read()
+        except (OSError, http.client.HTTPException):
+            recorder.count("http_errors")
+            connection.close()
+            connection = http_connection(args)
+            continue
+        recorder.latency("status_poll", time.monotonic() - sent)
+        recorder.count("status_poll_%d" % response.status)
+        if response.status == 200:
+            etag = response.getheader("ETag")
+            recorder.count("status_bytes", len(body))
+    connection.close()
+
+
+def fetch_json(args, path):
+    connection = http_connection(args)
+    try:
+        connection.request("GET", path)
+        response = connection.getresponse()
+        body = response.read()
+        return json.loads(body) if response.status == 200 else None
+    except (OSError, http.client.HTTPException, ValueError):
+        return None
+    finally:
+        connection.close()
+
+
+def metrics_sampler(args, recorder, stop, started):
+    while True:
+        metrics = fetch_json(args, "/api/metrics")
+        if metrics is None:
+            recorder.count("metrics_unavailable")
+        else:
+            with recorder.lock:
+                recorder.samples.append({
+                    "t": round(time.monotonic() - started, 1),
+                    "freeHeap": metrics["heap"]["free"],
+                    "maxBlock": metrics["heap"]["maxBlock"],
+                    "maxPassUs": metrics["loop"]["maxPassUs"],
+                    "effectRuns": metrics["effects"]["runs"],
+                    "effectMaxGapMs": metrics["effects"]["maxGapMs"],
+                    "deadlineMisses": metrics["effects"]["deadlineMisses"],
+                    "wsClients": metrics["websocket"]["clients"],
+                    "raw": metrics})
+        if stop.wait(args.metrics_interval):
+            break
+
+
+def device_summary(samples):
+    """Heap floor and effect jitter from the /api/metrics samples. The device
+    keeps the longest effect gap since boot; max_gap_ms_run is set only when
+    this run made it longer."""
+    if not samples:
+        return {"samples": 0}, {}
+    first, last = samples[0]["raw"], samples[-1]["raw"]
+    heap = {"samples": len(samples),
+            "free_min": min(s["freeHeap"] for s in samples),
+            "free_max": max(s["freeHeap"] for s in samples),
+            "max_block_min": min(s["maxBlock"] for s in samples),
+            "floor_since_boot": last["heap"]["minFree"],
+            "admission_level_max": max(s["raw"]["heap"]["level"] for s in samples)}
+    effects = {"ticks": last["effects"]["runs"] - first["effects"]["runs"],
+               "deadline_misses": last["effects"]["deadlineMisses"] - first["effects"]["deadlineMisses"],
+               "max_gap_ms_since_boot": last["effects"]["maxGapMs"],
+               "max_gap_ms_run": last["effects"]["maxGapMs"] if last["effects"]["maxGapMs"] > first["effects"]["maxGapMs"] else None,
+               "max_pass_us_since_boot": last["loop"]["maxPassUs"],
+               "pass_overruns": last["loop"]["overruns"] - first["loop"]["overruns"],
+               "queue_dropped": last["commands"]["queueDropped"] - first["commands"]["queueDropped"],
+               "ws_coalesced": last["websocket"]["coalesced"] - first["websocket"]["coalesced"],
+               "ws_slow_disconnects": last["websocket"]["slowDisconnects"] - first["websocket"]["slowDisconnects"]}
+    return heap, effects
+
+
+def progress(recorder, started, stop, every):
+    while not stop.wait(every):
+        elapsed = time.monotonic() - started
+        with recorder.lock:
+            counters = dict(recorder.counters)
+            last = recorder.samples[-1] if recorder.samples else None
+        commands = counters.get("ws_commands", 0) + sum(v for k, v in counters.items() if k.startswith("http_control_"))
+        line = "[%6.0fs] %7.1f cmd/s  %7.1f status/s  lost %d  disconnects %d" % (
+            elapsed, commands / elapsed, counters.get("status_frames", 0) / elapsed,
+            counters.get("ws_replies_lost", 0), counters.get("ws_disconnects", 0))
+        if last:
+            line += "  heap %d  effect gap %d ms" % (last["freeHeap"], last["effectMaxGapMs"])
+        print(line, file=sys.stderr)
+
+
+def run(args):
+    firmware = fetch_json(args, "/api/status")
+    if firmware is None:
+        sys.exit("loadgen: no status from http://%s:%d/api/status" % (args.host, args.http_port))
+
+    recorder = Recorder()
+    stop = threading.Event()
+    started = time.monotonic()
+    started_at = datetime.now(timezone.utc).replace(microsecond=0).isoformat()
+    workers = [threading.Thread(target=metrics_sampler, args=(args, recorder, stop, started))]
+    workers += [threading.Thread(target=ws_listener, args=(args, recorder, stop, i)) for i in range(args.ws_clients)]
+    workers += [threading.Thread(target=ws_slider, args=(args, recorder, stop, i)) for i in range(args.sliders)]
+    if args.control_rate > 0:
+        workers.append(threading.Thread(target=http_control, args=(args, recorder, stop)))
+    if args.poll_rate > 0:
+        workers.append(threading.Thread(target=http_poller, args=(args, recorder, stop)))
+    if args.progress > 0:
+        workers.append(threading.Thread(target=progress, args=(recorder, started, stop, args.progress)))
+    for worker in workers:
+        worker.daemon = True
+        worker.start()
+    try:
+        stop.wait(args.duration)
+    except KeyboardInterrupt:
+        print("loadgen: interrupted, reporting what ran", file=sys.stderr)
+    stop.set()
+    for worker in workers:
+        worker.join(REPLY_TIMEOUT_S + 6)
+    elapsed = time.monotonic() - started
+    return report(args, recorder, firmware, started_at, elapsed)
+
+
+def report(args, recorder, firmware, started_at, elapsed):
+    counters = recorder.counters
+    http_commands = sum(v for k, v in counters.items() if k.startswith("http_control_"))
+    ws_replies = counters.get("ws_replies_ok", 0) + counters.get("ws_replies_error", 0)
+    heap, effects = device_summary(recorder.samples)
+    return {
+        "schema": SCHEMA_VERSION,
+        "label": args.label,
+        "target": "%s:%d/%d" % (args.host, args.http_port, args.ws_port),
+        "firmware": {"name": firmware.get("name"), "buildDate": firmware.get("buildDate")},
+        "started_at": started_at,
+        "duration_s": round(elapsed, 1),
+        "config": {"ws_clients": args.ws_clients, "sliders": args.sliders, "slider_rate": args.slider_rate,
+                   "control_rate": args.control_rate, "poll_rate": args.poll_rate, "ws_path": args.ws_path},
+        "throughput": {"commands_per_s": round((http_commands + ws_replies) / elapsed, 2),
+                       "status_frames_per_s": round(counters.get("status_frames", 0) / elapsed, 2),
+                       "status_polls_per_s": round(sum(v for k, v in counters.items()
+                                                       if k.startswith("status_poll_")) / elapsed, 2),
+                       "status_kbytes_per_s": round(counters.get("status_bytes", 0) / 1024.0 / elapsed, 2)},
+        "latency_ms": {kind: summarize(values) for kind, values in sorted(recorder.latencies.items())},
+        "dropped": {"ws_replies_lost": counters.get("ws_replies_lost", 0),
+                    "ws_disconnects": counters.get("ws_disconnects", 0),
+                    "ws_connect_failures": counters.get("ws_connect_failures", 0),
+                    "http_errors": counters.get("http_errors", 0),
+                    "status_versions_coalesced": counters.get("status_versions_coalesced", 0)},
+        "counters": dict(sorted(counters.items())),
+        "heap": heap,
+        "effects": effects,
+        "samples": [{k: v for k, v in s.items() if k != "raw"} for s in recorder.samples] if args.samples else [],
+    }
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description="Load generator and soak harness for the RailHub8266 API")
+    parser.add_argument("host", help="board address, e.g. railhub.local or 192.168.1.50")
+    parser.add_argument("--http-port", type=int, default=80)
+    parser.add_argument("--ws-port", type=int, default=81)
+    parser.add_argument("--ws-path", default="/", help="WebSocket path and subscription query")
+    parser.add_argument("--duration", type=float, default=60, help="seconds (soak: hours, e.g. 14400)")
+    parser.add_argument("--ws-clients", type=int, default=2, help="listening WebSocket clients")
+    parser.add_argument("--sliders", type=int, default=1, help="WebSocket clients streaming brightness")
+    parser.add_argument("--slider-rate", type=float, default=10, help="commands per second per slider")
+    parser.add_argument("--control-rate", type=float, default=2, help="POST /api/control per second (0 = off)")
+    parser.add_argument("--poll-rate", type=float, default=1, help="GET /api/status per second (0 = off)")
+    parser.add_argument("--metrics-interval", type=float, default=5, help="seconds between /api/metrics samples")
+    parser.add_argument("--progress", type=float, default=10, help="seconds between progress lines (0 = quiet)")
+    parser.add_argument("--label", default=None, help="name of the run, e.g. the firmware release")
+    parser.add_argument("--no-samples", dest="samples", action="store_false", help="leave the metric samples out")
+    parser.add_argument("--output", help="write the result JSON to this file")
+    parser.add_argument("--append", help="append the result as one line to this JSON Lines file")
+    args = parser.parse_args(argv)
+    if args.ws_clients + args.sliders > 4:
+        print("loadgen: more than WS_MAX_CLIENTS (4) WebSocket clients, expect refusals", file=sys.stderr)
+    if args.sliders and args.slider_rate <= 0:
+        parser.error("--slider-rate must be positive")
+
+    result = run(args)
+    text = json.dumps(result, indent=2)
+    if args.output:
+        with open(args.output, "w", encoding="utf-8") as output_file:
+            output_file.write(text + "\n")
+    if args.append:
+        with open(args.append, "a", encoding="utf-8") as history_file:
+            history_file.write(json.dumps(result, separators=(",", ":")) + "\n")
+    print(text)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
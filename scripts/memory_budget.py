@@ -0,0 +1,160 @@
+"""RAM and flash per subsystem, checked against budgets.
+
+PlatformIO target: pio run -e esp12e -t memory_budget
+Reads the linker map that scripts/size_report.py has the linker write and
+attributes every input section to a subsystem from scripts/memory_budget.json
+(web UI, HTTP, JSON, WiFiManager, WebSockets, effects, persistence, ...):
+
+  data, rodata, bss  bytes in DRAM (0x3FFE8000-0x40000000)
+  iram               code in instruction RAM (0x40100000-0x40200000)
+  irom               code and constants run from flash (0x40200000-)
+  ram                data + rodata + bss
+  flash              data + rodata + iram + irom: what the partition stores
+
+The report goes to memory_report.txt in the project directory. It has a
+fixed layout and no timestamps, so committing it makes the cost of each
+change show up in the diff. The target fails when a subsystem or the
+total exceeds its budget.
+
+Standalone: python scripts/memory_budget.py firmware.map [budget.json] [report.txt]
+"""
+
+import json
+import os
+import re
+import sys
+
+try:
+    SCRIPT_DIR = os.path.dirname(os.path.abspath(__file__))
+except NameError:  # Run by SCons, from the project directory
+    SCRIPT_DIR = os.path.join(os.getcwd(), "scripts")
+sys.path.insert(0, SCRIPT_DIR)
+
+from size_report import DRAM_END, DRAM_START, iter_sections, module_name, section_kind  # noqa: E402
+
+IRAM_START = 0x40100000
+IROM_START = 0x40200000
+IROM_END = 0x40400000
+
+COLUMNS = ("data", "rodata", "bss", "iram", "irom", "ram", "flash")
+
+
+def region(name, address):
+    if DRAM_START <= address < DRAM_END:
+        return section_kind(name)
+    if IRAM_START <= address < IROM_START:
+        return "iram"
+    if IROM_START <= address < IROM_END:
+        return "irom"
+    return None
+
+
+def load_config(path):
+    with open(path, encoding="utf-8") as config_file:
+        config = json.load(config_file)
+    for subsystem in config["subsystems"]:
+        subsystem["module_patterns"] = [re.compile(p) for p in subsystem.get("modules", [])]
+        subsystem["section_patterns"] = [re.compile(p) for p in subsystem.get("sections", [])]
+    return config
+
+
+def subsystem_for(config, module, section):
+    for subsystem in config["subsystems"]:
+        if any(p.search(module) for p in subsystem["module_patterns"]) or \
+           any(p.search(section) for p in subsystem["section_patterns"]):
+            return subsystem["name"]
+    return "unassigned"
+
+
+def attribute(map_path, config):
+    usage = {s["name"]: dict.fromkeys(COLUMNS, 0) for s in config["subsystems"]}
+    for name, address, size, source in iter_sections(map_path):
+        kind = region(name, address)
+        if kind is None:
+            continue
+        subsystem = subsystem_for(config, module_name(source), name)
+        usage.setdefault(subsystem, dict.fromkeys(COLUMNS, 0))[kind] += size
+    for entry in usage.values():
+        entry["ram"] = entry["data"] + entry["rodata"] + entry["bss"]
+        entry["flash"] = entry["data"] + entry["rodata"] + entry["iram"] + entry["irom"]
+    return usage
+
+
+def check_budgets(usage, config):
+    """Lines describing each budget exceeded, empty when all fit."""
+    violations = []
+    for subsystem in config["subsystems"]:
+        for key, limit in sorted(subsystem.get("budget", {}).items()):
+            used = usage[subsystem["name"]][key]
+            if used > limit:
+                violations.append("%s %s: %d bytes, budget %d (+%d)" % (subsystem["name"], key, used, limit,
+                                                                        used - limit))
+    totals = total_usage(usage)
+    for key, limit in sorted(config.get("totals", {}).items()):
+        if key.startswith("_"):
+            continue
+        if totals[key] > limit:
+            violations.append("total %s: %d bytes, budget %d (+%d)" % (key, totals[key], limit, totals[key] - limit))
+    return violations
+
+
+def total_usage(usage):
+    return {key: sum(entry[key] for entry in usage.values()) for key in COLUMNS}
+
+
+def budget_text(budget):
+    return " ".join("%s<=%d" % (key, limit) for key, limit in sorted(budget.items()) if not key.startswith("_"))
+
+
+def format_report(usage, config):
+    lines = ["# Memory per subsystem in bytes (scripts/memory_budget.py, scripts/memory_budget.json)",
+             "%-14s" % "subsystem" + "".join("%9s" % column for column in COLUMNS) + "  budget"]
+    budgets = {s["name"]: s.get("budget", {}) for s in config["subsystems"]}
+    for name in list(budgets) + sorted(set(usage) - set(budgets)):
+        entry = usage[name]
+        lines.append("%-14s" % name + "".join("%9d" % entry[column] for column in COLUMNS) +
+                     ("  " + budget_text(budgets.get(name, {}))).rstrip())
+    totals = total_usage(usage)
+    lines.append("%-14s" % "TOTAL" + "".join("%9d" % totals[column] for column in COLUMNS) +
+                 ("  " + budget_text(config.get("totals", {}))).rstrip())
+    return "\n".join(lines) + "\n"
+
+
+def run(map_path, config_path, report_path):
+    """Write the report; returns the budget violations."""
+    config = load_config(config_path)
+    usage = attribute(map_path, config)
+    text = format_report(usage, config)
+    with open(report_path, "w", encoding="utf-8") as report_file:
+        report_file.write(text)
+    print(text, end="")
+    violations = check_budgets(usage, config)
+    for violation in violations:
+        print("OVER BUDGET: " + violation)
+    return violations
+
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO (SCons)
+except NameError:
+    env = None
+
+if env is not None:
+    def memory_budget_action(source, target, env):  # pylint: disable=unused-argument
+        violations = run(os.path.join(env.subst("$BUILD_DIR"), "firmware.map"),
+                         os.path.join(SCRIPT_DIR, "memory_budget.json"),
+                         os.path.join(env.subst("$PROJECT_DIR"), "memory_report.txt"))
+        return 1 if violations else 0
+
+    env.AddCustomTarget(
+        name="memory_budget",
+        dependencies="$BUILD_DIR/${PROGNAME}.elf",
+        actions=[memory_budget_action],
+        title="Memory Budget",
+        description="RAM/flash per subsystem from the linker map, fails over budget")
+elif __name__ == "__main__":
+    if len(sys.argv) < 2:
+        sys.exit("usage: memory_budget.py firmware.map [budget.json] [report.txt]")
+    CONFIG = sys.argv[2] if len(sys.argv) > 2 else os.path.join(SCRIPT_DIR, "memory_budget.json")
+    REPORT = sys.argv[3] if len(sys.argv) > 3 else "memory_report.txt"
+    sys.exit(1 if run(sys.argv[1], CONFIG, REPORT) else 0)
@@ -0,0 +1,159 @@
+"""DRAM use per module, from the linker map.
+
+PlatformIO post-build script (extra_scripts = post:scripts/size_report.py).
+After every firmware link it lists, per object file or library, the bytes
+it places in DRAM (.data, .rodata and .bss between 0x3FFE8000 and
+0x40000000) and the change since the previous build, so moving strings to
+flash or adding a buffer shows up module by module.
+
+The report is kept as $BUILD_DIR/dram_report.json, the one before it as
+dram_report.prev.json.
+
+Standalone: python scripts/size_report.py firmware.map [baseline.json]
+"""
+
+import json
+import os
+import re
+import sys
+
+DRAM_START = 0x3FFE8000
+DRAM_END = 0x40000000
+
+# Input section with address, size and object on one line, or the name
+# alone with the rest on the next line when the name is long
+SECTION_LINE = re.compile(r"^ (\S+)\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S.*)$")
+SECTION_NAME_ONLY = re.compile(r"^ (\S+)\s*$")
+SECTION_REST = re.compile(r"^\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S.*)$")
+
+
+def section_kind(name):
+    if "bss" in name or name == "COMMON":
+        return "bss"
+    if ".data" in name:
+        return "data"
+    return "rodata"
+
+
+def module_name(source):
+    """Project sources by path, everything else by library archive."""
+    source = source.strip().replace("\\", "/")
+    archive = re.match(r"^(.*\.a)\((.*)\)$", source)
+    if archive:
+        library = os.path.basename(archive.group(1))
+        if library == "libFrameworkArduino.a":
+            return "framework"
+        return re.sub(r"^lib|\.a$", "", library)
+    if "/src/" in source:
+        return "src/" + source.split("/src/", 1)[1].replace(".cpp.o", ".cpp").replace(".c.o", ".c")
+    return os.path.basename(source)
+
+
+def iter_sections(path):
+    """(section name, address, size, object) for every input section in the map."""
+    in_memory_map = False
+    pending_name = None
+    with open(path, encoding="utf-8", errors="replace") as map_file:
+        for line in map_file:
+            line = line.rstrip("\n")
+            if line.startswith("Linker script and memory map"):
+                in_memory_map = True
+                continue
+            if not in_memory_map:
+                continue
+
+            name = address = size = source = None
+            match = SECTION_LINE.match(line)
+            if match:
+                name, address, size, source = match.groups()
+                pending_name = None
+            elif pending_name:
+                rest = SECTION_REST.match(line)
+                if rest:
+                    name = pending_name
+                    address, size, source = rest.groups()
+                pending_name = None
+            else:
+                only = SECTION_NAME_ONLY.match(line)
+                if only and not only.group(1).startswith("*"):
+                    pending_name = only.group(1)
+                continue
+
+            if name is None or name.startswith("*"):
+                continue
+            size = int(size, 16)
+            if size:
+                yield name, int(address, 16), size, source
+
+
+def parse_map(path):
+    modules = {}
+    for name, address, size, source in iter_sections(path):
+        if not DRAM_START <= address < DRAM_END:
+            continue
+        entry = modules.setdefault(module_name(source), {"data": 0, "rodata": 0, "bss": 0})
+        entry[section_kind(name)] += size
+    for entry in modules.values():
+        entry["total"] = entry["data"] + entry["rodata"] + entry["bss"]
+    return modules
+
+
+def format_report(modules, previous=None):
+    previous = previous or {}
+    lines = ["DRAM per module (bytes)",
+             "%-28s %7s %7s %7s %7s %8s" % ("module", "data", "rodata", "bss", "total", "change")]
+    names = sorted(set(modules) | set(previous),
+                   key=lambda name: (-modules.get(name, {}).get("total", 0), name))
+    totals = {"data": 0, "rodata": 0, "bss": 0, "total": 0}
+    previous_total = 0
+    for name in names:
+        entry = modules.get(name, {"data": 0, "rodata": 0, "bss": 0, "total": 0})
+        before = previous.get(name, {}).get("total")
+        change = "" if before is None else "%+d" % (entry["total"] - before)
+        lines.append("%-28s %7d %7d %7d %7d %8s" % (name[:28], entry["data"], entry["rodata"], entry["bss"],
+                                                  entry["total"], change))
+        for key in totals:
+            totals[key] += entry[key]
+        previous_total += previous.get(name, {}).get("total", 0)
+    change = "%+d" % (totals["total"] - previous_total) if previous else ""
+    lines.append("%-28s %7d %7d %7d %7d %8s" % ("TOTAL", totals["data"], totals["rodata"], totals["bss"],
+                                              totals["total"], change))
+    return "\n".join(lines)
+
+
+def load_report(path):
+    if not path or not os.path.exists(path):
+        return None
+    with open(path, encoding="utf-8") as report_file:
+        return json.load(report_file)
+
+
+def report(map_path, build_dir):
+    modules = parse_map(map_path)
+    current_path = os.path.join(build_dir, "dram_report.json")
+    previous_path = os.path.join(build_dir, "dram_report.prev.json")
+    if os.path.exists(current_path):
+        os.replace(current_path, previous_path)
+    print(format_report(modules, load_report(previous_path)))
+    with open(current_path, "w", encoding="utf-8") as report_file:
+        json.dump(modules, report_file, indent=2, sort_keys=True)
+        report_file.write("\n")
+
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO (SCons)
+except NameError:
+    env = None
+
+if env is not None:
+    MAP_PATH = os.path.join(env.subst("$BUILD_DIR"), "firmware.map")
+    env.Append(LINKFLAGS=["-Wl,-Map," + MAP_PATH])
+
+    def size_report_action(source, target, env):  # pylint: disable=unused-argument
+        report(MAP_PATH, env.subst("$BUILD_DIR"))
+
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", size_report_action)
+elif __name__ == "__main__":
+    if len(sys.argv) < 2:
+        sys.exit("usage: size_report.py firmware.map [baseline.json]")
+    print(format_report(parse_map(sys.argv[1]), load_report(sys.argv[2] if len(sys.argv) > 2 else None)))
@@ -0,0 +1,424 @@
+#include "http_server.h"
+#include "log.h"
+
+static const char* httpStatusText(uint16_t status) {
+    switch (status) {
+        case 200: return "OK";
+        case 204: return "No Content";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 408: return "Request Timeout";
+        case 413: return "Payload Too Large";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        case 503: return "Service Unavailable";
+        case 505: return "HTTP Version Not Supported";
+        default: return "Unknown";
+    }
+}
+
+// JSON error bodies for responses generated by the server itself
+static const char* httpErrorBody(uint16_t status) {
+    switch (status) {
+        case 400: return "{\"error\":\"Bad request\"}";
+        case 404: return "{\"error\":\"Not found\"}";
+        case 405: return "{\"error\":\"Method not allowed\"}";
+        case 408: return "{\"error\":\"Request timeout\"}";
+        case 413: return "{\"error\":\"Request too large\"}";
+        case 431: return "{\"error\":\"Headers too large\"}";
+        case 501: return "{\"error\":\"Not implemented\"}";
+        case 503: return "{\"error\":\"Low memory, retry later\"}";
+        case 505: return "{\"error\":\"HTTP version not supported\"}";
+        default: return "{\"error\":\"Internal error\"}";
+    }
+}
+
+HttpServer::HttpServer(uint16_t port)
+    : listener_(port), routeCount_(0), admission_(nullptr),
+      connectionsAccepted_(0), requestsServed_(0), idleReclaimed_(0) {
+    for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        connections_[i].phase = ConnectionFree;
+    }
+    keepAliveLimits_.maxRequestsPerConnection = HTTP_MAX_REQUESTS_PER_CONNECTION;
+    keepAliveLimits_.maxIdleConnections = HTTP_MAX_IDLE_CONNECTIONS;
+    keepAliveLimits_.lowHeapBytes = HTTP_LOW_HEAP_BYTES;
+}
+
+bool HttpServer::on(const char* path, HttpMethod method, HttpHandler handler, HttpRouteClass routeClass) {
+    if (routeCount_ >= HTTP_MAX_ROUTES) {
+        LOG_PRINTF("[HTTP] Route table full, dropping %s\n", path);
+        return false;
+    }
+    routes_[routeCount_].path = path;
+    routes_[routeCount_].method = method;
+    routes_[routeCount_].handler = handler;
+    routes_[routeCount_].routeClass = routeClass;
+    routeCount_++;
+    return true;
+}
+
+void HttpServer::begin() {
+    listener_.begin();
+    listener_.setNoDelay(true);
+}
+
+uint8_t HttpServer::activeConnections() const {
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        if (connections_[i].phase != ConnectionFree) count++;
+    }
+    return count;
+}
+
+uint8_t HttpServer::idleConnections() const {
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        if (isIdle(connections_[i])) count++;
+    }
+    return count;
+}
+
+size_t HttpServer::streamWriteRoom(uint8_t connectionId) {
+    if (connectionId >= HTTP_MAX_CONNECTIONS) return 0;
+    Connection& connection = connections_[connectionId];
+    if (connection.phase != ConnectionStreaming || !connection.client.connected()) return 0;
+    return connection.client.availableForWrite();
+}
+
+size_t HttpServer::streamWrite(uint8_t connectionId, const char* data, size_t length) {
+    if (connectionId >= HTTP_MAX_CONNECTIONS) return 0;
+    Connection& connection = connections_[connectionId];
+    if (connection.phase != ConnectionStreaming) return 0;
+    return connection.client.write(reinterpret_cast<const uint8_t*>(data), length);
+}
+
+void HttpServer::closeStream(uint8_t connectionId) {
+    if (connectionId >= HTTP_MAX_CONNECTIONS) return;
+    Connection& connection = connections_[connectionId];
+    if (connection.phase != ConnectionFree && connection.response.streaming()) {
+        closeConnection(connection);
+    }
+}
+
+uint8_t HttpServer::closeAll() {
+    uint8_t closed = 0;
+    for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        if (connections_[i].phase != ConnectionFree) {
+            closeConnection(connections_[i]);
+            closed++;
+        }
+    }
+    return closed;
+}
+
+void HttpServer::poll() {
+    const unsigned long now = millis();
+    reclaimIdleUnderPressure();
+    acceptClients(now);
+    for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        Connection& connection = connections_[i];
+        if (connection.phase == ConnectionReading) {
+            serviceReading(connection, now);
+        }
+        // A request completed above can start writing in the same pass
+        // (fresh timestamp: the handler may have taken a few milliseconds)
+        if (connection.phase == ConnectionWriting) {
+            serviceWriting(connection, millis());
+        }
+        if (connection.phase == ConnectionStreaming) {
+            serviceStreaming(connection);
+        }
+    }
+}
+
+void HttpServer::acceptClients(unsigned long now) {
+    // Only take clients we have a slot for; the rest wait in the lwIP backlog.
+    // A waiting client takes precedence over a connection that is merely idle.
+    while (listener_.hasClient()) {
+        Connection* slot = nullptr;
+        for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS && slot == nullptr; i++) {
+            if (connections_[i].phase == ConnectionFree) slot = &connections_[i];
+        }
+        if (slot == nullptr) {
+            if (!reclaimOldestIdle()) return;
+            continue;
+        }
+        slot->client = listener_.accept();
+        if (!slot->client) return;
+        slot->client.setNoDelay(true);
+        slot->parser.reset();
+        slot->response.clear();
+        slot->requestsServed = 0;
+        slot->phase = ConnectionReading;
+        slot->phaseStartMs = now;
+        connectionsAccepted_++;
+    }
+}
+
+bool HttpServer::reclaimOldestIdle() {
+    Connection* oldest = nullptr;
+    for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        Connection& connection = connections_[i];
+        if (!isIdle(connection)) continue;
+        if (oldest == nullptr || connection.phaseStartMs - oldest->phaseStartMs > 0x80000000UL) {
+            oldest = &connection; // Earlier idle start (wrap-safe comparison)
+        }
+    }
+    if (oldest == nullptr) return false;
+    closeConnection(*oldest);
+    idleReclaimed_++;
+    return true;
+}
+
+void HttpServer::reclaimIdleUnderPressure() {
+    if (idleConnections() == 0) return;
+    const uint32_t freeHeap = ESP.getFreeHeap();
+    if (!httpReclaimIdle(freeHeap, keepAliveLimits_)) return;
+    uint8_t reclaimed = 0;
+    while (reclaimOldestIdle()) reclaimed++;
+    LOG_PRINTF("[HTTP] Low heap (%u bytes): closed %u idle connection(s)\n",
+               static_cast<unsigned>(freeHeap), reclaimed);
+}
+
+void HttpServer::serviceReading(Connection& connection, unsigned long now) {
+    WiFiClient& client = connection.client;
+    const int available = client.available();
+    if (available > 0) {
+        if (!connection.parser.hasBufferedData()) {
+            connection.phaseStartMs = now; // Request timeout runs from the first byte
+        }
+        size_t count = static_cast<size_t>(available);
+        if (count > connection.parser.writableSpace()) count = connection.parser.writableSpace();
+        // Only reads what lwIP already holds - never waits for more
+        const int received = client.read(reinterpret_cast<uint8_t*>(connection.parser.writePtr()), count);
+        if (received > 0) {
+            connection.parser.commit(static_cast<size_t>(received));
+        }
+    }
+
+    switch (connection.parser.state()) {
+        case HttpConnectionParser::Complete:
+            dispatch(connection);
+            return;
+        case HttpConnectionParser::Failed:
+            LOG_PRINTF("[HTTP] Rejecting request: %u %s\n", connection.parser.errorStatus(),
+                       httpStatusText(connection.parser.errorStatus()));
+            respondWithError(connection, connection.parser.errorStatus(), false);
+            return;
+        default:
+            break;
+    }
+
+    if (!client.connected()) {
+        closeConnection(connection);
+    } else if (connection.parser.hasBufferedData()) {
+        if (now - connection.phaseStartMs >= HTTP_REQUEST_TIMEOUT_MS) {
+            respondWithError(connection, 408, false);
+        }
+    } else {
+        // Nothing sent yet: a fresh connection gets the request timeout,
+        // a kept-alive one the (longer) idle timeout
+        const unsigned long timeout = connection.requestsServed > 0 ? HTTP_KEEPALIVE_TIMEOUT_MS : HTTP_REQUEST_TIMEOUT_MS;
+        if (now - connection.phaseStartMs >= timeout) {
+            closeConnection(connection);
+        }
+    }
+}
+
+void HttpServer::dispatch(Connection& connection) {
+    const HttpConnectionParser& parser = connection.parser;
+    const bool headOnly = parser.method() == HttpMethod::Head;
+    const HttpMethod routeMethod = headOnly ? HttpMethod::Get : parser.method();
+
+    bool pathMatched = false;
+    const Route* route = nullptr;
+    for (uint8_t i = 0; i < routeCount_ && route == nullptr; i++) {
+        if (!parser.path().equals(routes_[i].path)) continue;
+        pathMatched = true;
+        if (routes_[i].method == routeMethod) route = &routes_[i];
+    }
+
+    connection.requestsServed++;
+    requestsServed_++;
+
+    if (route == nullptr) {
+        respondWithError(connection, pathMatched ? 405 : 404, true);
+        return;
+    }
+    if (admission_ != nullptr && !admission_->admitRequest(route->routeClass == HttpRouteClass::Essential)) {
+        respondWithError(connection, 503, true);
+        return;
+    }
+
+    connection.response.clear();
+    const HttpRequest request(parser, connection.client.remoteIP(), static_cast<uint8_t>(&connection - connections_));
+    route->handler(request, connection.response);
+    if (!connection.response.started()) {
+        connection.response.release();
+        respondWithError(connection, 500, true);
+        return;
+    }
+    // A stream only ends when the connection does
+    const bool keepAlive = !connection.response.streaming() && decideKeepAlive(connection, true);
+    startResponse(connection, headOnly, keepAlive);
+}
+
+bool HttpServer::decideKeepAlive(const Connection& connection, bool streamInSync) const {
+    // The connection itself is busy with this request, so every idle one is "other"
+    return httpKeepConnection(connection.parser.keepAlive(), streamInSync, connection.requestsServed,
+                              idleConnections(), ESP.getFreeHeap(), keepAliveLimits_);
+}
+
+void HttpServer::respondWithError(Connection& connection, uint16_t status, bool streamInSync) {
+    connection.response.clear();
+    connection.response.send(status, "application/json", httpErrorBody(status));
+    startResponse(connection, false, decideKeepAlive(connection, streamInSync));
+}
+
+void HttpServer::startResponse(Connection& connection, bool headOnly, bool keepAlive) {
+    const HttpResponse& response = connection.response;
+    const char* const headers = response.headers() ? response.headers() : "";
+    int length;
+    if (response.status() == 304) {
+        // No body and no Content-Length: it would have to be the full 200 length
+        headOnly = true;
+        length = snprintf(connection.head, sizeof(connection.head), "HTTP/1.1 304 %s\r\n%s",
+                          httpStatusText(304), headers);
+    } else if (response.streaming() && !headOnly) {
+        length = snprintf(connection.head, sizeof(connection.head),
+                          "HTTP/1.1 200 %s\r\n"
+                          "Content-Type: %s\r\n"
+                          "%s",
+                          httpStatusText(200), response.contentType() ? response.contentType() : "text/plain", headers);
+    } else {
+        length = snprintf(connection.head, sizeof(connection.head),
+                          "HTTP/1.1 %u %s\r\n"
+                          "Content-Type: %s\r\n"
+                          "Content-Length: %u\r\n"
+                          "%s%s",
+                          response.status(), httpStatusText(response.status()),
+                          response.contentType() ? response.contentType() : "text/plain",
+                          static_cast<unsigned>(response.contentLength()),
+                          response.status() == 503 ? "Retry-After: 2\r\n" : "", headers);
+    }
+    if (length < 0) length = 0;
+    if (static_cast<size_t>(length) < sizeof(connection.head)) {
+        char* const tail = connection.head + length;
+        const size_t tailSize = sizeof(connection.head) - length;
+        const int tailLength = keepAlive
+            ? snprintf(tail, tailSize, "Connection: keep-alive\r\nKeep-Alive: timeout=%u, max=%u\r\n\r\n",
+                       static_cast<unsigned>(HTTP_KEEPALIVE_TIMEOUT_MS / 1000),
+                       static_cast<unsigned>(HTTP_MAX_REQUESTS_PER_CONNECTION - connection.requestsServed))
+            : snprintf(tail, tailSize, "Connection: close\r\n\r\n");
+        if (tailLength > 0) length += tailLength;
+    }
+    if (static_cast<size_t>(length) >= sizeof(connection.head)) length = sizeof(connection.head) - 1;
+
+    connection.headLength = static_cast<size_t>(length);
+    connection.headSent = 0;
+    connection.segmentIndex = 0;
+    connection.segmentSent = 0;
+    connection.headOnly = headOnly;
+    connection.keepAlive = keepAlive;
+    if (headOnly) {
+        connection.response.release(); // Body is never sent
+    }
+    connection.phase = ConnectionWriting;
+    connection.phaseStartMs = millis();
+}
+
+void HttpServer::serviceWriting(Connection& connection, unsigned long now) {
+    WiFiClient& client = connection.client;
+    if (!client.connected()) {
+        closeConnection(connection);
+        return;
+    }
+
+    // Never write more than the TCP send buffer takes right now, so write()
+    // returns immediately instead of waiting for ACKs from a slow client
+    size_t room = client.availableForWrite();
+    for (;;) {
+        const bool headPending = connection.headSent < connection.headLength;
+        const bool bodyPending = !connection.headOnly && connection.segmentIndex < connection.response.segmentCount();
+        if (!headPending && !bodyPending) {
+            if (connection.response.streaming() && !connection.headOnly) {
+                connection.phase = ConnectionStreaming; // Application writes from here on
+                return;
+            }
+            finishResponse(connection, now);
+            return;
+        }
+        if (room == 0) break;
+
+        size_t written = 0;
+        if (headPending) {
+            size_t count = connection.headLength - connection.headSent;
+            if (count > room) count = room;
+            written = client.write(reinterpret_cast<const uint8_t*>(connection.head + connection.headSent), count);
+            connection.headSent += written;
+        } else {
+            const HttpResponse::Segment& segment = connection.response.segment(connection.segmentIndex);
+            size_t count = segment.length - connection.segmentSent;
+            if (count > room) count = room;
+            const char* data = segment.data + connection.segmentSent;
+            written = segment.inFlash ? client.write_P(data, count)
+                                      : client.write(reinterpret_cast<const uint8_t*>(data), count);
+            connection.segmentSent += written;
+            if (connection.segmentSent >= segment.length) {
+                connection.segmentIndex++;
+                connection.segmentSent = 0;
+            }
+        }
+
+        if (written == 0) break;
+        room -= written;
+        connection.phaseStartMs = now;
+    }
+
+    if (now - connection.phaseStartMs >= HTTP_WRITE_TIMEOUT_MS) {
+        LOG_PRINTF("[HTTP] Write timeout, dropping client\n");
+        closeConnection(connection);
+    }
+}
+
+void HttpServer::serviceStreaming(Connection& connection) {
+    WiFiClient& client = connection.client;
+    // Nothing is expected from the client; drop whatever it sends so lwIP
+    // doesn't hold on to it
+    const int available = client.available();
+    if (available > 0) {
+        connection.parser.reset();
+        size_t count = static_cast<size_t>(available);
+        if (count > connection.parser.writableSpace()) count = connection.parser.writableSpace();
+        client.read(reinterpret_cast<uint8_t*>(connection.parser.writePtr()), count);
+    }
+    if (!client.connected()) {
+        closeConnection(connection);
+    }
+}
+
+void HttpServer::finishResponse(Connection& connection, unsigned long now) {
+    if (!connection.keepAlive) {
+        closeConnection(connection);
+        return;
+    }
+    // Keep the connection; bytes of a pipelined request stay in the parser
+    // and are dispatched on the next poll()
+    connection.response.release();
+    connection.response.clear();
+    connection.parser.nextRequest();
+    connection.phase = ConnectionReading;
+    connection.phaseStartMs = now;
+}
+
+void HttpServer::closeConnection(Connection& connection) {
+    connection.response.release();
+    connection.response.clear();
+    connection.parser.reset();
+    // lwIP still delivers queued data after close; don't wait for the ACKs
+    connection.client.stop(1);
+    connection.phase = ConnectionFree;
+}
@@ -1,308 +1,1455 @@
 #include <ESP8266WiFi.h>
 #include <ArduinoJson.h>
-#include <ESP8266WebServer.h>
 #include <WiFiManager.h>
 #include <EEPROM.h>
 #include <ESP8266mDNS.h>
 #include <WebSocketsServer.h>
+extern "C" {
+#include <user_interface.h>
+}
+#include <lwip/opt.h>
 #include "config.h"
+#include "text_buffer.h"
+#include "json_arena.h"
+#include "log.h"
+#include "http_server.h"
+#include "admission_control.h"
+#include "ws_client_queue.h"
+#include "status_snapshot.h"
+#include "status_subscription.h"
+#include "status_json.h"
+#include "command_router.h"
+#include "spsc_queue.h"
+#include "output_table.h"
+#include "output_map.h"
+#include "output_driver.h"
+#include "wifi_bringup.h"
+#include "link_supervisor.h"
+#include "rtc_snapshot.h"
+#include "effect_engine.h"
+#include "flight_recorder.h"
+#include "task_scheduler.h"
+#include "idle_governor.h"
+#include "web_ui.h"
 
 // Forward declarations
 void initializeOutputs();
 void initializeWiFi();
 void initializeWiFiManager();
+void updateWiFiBringup();
+void onStationConnected();
+void superviseWiFiLink();
+void onLinkRestored();
+bool startMdns();
+void startNetworkServices();
 void checkConfigPortalTrigger();
 void initializeWebServer();
-void executeOutputCommand(int pin, bool active, int brightnessPercent);
+void executeOutputCommand(int index, bool active, int brightnessPercent);
 void updateBlinkingOutputs();
+void applyOutputCommands();
 void updateChasingLightGroups();
 void setOutputInterval(int index, unsigned int intervalMs);
 void createChasingGroup(uint8_t groupId, const uint8_t* outputIndices, uint8_t count, unsigned int intervalMs, const char* groupName = nullptr);
 void deleteChasingGroup(uint8_t groupId);
 void saveChasingGroups();
 void loadChasingGroups();
-void saveOutputState(int index);
+void saveOutputStates(const uint8_t* indices, uint8_t count);
 void loadOutputStates();
 void saveAllOutputStates();
 void saveCustomParameters();
 void loadCustomParameters();
+bool restoreRtcSnapshot();
+void saveRtcSnapshot();
+void recordTraceKeyframe();
+void discardRtcSnapshot();
+void runEffectTask();
+void runButtonTask();
+void runWiFiTask();
+void runHttpTask();
+void runWebSocketTask();
+void runSerialTask();
+void runHeapTask();
+void runTelemetryTask();
+void runMdnsTask();
+void governPower();
 
 // Helper functions
-int findOutputIndexByPin(int pin);
-void serializeStatusToJson(JsonDocument& doc);
-bool deserializeJsonRequest(String body, JsonDocument& doc, IPAddress clientIP, const char* endpoint);
+void serializeStatusToJson(JsonDocument& doc, const StatusSubscription& subscription);
+void serializeDeviceToJson(JsonDocument& doc);
+void serializeDiagnosticsToJson(JsonDocument& doc);
+bool deserializeJsonRequest(const char* body, size_t length, JsonDocument& doc, const IPAddress& clientIP, const char* endpoint);
+void handleWebSocketCommand(uint8_t num, const uint8_t* payload, size_t length);
+void saveOutputName(int index, const char* name);
 
 // Global variables
 // Web Server
-ESP8266WebServer* server = nullptr;
-WebSocketsServer* ws = nullptr;
+HttpServer* server = nullptr;
+
+// WebSocketsServer exposing how much a client's TCP send buffer can take, so
+// status frames are written only when they fit and never wait in write()
+class StatusWebSocketsServer : public WebSocketsServer {
+public:
+    explicit StatusWebSocketsServer(uint16_t port) : WebSocketsServer(port) {}
+
+    size_t writeRoom(uint8_t num) {
+        if (num >= WEBSOCKETS_SERVER_CLIENT_MAX) return 0;
+        WSclient_t* client = &_clients[num];
+        if (client->status != WSC_CONNECTED || !client->tcp) return 0;
+        return client->tcp->availableForWrite();
+    }
+};
+
+static_assert(WS_MAX_CLIENTS <= WEBSOCKETS_SERVER_CLIENT_MAX, "WS_MAX_CLIENTS exceeds the WebSockets library client slots");
+
+typedef WsClientQueues<WEBSOCKETS_SERVER_CLIENT_MAX> StatusClientQueues;
+const size_t WS_FRAME_HEADER_SIZE = 4; // Unmasked server frame, payload < 64KB
+
+StatusWebSocketsServer* ws = nullptr;
+StatusClientQueues wsClientQueues(WS_SLOW_CLIENT_TIMEOUT_MS, WS_MAX_CLIENTS);
+
+// Status subscriptions (?sections=&outputs=&groups=&telemetry=, see status_subscription.h).
+// Clients with the same filter share a class; class 0 is the full snapshot.
+typedef SubscriptionClasses<STATUS_MAX_SUBSCRIPTION_CLASSES> StatusSubscriptionClasses;
+StatusSubscriptionClasses subscriptionClasses;
+
+struct StatusSubscriber {
+    uint8_t classIndex;     // StatusSubscriptionClasses::NO_CLASS while not subscribed
+    bool telemetry;         // Also wants the periodic telemetry snapshots
+};
+
+StatusSubscriber wsSubscribers[WEBSOCKETS_SERVER_CLIENT_MAX];
+
+// Server-Sent Events streams, indexed by HTTP connection id
+static_assert(SSE_MAX_STREAMS < HTTP_MAX_CONNECTIONS, "SSE streams must leave HTTP connections for requests");
+
+struct EventStream {
+    StatusSubscriber subscriber;
+    unsigned long lastWriteMs;
+};
+
+typedef WsClientQueues<HTTP_MAX_CONNECTIONS> EventStreamQueues;
+EventStreamQueues sseClientQueues(WS_SLOW_CLIENT_TIMEOUT_MS, SSE_MAX_STREAMS);
+EventStream eventStreams[HTTP_MAX_CONNECTIONS];
+const size_t SSE_EVENT_PREFIX_SIZE = 40; // "id: 4294967295\nevent: status\ndata: "
 WiFiManager wifiManager;
 
-// WebSocket broadcast timer
+// WebSocket broadcast timer (state changes are pushed immediately)
 unsigned long lastBroadcast = 0;
-const unsigned long BROADCAST_INTERVAL = 500; // Broadcast every 500ms
+const unsigned long BROADCAST_INTERVAL = 500; // Minimum spacing while throttled: x ADMISSION_BROADCAST_SLOWDOWN
+
+// Admission control - sheds WebSocket clients, non-essential requests and
+// broadcast rate (in that order) when the heap runs low
+const AdmissionThresholds ADMISSION_THRESHOLDS = {
+    {ADMISSION_WS_REJECT_HEAP, ADMISSION_SHED_HEAP, ADMISSION_THROTTLE_HEAP},
+    {ADMISSION_WS_REJECT_BLOCK, ADMISSION_SHED_BLOCK, ADMISSION_THROTTLE_BLOCK},
+    ADMISSION_HYSTERESIS_BYTES,
+    ADMISSION_BROADCAST_SLOWDOWN
+};
+AdmissionController admission(ADMISSION_THRESHOLDS);
+unsigned long lastAdmissionSample = 0;
 
 #define MAX_CHASING_GROUPS 4
 
 // Constants
 const uint32_t FLASH_PARTITION_SIZE = 1044464; // Program partition size (from platformio build output)
-const uint8_t MAX_OUTPUTS_PER_CHASING_GROUP = 8;
-const uint8_t MAX_NAME_LENGTH = 20;
+const uint8_t MAX_OUTPUTS_PER_CHASING_GROUP = CHASING_GROUP_MAX_OUTPUTS;
+const uint8_t MAX_NAME_LENGTH = ENGINE_NAME_LENGTH;
 const uint16_t MIN_CHASING_INTERVAL_MS = 50;
 
-// Chasing group structure
-struct ChasingGroup {
+// JSON arena sizing - conservative upper bounds for ArduinoJson 7 on a 32-bit target.
+// ArduinoJson grabs variant slots in pools of 128, so node storage is rounded up
+// to whole pools; copied strings (names, IP, MAC, SSID) come on top.
+const size_t JSON_ARENA_SLOT_SIZE = 16;
+const size_t JSON_ARENA_POOL_SIZE = 128 * JSON_ARENA_SLOT_SIZE;
+const size_t JSON_ARENA_STRING_OVERHEAD = 16; // Per copied string (node header + alignment)
+
+constexpr size_t jsonArenaPoolBytes(size_t slots) {
+    return ((slots * JSON_ARENA_SLOT_SIZE + JSON_ARENA_POOL_SIZE - 1) / JSON_ARENA_POOL_SIZE) * JSON_ARENA_POOL_SIZE;
+}
+
+// Status: 16 root members, 7 members per output, 5 members + pin list per group (2 slots per member),
+// plus the diagnostics objects (http: 5, admission: 7, websocket: 6, sse: 2, snapshot: 3 members)
+const size_t STATUS_JSON_DIAGNOSTIC_SLOTS = 2 * (1 + 5) + 2 * (1 + 7) + 2 * (1 + 6) + 2 * (1 + 2) + 2 * (1 + 3);
+const size_t STATUS_JSON_SLOTS = 2 * 16 + STATUS_JSON_DIAGNOSTIC_SLOTS
+    + MAX_OUTPUTS * (1 + 2 * 7)
+    + MAX_CHASING_GROUPS * (1 + 2 * 5 + MAX_OUTPUTS_PER_CHASING_GROUP);
+const size_t STATUS_JSON_STRING_BYTES = (40 + 33 + 18 + 16 + 4 * JSON_ARENA_STRING_OVERHEAD)
+    + MAX_OUTPUTS * (MAX_NAME_LENGTH + 1 + JSON_ARENA_STRING_OVERHEAD)
+    + MAX_CHASING_GROUPS * (MAX_NAME_LENGTH + 1 + JSON_ARENA_STRING_OVERHEAD);
+const size_t STATUS_JSON_ARENA_REQUIRED = jsonArenaPoolBytes(STATUS_JSON_SLOTS) + STATUS_JSON_STRING_BYTES;
+
+// Largest request is chasing/create over WebSocket: command, groupId, interval, name,
+// outputs[MAX_OUTPUTS_PER_CHASING_GROUP] or ids[] (keys and string values are copied)
+const size_t REQUEST_JSON_SLOTS = 2 * 5 + MAX_OUTPUTS_PER_CHASING_GROUP;
+const size_t REQUEST_JSON_ARENA_REQUIRED = jsonArenaPoolBytes(REQUEST_JSON_SLOTS)
+    + 7 * (MAX_NAME_LENGTH + 1 + JSON_ARENA_STRING_OVERHEAD);
+
+static_assert(STATUS_JSON_ARENA_REQUIRED <= JSON_STATUS_ARENA_SIZE,
+              "JSON_STATUS_ARENA_SIZE too small for MAX_OUTPUTS/MAX_CHASING_GROUPS - increase it in config.h");
+static_assert(REQUEST_JSON_ARENA_REQUIRED <= JSON_REQUEST_ARENA_SIZE,
+              "JSON_REQUEST_ARENA_SIZE too small for MAX_OUTPUTS_PER_CHASING_GROUP - increase it in config.h");
+
+typedef JsonArenaAllocator<JSON_REQUEST_ARENA_SIZE> RequestJsonAllocator;
+typedef JsonArenaScope<JSON_REQUEST_ARENA_SIZE> RequestJsonScope;
+typedef JsonArenaAllocator<JSON_STATUS_ARENA_SIZE> StatusJsonAllocator;
+typedef JsonArenaScope<JSON_STATUS_ARENA_SIZE> StatusJsonScope;
+
+// Preallocated arenas: request parsing and status serialization never share one,
+// since handlers broadcast status while their request document is still alive
+RequestJsonAllocator requestJsonAllocator;
+StatusJsonAllocator statusJsonAllocator;
+
+// EEPROM layout for ESP8266. Only describes where each field lives: fields are
+// read and written in place (EEPROM_AT), the EEPROM library already keeps its
+// own RAM copy of the sector, so there is no second one here.
+// The output arrays keep their 8 slots even with fewer outputs: the offsets of
+// everything after them are what devices in the field have stored.
+const uint8_t EEPROM_OUTPUT_SLOTS = 8;
+
+struct EEPROMChasingGroup {
     uint8_t groupId;
     bool active;
-    char name[21]; // 20 chars + null terminator
-    uint8_t outputIndices[8]; // Max 8 outputs per group
+    char name[21];
+    uint8_t outputIndices[8];
     uint8_t outputCount;
-    uint16_t interval; // Step interval in ms
-    uint8_t currentStep; // Current active output in sequence
-    unsigned long lastStepTime;
+    uint16_t interval;
 };
 
-// EEPROM structure for ESP8266
 struct EEPROMData {
     char deviceName[40];
-    bool outputStates[8];
-    uint8_t outputBrightness[8];
-    char outputNames[8][21]; // 20 chars + null terminator
-    uint16_t outputIntervals[8]; // Blink interval in milliseconds (0 = no blink)
+    bool outputStates[EEPROM_OUTPUT_SLOTS];
+    uint8_t outputBrightness[EEPROM_OUTPUT_SLOTS];
+    char outputNames[EEPROM_OUTPUT_SLOTS][21]; // 20 chars + null terminator
+    uint16_t outputIntervals[EEPROM_OUTPUT_SLOTS]; // Blink interval in milliseconds (0 = no blink)
     // Chasing groups data
     uint8_t chasingGroupCount;
-    struct {
-        uint8_t groupId;
-        bool active;
-        char name[21];
-        uint8_t outputIndices[8];
-        uint8_t outputCount;
-        uint16_t interval;
-    } chasingGroups[MAX_CHASING_GROUPS];
+    EEPROMChasingGroup chasingGroups[MAX_CHASING_GROUPS];
     uint8_t checksum;
 };
-EEPROMData eepromData;
 
-String macAddress;
+// EEPROM address of a field, or of element 'index' of an array field
+#define EEPROM_AT(field) offsetof(EEPROMData, field)
+#define EEPROM_AT_INDEX(field, index) (offsetof(EEPROMData, field) + (index) * sizeof(EEPROMData::field[0]))
+
+static_assert(MAX_OUTPUTS <= EEPROM_OUTPUT_SLOTS, "EEPROM layout stores at most EEPROM_OUTPUT_SLOTS outputs");
+static_assert(sizeof(EEPROMData) <= EEPROM_SIZE, "EEPROMData exceeds EEPROM_SIZE");
+static_assert(MAX_NAME_LENGTH + 1 == sizeof(EEPROMData::outputNames[0]), "Output name slots must match the EEPROM layout");
+
+char macAddress[18] = ""; // "AA:BB:CC:DD:EE:FF"
+char stationSsid[33] = ""; // Cached at connect time (WiFi.SSID() returns a heap String)
 char customDeviceName[40] = DEVICE_NAME; // Custom device name from WiFiManager
+WiFiManagerParameter deviceNameParameter("device_name", "Device Name", DEVICE_NAME, 40); // Outlives setup(): the portal runs from loop()
 bool portalRunning = false;
 unsigned long portalButtonPressTime = 0;
 bool wifiConnected = false;
 
-// Output pin configuration
-int outputPins[MAX_OUTPUTS] = LED_PINS;
-bool outputStates[MAX_OUTPUTS] = {false};
-int outputBrightness[MAX_OUTPUTS] = {255}; // 0-255 for PWM
-String outputNames[MAX_OUTPUTS]; // Custom names for outputs
-unsigned int outputIntervals[MAX_OUTPUTS] = {0}; // Blink interval in ms (0 = no blink)
-unsigned long lastBlinkTime[MAX_OUTPUTS] = {0}; // Last blink toggle time
-bool blinkState[MAX_OUTPUTS] = {false}; // Current blink state (for internal tracking)
-int8_t outputChasingGroup[MAX_OUTPUTS] = {-1, -1, -1, -1, -1, -1, -1}; // Which chasing group owns this output (-1 = none)
+// WiFi bring-up (see wifi_bringup.h): stepped from loop() so effects run from boot
+const WifiBringupTimeouts WIFI_BRINGUP_TIMEOUTS = {WIFI_CONNECT_TIMEOUT_MS, WIFIMANAGER_TIMEOUT * 1000UL};
+WifiBringup wifiBringup(WIFI_BRINGUP_TIMEOUTS);
+
+// Station link after bring-up (see link_supervisor.h): reconnects with
+// jittered exponential backoff, services are kept and restarted as needed
+const LinkBackoffPolicy LINK_BACKOFF_POLICY = {WIFI_RECONNECT_MIN_MS, WIFI_RECONNECT_MAX_MS, WIFI_RECONNECT_ATTEMPT_MS,
+                                               WIFI_RECONNECT_JITTER_PERCENT};
+LinkSupervisor linkSupervisor(LINK_BACKOFF_POLICY);
+uint32_t stationIp = 0;   // Address the servers' sockets were opened on
+bool mdnsStarted = false;
+bool effectsStarted = false;
+unsigned long firstEffectTickMs = 0; // millis() at the first effect step: boot-to-effects latency
+
+// Output state: pins, on/lit bitsets, duty, blink timing, group and name of
+// every output in one block (see output_table.h). An output's index is its
+// stable ID in the API; GPIO numbers map to it through OUTPUT_MAP, built at
+// compile time (see output_map.h).
+constexpr uint8_t OUTPUT_PINS[MAX_OUTPUTS] = LED_PINS;
+static_assert(outputPinsValid(OUTPUT_PINS), "LED_PINS must be distinct GPIO 0-16");
+constexpr OutputPinMap OUTPUT_MAP = makeOutputPinMap(OUTPUT_PINS);
+
+typedef OutputTable<MAX_OUTPUTS, MAX_NAME_LENGTH> OutputStateTable;
+OutputStateTable outputTable(OUTPUT_PINS);
+
+// Pin access for outputDriver (see output_driver.h): dimmed outputs through
+// the core's PWM waveform generator, fully on/off ones straight to the GPIO
+// set/clear registers (GPIO 16 has a register of its own)
+struct Esp8266OutputPins {
+    static void pwm(uint8_t pin, uint8_t duty) { analogWrite(pin, duty); }
+    // Duty 0 stops the pin's waveform and leaves it a plain GPIO output
+    static void detachPwm(uint8_t pin) { analogWrite(pin, 0); }
+    static void set(uint8_t pin) {
+        if (pin == 16) GP16O |= 1;
+        else GPOS = static_cast<uint32_t>(1) << pin;
+    }
+    static void clear(uint8_t pin) {
+        if (pin == 16) GP16O &= ~1;
+        else GPOC = static_cast<uint32_t>(1) << pin;
+    }
+};
+typedef OutputDriver<Esp8266OutputPins, MAX_OUTPUTS> OutputPinDriver;
+OutputPinDriver outputDriver(OUTPUT_PINS);
 
 // Chasing light groups
 ChasingGroup chasingGroups[MAX_CHASING_GROUPS];
 uint8_t chasingGroupCount = 0;
 
-// Timing variables
+// Warm-restart snapshot of the engine state in RTC user memory (see
+// rtc_snapshot.h), placed after the first 128 bytes, which the OTA bootloader uses
+typedef EffectSnapshot<MAX_OUTPUTS, MAX_CHASING_GROUPS, MAX_OUTPUTS_PER_CHASING_GROUP> RtcEffectSnapshot;
+const uint32_t RTC_SNAPSHOT_BLOCK = 32; // In 4-byte blocks
+static_assert(RTC_SNAPSHOT_BLOCK * 4 + sizeof(RtcEffectSnapshot) <= 512, "RTC snapshot exceeds RTC user memory");
+static_assert(sizeof(RtcEffectSnapshot::Group::outputIndices) == sizeof(ChasingGroup::outputIndices), "Snapshot group size mismatch");
+RtcEffectSnapshot rtcSnapshot;
+bool rtcSnapshotEnabled = true;  // Off after /api/reset, so the reboot starts from the cleared EEPROM
+bool rtcSnapshotDirty = true;    // Engine state changed since the last write
+bool warmRestored = false;       // Outputs came from the snapshot at this boot
+uint32_t rtcRestoreUs = 0;       // micros() when the restored outputs were driven
+
+// Flight recorder: commands, client connects, loop overruns and engine
+// keyframes in a RAM ring, downloaded from GET /api/trace and replayed on the
+// host (see flight_recorder.h, trace_replay.h). FLIGHT_RECORDER_SIZE 0 turns
+// every record call into a no-op.
+FlightRecorder<FLIGHT_RECORDER_SIZE> flightRecorder;
+uint32_t tracedOverrunPasses = 0;
+static_assert(sizeof(RtcEffectSnapshot) <= 255, "Keyframe exceeds a trace record");
+static_assert(FLIGHT_RECORDER_SIZE == 0 || FLIGHT_RECORDER_SIZE >= 8 * sizeof(RtcEffectSnapshot),
+              "FLIGHT_RECORDER_SIZE must hold 8 keyframes");
+uint32_t rtcRestoreGapMs = 0;    // Last snapshot -> restore, from the RTC clock
+uint32_t rtcSnapshotWrites = 0;
+uint32_t rtcSnapshotWriteUs = 0; // Duration of the last write
+
+// Fixed buffers for the request/broadcast hot paths (no Arduino String on the heap)
+const size_t STATUS_JSON_BUFFER_SIZE = 2304; // Full status document incl. diagnostics for MAX_OUTPUTS + MAX_CHASING_GROUPS
+const size_t LOG_LINE_BUFFER_SIZE = 160;
+const size_t STATUS_ETAG_SIZE = 24;          // W/"xxxxxxxx-4294967295"
+char logLineBuffer[LOG_LINE_BUFFER_SIZE];
+
+// Status frames and events are written in one piece once the send buffer has room
+static_assert(WS_TCP_SEND_BUFFER == TCP_SND_BUF, "WS_TCP_SEND_BUFFER must match the lwIP variant platformio.ini selects");
+static_assert(STATUS_JSON_BUFFER_SIZE + WS_FRAME_HEADER_SIZE <= TCP_SND_BUF, "A status frame must fit the TCP send buffer");
+static_assert(SSE_EVENT_PREFIX_SIZE + STATUS_JSON_BUFFER_SIZE + 2 <= TCP_SND_BUF, "A status event must fit the TCP send buffer");
+
+// Serialize-once status snapshots, shared by every WebSocket frame and /api/status response
+typedef SnapshotStore<STATUS_JSON_BUFFER_SIZE, STATUS_SNAPSHOT_SLOTS> StatusSnapshotStore;
+typedef StatusSnapshotStore::Snapshot StatusSnapshot;
+StatusSnapshotStore statusSnapshots;
+uint32_t statusVersion = 1;           // Bumped by every state change; the /api/status ETag
+uint32_t statusBootId = 0;            // Random per boot, so ETags cached before a reboot never match
+uint32_t statusNotModified = 0;       // /api/status requests answered with 304
+bool statusBroadcastPending = false;  // Broadcast deferred (throttled or no free snapshot slot)
+StatusChange pendingStatusChanges = StatusChange::none(); // Changes not yet in a snapshot
+char statusHeaders[64 + STATUS_ETAG_SIZE];
+
+// loop() as a table of cooperative tasks (see task_scheduler.h). Each one
+// does a bounded step and returns; the effect tick is never deferred, the
+// network tasks get the rest of the pass budget before telemetry and mDNS.
+struct ArduinoClock {
+    static uint32_t nowMs() { return millis(); }
+    static uint32_t nowUs() { return micros(); }
+};
+
+const TaskSpec TASKS[] = {
+    // name         run               priority               period  deadline                      budget (us)
+    {"effects",     runEffectTask,    TaskPriority::High,    0,      SCHEDULER_EFFECT_DEADLINE_MS, 1000},
+    {"button",      runButtonTask,    TaskPriority::Medium,  0,      0,                            100},
+    {"wifi",        runWiFiTask,      TaskPriority::Medium,  0,      0,                            2000},
+    {"http",        runHttpTask,      TaskPriority::Medium,  0,      0,                            3000},
+    {"websocket",   runWebSocketTask, TaskPriority::Medium,  0,      0,                            3000},
+    {"serial",      runSerialTask,    TaskPriority::Medium,  0,      0,                            1000},
+    {"heap",        runHeapTask,      TaskPriority::Low,     0,      0,                            200},
+    {"telemetry",   runTelemetryTask, TaskPriority::Low,     0,      0,                            4000},
+    {"mdns",        runMdnsTask,      TaskPriority::Low,     0,      0,                            1000},
+};
+const uint8_t TASK_COUNT = sizeof(TASKS) / sizeof(TASKS[0]);
+
+typedef TaskScheduler<ArduinoClock, TASK_COUNT> LoopScheduler;
+LoopScheduler scheduler(TASKS, TASK_COUNT, SCHEDULER_PASS_BUDGET_US, SCHEDULER_MAX_DEFERRALS);
+
+// Idle power management between passes (see idle_governor.h)
+const PowerPolicy POWER_POLICY = {POWER_IDLE_AFTER_MS, POWER_BOOST_HOLD_MS, POWER_BOOST_PASS_US, POWER_MAX_IDLE_MS,
+                                  POWER_LIGHT_SLEEP};
+IdleGovernor powerGovernor(POWER_POLICY);
+PowerMode appliedPowerMode = PowerMode::Awake;
+bool powerModeApplied = false;   // The core starts in modem sleep; the first plan sets the mode
+bool cpuBoosted = false;         // esp12e boots at 80 MHz
 
 void broadcastStatus(); // Forward declaration
+void markStatusChanged(const StatusChange& change);
+void pumpWebSocketClients(unsigned long now);
+void pumpEventStreams(unsigned long now);
+
+static_assert(MAX_OUTPUTS <= 32, "Status subscriptions keep output filters in a 32-bit mask");
+
+void unsubscribeStatus(StatusSubscriber& subscriber) {
+    subscriptionClasses.release(subscriber.classIndex);
+    subscriber.classIndex = StatusSubscriptionClasses::NO_CLASS;
+    subscriber.telemetry = false;
+}
+
+// Parse a subscription query and join the matching class; false if it is malformed
+bool subscribeStatus(StatusSubscriber& subscriber, TextView query, bool defaultTelemetry) {
+    StatusSubscription subscription;
+    bool telemetry = defaultTelemetry;
+    if (!parseStatusSubscription(query, OUTPUT_MAP, defaultTelemetry, subscription, telemetry)) return false;
+    unsubscribeStatus(subscriber);
+    subscriber.classIndex = subscriptionClasses.acquire(subscription);
+    subscriber.telemetry = telemetry;
+    return true;
+}
+
+bool subscriberWants(const StatusSubscriber& subscriber, const StatusChange& change) {
+    return subscriber.classIndex != StatusSubscriptionClasses::NO_CLASS &&
+           subscriptionClasses.subscription(subscriber.classIndex).wants(change, subscriber.telemetry);
+}
+
+// Feed the admission controller a fresh heap sample, logging level changes
+void sampleHeapForAdmission() {
+    const AdmissionLevel previous = admission.level();
+    const uint32_t freeHeap = ESP.getFreeHeap();
+    const uint32_t maxBlock = ESP.getMaxFreeBlockSize();
+    const AdmissionLevel level = admission.update(freeHeap, maxBlock);
+    if (level != previous) {
+        LOG_PRINTF("[ADMISSION] Level %u -> %u (free heap %u, max block %u bytes)\n",
+                   static_cast<unsigned>(previous), static_cast<unsigned>(level), static_cast<unsigned>(freeHeap), static_cast<unsigned>(maxBlock));
+    }
+    lastAdmissionSample = millis();
+}
+
+// printf-style logging through a static line buffer.
+// Serial.printf() falls back to new[] for lines longer than 64 bytes.
+void writeLogLine(int length) {
+    if (length < 0) return;
+    if (static_cast<size_t>(length) >= sizeof(logLineBuffer)) {
+        length = sizeof(logLineBuffer) - 1; // Truncated
+    }
+    Serial.write(reinterpret_cast<const uint8_t*>(logLineBuffer), length);
+}
+
+void logPrintf(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    const int length = vsnprintf(logLineBuffer, sizeof(logLineBuffer), format, args);
+    va_end(args);
+    writeLogLine(length);
+}
+
+void logPrintf_P(PGM_P format, ...) {
+    va_list args;
+    va_start(args, format);
+    const int length = vsnprintf_P(logLineBuffer, sizeof(logLineBuffer), format, args);
+    va_end(args);
+    writeLogLine(length);
+}
 
 void wsEvent(uint8_t num, WStype_t type, uint8_t* payload, size_t length) {
     switch(type) {
         case WStype_DISCONNECTED:
-            Serial.printf("[WS] Client #%u disconnected\n", num);
+            wsClientQueues.disconnect(num);
+            unsubscribeStatus(wsSubscribers[num]);
+            flightRecorder.recordDisconnect(millis(), num);
+            LOG_PRINTF("[WS] Client #%u disconnected\n", num);
             break;
         case WStype_CONNECTED:
             {
+                // The library has already allocated the client; drop it again if memory is short
+                sampleHeapForAdmission();
+                if (!admission.admitWebSocketClient()) {
+                    LOG_PRINTF("[ADMISSION] Rejecting WebSocket client #%u (low memory)\n", num);
+                    ws->disconnect(num);
+                    break;
+                }
+                // The payload is the request URL; its query selects the subscription
+                const TextView url(reinterpret_cast<const char*>(payload), length);
+                const char* question = url.empty() ? nullptr : static_cast<const char*>(memchr(url.data, '?', url.length));
+                const TextView query = question ? TextView(question + 1, url.data + url.length - (question + 1)) : TextView();
+                if (!subscribeStatus(wsSubscribers[num], query, true)) {
+                    LOG_PRINTF("[WS] Rejecting client #%u (bad subscription: %.*s)\n", num, static_cast<int>(url.length), url.data);
+                    ws->disconnect(num);
+                    break;
+                }
+                const unsigned long now = millis();
+                if (!wsClientQueues.connect(num, now)) {
+                    LOG_PRINTF("[WS] Rejecting client #%u (%u clients connected)\n", num, static_cast<unsigned>(WS_MAX_CLIENTS));
+                    unsubscribeStatus(wsSubscribers[num]);
+                    ws->disconnect(num);
+                    break;
+                }
                 IPAddress ip = ws->remoteIP(num);
-                Serial.printf("[WS] Client #%u connected from %d.%d.%d.%d\n", num, ip[0], ip[1], ip[2], ip[3]);
-                broadcastStatus(); // Send current status to new client
+                const uint8_t address[4] = {ip[0], ip[1], ip[2], ip[3]};
+                flightRecorder.recordConnect(now, num, address);
+                LOG_PRINTF("[WS] Client #%u connected from %d.%d.%d.%d (status class %u)\n", num, ip[0], ip[1], ip[2], ip[3],
+                           wsSubscribers[num].classIndex);
+                pumpWebSocketClients(now); // New clients start pending: send the current status
             }
             break;
         case WStype_TEXT:
-            Serial.printf("[WS] Received from #%u: %s\n", num, payload);
+            handleWebSocketCommand(num, payload, length);
             break;
     }
 }
 
-// Helper function to find output index by GPIO pin
-int findOutputIndexByPin(int pin) {
-    for (int i = 0; i < MAX_OUTPUTS; i++) {
-        if (outputPins[i] == pin) {
-            return i;
-        }
+// Helper function to serialize status to JSON (the full document for the
+// shared snapshot, or the sections/outputs/groups a subscription asked for)
+void serializeStatusToJson(JsonDocument& doc, const StatusSubscription& subscription) {
+    doc["version"] = statusVersion; // Changes with the outputs/groups below, not with the telemetry
+    
+    if (subscription.includes(StatusSectionDevice)) {
+        serializeDeviceToJson(doc);
+    }
+    
+    if (subscription.includes(StatusSectionOutputs)) {
+        serializeOutputsToJson(doc["outputs"].to<JsonArray>(), outputTable, subscription);
+    }
+    
+    if (subscription.includes(StatusSectionGroups)) {
+        serializeChasingGroupsToJson(doc["chasingGroups"].to<JsonArray>(), outputTable, chasingGroups, MAX_CHASING_GROUPS,
+                                     subscription);
+    }
+    
+    if (subscription.includes(StatusSectionMetrics)) {
+        serializeDiagnosticsToJson(doc);
     }
-    return -1;
 }
 
-// Helper function to serialize status to JSON (used by both broadcastStatus and /api/status)
-void serializeStatusToJson(JsonDocument& doc) {
+// Device section: identity, network, heap, uptime and flash
+void serializeDeviceToJson(JsonDocument& doc) {
+    const bool apMode = WiFi.getMode() == WIFI_AP;
+    const IPAddress ip = apMode ? WiFi.softAPIP() : WiFi.localIP();
+    char ipText[IPV4_TEXT_SIZE];
+    formatIPv4(ipText, sizeof(ipText), ip[0], ip[1], ip[2], ip[3]);
+    
     doc["macAddress"] = macAddress;
     doc["name"] = customDeviceName;
-    doc["wifiMode"] = WiFi.getMode() == WIFI_AP ? "AP" : "STA";
-    doc["ip"] = WiFi.getMode() == WIFI_AP ? WiFi.softAPIP().toString() : WiFi.localIP().toString();
-    doc["ssid"] = WiFi.getMode() == WIFI_AP ? String(AP_SSID) : WiFi.SSID();
+    doc["wifiMode"] = apMode ? "AP" : "STA";
+    doc["ip"] = ipText; // Copied into the document (char array)
+    doc["ssid"] = apMode ? AP_SSID : static_cast<const char*>(stationSsid);
     doc["apClients"] = WiFi.softAPgetStationNum();
     doc["freeHeap"] = ESP.getFreeHeap();
     doc["uptime"] = millis();
-    doc["buildDate"] = String(__DATE__) + " " + String(__TIME__);
+    doc["buildDate"] = __DATE__ " " __TIME__;
     doc["flashUsed"] = ESP.getSketchSize();
     doc["flashFree"] = ESP.getFreeSketchSpace();
     doc["flashPartition"] = FLASH_PARTITION_SIZE;
+}
+
+// Commands: every state change reachable over HTTP (POST <httpPath>), a
+// WebSocket text frame ({"command":"<name>", ...}) or the serial console
+// ("<name> field=value ..."). The router validates the fields against these
+// tables before a handler runs (see command_router.h); a handler only acts.
+static_assert(COMMAND_TEXT_SIZE >= MAX_NAME_LENGTH + 1, "COMMAND_TEXT_SIZE must hold an output or group name");
+static_assert(MAX_OUTPUTS_PER_CHASING_GROUP <= COMMAND_MAX_LIST, "COMMAND_MAX_LIST must hold a chasing group's outputs");
+static_assert(MAX_OUTPUTS <= COMMAND_MAX_LIST && MAX_OUTPUTS <= MAX_OUTPUTS_PER_CHASING_GROUP,
+              "A control/interval command addressing every output must fit COMMAND_MAX_LIST and OutputCommand::outputs");
+
+// Changes to the output engine's state (outputTable, chasingGroups[]) are
+// never made by a command handler.
+// Handlers post them to outputCommands; the engine applies every queued
+// command at the start of its next tick, before stepping the effects, so an
+// effect never sees half a change, and publishes the tick's changes as one
+// status version, so no client does either. Producer: command handlers (HTTP,
+// WebSocket, serial). Consumer: applyOutputCommands(). OutputCommand and
+// the state changes it makes are in effect_engine.h.
+
+typedef SpscQueue<OutputCommand, OUTPUT_COMMAND_QUEUE_SIZE> OutputCommandQueue;
+OutputCommandQueue outputCommands;
+
+// Producer side: the reply for a command the engine can't take right now
+CommandResult postOutputCommand(const OutputCommand& command) {
+    if (!outputCommands.push(command)) {
+        LOG_PRINTF("[ENGINE] Command queue full (%u queued), command dropped\n", static_cast<unsigned>(OUTPUT_COMMAND_QUEUE_SIZE));
+        return CommandResult::unavailable("Command queue full, retry later");
+    }
+    flightRecorder.recordOutputCommand(millis(), command);
+    return CommandResult::ok();
+}
+
+OutputCommand makeOutputCommand(OutputCommandType type, uint8_t target) {
+    OutputCommand command;
+    memset(&command, 0, sizeof(command));
+    command.type = type;
+    command.target = target;
+    return command;
+}
+
+// The outputs named by the command's Outputs field (args.list)
+void setCommandOutputs(OutputCommand& command, const CommandArgs& args) {
+    command.outputCount = args.listCount;
+    memcpy(command.outputs, args.list, args.listCount);
+}
+
+// Output fields take the GPIO under "pin"/"outputs", or IDs as "id", "ids"
+// (list or ranges) and "mask"; control and interval may address several
+const CommandField CONTROL_FIELDS[] = {
+    {"pin", CommandFieldType::Outputs, true, 1, MAX_OUTPUTS, 0},
+    {"active", CommandFieldType::Boolean, true, 0, 1, 0},
+    {"brightness", CommandFieldType::Integer, false, 0, 100, 100}
+};
+
+CommandResult commandControl(const CommandArgs& args) {
+    OutputCommand command = makeOutputCommand(OutputCommandType::SetOutput, 0);
+    setCommandOutputs(command, args);
+    command.active = args.flag(1);
+    command.brightness = static_cast<uint8_t>(args.number(2));
+    const CommandResult result = postOutputCommand(command);
+    return result.succeeded() ? CommandResult::ok("ok") : result;
+}
+
+const CommandField NAME_FIELDS[] = {
+    {"pin", CommandFieldType::Output, true, 0, 0, 0},
+    {"name", CommandFieldType::Text, false, 0, 0, 0}  // Empty restores the default name
+};
+
+CommandResult commandName(const CommandArgs& args) {
+    OutputCommand command = makeOutputCommand(OutputCommandType::RenameOutput, static_cast<uint8_t>(args.number(0)));
+    strncpy(command.name, args.text(1), MAX_NAME_LENGTH);
+    return postOutputCommand(command);
+}
+
+const CommandField INTERVAL_FIELDS[] = {
+    {"pin", CommandFieldType::Outputs, true, 1, MAX_OUTPUTS, 0},
+    {"interval", CommandFieldType::Integer, true, 0, 65535, 0}  // 0 = steady
+};
+
+CommandResult commandInterval(const CommandArgs& args) {
+    OutputCommand command = makeOutputCommand(OutputCommandType::SetInterval, 0);
+    setCommandOutputs(command, args);
+    command.interval = static_cast<uint16_t>(args.number(1));
+    return postOutputCommand(command);
+}
+
+const CommandField CHASING_CREATE_FIELDS[] = {
+    {"groupId", CommandFieldType::Integer, true, 1, 255, 0},
+    {"interval", CommandFieldType::Integer, true, MIN_CHASING_INTERVAL_MS, 65535, 0},
+    {"outputs", CommandFieldType::Outputs, true, 1, MAX_OUTPUTS_PER_CHASING_GROUP, 0},
+    {"name", CommandFieldType::Text, false, 0, 0, 0}
+};
+
+CommandResult commandChasingCreate(const CommandArgs& args) {
+    OutputCommand command = makeOutputCommand(OutputCommandType::CreateGroup, static_cast<uint8_t>(args.number(0)));
+    command.interval = static_cast<uint16_t>(args.number(1));
+    setCommandOutputs(command, args);
+    strncpy(command.name, args.text(3), MAX_NAME_LENGTH);
+    return postOutputCommand(command);
+}
+
+const CommandField GROUP_ID_FIELDS[] = {
+    {"groupId", CommandFieldType::Integer, true, 1, 255, 0}
+};
+
+CommandResult commandChasingDelete(const CommandArgs& args) {
+    return postOutputCommand(makeOutputCommand(OutputCommandType::DeleteGroup, static_cast<uint8_t>(args.number(0))));
+}
+
+const CommandField CHASING_NAME_FIELDS[] = {
+    {"groupId", CommandFieldType::Integer, true, 1, 255, 0},
+    {"name", CommandFieldType::Text, false, 0, 0, 0}  // Empty restores "Group <id>"
+};
+
+// The group is looked up here for the 404; one deleted by a command still in
+// the queue is reported by the engine when the rename is applied
+CommandResult commandChasingName(const CommandArgs& args) {
+    const uint8_t groupId = static_cast<uint8_t>(args.number(0));
+    for (int i = 0; i < MAX_CHASING_GROUPS; i++) {
+        if (chasingGroups[i].active && chasingGroups[i].groupId == groupId) {
+            OutputCommand command = makeOutputCommand(OutputCommandType::RenameGroup, groupId);
+            strncpy(command.name, args.text(1), MAX_NAME_LENGTH);
+            return postOutputCommand(command);
+        }
+    }
+    return CommandResult::notFound("Group not found", "groupId");
+}
+
+CommandResult commandReset(const CommandArgs&) {
+    LOG_PRINTF("[EEPROM] Resetting all saved states (free heap %u bytes)...\n", ESP.getFreeHeap());
+    for (int i = 0; i < EEPROM_SIZE; i++) {
+        EEPROM.write(i, 0xFF);
+    }
+    EEPROM.commit();
+    discardRtcSnapshot();
+    LOG_PRINTF("[EEPROM] All saved states cleared (free heap %u bytes)\n", ESP.getFreeHeap());
+    return CommandResult::ok("reset_complete");
+}
+
+// Renames are non-essential: shed first when memory runs low
+const CommandSpec COMMANDS[] = {
+    {"control", "/api/control", commandControl, COMMAND_FIELDS(CONTROL_FIELDS), true},
+    {"name", "/api/name", commandName, COMMAND_FIELDS(NAME_FIELDS), false},
+    {"interval", "/api/interval", commandInterval, COMMAND_FIELDS(INTERVAL_FIELDS), true},
+    {"chasing/create", "/api/chasing/create", commandChasingCreate, COMMAND_FIELDS(CHASING_CREATE_FIELDS), true},
+    {"chasing/delete", "/api/chasing/delete", commandChasingDelete, COMMAND_FIELDS(GROUP_ID_FIELDS), true},
+    {"chasing/name", "/api/chasing/name", commandChasingName, COMMAND_FIELDS(CHASING_NAME_FIELDS), false},
+    {"reset", "/api/reset", commandReset, nullptr, 0, true}
+};
+const uint8_t COMMAND_COUNT = sizeof(COMMANDS) / sizeof(COMMANDS[0]);
+
+CommandRouter commandRouter(COMMANDS, COMMAND_COUNT, OUTPUT_MAP);
+
+// A handled command into the flight recorder; 'command' is nullptr when the
+// name or the request was not understood
+void traceCommand(TraceSource source, uint8_t client, const CommandSpec* command, const CommandResult& result) {
+    const uint8_t index = command != nullptr ? static_cast<uint8_t>(command - COMMANDS) : TRACE_UNKNOWN_COMMAND;
+    flightRecorder.recordCommand(millis(), source, client, index, static_cast<uint8_t>(result.status));
+}
+
+// Field access for a JSON request body or WebSocket frame
+class JsonCommandInput : public CommandInput {
+public:
+    explicit JsonCommandInput(JsonObjectConst object) : object_(object) {}
+    
+    CommandInputStatus integer(const char* name, int32_t& value) const override {
+        const JsonVariantConst field = object_[name];
+        if (field.isNull()) return CommandInputStatus::Missing;
+        if (!field.is<int32_t>()) return CommandInputStatus::Invalid;
+        value = field.as<int32_t>();
+        return CommandInputStatus::Ok;
+    }
     
-    JsonArray outputs = doc["outputs"].to<JsonArray>();
-    for (int i = 0; i < MAX_OUTPUTS; i++) {
-        JsonObject output = outputs.add<JsonObject>();
-        output["pin"] = outputPins[i];
-        output["active"] = outputStates[i];
-        output["brightness"] = map(outputBrightness[i], 0, 255, 0, 100);
-        output["name"] = outputNames[i];
-        output["interval"] = outputIntervals[i];
-        output["chasingGroup"] = outputChasingGroup[i];
+    // true/false, or a number (0 = false) as older clients send
+    CommandInputStatus boolean(const char* name, bool& value) const override {
+        const JsonVariantConst field = object_[name];
+        if (field.isNull()) return CommandInputStatus::Missing;
+        if (field.is<bool>()) value = field.as<bool>();
+        else if (field.is<int32_t>()) value = field.as<int32_t>() != 0;
+        else return CommandInputStatus::Invalid;
+        return CommandInputStatus::Ok;
     }
     
-    JsonArray groups = doc["chasingGroups"].to<JsonArray>();
-    for (int i = 0; i < MAX_CHASING_GROUPS; i++) {
-        if (chasingGroups[i].active) {
-            JsonObject group = groups.add<JsonObject>();
-            group["groupId"] = chasingGroups[i].groupId;
-            group["name"] = chasingGroups[i].name;
-            group["interval"] = chasingGroups[i].interval;
-            group["outputCount"] = chasingGroups[i].outputCount;
-            JsonArray groupOutputs = group["outputs"].to<JsonArray>();
-            for (int j = 0; j < chasingGroups[i].outputCount; j++) {
-                groupOutputs.add(outputPins[chasingGroups[i].outputIndices[j]]);
-            }
+    CommandInputStatus text(const char* name, TextView& value) const override {
+        const JsonVariantConst field = object_[name];
+        if (field.isNull()) return CommandInputStatus::Missing;
+        if (!field.is<const char*>()) return CommandInputStatus::Invalid;
+        value = TextView::fromCString(field.as<const char*>());
+        return CommandInputStatus::Ok;
+    }
+    
+    CommandInputStatus integers(const char* name, int32_t* values, uint8_t capacity, uint8_t& count) const override {
+        const JsonVariantConst field = object_[name];
+        if (field.isNull()) return CommandInputStatus::Missing;
+        if (!field.is<JsonArrayConst>()) return CommandInputStatus::Invalid;
+        count = 0;
+        for (JsonVariantConst item : field.as<JsonArrayConst>()) {
+            if (!item.is<int32_t>()) return CommandInputStatus::Invalid;
+            if (count < capacity) values[count] = item.as<int32_t>();
+            if (count < 255) count++;
+        }
+        return CommandInputStatus::Ok;
+    }
+    
+private:
+    JsonObjectConst object_;
+};
+
+// Fields each command reads, keyed by HTTP path ("websocket": all of them plus
+// "command"). Anything else in a body is skipped by the parser without taking
+// request arena slots. Built once at boot from COMMANDS and shrunk to size
+// (string literal keys are stored as pointers).
+JsonDocument requestFilters;
+
+void initializeRequestFilters() {
+    JsonObject webSocket = requestFilters["websocket"].to<JsonObject>();
+    webSocket["command"] = true;
+    for (uint8_t i = 0; i < COMMAND_COUNT; i++) {
+        const CommandSpec& command = COMMANDS[i];
+        JsonObject filter = requestFilters[command.httpPath].to<JsonObject>();
+        for (uint8_t f = 0; f < command.fieldCount; f++) {
+            forEachCommandFieldKey(command.fields[f], [&filter, &webSocket](const char* key) {
+                filter[key] = true;
+                webSocket[key] = true;
+            });
         }
     }
+    requestFilters.shrinkToFit();
 }
 
-// Helper function for JSON deserialization with consistent error handling
-bool deserializeJsonRequest(String body, JsonDocument& doc, IPAddress clientIP, const char* endpoint) {
-    DeserializationError error = deserializeJson(doc, body);
+// Helper function for JSON deserialization with consistent error handling.
+// Parses straight from the connection buffer - no intermediate String copy -
+// keeping only the endpoint's fields (requestFilters) and refusing nesting
+// beyond JSON_REQUEST_NESTING_LIMIT. The body size is capped by the HTTP
+// parser (HTTP_MAX_BODY_SIZE), so a request never needs more than its arena.
+bool deserializeJsonRequest(const char* body, size_t length, JsonDocument& doc, const IPAddress& clientIP, const char* endpoint) {
+    const JsonVariantConst filter = requestFilters[endpoint];
+    const DeserializationOption::NestingLimit nestingLimit(JSON_REQUEST_NESTING_LIMIT);
+    DeserializationError error = filter.isNull()
+        ? deserializeJson(doc, body, length, nestingLimit)
+        : deserializeJson(doc, body, length, DeserializationOption::Filter(filter), nestingLimit);
     
     if (error) {
-        Serial.print("[ERROR] JSON deserialization failed for ");
+        Serial.print(F("[ERROR] JSON deserialization failed for "));
         Serial.print(endpoint);
-        Serial.print(" from ");
-        Serial.print(clientIP.toString());
-        Serial.print(": ");
+        Serial.print(F(" from "));
+        Serial.print(clientIP);
+        Serial.print(F(": "));
         Serial.println(error.c_str());
         return false;
     }
     return true;
 }
 
-void broadcastStatus() {
-    if (!ws) return;
+// WebSocket transport: {"command":"control","pin":4,"active":true} is answered
+// on the same socket with the HTTP reply body. The admission controller sheds
+// non-essential commands here just like their HTTP routes.
+void handleWebSocketCommand(uint8_t num, const uint8_t* payload, size_t length) {
+    static char reply[COMMAND_REPLY_SIZE];
+    CommandResult result;
+    const CommandSpec* command = nullptr;
+    {
+        RequestJsonScope arenaScope(requestJsonAllocator);
+        JsonDocument doc(&requestJsonAllocator);
+        if (!deserializeJsonRequest(reinterpret_cast<const char*>(payload), length, doc, ws->remoteIP(num), "websocket")) {
+            result = CommandResult::invalid("Invalid JSON");
+        } else {
+            const TextView name = TextView::fromCString(doc["command"] | "");
+            command = commandRouter.find(name);
+            if (command != nullptr && !admission.admitRequest(command->essential)) {
+                result = CommandResult::unavailable("Low memory, retry later");
+            } else {
+                result = commandRouter.dispatch(name, JsonCommandInput(doc.as<JsonObjectConst>()));
+            }
+            LOG_PRINTF("[WS] Command '%.*s' from #%u: %u\n", static_cast<int>(name.length), name.data, num, result.httpStatus());
+        }
+    }
+    traceCommand(TraceSource::WebSocket, num, command, result);
     
-    JsonDocument doc;
-    serializeStatusToJson(doc);
+    // A reply that doesn't fit the send buffer right now is dropped rather
+    // than blocking loop(); the status broadcast reflects the outcome anyway
+    const size_t replyLength = formatCommandReply(reply, sizeof(reply), result);
+    if (ws->writeRoom(num) >= replyLength + WS_FRAME_HEADER_SIZE) {
+        ws->sendTXT(num, reply, replyLength);
+    }
+}
+
+// Serial console transport: one command per line, "<name> field=value ...",
+// e.g. "control pin=4 active=on brightness=50". "help" lists the commands.
+char serialCommandLine[SERIAL_COMMAND_LINE_SIZE];
+size_t serialCommandLength = 0;
+bool serialCommandOverflow = false;
+
+void runSerialCommand(TextView line) {
+    TextView name;
+    TextView arguments;
+    splitCommandLine(line, name, arguments);
+    if (name.empty()) return;
+    
+    if (name.equals("help")) {
+        for (uint8_t i = 0; i < COMMAND_COUNT; i++) {
+            LOG_PRINTF("[CMD] %s", COMMANDS[i].name);
+            for (uint8_t f = 0; f < COMMANDS[i].fieldCount; f++) {
+                const CommandField& field = COMMANDS[i].fields[f];
+                Serial.print(field.required ? " " : " [");
+                bool first = true;
+                forEachCommandFieldKey(field, [&first](const char* key) { // pin=|id= ...
+                    LOG_PRINTF("%s%s=", first ? "" : "|", key);
+                    first = false;
+                });
+                if (!field.required) Serial.print(F("]"));
+            }
+            Serial.println();
+        }
+        Serial.println(F("[CMD] stats"));
+        return;
+    }
     
-    String response;
-    serializeJson(doc, response);
-    ws->broadcastTXT(response);
+    // Command, output engine queue, pin driver, boot, link, RTC snapshot, scheduler, power and flight recorder
+    // counters, as served by GET /api/metrics
+    if (name.equals("stats")) {
+        const CommandMetrics& commands = commandRouter.metrics();
+        const SpscQueueMetrics queue = outputCommands.metrics();
+        LOG_PRINTF("[CMD] Commands: %u dispatched, %u rejected, %u unknown\n", static_cast<unsigned>(commands.dispatched),
+                   static_cast<unsigned>(commands.rejected), static_cast<unsigned>(commands.unknown));
+        LOG_PRINTF("[ENGINE] Queue: %u/%u queued (high water %u), %u posted, %u applied, %u dropped\n",
+                   queue.depth, outputCommands.capacity(), queue.highWater, static_cast<unsigned>(queue.pushed),
+                   static_cast<unsigned>(queue.popped), static_cast<unsigned>(queue.dropped));
+        const OutputDriverMetrics pins = outputDriver.metrics();
+        LOG_PRINTF("[OUTPUT] Pins: %u register writes (0%%/100%%), %u PWM writes, %u detached from PWM, %u on PWM now\n",
+                   static_cast<unsigned>(pins.gpioWrites), static_cast<unsigned>(pins.pwmWrites),
+                   static_cast<unsigned>(pins.pwmDetaches), pins.pwmPins);
+        LOG_PRINTF("[BOOT] First effect tick at %u ms, WiFi %s (station link after %u ms)\n",
+                   static_cast<unsigned>(firstEffectTickMs), WifiBringup::stateName(wifiBringup.state()),
+                   static_cast<unsigned>(wifiBringup.linkUpMs()));
+        const LinkMetrics& link = linkSupervisor.metrics();
+        LOG_PRINTF("[WIFI] Link %s: %u outages (last %u ms, longest %u ms, total %u ms), %u reconnect attempts, last reconnect %u ms\n",
+                   linkSupervisor.up() ? "up" : "down", static_cast<unsigned>(link.outages),
+                   static_cast<unsigned>(link.lastOutageMs), static_cast<unsigned>(link.longestOutageMs),
+                   static_cast<unsigned>(link.totalOutageMs), static_cast<unsigned>(link.attempts),
+                   static_cast<unsigned>(link.lastReconnectMs));
+        LOG_PRINTF("[RTC] Snapshot: %u writes (last %u us, %u bytes)%s; this boot %s\n",
+                   static_cast<unsigned>(rtcSnapshotWrites), static_cast<unsigned>(rtcSnapshotWriteUs),
+                   static_cast<unsigned>(sizeof(rtcSnapshot)), rtcSnapshotEnabled ? "" : ", disabled until reboot",
+                   warmRestored ? "restored from it" : "started cold");
+        if (warmRestored) {
+            LOG_PRINTF("[RTC] Restored %u us after start, %u ms after the last snapshot\n",
+                       static_cast<unsigned>(rtcRestoreUs), static_cast<unsigned>(rtcRestoreGapMs));
+        }
+        const SchedulerStats& passes = scheduler.schedulerStats();
+        LOG_PRINTF("[SCHED] %u passes, longest %u us, %u over the %u us budget\n", static_cast<unsigned>(passes.passes),
+                   static_cast<unsigned>(passes.maxPassUs), static_cast<unsigned>(passes.overrunPasses),
+                   static_cast<unsigned>(SCHEDULER_PASS_BUDGET_US));
+        for (uint8_t i = 0; i < scheduler.count(); i++) {
+            const TaskSpec& task = scheduler.task(i);
+            const TaskStats& stats = scheduler.stats(i);
+            LOG_PRINTF("[SCHED] %-9s %-6s %u runs, avg %u us, max %u us, %u over budget, %u deferred, "
+                       "max gap %u ms, %u deadline misses\n",
+                       task.name, LoopScheduler::priorityName(task.priority), static_cast<unsigned>(stats.runs),
+                       static_cast<unsigned>(stats.runs ? stats.totalUs / stats.runs : 0), static_cast<unsigned>(stats.maxUs),
+                       static_cast<unsigned>(stats.overBudget), static_cast<unsigned>(stats.deferrals),
+                       static_cast<unsigned>(stats.maxGapMs), static_cast<unsigned>(stats.deadlineMisses));
+        }
+        const PowerMetrics& power = powerGovernor.metrics();
+        const unsigned duty = powerGovernor.dutyCyclePermille(millis());
+        LOG_PRINTF("[POWER] %s, CPU %u MHz, duty cycle %u.%u%%, %u wakes (%u by activity), %u boosts to 160 MHz; "
+                   "awake %u s, modem-sleep %u s, light-sleep %u s\n",
+                   IdleGovernor::modeName(powerGovernor.mode()), static_cast<unsigned>(ESP.getCpuFreqMHz()), duty / 10,
+                   duty % 10, static_cast<unsigned>(power.idles), static_cast<unsigned>(power.activityWakes),
+                   static_cast<unsigned>(power.boosts), static_cast<unsigned>(power.modeMs[0] / 1000),
+                   static_cast<unsigned>(power.modeMs[1] / 1000), static_cast<unsigned>(power.modeMs[2] / 1000));
+        const FlightRecorderMetrics trace = flightRecorder.metrics();
+        LOG_PRINTF("[TRACE] Flight recorder: %u/%u bytes, %u records, %u evicted, %u dropped, %u keyframes\n",
+                   static_cast<unsigned>(trace.bytes), static_cast<unsigned>(flightRecorder.capacity()),
+                   static_cast<unsigned>(trace.recorded), static_cast<unsigned>(trace.evicted),
+                   static_cast<unsigned>(trace.dropped), static_cast<unsigned>(trace.keyframes));
+        return;
+    }
+    
+    static char reply[COMMAND_REPLY_SIZE];
+    const KeyValueCommandInput input(arguments);
+    const CommandResult result = input.valid() ? commandRouter.dispatch(name, input)
+                                               : CommandResult::invalid("Expected field=value pairs");
+    traceCommand(TraceSource::Serial, 0, commandRouter.find(name), result);
+    formatCommandReply(reply, sizeof(reply), result);
+    LOG_PRINTF("[CMD] %.*s -> %s\n", static_cast<int>(name.length), name.data, reply);
+}
+
+// Collect console input into serialCommandLine without blocking; an
+// overlong line is discarded up to its end
+void pollSerialCommands() {
+    while (Serial.available() > 0) {
+        const char c = static_cast<char>(Serial.read());
+        if (c == '\r' || c == '\n') {
+            if (serialCommandOverflow) {
+                LOG_PRINTF("[CMD] Console line too long (max %u characters)\n", static_cast<unsigned>(SERIAL_COMMAND_LINE_SIZE));
+            } else {
+                runSerialCommand(TextView(serialCommandLine, serialCommandLength));
+            }
+            serialCommandLength = 0;
+            serialCommandOverflow = false;
+        } else if (serialCommandLength < sizeof(serialCommandLine)) {
+            serialCommandLine[serialCommandLength++] = c;
+        } else {
+            serialCommandOverflow = true;
+        }
+    }
+}
+
+// Diagnostics counters appended to every status snapshot
+void serializeDiagnosticsToJson(JsonDocument& doc) {
+    doc["flashTotal"] = ESP.getFlashChipSize();
+    if (server) {
+        JsonObject http = doc["http"].to<JsonObject>();
+        http["connections"] = server->activeConnections();
+        http["idle"] = server->idleConnections();
+        http["accepted"] = server->connectionsAccepted();
+        http["requests"] = server->requestsServed(); // requests - accepted = served on reused connections
+        http["idleReclaimed"] = server->idleReclaimed();
+    }
+    const AdmissionMetrics& shed = admission.metrics();
+    JsonObject admissionInfo = doc["admission"].to<JsonObject>();
+    admissionInfo["level"] = static_cast<uint8_t>(admission.level());
+    admissionInfo["wsRejected"] = shed.webSocketRejected;
+    admissionInfo["requestsShed"] = shed.requestsShed;
+    admissionInfo["broadcastsDeferred"] = shed.broadcastsDeferred;
+    admissionInfo["escalations"] = shed.escalations;
+    admissionInfo["minFreeHeap"] = shed.minFreeHeap;
+    admissionInfo["minMaxBlock"] = shed.minMaxBlock;
+    const WsQueueMetrics& wsQueue = wsClientQueues.metrics();
+    JsonObject wsInfo = doc["websocket"].to<JsonObject>();
+    wsInfo["clients"] = wsClientQueues.connectedCount();
+    wsInfo["framesSent"] = wsQueue.framesSent;
+    wsInfo["coalesced"] = wsQueue.framesCoalesced; // Superseded before the client could take them
+    wsInfo["slowDisconnects"] = wsQueue.slowDisconnects;
+    wsInfo["rejected"] = wsQueue.rejectedClients;
+    wsInfo["maxBacklogMs"] = wsQueue.maxBacklogMs;
+    const WsQueueMetrics& sseQueue = sseClientQueues.metrics();
+    JsonObject sseInfo = doc["sse"].to<JsonObject>();
+    sseInfo["streams"] = sseClientQueues.connectedCount();
+    sseInfo["eventsSent"] = sseQueue.framesSent;
+    const SnapshotMetrics& snapshotStats = statusSnapshots.metrics();
+    JsonObject snapshotInfo = doc["snapshot"].to<JsonObject>();
+    snapshotInfo["builds"] = snapshotStats.builds;
+    snapshotInfo["served"] = snapshotStats.served;
+    snapshotInfo["notModified"] = statusNotModified;
+}
+
+// Serialize the (filtered) status into 'dest'; false if the arena or the buffer overflows
+bool renderStatusJson(const StatusSubscription& subscription, char* dest, size_t size, size_t& length) {
+    StatusJsonScope arenaScope(statusJsonAllocator);
+    JsonDocument doc(&statusJsonAllocator);
+    serializeStatusToJson(doc, subscription);
+    if (doc.overflowed()) {
+        Serial.print(F("[ERROR] Status JSON arena exhausted ("));
+        Serial.print(JSON_STATUS_ARENA_SIZE);
+        Serial.println(F(" bytes)"));
+        return false;
+    }
+    length = measureJson(doc);
+    if (length >= size) {
+        Serial.print(F("[ERROR] Status JSON too large for buffer: "));
+        Serial.print(length);
+        Serial.print(F("/"));
+        Serial.println(size);
+        return false;
+    }
+    serializeJson(doc, dest, size);
+    return true;
+}
+
+// Render the full status into a free snapshot slot, make it current and queue
+// it for every WebSocket client and event stream whose subscription covers the
+// changes since the last snapshot (none: a telemetry refresh). Returns nullptr
+// while all other slots are still being sent (the previous snapshot stays
+// current) or if the document overflows.
+const StatusSnapshot* buildStatusSnapshot(unsigned long now) {
+    StatusSnapshot* snapshot = statusSnapshots.beginBuild();
+    if (snapshot == nullptr) return nullptr;
+    
+    size_t length = 0;
+    if (!renderStatusJson(StatusSubscription::all(), snapshot->data, sizeof(snapshot->data), length)) return nullptr;
+    statusSnapshots.publish(snapshot, length, statusVersion, now);
+    
+    const StatusChange change = pendingStatusChanges.empty() ? StatusChange::telemetry() : pendingStatusChanges;
+    pendingStatusChanges = StatusChange::none();
+    for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+        if (subscriberWants(wsSubscribers[num], change)) wsClientQueues.publish(num, now);
+    }
+    for (uint8_t id = 0; id < HTTP_MAX_CONNECTIONS; id++) {
+        if (subscriberWants(eventStreams[id].subscriber, change)) sseClientQueues.publish(id, now);
+    }
+    return snapshot;
+}
+
+// Status document as sent to one subscription class
+struct StatusFrame {
+    const char* data;
+    size_t length;
+    uint32_t version;
+};
+
+// Class 0 sends the shared snapshot as is. Filtered classes are rendered on
+// demand into 'scratch', a free snapshot slot borrowed for the current pump
+// pass (never published); false while no slot is free.
+bool statusFrameFor(uint8_t classIndex, const StatusSnapshot* snapshot, StatusSnapshot*& scratch, StatusFrame& frame) {
+    if (classIndex == 0) {
+        frame.data = snapshot->data;
+        frame.length = snapshot->length;
+        frame.version = snapshot->version;
+        return true;
+    }
+    if (scratch == nullptr) scratch = statusSnapshots.beginBuild();
+    if (scratch == nullptr) return false;
+    if (!renderStatusJson(subscriptionClasses.subscription(classIndex), scratch->data, sizeof(scratch->data), frame.length)) return false;
+    frame.data = scratch->data;
+    frame.version = statusVersion;
+    return true;
+}
+
+void releaseStatusSnapshot(void* snapshot) {
+    statusSnapshots.release(static_cast<const StatusSnapshot*>(snapshot));
+}
+
+// Weak ETag: two snapshots of the same state version may differ in telemetry
+void formatStatusETag(char* dest, size_t size, uint32_t version) {
+    snprintf(dest, size, "W/\"%08x-%u\"", static_cast<unsigned>(statusBootId), static_cast<unsigned>(version));
+}
+
+// Headers for /api/status; the browser revalidates instead of reusing its copy blindly
+const char* statusResponseHeaders(const char* etag) {
+    snprintf(statusHeaders, sizeof(statusHeaders), "ETag: %s\r\nCache-Control: no-cache\r\n", etag);
+    return statusHeaders;
+}
+
+void broadcastStatus() {
+    if (!ws) return;
+    const unsigned long now = millis();
+    if (admission.throttlingBroadcasts() && now - lastBroadcast < admission.broadcastInterval(BROADCAST_INTERVAL)) {
+        // Under memory pressure state changes ride along with the next throttled broadcast
+        if (!statusBroadcastPending) admission.recordDeferredBroadcast();
+        statusBroadcastPending = true;
+        return;
+    }
+    if (buildStatusSnapshot(now) == nullptr) {
+        statusBroadcastPending = true; // Retried from loop() once an HTTP response releases a slot
+        return;
+    }
+    statusBroadcastPending = false;
+    lastBroadcast = now;
+    pumpWebSocketClients(now);
+    pumpEventStreams(now);
+}
+
+// Outputs, names, intervals or groups changed: new version, pushed right away
+// to the subscribers it concerns
+void markStatusChanged(const StatusChange& change) {
+    statusVersion++;
+    pendingStatusChanges.add(change);
+    broadcastStatus();
+}
+
+// Write the current status to every pending client whose send buffer can
+// take the whole frame; a client that fell behind skips straight to it.
+// Frames fit TCP_SND_BUF (see the asserts above), so a drained connection
+// always has room.
+// Each subscription class is rendered at most once per pass. A filtered
+// document is never larger than the full snapshot, so a client with room for
+// that is served without rendering first; otherwise its own frame is
+// rendered and sized, so a small filtered frame is not held back.
+void pumpWebSocketClients(unsigned long now) {
+    const StatusSnapshot* snapshot = statusSnapshots.current();
+    if (!ws || snapshot == nullptr) return;
+    const size_t fullBound = snapshot->length + WS_FRAME_HEADER_SIZE;
+    StatusSnapshot* scratch = nullptr;
+    for (uint8_t classIndex = 0; classIndex < STATUS_MAX_SUBSCRIPTION_CLASSES; classIndex++) {
+        if (!subscriptionClasses.active(classIndex)) continue;
+        StatusFrame frame = {nullptr, 0, 0};
+        for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+            if (wsSubscribers[num].classIndex != classIndex) continue;
+            const size_t room = ws->writeRoom(num);
+            if (frame.data == nullptr && room < fullBound && wsClientQueues.pending(num)) {
+                statusFrameFor(classIndex, snapshot, scratch, frame); // On failure the full bound applies
+            }
+            const size_t frameBound = frame.data != nullptr ? frame.length + WS_FRAME_HEADER_SIZE : fullBound;
+            switch (wsClientQueues.poll(num, room, frameBound, now)) {
+                case StatusClientQueues::Send:
+                    if (frame.data == nullptr && !statusFrameFor(classIndex, snapshot, scratch, frame)) {
+                        break; // Stays pending until a snapshot slot frees up
+                    }
+                    ws->sendTXT(num, frame.data, frame.length);
+                    wsClientQueues.markSent(num, now);
+                    break;
+                case StatusClientQueues::Drop:
+                    LOG_PRINTF("[WS] Client #%u backed up for %lu ms, disconnecting\n", num, static_cast<unsigned long>(WS_SLOW_CLIENT_TIMEOUT_MS));
+                    ws->disconnect(num);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+}
+
+// "status" event header, the frame's state version as event id
+int formatStatusEventPrefix(char* prefix, size_t size, const StatusFrame& frame) {
+    return snprintf(prefix, size, "id: %u\nevent: status\ndata: ", static_cast<unsigned>(frame.version));
+}
+
+// Write one whole event; false if the connection took only part of it
+bool writeStatusEvent(uint8_t id, const char* prefix, size_t prefixLength, const StatusFrame& frame) {
+    return server->streamWrite(id, prefix, prefixLength) == prefixLength &&
+           server->streamWrite(id, frame.data, frame.length) == frame.length && // Compact JSON: no newlines
+           server->streamWrite(id, "\n\n", 2) == 2;
+}
+
+// Same for the Server-Sent Events streams: one "status" event per update,
+// its state version as event id. Quiet streams get a comment line now and
+// then, so a client that vanished fills its send buffer and is dropped.
+void pumpEventStreams(unsigned long now) {
+    const StatusSnapshot* snapshot = statusSnapshots.current();
+    if (!server || snapshot == nullptr || sseClientQueues.connectedCount() == 0) return;
+    const size_t fullBound = SSE_EVENT_PREFIX_SIZE + snapshot->length + 2;
+    StatusSnapshot* scratch = nullptr;
+    for (uint8_t classIndex = 0; classIndex < STATUS_MAX_SUBSCRIPTION_CLASSES; classIndex++) {
+        if (!subscriptionClasses.active(classIndex)) continue;
+        StatusFrame frame = {nullptr, 0, 0};
+        char prefix[SSE_EVENT_PREFIX_SIZE];
+        int prefixLength = 0;
+        for (uint8_t id = 0; id < HTTP_MAX_CONNECTIONS; id++) {
+            if (!sseClientQueues.isConnected(id) || eventStreams[id].subscriber.classIndex != classIndex) continue;
+            const size_t room = server->streamWriteRoom(id);
+            if (frame.data == nullptr && room < fullBound && sseClientQueues.pending(id)) {
+                statusFrameFor(classIndex, snapshot, scratch, frame); // On failure the full bound applies
+            }
+            if (frame.data != nullptr && prefixLength == 0) prefixLength = formatStatusEventPrefix(prefix, sizeof(prefix), frame);
+            const size_t frameBound = frame.data != nullptr ? static_cast<size_t>(prefixLength) + frame.length + 2 : fullBound;
+            switch (sseClientQueues.poll(id, room, frameBound, now)) {
+                case EventStreamQueues::Send:
+                    if (frame.data == nullptr) {
+                        if (!statusFrameFor(classIndex, snapshot, scratch, frame)) break; // Stays pending
+                        prefixLength = formatStatusEventPrefix(prefix, sizeof(prefix), frame);
+                    }
+                    if (!writeStatusEvent(id, prefix, static_cast<size_t>(prefixLength), frame)) {
+                        // The rest would run into the next event: the client reconnects and resyncs
+                        LOG_PRINTF("[SSE] Stream #%u took a partial event, closing\n", id);
+                        server->closeStream(id);
+                        break;
+                    }
+                    sseClientQueues.markSent(id, now);
+                    eventStreams[id].lastWriteMs = now;
+                    break;
+                case EventStreamQueues::Drop:
+                    LOG_PRINTF("[SSE] Stream #%u backed up for %lu ms, closing\n", id, static_cast<unsigned long>(WS_SLOW_CLIENT_TIMEOUT_MS));
+                    server->closeStream(id);
+                    break;
+                case EventStreamQueues::Idle:
+                    if (now - eventStreams[id].lastWriteMs >= SSE_HEARTBEAT_MS && room >= 3) {
+                        if (server->streamWrite(id, ":\n\n", 3) != 3) {
+                            LOG_PRINTF("[SSE] Stream #%u took a partial heartbeat, closing\n", id);
+                            server->closeStream(id);
+                            break;
+                        }
+                        eventStreams[id].lastWriteMs = now;
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+}
+
+// Release callback of an /api/events response: the stream's connection is gone
+void closeEventStream(void* stream) {
+    const uint8_t id = static_cast<uint8_t>(static_cast<EventStream*>(stream) - eventStreams);
+    sseClientQueues.disconnect(id);
+    unsubscribeStatus(eventStreams[id].subscriber);
+    LOG_PRINTF("[SSE] Stream #%u closed\n", id);
 }
 
 void setup() {
+    // Warm boot: outputs and effects back before anything else, even EEPROM
+    warmRestored = restoreRtcSnapshot();
+    
     Serial.begin(115200);
     delay(100);
     
     // Initialize EEPROM for ESP8266
     EEPROM.begin(EEPROM_SIZE);
     
-    Serial.println("\n\n========================================");
-    Serial.println("  RailHub8266 ESP8266 Controller v1.0");
-    Serial.println("========================================");
-    Serial.println("[BOOT] Chip ID: " + String(ESP.getChipId(), HEX));
-    Serial.println("[BOOT] CPU Frequency: " + String(ESP.getCpuFreqMHz()) + " MHz");
-    Serial.println("[BOOT] Flash Size: " + String(ESP.getFlashChipSize() / 1024) + " KB");
-    Serial.println("[BOOT] Free Heap: " + String(ESP.getFreeHeap()) + " bytes");
+    Serial.println(F("\n\n========================================"));
+    Serial.println(F("  RailHub8266 ESP8266 Controller v1.0"));
+    Serial.println(F("========================================"));
+    LOG_PRINTF("[BOOT] Chip ID: %x\n", ESP.getChipId());
+    LOG_PRINTF("[BOOT] CPU Frequency: %u MHz\n", ESP.getCpuFreqMHz());
+    LOG_PRINTF("[BOOT] Flash Size: %u KB\n", ESP.getFlashChipSize() / 1024);
+    LOG_PRINTF("[BOOT] Free Heap: %u bytes\n", ESP.getFreeHeap());
+    LOG_PRINTF("[BOOT] Reset reason: %s\n", ESP.getResetReason().c_str());
+    if (warmRestored) {
+        LOG_PRINTF("[BOOT] Warm restart: outputs and effects restored from RTC memory %u us after start (%u ms since the last snapshot)\n",
+                   static_cast<unsigned>(rtcRestoreUs), static_cast<unsigned>(rtcRestoreGapMs));
+    }
+    statusBootId = ESP.random();
     
     // Get MAC address for unique identification
-    macAddress = WiFi.macAddress();
-    Serial.println("[INIT] MAC Address: " + macAddress);
+    uint8_t mac[6];
+    WiFi.macAddress(mac);
+    snprintf(macAddress, sizeof(macAddress), "%02X:%02X:%02X:%02X:%02X:%02X",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    LOG_PRINTF("[INIT] MAC Address: %s\n", macAddress);
     
     // Initialize portal trigger pin
-    Serial.println("[INIT] Configuring portal trigger pin (GPIO " + String(PORTAL_TRIGGER_PIN) + ")");
+    LOG_PRINTF("[INIT] Configuring portal trigger pin (GPIO %d)\n", PORTAL_TRIGGER_PIN);
     pinMode(PORTAL_TRIGGER_PIN, INPUT_PULLUP);
     
     // Initialize output pins
-    Serial.println("[INIT] Initializing " + String(MAX_OUTPUTS) + " output pins...");
+    LOG_PRINTF("[INIT] Initializing %d output pins...\n", MAX_OUTPUTS);
     initializeOutputs();
     
     // Load custom parameters from preferences
-    Serial.println("[INIT] Loading custom parameters from NVRAM...");
+    Serial.println(F("[INIT] Loading custom parameters from NVRAM..."));
     loadCustomParameters();
     
     // Load saved output states from NVRAM
-    Serial.println("[INIT] Loading saved output states...");
+    Serial.println(F("[INIT] Loading saved output states..."));
     loadOutputStates();
     
     // Load chasing groups
-    Serial.println("[INIT] Loading chasing groups...");
+    Serial.println(F("[INIT] Loading chasing groups..."));
     loadChasingGroups();
     
-    // Initialize WiFi with WiFiManager
-    Serial.println("[INIT] Initializing WiFi Manager...");
+    // Request body filters: allocated once, before WiFi fragments the heap
+    initializeRequestFilters();
+    
+    // Start WiFi with WiFiManager; connecting, the portal and the web server
+    // are driven from loop() so the effects above run meanwhile
+    Serial.println(F("[INIT] Initializing WiFi Manager..."));
     initializeWiFiManager();
     
-    // Initialize web server after WiFi is connected
-    if (wifiConnected) {
-        Serial.println("[INIT] Starting web server on port 80...");
-        server = new ESP8266WebServer(80);
-        initializeWebServer();
-        Serial.println("[WEB] Web server initialized successfully");
-        
-        Serial.println("[INIT] Starting WebSocket server on port 81...");
-        ws = new WebSocketsServer(81);
-        ws->begin();
-        ws->onEvent(wsEvent);
-        Serial.println("[WS] WebSocket server started on port 81");
-    } else {
-        Serial.println("[WARN] WiFi not connected - web server not started");
+    Serial.println(F("\n========================================"));
+    Serial.println(F("  Setup Complete!"));
+    Serial.println(F("========================================"));
+    LOG_PRINTF("[INFO] Device Name: %s\n", customDeviceName);
+    LOG_PRINTF("[INFO] Free Heap: %u bytes\n", ESP.getFreeHeap());
+    LOG_PRINTF("[INFO] JSON arenas: request %u/%u bytes, status %u/%u bytes (static, required/reserved)\n",
+               static_cast<unsigned>(REQUEST_JSON_ARENA_REQUIRED), JSON_REQUEST_ARENA_SIZE,
+               static_cast<unsigned>(STATUS_JSON_ARENA_REQUIRED), JSON_STATUS_ARENA_SIZE);
+    LOG_PRINTF("[INFO] Output table: %u bytes for %u outputs\n", static_cast<unsigned>(sizeof(outputTable)), MAX_OUTPUTS);
+    Serial.println(F("[INFO] System ready for operation\n"));
+}
+
+// Apply queued commands, then step the effects
+void runEffectTask() {
+    applyOutputCommands();
+    
+    if (!effectsStarted) {
+        effectsStarted = true;
+        firstEffectTickMs = millis();
+        LOG_PRINTF("[BOOT] First effect tick %u ms after boot (WiFi %s)\n", static_cast<unsigned>(firstEffectTickMs),
+                   WifiBringup::stateName(wifiBringup.state()));
+    }
+    
+    // Update chasing light groups (has priority)
+    updateChasingLightGroups();
+    
+    // Update blinking outputs (only for non-chasing outputs)
+    updateBlinkingOutputs();
+    
+    // Keep the warm-restart snapshot current
+    if (rtcSnapshotDirty && rtcSnapshotEnabled) {
+        saveRtcSnapshot();
     }
     
-    Serial.println("\n========================================");
-    Serial.println("  Setup Complete!");
-    Serial.println("========================================");
-    Serial.println("[INFO] Device Name: " + String(customDeviceName));
-    Serial.println("[INFO] Free Heap: " + String(ESP.getFreeHeap()) + " bytes");
-    Serial.println("[INFO] System ready for operation\n");
+    // Give the flight recorder a known engine state to replay from
+    if (flightRecorder.keyframeDue()) {
+        recordTraceKeyframe();
+    }
 }
 
-void loop() {
-    // Check for config portal trigger button
+// Check for config portal trigger button
+void runButtonTask() {
     checkConfigPortalTrigger();
-    
-    // Handle web server requests
+}
+
+// Step WiFi bring-up (non-blocking): connect, portal, fallback AP;
+// afterwards watch the station link and reconnect when it drops
+void runWiFiTask() {
+    updateWiFiBringup();
+    superviseWiFiLink();
+}
+
+// Advance HTTP connections (non-blocking)
+void runHttpTask() {
     if (server) {
-        server->handleClient();
+        server->poll();
+        pumpEventStreams(millis());
     }
+}
+
+// Handle WebSocket events
+void runWebSocketTask() {
+    if (!ws) return;
+    ws->loop();
     
-    // Handle WebSocket events
-    if (ws) {
-        ws->loop();
-        
-        // Broadcast status periodically for real-time updates
-        unsigned long now = millis();
-        if (now - lastBroadcast >= BROADCAST_INTERVAL) {
-            broadcastStatus();
-            lastBroadcast = now;
-        }
+    // State changes are pushed as they happen; rebuild here for deferred ones
+    if (statusBroadcastPending || !statusSnapshots.isCurrent(statusVersion)) {
+        broadcastStatus();
     }
     
-    // Update mDNS responder
+    // Clients that were backed up get the newest status once they drain
+    if (wsClientQueues.anyPending()) {
+        pumpWebSocketClients(millis());
+    }
+}
+
+// Commands typed on the serial console
+void runSerialTask() {
+    pollSerialCommands();
+}
+
+// Track heap pressure for admission control
+void runHeapTask() {
+    if (millis() - lastAdmissionSample >= ADMISSION_SAMPLE_INTERVAL_MS) {
+        sampleHeapForAdmission();
+    }
+}
+
+// Refresh the telemetry (heap, uptime, diagnostics) for WebSocket clients
+void runTelemetryTask() {
+    // No snapshot yet when the first build failed (too large, or no free slot): retry
+    const StatusSnapshot* snapshot = statusSnapshots.current();
+    if (ws && (snapshot == nullptr || millis() - snapshot->builtAtMs >= STATUS_TELEMETRY_INTERVAL_MS)) {
+        broadcastStatus();
+    }
+}
+
+// Update mDNS responder
+void runMdnsTask() {
     MDNS.update();
+}
+
+// Time until the next blink toggle or chase step; 0 while something is
+// waiting to be applied, NO_EFFECT_DEADLINE when nothing steps
+uint32_t msUntilNextEffectStep(unsigned long now) {
+    if (!outputCommands.empty()) return 0;
+    uint32_t next = NO_EFFECT_DEADLINE;
+    for (uint8_t g = 0; g < MAX_CHASING_GROUPS; g++) {
+        const ChasingGroup& group = chasingGroups[g];
+        if (!group.active || group.outputCount == 0) continue;
+        const unsigned long since = now - group.lastStepTime;
+        const uint32_t due = since >= group.interval ? 0 : group.interval - since;
+        if (due < next) next = due;
+    }
+    for (uint8_t i = 0; i < MAX_OUTPUTS; i++) {
+        if (!outputTable.isOn(i) || outputTable.inGroup(i)) continue;
+        if (outputTable.interval[i] == 0) {
+            if (!outputTable.isLit(i)) return 0; // Steady output not driven yet
+            continue;
+        }
+        const unsigned long since = now - outputTable.lastToggleMs[i];
+        const uint32_t due = since >= outputTable.interval[i] ? 0 : outputTable.interval[i] - since;
+        if (due < next) next = due;
+    }
+    return next;
+}
+
+// Pick radio sleep mode and CPU clock for the pass just run, then idle
+// until the next effect step if the governor allows it
+void governPower() {
+    const unsigned long now = millis();
+    PowerInputs inputs;
+    inputs.networkBusy = wifiBringup.state() != WifiBringupState::Connected || !linkSupervisor.up() || portalRunning ||
+                         portalButtonPressTime != 0 || wsClientQueues.connectedCount() > 0 ||
+                         (server && server->activeConnections() > 0) || statusBroadcastPending ||
+                         Serial.available() > 0 || serialCommandLength > 0;
+    inputs.nextEffectMs = msUntilNextEffectStep(now);
+    inputs.effectsRunning = inputs.nextEffectMs != NO_EFFECT_DEADLINE;
+    inputs.pwmActive = outputDriver.metrics().pwmPins > 0;
+    inputs.passUs = scheduler.schedulerStats().lastPassUs;
+    const PowerPlan plan = powerGovernor.update(now, inputs);
+    
+    if (!powerModeApplied || plan.mode != appliedPowerMode) {
+        const WiFiSleepType_t sleepType = plan.mode == PowerMode::Awake        ? WIFI_NONE_SLEEP
+                                          : plan.mode == PowerMode::ModemSleep ? WIFI_MODEM_SLEEP
+                                                                               : WIFI_LIGHT_SLEEP;
+        WiFi.setSleepMode(sleepType, plan.mode == PowerMode::Awake ? 0 : POWER_DTIM_LISTEN_INTERVAL);
+        if (powerModeApplied) {
+            LOG_PRINTF("[POWER] %s -> %s\n", IdleGovernor::modeName(appliedPowerMode), IdleGovernor::modeName(plan.mode));
+        }
+        appliedPowerMode = plan.mode;
+        powerModeApplied = true;
+    }
+    if (plan.boost != cpuBoosted) {
+        system_update_cpu_freq(plan.boost ? SYS_CPU_160MHZ : SYS_CPU_80MHZ);
+        cpuBoosted = plan.boost;
+    }
     
-    // Update chasing light groups (has priority)
-    updateChasingLightGroups();
+    if (plan.idleMs == 0) {
+        yield();
+        return;
+    }
+    const unsigned long idleStart = millis();
+    delay(plan.idleMs); // The SDK sleeps the radio (and in light sleep the CPU) meanwhile
+    const uint32_t idledMs = millis() - idleStart;
+    powerGovernor.idled(idledMs);
+    scheduler.idled(idledMs);
+}
+
+void loop() {
+    scheduler.runPass();
     
-    // Update blinking outputs (only for non-chasing outputs)
-    updateBlinkingOutputs();
+    // A pass over budget delays the next effect tick; the replay needs to know
+    const SchedulerStats& passes = scheduler.schedulerStats();
+    if (passes.overrunPasses != tracedOverrunPasses) {
+        tracedOverrunPasses = passes.overrunPasses;
+        flightRecorder.recordOverrun(millis(), passes.lastPassUs);
+    }
     
-    // Handle any other tasks
-    yield();
+    // Sleep modes, CPU clock and idling; yields when staying awake
+    governPower();
 }
 
 // Periodic status logging (called every 60 seconds via timer)
@@ -312,52 +1459,52 @@ void logSystemStatus() {
     
     if (currentMillis - lastStatusLog >= 60000) {
         lastStatusLog = currentMillis;
-        Serial.println("\n[STATUS] === System Status Report ===");
-        Serial.println("[STATUS] Uptime: " + String(currentMillis / 1000) + " seconds");
-        Serial.println("[STATUS] Free Heap: " + String(ESP.getFreeHeap()) + " bytes");
-        Serial.println("[STATUS] WiFi Status: " + String(WiFi.isConnected() ? "Connected" : "Disconnected"));
+        Serial.println(F("\n[STATUS] === System Status Report ==="));
+        LOG_PRINTF("[STATUS] Uptime: %lu seconds\n", currentMillis / 1000);
+        LOG_PRINTF("[STATUS] Free Heap: %u bytes\n", ESP.getFreeHeap());
+        LOG_PRINTF("[STATUS] WiFi Status: %s\n", WiFi.isConnected() ? "Connected" : "Disconnected");
         if (WiFi.isConnected()) {
-            Serial.println("[STATUS] IP Address: " + WiFi.localIP().toString());
-            Serial.println("[STATUS] RSSI: " + String(WiFi.RSSI()) + " dBm");
+            Serial.print(F("[STATUS] IP Address: "));
+            Serial.println(WiFi.localIP());
+            LOG_PRINTF("[STATUS] RSSI: %d dBm\n", WiFi.RSSI());
         }
         
-        // Count active outputs
-        int activeCount = 0;
-        for (int i = 0; i < MAX_OUTPUTS; i++) {
-            if (outputStates[i]) activeCount++;
-        }
-        Serial.println("[STATUS] Active Outputs: " + String(activeCount) + "/" + String(MAX_OUTPUTS));
-        Serial.println("[STATUS] ========================\n");
+        LOG_PRINTF("[STATUS] Active Outputs: %d/%d\n", outputTable.onCount(), MAX_OUTPUTS);
+        Serial.println(F("[STATUS] ========================\n"));
     }
 }
 
 void initializeOutputs() {
-    Serial.println("[OUTPUT] Initializing outputs...");
+    Serial.println(F("[OUTPUT] Initializing outputs..."));
     
     // Set PWM range for ESP8266 (0-1023 by default, we'll use 0-255 range)
     analogWriteRange(255);
     analogWriteFreq(1000); // 1kHz PWM frequency
     
-    for (int i = 0; i < MAX_OUTPUTS; i++) {
-        Serial.print("[OUTPUT] Configuring Output " + String(i) + " on GPIO " + String(outputPins[i]));
-        pinMode(outputPins[i], OUTPUT);
-        analogWrite(outputPins[i], 0);
-        Serial.println(" - OK (PWM 1kHz, 8-bit)");
+    if (warmRestored) {
+        // Configured and driven by restoreRtcSnapshot(); writing 0 here would blank them
+        Serial.println(F("[OUTPUT] Outputs already driven from the RTC snapshot"));
+    } else {
+        for (int i = 0; i < MAX_OUTPUTS; i++) {
+            LOG_PRINTF("[OUTPUT] Configuring Output %d on GPIO %d", i, outputTable.pins[i]);
+            pinMode(outputTable.pins[i], OUTPUT);
+            outputDriver.write(i, 0);
+            Serial.println(F(" - OK (PWM 1kHz, 8-bit)"));
+        }
     }
     
     // Status LED (active LOW on ESP8266)
-    Serial.println("[OUTPUT] Initializing status LED on GPIO " + String(STATUS_LED_PIN));
+    LOG_PRINTF("[OUTPUT] Initializing status LED on GPIO %d\n", STATUS_LED_PIN);
     pinMode(STATUS_LED_PIN, OUTPUT);
     digitalWrite(STATUS_LED_PIN, LOW); // Turn on status LED (active LOW)
-    Serial.println("[OUTPUT] All outputs initialized successfully");
+    Serial.println(F("[OUTPUT] All outputs initialized successfully"));
 }
 
 void initializeWiFi() {
-    Serial.println("Configuring Access Point...");
+    Serial.println(F("Configuring Access Point..."));
     
     // Disconnect from any existing WiFi connection
     WiFi.disconnect();
-    delay(100);
     
     // Configure Access Point IP address
     IPAddress local_IP;
@@ -369,7 +1516,7 @@ void initializeWiFi() {
     subnet.fromString(AP_SUBNET);
     
     if (!WiFi.softAPConfig(local_IP, gateway, subnet)) {
-        Serial.println("AP Config Failed!");
+        Serial.println(F("AP Config Failed!"));
     }
     
     // Start Access Point
@@ -377,45 +1524,39 @@ void initializeWiFi() {
     
     if (apStarted) {
         Serial.println();
-        Serial.println("Access Point started successfully!");
-        Serial.print("AP SSID: ");
+        Serial.println(F("Access Point started successfully!"));
+        Serial.print(F("AP SSID: "));
         Serial.println(AP_SSID);
-        Serial.print("AP IP address: ");
+        Serial.print(F("AP IP address: "));
         Serial.println(WiFi.softAPIP());
-        Serial.print("AP MAC address: ");
+        Serial.print(F("AP MAC address: "));
         Serial.println(WiFi.softAPmacAddress());
-        Serial.print("Max connections: ");
+        Serial.print(F("Max connections: "));
         Serial.println(AP_MAX_CONNECTIONS);
         
-        // Blink status LED to indicate AP started (active LOW)
-        for (int i = 0; i < 5; i++) {
-            digitalWrite(STATUS_LED_PIN, HIGH);
-            delay(150);
-            digitalWrite(STATUS_LED_PIN, LOW);
-            delay(150);
-        }
+        // Status LED on (active LOW); no blink sequence, loop() must not stall
+        digitalWrite(STATUS_LED_PIN, LOW);
     } else {
         Serial.println();
-        Serial.println("Access Point failed to start!");
+        Serial.println(F("Access Point failed to start!"));
     }
 }
 
 void initializeWiFiManager() {
-    Serial.println("[WIFI] Initializing WiFiManager...");
-    Serial.println("[WIFI] Configuration Portal SSID: " + String(WIFIMANAGER_AP_SSID));
-    Serial.println("[WIFI] Portal Trigger Pin: GPIO " + String(PORTAL_TRIGGER_PIN));
+    Serial.println(F("[WIFI] Initializing WiFiManager..."));
+    LOG_PRINTF("[WIFI] Configuration Portal SSID: %s\n", WIFIMANAGER_AP_SSID);
+    LOG_PRINTF("[WIFI] Portal Trigger Pin: GPIO %d\n", PORTAL_TRIGGER_PIN);
     
     // Ensure WiFi is in correct mode
     WiFi.mode(WIFI_STA);
-    delay(100);
     
     // WiFiManager already initialized globally
     
-    // Set custom parameters
-    WiFiManagerParameter custom_device_name("device_name", "Device Name", customDeviceName, 40);
+    // Set custom parameters (portal default: the name loaded from EEPROM)
+    deviceNameParameter.setValue(customDeviceName, 40);
     
     // Add parameters to WiFiManager
-    wifiManager.addParameter(&custom_device_name);
+    wifiManager.addParameter(&deviceNameParameter);
     
     // Minimal configuration for ESP8266 to save RAM
     wifiManager.setMinimumSignalQuality(20);  // Higher = fewer networks shown = less RAM
@@ -427,81 +1568,37 @@ void initializeWiFiManager() {
     
     // Set save config callback
     wifiManager.setSaveConfigCallback([]() {
-        Serial.println("[WIFI] Configuration saved!");
-        Serial.print("[WIFI] Device Name: ");
+        Serial.println(F("[WIFI] Configuration saved!"));
+        Serial.print(F("[WIFI] Device Name: "));
         Serial.println(customDeviceName);
-        Serial.println("[WIFI] WiFi credentials will be used on next boot");
-        Serial.println("[WIFI] Restarting ESP8266 to apply new configuration...");
+        Serial.println(F("[WIFI] WiFi credentials will be used on next boot"));
+        Serial.println(F("[WIFI] Restarting ESP8266 to apply new configuration..."));
         delay(2000);
         ESP.restart();
     });
     
-    // Set short timeout to free memory after config
-    wifiManager.setConfigPortalTimeout(300); // 5 minutes timeout
+    // The portal is serviced from loop(); its timeout (WIFIMANAGER_TIMEOUT) is
+    // kept by wifiBringup, which then starts the fallback AP
+    wifiManager.setConfigPortalBlocking(false);
     
     // Disable debug output to save RAM
     wifiManager.setDebugOutput(false);
     
-    // Set custom CSS for captive portal to match ESP8266 page style
-    wifiManager.setCustomHeadElement(
-        "<style>"
-        ":root{--color-bg-primary:#0a0a0a;--color-bg-secondary:#141414;--color-bg-tertiary:#1a1a1a;--color-bg-card:#1c1c1c;--color-border:#2a2a2a;--color-border-hover:#3a3a3a;"
-        "--color-text-primary:#e8e8e8;--color-text-secondary:#a0a0a0;--color-text-muted:#707070;--color-accent:#6c9bcf;--color-accent-hover:#5a8bc0;--color-success:#4a9b6f;"
-        "--color-danger:#b85c5c;--color-warning:#c9a257;--font-primary:'Segoe UI',-apple-system,BlinkMacSystemFont,'Helvetica Neue',sans-serif}"
-        "*{margin:0;padding:0;box-sizing:border-box}"
-        "body{font-family:var(--font-primary);background:var(--color-bg-primary);color:var(--color-text-primary);min-height:100vh;font-size:15px;line-height:1.6;letter-spacing:0.01em}"
-        "h1{font-size:2rem;margin-bottom:8px;font-weight:300;letter-spacing:0.03em;color:var(--color-text-primary)}"
-        "h2{font-size:1.2rem;margin-bottom:10px;color:var(--color-text-primary);font-weight:400}"
-        "h3{font-size:1rem;margin-bottom:10px;color:var(--color-text-primary);font-weight:400}"
-        "form{background:var(--color-bg-card);border:1px solid var(--color-border);padding:24px;border-radius:8px;margin:20px 0}"
-        "label{display:block;margin-bottom:8px;color:var(--color-text-secondary);font-size:0.9rem;font-weight:400}"
-        "input[type='text'],input[type='password'],input[type='number'],select{width:100%;padding:11px 14px;background:rgba(255,255,255,0.03);border:1px solid var(--color-border);color:var(--color-text-primary);border-radius:4px;font-size:0.9rem;font-family:var(--font-primary);transition:all 0.2s ease;box-sizing:border-box}"
-        "input[type='text']:focus,input[type='password']:focus,input[type='number']:focus,select:focus{outline:none;border-color:var(--color-accent);background:rgba(255,255,255,0.05)}"
-        "button,input[type='submit']{padding:11px 24px;border:1px solid var(--color-border);border-radius:2px;cursor:pointer;font-size:0.85rem;font-weight:400;letter-spacing:0.05em;transition:all 0.2s ease;text-transform:uppercase;background:transparent;color:var(--color-text-primary);font-family:var(--font-primary)}"
-        "button:hover,input[type='submit']:hover{border-color:var(--color-border-hover);background:var(--color-bg-tertiary)}"
-        "button:active,input[type='submit']:active{transform:scale(0.98)}"
-        "input[type='submit'],button[type='submit']{background:var(--color-accent);border-color:var(--color-accent);color:#fff}"
-        "input[type='submit']:hover,button[type='submit']:hover{background:var(--color-accent-hover);border-color:var(--color-accent-hover)}"
-        ".form-group{margin-bottom:20px}"
-        ".form-row{display:flex;gap:12px;margin-bottom:20px}"
-        ".form-row .form-group{flex:1;margin-bottom:0}"
-        "p{color:var(--color-text-secondary);font-size:0.9rem;line-height:1.6;margin-bottom:15px}"
-        "a{color:var(--color-accent);text-decoration:none;transition:color 0.2s}"
-        "a:hover{color:var(--color-accent-hover)}"
-        ".wifi-list{background:var(--color-bg-secondary);border:1px solid var(--color-border);border-radius:4px;padding:8px;max-height:300px;overflow-y:auto;margin-bottom:20px}"
-        ".wifi-item{padding:12px;margin:4px 0;background:var(--color-bg-tertiary);border:1px solid var(--color-border);border-radius:4px;cursor:pointer;transition:all 0.2s}"
-        ".wifi-item:hover{background:var(--color-bg-card);border-color:var(--color-border-hover)}"
-        ".wifi-item strong{color:var(--color-text-primary);display:block;margin-bottom:4px}"
-        ".wifi-item small{color:var(--color-text-muted);font-size:0.8rem}"
-        "table{width:100%;border-collapse:collapse;margin:20px 0}"
-        "table td,table th{padding:12px;text-align:left;border-bottom:1px solid var(--color-border);color:var(--color-text-primary)}"
-        "table th{color:var(--color-text-secondary);font-weight:400;text-transform:uppercase;font-size:0.75rem;letter-spacing:0.05em}"
-        ".msg{background:var(--color-bg-tertiary);border:1px solid var(--color-border);padding:15px;border-radius:4px;margin:15px 0;color:var(--color-text-primary)}"
-        ".msg.error{background:rgba(184,92,92,0.1);border-color:var(--color-danger);color:var(--color-danger)}"
-        ".msg.success{background:rgba(74,155,111,0.1);border-color:var(--color-success);color:var(--color-success)}"
-        "@media (max-width:768px){form{padding:16px}input[type='text'],input[type='password'],input[type='number'],select{font-size:16px}.form-row{flex-direction:column;gap:0}}"
-        "</style>"
-    );
-    
     // Set AP callback
     wifiManager.setAPCallback([](WiFiManager *myWiFiManager) {
-        Serial.println("\n========================================");
-        Serial.println("     CONFIGURATION MODE ACTIVE");
-        Serial.println("========================================");
-        Serial.println("[WIFI] AP Mode Started");
-        Serial.println("[WIFI] AP SSID: " + String(WIFIMANAGER_AP_SSID));
-        Serial.println("[WIFI] AP Password: " + String(WIFIMANAGER_AP_PASSWORD));
-        Serial.println("[WIFI] AP IP Address: " + WiFi.softAPIP().toString());
-        Serial.println("[WIFI] Configuration Portal: http://192.168.4.1");
-        Serial.println("[INFO] Connect your device to the AP above");
-        Serial.println("[INFO] Portal running on port 80");
-        Serial.println("========================================\n");
+        Serial.println(F("\n========================================"));
+        Serial.println(F("     CONFIGURATION MODE ACTIVE"));
+        Serial.println(F("========================================"));
+        Serial.println(F("[WIFI] AP Mode Started"));
+        LOG_PRINTF("[WIFI] AP SSID: %s\n", WIFIMANAGER_AP_SSID);
+        LOG_PRINTF("[WIFI] AP Password: %s\n", WIFIMANAGER_AP_PASSWORD);
+        Serial.print(F("[WIFI] AP IP Address: "));
+        Serial.println(WiFi.softAPIP());
+        Serial.println(F("[WIFI] Configuration Portal: http://192.168.4.1"));
+        Serial.println(F("[INFO] Connect your device to the AP above"));
+        Serial.println(F("[INFO] Portal running on port 80"));
+        Serial.println(F("========================================\n"));
         
-        // Blink LED to indicate config mode (active LOW)
-        for (int i = 0; i < 10; i++) {
-            digitalWrite(STATUS_LED_PIN, !digitalRead(STATUS_LED_PIN));
-            delay(100);
-        }
         digitalWrite(STATUS_LED_PIN, LOW); // On (active LOW)
     });
     
@@ -511,63 +1608,208 @@ void initializeWiFiManager() {
     IPAddress portal_subnet(255, 255, 255, 0);
     wifiManager.setAPStaticIPConfig(portal_ip, portal_gateway, portal_subnet);
     
-    // Try to connect with saved credentials or start portal
-    Serial.println("[WIFI] Attempting to connect to WiFi...");
-    Serial.print("[WIFI] Config AP SSID: ");
-    Serial.println(WIFIMANAGER_AP_SSID);
+    // Join with the saved credentials; updateWiFiBringup() takes it from here
+    const bool haveCredentials = wifiManager.getWiFiIsSaved();
+    if (haveCredentials) {
+        Serial.println(F("[WIFI] Attempting to connect to WiFi..."));
+        WiFi.begin();
+    } else {
+        Serial.println(F("[WIFI] No saved credentials"));
+    }
+    wifiBringup.begin(millis(), haveCredentials);
+}
+
+// Portal stylesheet: WiFiManager reads it with plain string functions, which
+// can't read flash, so it gets a heap copy for as long as the portal runs
+char* portalHeadElement = nullptr;
+
+void attachPortalStyle() {
+    if (portalHeadElement) return;
+    portalHeadElement = static_cast<char*>(malloc(PORTAL_HEAD_ELEMENT_LENGTH + 1));
+    if (!portalHeadElement) return; // Portal still works, unstyled
+    memcpy_P(portalHeadElement, PORTAL_HEAD_ELEMENT, PORTAL_HEAD_ELEMENT_LENGTH + 1);
+    wifiManager.setCustomHeadElement(portalHeadElement);
+}
+
+void releasePortalStyle() {
+    if (!portalHeadElement) return;
+    wifiManager.setCustomHeadElement("");
+    free(portalHeadElement);
+    portalHeadElement = nullptr;
+}
+
+// Non-blocking WiFi bring-up step, called every loop() pass
+void updateWiFiBringup() {
+    if (wifiBringup.settled()) return;
+    if (wifiBringup.state() == WifiBringupState::Portal) {
+        wifiManager.process();
+    }
+    
+    switch (wifiBringup.update(millis(), WiFi.status() == WL_CONNECTED)) {
+        case WifiBringupAction::StartPortal: {
+            LOG_PRINTF("[WIFI] Starting configuration portal (%s, closes after %u s)\n", WIFIMANAGER_AP_SSID,
+                       static_cast<unsigned>(WIFIMANAGER_TIMEOUT));
+            // Use NULL for open AP if password is empty, otherwise use the password
+            const char* apPassword = (strlen(WIFIMANAGER_AP_PASSWORD) == 0) ? NULL : WIFIMANAGER_AP_PASSWORD;
+            attachPortalStyle();
+            wifiManager.startConfigPortal(WIFIMANAGER_AP_SSID, apPassword); // Returns at once (non-blocking)
+            break;
+        }
+        case WifiBringupAction::StartFallbackAp:
+            // Nobody configured the device - fallback to AP mode
+            Serial.println(F("[ERROR] Failed to connect - starting fallback AP mode"));
+            wifiManager.stopConfigPortal();
+            releasePortalStyle();
+            initializeWiFi();
+            startNetworkServices();
+            break;
+        case WifiBringupAction::LinkUp:
+            if (wifiManager.getConfigPortalActive()) {
+                wifiManager.stopConfigPortal(); // Frees port 80 for the web server
+            }
+            releasePortalStyle();
+            onStationConnected();
+            break;
+        default:
+            break;
+    }
+}
+
+void onStationConnected() {
+    wifiConnected = true;
+    
+    // Cache SSID once so status serialization doesn't build a String per request
+    strncpy(stationSsid, WiFi.SSID().c_str(), sizeof(stationSsid) - 1);
+    stationSsid[sizeof(stationSsid) - 1] = '\0';
+    
+    Serial.println(F("\n========================================"));
+    Serial.println(F("     WIFI CONNECTION SUCCESSFUL"));
+    Serial.println(F("========================================"));
+    Serial.print(F("[WIFI] IP Address: "));
+    Serial.println(WiFi.localIP());
+    Serial.print(F("[WIFI] SSID: "));
+    Serial.println(stationSsid);
+    Serial.print(F("[WIFI] Signal Strength: "));
+    Serial.print(WiFi.RSSI());
+    Serial.println(F(" dBm"));
+    Serial.print(F("[WIFI] MAC Address: "));
+    Serial.println(macAddress);
+    Serial.print(F("[WIFI] Connection Time: "));
+    Serial.print(wifiBringup.linkUpMs());
+    Serial.println(F("ms"));
+    Serial.println(F("========================================\n"));
+    
+    // Get custom parameters
+    if (strncmp(customDeviceName, deviceNameParameter.getValue(), sizeof(customDeviceName) - 1) != 0) {
+        strncpy(customDeviceName, deviceNameParameter.getValue(), sizeof(customDeviceName) - 1);
+        saveCustomParameters();
+    }
     
-    // Use NULL for open AP if password is empty, otherwise use the password
-    const char* apPassword = (strlen(WIFIMANAGER_AP_PASSWORD) == 0) ? NULL : WIFIMANAGER_AP_PASSWORD;
+    // Start mDNS service
+    startMdns();
     
-    unsigned long connectStart = millis();
-    if (wifiManager.autoConnect(WIFIMANAGER_AP_SSID, apPassword)) {
-        // Connected to WiFi successfully
-        unsigned long connectDuration = millis() - connectStart;
-        wifiConnected = true;
-        
-        Serial.println("\n========================================");
-        Serial.println("     WIFI CONNECTION SUCCESSFUL");
-        Serial.println("========================================");
-        Serial.print("[WIFI] IP Address: ");
+    // The SDK would retry at once, forever; linkSupervisor paces reconnects instead
+    stationIp = WiFi.localIP();
+    WiFi.setAutoReconnect(false);
+    linkSupervisor.begin();
+    
+    // Solid LED to indicate connected (active LOW)
+    digitalWrite(STATUS_LED_PIN, LOW);
+    
+    startNetworkServices();
+}
+
+bool startMdns() {
+    char hostname[sizeof(customDeviceName)];
+    size_t hostnameLength = 0;
+    for (; customDeviceName[hostnameLength] != '\0' && hostnameLength < sizeof(hostname) - 1; hostnameLength++) {
+        const char c = customDeviceName[hostnameLength];
+        hostname[hostnameLength] = (c == ' ') ? '-' : static_cast<char>(tolower(c));
+    }
+    hostname[hostnameLength] = '\0';
+    mdnsStarted = MDNS.begin(hostname);
+    if (mdnsStarted) {
+        Serial.print(F("[MDNS] mDNS responder started: "));
+        Serial.print(hostname);
+        Serial.println(F(".local"));
+        MDNS.addService("http", "tcp", 80);
+        Serial.println(F("[MDNS] HTTP service added"));
+    } else {
+        Serial.println(F("[ERROR] mDNS failed to start"));
+    }
+    return mdnsStarted;
+}
+
+// Station link supervision once bring-up has connected, every loop() pass
+void superviseWiFiLink() {
+    if (wifiBringup.state() != WifiBringupState::Connected) return;
+    
+    const unsigned long now = millis();
+    switch (linkSupervisor.update(now, WiFi.status() == WL_CONNECTED, ESP.random())) {
+        case LinkAction::Lost:
+            wifiConnected = false;
+            Serial.println(F("[WIFI] Station link lost - reconnecting in the background"));
+            break;
+        case LinkAction::Reconnect:
+            LOG_PRINTF("[WIFI] Reconnect attempt %u\n", static_cast<unsigned>(linkSupervisor.failures() + 1));
+            WiFi.begin(); // Saved credentials
+            break;
+        case LinkAction::EndAttempt:
+            // Not WiFi.disconnect(): that also clears the saved credentials
+            wifi_station_disconnect();
+            LOG_PRINTF("[WIFI] Reconnect attempt failed, next in %u ms\n",
+                       static_cast<unsigned>(linkSupervisor.nextAttemptInMs(now)));
+            break;
+        case LinkAction::Restored:
+            onLinkRestored();
+            break;
+        default:
+            break;
+    }
+}
+
+// Servers keep their routes, subscriptions and counters across an outage;
+// only sockets opened on an address the station no longer has are dropped
+void onLinkRestored() {
+    wifiConnected = true;
+    const LinkMetrics& link = linkSupervisor.metrics();
+    LOG_PRINTF("[WIFI] Station link restored after %u ms (attempt took %u ms)\n",
+               static_cast<unsigned>(link.lastOutageMs), static_cast<unsigned>(link.lastReconnectMs));
+    
+    const uint32_t ip = WiFi.localIP();
+    if (ip != stationIp) {
+        stationIp = ip;
+        Serial.print(F("[WIFI] New IP Address: "));
         Serial.println(WiFi.localIP());
-        Serial.print("[WIFI] SSID: ");
-        Serial.println(WiFi.SSID());
-        Serial.print("[WIFI] Signal Strength: ");
-        Serial.print(WiFi.RSSI());
-        Serial.println(" dBm");
-        Serial.print("[WIFI] MAC Address: ");
-        Serial.println(WiFi.macAddress());
-        Serial.print("[WIFI] Connection Time: ");
-        Serial.print(connectDuration);
-        Serial.println("ms");
-        Serial.println("========================================\n");
-        
-        // Get custom parameters
-        strncpy(customDeviceName, custom_device_name.getValue(), 40);
-        saveCustomParameters();
-        
-        // Start mDNS service
-        String hostname = String(customDeviceName);
-        hostname.toLowerCase();
-        hostname.replace(" ", "-");
-        if (MDNS.begin(hostname.c_str())) {
-            Serial.print("[MDNS] mDNS responder started: ");
-            Serial.print(hostname);
-            Serial.println(".local");
-            MDNS.addService("http", "tcp", 80);
-            Serial.println("[MDNS] HTTP service added");
-        } else {
-            Serial.println("[ERROR] mDNS failed to start");
-        }
-        
-        // Solid LED to indicate connected (active LOW)
-        digitalWrite(STATUS_LED_PIN, LOW);
+        const uint8_t closed = server ? server->closeAll() : 0;
+        if (ws) ws->disconnect();
+        LOG_PRINTF("[WEB] Closed %u stale HTTP connections and the WebSocket clients\n", closed);
+    }
+    
+    if (mdnsStarted) {
+        MDNS.notifyAPChange(); // Re-announce on the restored link
     } else {
-        // Failed to connect - fallback to AP mode
-        Serial.println("[ERROR] Failed to connect - starting fallback AP mode");
-        wifiConnected = false;
-        initializeWiFi();
+        startMdns();
     }
+    startNetworkServices();
+}
+
+// HTTP and WebSocket servers, once there is a network (station or fallback AP)
+void startNetworkServices() {
+    if (server) return;
+    
+    LOG_PRINTF("[INIT] Starting web server on port %d...\n", HTTP_PORT);
+    server = new HttpServer(HTTP_PORT);
+    server->setAdmissionController(&admission);
+    initializeWebServer();
+    Serial.println(F("[WEB] Web server initialized successfully"));
+    
+    LOG_PRINTF("[INIT] Starting WebSocket server on port %d...\n", WS_PORT);
+    ws = new StatusWebSocketsServer(WS_PORT);
+    ws->begin();
+    ws->onEvent(wsEvent);
+    LOG_PRINTF("[WS] WebSocket server started on port %d (max %d clients)\n", WS_PORT, WS_MAX_CLIENTS);
+    LOG_PRINTF("[INFO] Free Heap: %u bytes\n", ESP.getFreeHeap());
 }
 
 void checkConfigPortalTrigger() {
@@ -578,37 +1820,37 @@ void checkConfigPortalTrigger() {
         if (portalButtonPressTime == 0) {
             portalButtonPressTime = millis();
             warningShown = false;
-            Serial.println("[PORTAL] Config button pressed (hold for 3s to trigger)");
+            Serial.println(F("[PORTAL] Config button pressed (hold for 3s to trigger)"));
         } else {
             unsigned long holdDuration = millis() - portalButtonPressTime;
             
             // Warning at 2.5 seconds - only show once
             if (holdDuration > 2500 && !warningShown && !portalRunning) {
-                Serial.println("[PORTAL] Warning: Portal trigger in 0.5s...");
+                Serial.println(F("[PORTAL] Warning: Portal trigger in 0.5s..."));
                 warningShown = true;
             }
             
             if (holdDuration > PORTAL_TRIGGER_DURATION && !portalRunning) {
-                Serial.println("[PORTAL] Portal trigger detected! Resetting WiFi and restarting...");
-                Serial.print("[PORTAL] Free heap before reset: ");
+                Serial.println(F("[PORTAL] Portal trigger detected! Resetting WiFi and restarting..."));
+                Serial.print(F("[PORTAL] Free heap before reset: "));
                 Serial.print(ESP.getFreeHeap());
-                Serial.println(" bytes");
+                Serial.println(F(" bytes"));
                 portalRunning = true;
                 
                 // Blink LED rapidly (active LOW)
-                Serial.println("[PORTAL] Blinking status LED (confirmation)");
+                Serial.println(F("[PORTAL] Blinking status LED (confirmation)"));
                 for (int i = 0; i < 20; i++) {
                     digitalWrite(STATUS_LED_PIN, !digitalRead(STATUS_LED_PIN));
                     delay(50);
                 }
                 
                 // Clear WiFi settings (ESP8266 stores WiFi creds in flash)
-                Serial.println("[PORTAL] Disconnecting WiFi and clearing saved networks...");
+                Serial.println(F("[PORTAL] Disconnecting WiFi and clearing saved networks..."));
                 WiFi.disconnect(true); // true = also erase stored credentials
                 delay(1000);
                 
                 // Restart to trigger portal
-                Serial.println("[PORTAL] Restarting ESP8266 in 1s...");
+                Serial.println(F("[PORTAL] Restarting ESP8266 in 1s..."));
                 Serial.flush();
                 delay(1000);
                 ESP.restart();
@@ -617,9 +1859,9 @@ void checkConfigPortalTrigger() {
     } else {
         if (portalButtonPressTime > 0) {
             unsigned long pressDuration = millis() - portalButtonPressTime;
-            Serial.print("[PORTAL] Config button released after ");
+            Serial.print(F("[PORTAL] Config button released after "));
             Serial.print(pressDuration);
-            Serial.println("ms (trigger requires 3000ms)");
+            Serial.println(F("ms (trigger requires 3000ms)"));
         }
         portalButtonPressTime = 0;
         portalRunning = false;
@@ -628,283 +1870,281 @@ void checkConfigPortalTrigger() {
 }
 
 void saveCustomParameters() {
-    Serial.println("[EEPROM] Saving custom parameters...");
-    
-    // Read current EEPROM data
-    EEPROM.get(0, eepromData);
+    Serial.println(F("[EEPROM] Saving custom parameters..."));
     
     // Update device name
-    strncpy(eepromData.deviceName, customDeviceName, 39);
-    eepromData.deviceName[39] = '\0';
-    
-    // Write back to EEPROM
-    EEPROM.put(0, eepromData);
+    customDeviceName[39] = '\0';
+    EEPROM.put(EEPROM_AT(deviceName), customDeviceName);
     EEPROM.commit();
     
-    Serial.print("[EEPROM] Custom parameters saved: Device Name = '");
+    Serial.print(F("[EEPROM] Custom parameters saved: Device Name = '"));
     Serial.print(customDeviceName);
-    Serial.println("'");
+    Serial.println(F("'"));
 }
 
 void saveChasingGroups() {
-    Serial.println("[EEPROM] Saving chasing groups...");
-    
-    // Read current EEPROM data
-    EEPROM.get(0, eepromData);
+    Serial.println(F("[EEPROM] Saving chasing groups..."));
     
     // Update chasing groups
-    eepromData.chasingGroupCount = 0;
+    uint8_t savedCount = 0;
     for (int i = 0; i < MAX_CHASING_GROUPS; i++) {
+        EEPROMChasingGroup record;
+        EEPROM.get(EEPROM_AT_INDEX(chasingGroups, i), record);
         if (chasingGroups[i].active) {
-            eepromData.chasingGroups[i].groupId = chasingGroups[i].groupId;
-            eepromData.chasingGroups[i].active = true;
-            strncpy(eepromData.chasingGroups[i].name, chasingGroups[i].name, MAX_NAME_LENGTH);
-            eepromData.chasingGroups[i].name[MAX_NAME_LENGTH] = '\0';
-            eepromData.chasingGroups[i].outputCount = chasingGroups[i].outputCount;
-            eepromData.chasingGroups[i].interval = chasingGroups[i].interval;
+            record.groupId = chasingGroups[i].groupId;
+            record.active = true;
+            strncpy(record.name, chasingGroups[i].name, MAX_NAME_LENGTH);
+            record.name[MAX_NAME_LENGTH] = '\0';
+            record.outputCount = chasingGroups[i].outputCount;
+            record.interval = chasingGroups[i].interval;
             for (int j = 0; j < chasingGroups[i].outputCount; j++) {
-                eepromData.chasingGroups[i].outputIndices[j] = chasingGroups[i].outputIndices[j];
+                record.outputIndices[j] = chasingGroups[i].outputIndices[j];
             }
-            eepromData.chasingGroupCount++;
+            savedCount++;
         } else {
-            eepromData.chasingGroups[i].active = false;
+            record.active = false;
         }
+        EEPROM.put(EEPROM_AT_INDEX(chasingGroups, i), record);
     }
+    EEPROM.put(EEPROM_AT(chasingGroupCount), savedCount);
     
     // Write back to EEPROM
-    EEPROM.put(0, eepromData);
     EEPROM.commit();
     
-    Serial.print("[EEPROM] Saved ");
-    Serial.print(eepromData.chasingGroupCount);
-    Serial.println(" chasing groups");
+    Serial.print(F("[EEPROM] Saved "));
+    Serial.print(savedCount);
+    Serial.println(F(" chasing groups"));
 }
 
 void loadChasingGroups() {
-    Serial.println("[EEPROM] Loading chasing groups...");
-    
-    // Read EEPROM data
-    EEPROM.get(0, eepromData);
+    Serial.println(F("[EEPROM] Loading chasing groups..."));
     
     int loadedGroups = 0;
     
     for (int i = 0; i < MAX_CHASING_GROUPS; i++) {
-        if (eepromData.chasingGroups[i].active && eepromData.chasingGroups[i].outputCount > 0) {
-            chasingGroups[i].groupId = eepromData.chasingGroups[i].groupId;
+        EEPROMChasingGroup record;
+        EEPROM.get(EEPROM_AT_INDEX(chasingGroups, i), record);
+        if (warmRestored) {
+            // Definition and step came from the RTC snapshot; only the name lives here
+            if (chasingGroups[i].active && record.active && record.groupId == chasingGroups[i].groupId) {
+                strncpy(chasingGroups[i].name, record.name, MAX_NAME_LENGTH);
+                chasingGroups[i].name[MAX_NAME_LENGTH] = '\0';
+                loadedGroups++;
+            }
+            continue;
+        }
+        if (record.active && record.outputCount > 0 && record.outputCount <= MAX_OUTPUTS_PER_CHASING_GROUP) {
+            chasingGroups[i].groupId = record.groupId;
             chasingGroups[i].active = true;
-            strncpy(chasingGroups[i].name, eepromData.chasingGroups[i].name, MAX_NAME_LENGTH);
+            strncpy(chasingGroups[i].name, record.name, MAX_NAME_LENGTH);
             chasingGroups[i].name[MAX_NAME_LENGTH] = '\0';
-            chasingGroups[i].outputCount = eepromData.chasingGroups[i].outputCount;
-            chasingGroups[i].interval = eepromData.chasingGroups[i].interval;
+            chasingGroups[i].outputCount = record.outputCount;
+            chasingGroups[i].interval = record.interval;
             chasingGroups[i].currentStep = 0;
             chasingGroups[i].lastStepTime = millis();
             
             for (int j = 0; j < chasingGroups[i].outputCount; j++) {
-                uint8_t idx = eepromData.chasingGroups[i].outputIndices[j];
+                uint8_t idx = record.outputIndices[j];
                 chasingGroups[i].outputIndices[j] = idx;
                 if (idx < MAX_OUTPUTS) {
-                    outputChasingGroup[idx] = chasingGroups[i].groupId;
+                    outputTable.group[idx] = chasingGroups[i].groupId;
                 }
             }
             
             loadedGroups++;
             
-            Serial.print("[CHASING] Loaded group ");
+            Serial.print(F("[CHASING] Loaded group "));
             Serial.print(chasingGroups[i].groupId);
-            Serial.print(" '");
+            Serial.print(F(" '"));
             Serial.print(chasingGroups[i].name);
-            Serial.print("' with ");
+            Serial.print(F("' with "));
             Serial.print(chasingGroups[i].outputCount);
-            Serial.print(" outputs, interval: ");
+            Serial.print(F(" outputs, interval: "));
             Serial.print(chasingGroups[i].interval);
-            Serial.println("ms");
+            Serial.println(F("ms"));
         } else {
             chasingGroups[i].active = false;
             chasingGroups[i].outputCount = 0;
         }
     }
     
-    Serial.print("[EEPROM] Loaded ");
-    Serial.print(loadedGroups);
-    Serial.println(" chasing groups");
+    Serial.print(F("[EEPROM] Loaded "));
+    Serial.print(loadedGroups);
+    Serial.println(F(" chasing groups"));
+}
+
+// Capture the engine state into RTC memory; called after a pass that changed it.
+// Timers are stored as ages so the RTC clock can carry them across a reset.
+void saveRtcSnapshot() {
+    const uint32_t start = micros();
+    const unsigned long now = millis();
+    captureEffectSnapshot(rtcSnapshot, outputTable, chasingGroups, MAX_CHASING_GROUPS, now,
+                          system_get_rtc_time(), system_rtc_clock_cali_proc());
+    ESP.rtcUserMemoryWrite(RTC_SNAPSHOT_BLOCK, reinterpret_cast<uint32_t*>(&rtcSnapshot), sizeof(rtcSnapshot));
+    rtcSnapshotDirty = false;
+    rtcSnapshotWrites++;
+    rtcSnapshotWriteUs = micros() - start;
+}
+
+// Engine state as a flight recorder keyframe, in the RTC snapshot layout
+// (the RTC clock fields stay zero)
+void recordTraceKeyframe() {
+    const unsigned long now = millis();
+    RtcEffectSnapshot keyframe;
+    memset(&keyframe, 0, sizeof(keyframe));
+    captureEffectState(keyframe, outputTable, chasingGroups, MAX_CHASING_GROUPS, now);
+    keyframe.seal();
+    flightRecorder.record(TraceEvent::Keyframe, now, reinterpret_cast<const uint8_t*>(&keyframe), sizeof(keyframe));
+}
+
+// Warm boot: rebuild the engine state from the RTC snapshot and drive the
+// pins, with every blink and chase advanced by the time the reset took.
+// False after a power-on or without a valid snapshot.
+bool restoreRtcSnapshot() {
+    const rst_info* reset = ESP.getResetInfoPtr();
+    if (reset->reason == REASON_DEFAULT_RST || reset->reason == REASON_DEEP_SLEEP_AWAKE) return false;
+    // Group names come from EEPROM in loadChasingGroups()
+    if (!ESP.rtcUserMemoryRead(RTC_SNAPSHOT_BLOCK, reinterpret_cast<uint32_t*>(&rtcSnapshot), sizeof(rtcSnapshot)) ||
+        !restoreEffectSnapshot(rtcSnapshot, outputTable, chasingGroups, MAX_CHASING_GROUPS, millis(),
+                               system_get_rtc_time(), rtcRestoreGapMs)) {
+        memset(&rtcSnapshot, 0, sizeof(rtcSnapshot));
+        return false;
+    }
+    
+    // Same pin setup as initializeOutputs(), then the restored levels
+    analogWriteRange(255);
+    analogWriteFreq(1000);
+    for (uint8_t i = 0; i < MAX_OUTPUTS; i++) {
+        pinMode(outputTable.pins[i], OUTPUT);
+    }
+    driveEffectOutputs(outputTable, outputDriver, chasingGroups, MAX_CHASING_GROUPS);
+    rtcRestoreUs = micros();
+    return true;
+}
+
+// After /api/reset: the next boot must start from the cleared EEPROM
+void discardRtcSnapshot() {
+    rtcSnapshotEnabled = false;
+    rtcSnapshot.invalidate();
+    ESP.rtcUserMemoryWrite(RTC_SNAPSHOT_BLOCK, &rtcSnapshot.magic, sizeof(rtcSnapshot.magic));
 }
 
 void loadCustomParameters() {
-    Serial.println("[EEPROM] Loading custom parameters...");
+    Serial.println(F("[EEPROM] Loading custom parameters..."));
     
-    // Read EEPROM data
-    EEPROM.get(0, eepromData);
+    // Read straight into the name buffer (same 40-byte slot)
+    static_assert(sizeof(customDeviceName) == sizeof(EEPROMData::deviceName), "Device name slot mismatch");
+    EEPROM.get(EEPROM_AT(deviceName), customDeviceName);
+    customDeviceName[39] = '\0';
     
     // Check if data is valid (simple check - not empty)
-    if (eepromData.deviceName[0] != '\0' && eepromData.deviceName[0] != 0xFF) {
-        strncpy(customDeviceName, eepromData.deviceName, 39);
-        customDeviceName[39] = '\0';
-        Serial.print("[EEPROM] Loaded custom device name: '");
+    if (customDeviceName[0] != '\0' && static_cast<uint8_t>(customDeviceName[0]) != 0xFF) {
+        Serial.print(F("[EEPROM] Loaded custom device name: '"));
         Serial.print(customDeviceName);
-        Serial.println("'");
+        Serial.println(F("'"));
     } else {
         strncpy(customDeviceName, DEVICE_NAME, 39);
         customDeviceName[39] = '\0';
-        Serial.print("[EEPROM] No custom device name found, using default: '");
+        Serial.print(F("[EEPROM] No custom device name found, using default: '"));
         Serial.print(customDeviceName);
-        Serial.println("'");
+        Serial.println(F("'"));
     }
 }
 
-void executeOutputCommand(int pin, bool active, int brightnessPercent) {
+// Switch one output (by ID); the caller persists the batch (saveOutputStates)
+void executeOutputCommand(int outputIndex, bool active, int brightnessPercent) {
     unsigned long startTime = millis();
     
-    // Find the output index for the given pin
-    int outputIndex = findOutputIndexByPin(pin);
-    
-    if (outputIndex == -1) {
-        Serial.println("[ERROR] Invalid GPIO pin: " + String(pin));
+    if (outputIndex < 0 || outputIndex >= MAX_OUTPUTS) {
+        LOG_PRINTF("[ERROR] Invalid output: %d\n", outputIndex);
         return;
     }
+    const int pin = outputTable.pins[outputIndex];
     
     // Validate brightness range
     if (brightnessPercent < 0 || brightnessPercent > 100) {
-        Serial.println("[ERROR] Invalid brightness: " + String(brightnessPercent) + "% (must be 0-100)");
+        LOG_PRINTF("[ERROR] Invalid brightness: %d%% (must be 0-100)\n", brightnessPercent);
         brightnessPercent = constrain(brightnessPercent, 0, 100);
     }
     
-    // Update state
-    outputStates[outputIndex] = active;
-    outputBrightness[outputIndex] = map(brightnessPercent, 0, 100, 0, 255);
-    
-    // Apply the command
-    if (active) {
-        analogWrite(outputPins[outputIndex], outputBrightness[outputIndex]);
-    } else {
-        analogWrite(outputPins[outputIndex], 0);
-    }
-    
-    // Save the state to persistent storage
-    saveOutputState(outputIndex);
-    
-    // Broadcast update to all WebSocket clients
-    broadcastStatus();
+    // Update state and apply the command (published by applyOutputCommands())
+    setOutputLevel(outputTable, outputDriver, static_cast<uint8_t>(outputIndex), active,
+                   brightnessDuty(static_cast<uint8_t>(brightnessPercent)));
     
     unsigned long duration = millis() - startTime;
-    String nameStr = outputNames[outputIndex].length() > 0 ? " [" + outputNames[outputIndex] + "]" : "";
-    Serial.println("[CMD] Output " + String(outputIndex) + " (GPIO " + String(pin) + ")" + nameStr + ": " + 
-                   (active ? "ON" : "OFF") + " @ " + String(brightnessPercent) + "% (" + String(duration) + "ms)");
+    const char* name = outputTable.names[outputIndex];
+    LOG_PRINTF("[CMD] Output %d (GPIO %d)%s%s%s: %s @ %d%% (%lums)\n", outputIndex, pin,
+               name[0] ? " [" : "", name, name[0] ? "]" : "",
+               active ? "ON" : "OFF", brightnessPercent, duration);
 }
 
-void saveOutputState(int index) {
-    if (index < 0 || index >= MAX_OUTPUTS) {
-        Serial.print("[ERROR] Invalid output index for state save: ");
-        Serial.println(index);
-        return;
+// Write one output's state, duty and interval into its EEPROM slots (no commit)
+static void putOutputState(int index) {
+    EEPROM.put(EEPROM_AT_INDEX(outputStates, index), outputTable.isOn(index));
+    EEPROM.put(EEPROM_AT_INDEX(outputBrightness, index), outputTable.brightness[index]);
+    EEPROM.put(EEPROM_AT_INDEX(outputIntervals, index), outputTable.interval[index]);
+}
+
+// Persist the outputs one command changed: one EEPROM commit for all of them
+void saveOutputStates(const uint8_t* indices, uint8_t count) {
+    for (uint8_t i = 0; i < count; i++) {
+        const uint8_t index = indices[i];
+        if (index >= MAX_OUTPUTS) {
+            LOG_PRINTF("[ERROR] Invalid output index for state save: %u\n", index);
+            continue;
+        }
+        putOutputState(index);
+        LOG_PRINTF("[EEPROM] Saved state for Output %u (GPIO %u): %s @ %u PWM, Interval: %ums\n", index,
+                   outputTable.pins[index], outputTable.isOn(index) ? "ON" : "OFF",
+                   outputTable.brightness[index], outputTable.interval[index]);
     }
-    
-    // Read current EEPROM data
-    EEPROM.get(0, eepromData);
-    
-    // Update specific output
-    eepromData.outputStates[index] = outputStates[index];
-    eepromData.outputBrightness[index] = outputBrightness[index];
-    eepromData.outputIntervals[index] = outputIntervals[index];
-    
-    // Write back to EEPROM
-    EEPROM.put(0, eepromData);
     EEPROM.commit();
-    
-    Serial.print("[EEPROM] Saved state for Output ");
-    Serial.print(index);
-    Serial.print(" (GPIO ");
-    Serial.print(outputPins[index]);
-    Serial.print("): ");
-    Serial.print(outputStates[index] ? "ON" : "OFF");
-    Serial.print(" @ ");
-    Serial.print(outputBrightness[index]);
-    Serial.print(" PWM, Interval: ");
-    Serial.print(outputIntervals[index]);
-    Serial.println("ms");
-}
-
-void saveOutputName(int index, String name) {
+}
+
+void saveOutputName(int index, const char* name) {
     if (index < 0 || index >= MAX_OUTPUTS) {
-        Serial.println("[ERROR] Invalid output index for name save: " + String(index));
+        LOG_PRINTF("[ERROR] Invalid output index for name save: %d\n", index);
         return;
     }
     
-    // Read current EEPROM data
-    EEPROM.get(0, eepromData);
+    // Trim into the fixed name slot (max 20 chars + null); empty/whitespace-only clears the name
+    const size_t nameLength = copyTrimmed(outputTable.names[index], sizeof(outputTable.names[index]), name);
+    EEPROM.put(EEPROM_AT_INDEX(outputNames, index), outputTable.names[index]);
+    EEPROM.commit();
     
-    // If name is empty or whitespace-only, clear the name
-    name.trim(); // Trim modifies in place
-    if (name.length() == 0) {
-        eepromData.outputNames[index][0] = '\0';
-        outputNames[index] = "";
-        EEPROM.put(0, eepromData);
-        EEPROM.commit();
-        Serial.println("[EEPROM] Removed custom name for Output " + String(index) + " (GPIO " + String(outputPins[index]) + ") - using default");
+    if (nameLength == 0) {
+        LOG_PRINTF("[EEPROM] Removed custom name for Output %d (GPIO %d) - using default\n", index, outputTable.pins[index]);
         return;
     }
-    
-    // Copy name to EEPROM structure (max 20 chars + null)
-    strncpy(eepromData.outputNames[index], name.c_str(), MAX_NAME_LENGTH);
-    eepromData.outputNames[index][MAX_NAME_LENGTH] = '\0';
-    
-    // Write back to EEPROM
-    EEPROM.put(0, eepromData);
-    EEPROM.commit();
-    
-    outputNames[index] = name;
-    Serial.println("[EEPROM] Saved name for Output " + String(index) + " (GPIO " + String(outputPins[index]) + "): '" + name + "'");
+    LOG_PRINTF("[EEPROM] Saved name for Output %d (GPIO %d): '%s'\n", index, outputTable.pins[index], outputTable.names[index]);
 }
 
 void loadOutputStates() {
-    Serial.println("[EEPROM] Loading saved output states...");
-    
-    // Read EEPROM data
-    EEPROM.get(0, eepromData);
-    
-    // Check if data is valid (check for uninitialized EEPROM)
-    bool validData = true;
-    
-    // Check device name for 0xFF pattern (uninitialized)
-    if (eepromData.deviceName[0] == 0xFF) {
-        validData = false;
-    }
+    Serial.println(F("[EEPROM] Loading saved output states..."));
     
-    // Check brightness values
-    for (int i = 0; i < MAX_OUTPUTS; i++) {
-        if (eepromData.outputBrightness[i] > 255) {
-            validData = false;
-            break;
-        }
-    }
+    // Check device name for 0xFF pattern (uninitialized EEPROM)
+    uint8_t firstNameByte = 0;
+    EEPROM.get(EEPROM_AT(deviceName), firstNameByte);
     
     // Initialize with defaults if invalid
-    if (!validData) {
-        Serial.println("[EEPROM] No valid data found, initializing defaults");
+    if (firstNameByte == 0xFF) {
+        Serial.println(F("[EEPROM] No valid data found, initializing defaults"));
         
-        // Clear entire structure
-        memset(&eepromData, 0, sizeof(eepromData));
+        // Clear the entire layout: outputs off, no names, no blinking, no chasing groups
+        for (size_t i = 0; i < sizeof(EEPROMData); i++) {
+            EEPROM.write(i, 0);
+        }
         
         // Set defaults
+        const uint8_t defaultBrightness = 255;
         for (int i = 0; i < MAX_OUTPUTS; i++) {
-            eepromData.outputStates[i] = false;
-            eepromData.outputBrightness[i] = 255;
-            eepromData.outputNames[i][0] = '\0';
-            eepromData.outputIntervals[i] = 0;
-        }
-        
-        // Initialize chasing groups
-        eepromData.chasingGroupCount = 0;
-        for (int i = 0; i < MAX_CHASING_GROUPS; i++) {
-            eepromData.chasingGroups[i].active = false;
-            eepromData.chasingGroups[i].outputCount = 0;
+            EEPROM.put(EEPROM_AT_INDEX(outputBrightness, i), defaultBrightness);
         }
+        char defaultName[sizeof(EEPROMData::deviceName)] = DEVICE_NAME;
+        EEPROM.put(EEPROM_AT(deviceName), defaultName);
         
-        strncpy(eepromData.deviceName, DEVICE_NAME, 39);
-        eepromData.deviceName[39] = '\0';
-        
-        EEPROM.put(0, eepromData);
         EEPROM.commit();
-        Serial.println("[EEPROM] Defaults saved to EEPROM");
+        Serial.println(F("[EEPROM] Defaults saved to EEPROM"));
     }
     
     int loadedCount = 0;
@@ -912,1075 +2152,591 @@ void loadOutputStates() {
     int blinkingCount = 0;
     
     for (int i = 0; i < MAX_OUTPUTS; i++) {
-        // Load state and brightness from EEPROM
-        outputStates[i] = eepromData.outputStates[i];
-        outputBrightness[i] = eepromData.outputBrightness[i];
-        outputIntervals[i] = eepromData.outputIntervals[i];
-        
         // Load custom name - validate it's printable ASCII
-        if (eepromData.outputNames[i][0] != '\0' && 
-            eepromData.outputNames[i][0] != 0xFF &&
-            eepromData.outputNames[i][0] >= 32 && 
-            eepromData.outputNames[i][0] <= 126) {
-            // Ensure null termination
-            eepromData.outputNames[i][MAX_NAME_LENGTH] = '\0';
-            outputNames[i] = String(eepromData.outputNames[i]);
+        char* const name = outputTable.names[i];
+        EEPROM.get(EEPROM_AT_INDEX(outputNames, i), outputTable.names[i]);
+        name[MAX_NAME_LENGTH] = '\0';
+        if (name[0] >= 32 && name[0] <= 126) {
             namedCount++;
         } else {
-            outputNames[i] = "";
+            name[0] = '\0';
         }
         
+        // Warm restart: state and blink phase came from the RTC snapshot
+        if (warmRestored) continue;
+        
+        // Load state and brightness from EEPROM
+        bool on = false;
+        EEPROM.get(EEPROM_AT_INDEX(outputStates, i), on);
+        EEPROM.get(EEPROM_AT_INDEX(outputBrightness, i), outputTable.brightness[i]);
+        EEPROM.get(EEPROM_AT_INDEX(outputIntervals, i), outputTable.interval[i]);
+        outputTable.setOn(i, on);
+        
         // Apply the loaded state to the output
-        if (outputStates[i]) {
+        if (on) {
             // If blinking is enabled, start in ON state
-            if (outputIntervals[i] > 0) {
-                analogWrite(outputPins[i], outputBrightness[i]);
-                blinkState[i] = true;
-                lastBlinkTime[i] = millis();
+            outputDriver.write(i, outputTable.brightness[i]);
+            outputTable.setLit(i, true);
+            if (outputTable.interval[i] > 0) {
+                outputTable.lastToggleMs[i] = millis();
                 blinkingCount++;
-            } else {
-                analogWrite(outputPins[i], outputBrightness[i]);
             }
-            int brightPercent = map(outputBrightness[i], 0, 255, 0, 100);
-            Serial.print("[EEPROM] Output " + String(i) + " (GPIO " + String(outputPins[i]) + "): ON @ " + String(brightPercent) + "%");
-            if (outputIntervals[i] > 0) {
-                Serial.print(" [Blink: " + String(outputIntervals[i]) + "ms]");
+            int brightPercent = map(outputTable.brightness[i], 0, 255, 0, 100);
+            LOG_PRINTF("[EEPROM] Output %d (GPIO %d): ON @ %d%%", i, outputTable.pins[i], brightPercent);
+            if (outputTable.interval[i] > 0) {
+                LOG_PRINTF(" [Blink: %ums]", outputTable.interval[i]);
             }
-            if (outputNames[i].length() > 0) {
-                Serial.println(" [Name: " + outputNames[i] + "]");
+            if (name[0] != '\0') {
+                LOG_PRINTF(" [Name: %s]\n", name);
             } else {
-                Serial.println("");
+                Serial.println(F(""));
             }
             loadedCount++;
         } else {
-            analogWrite(outputPins[i], 0);
-            blinkState[i] = false;
+            outputDriver.write(i, 0);
+            outputTable.setLit(i, false);
         }
     }
     
-    Serial.println("[EEPROM] Loaded " + String(loadedCount) + " active outputs, " + String(namedCount) + " custom names, " + String(blinkingCount) + " blinking");
+    if (warmRestored) {
+        LOG_PRINTF("[EEPROM] Loaded %d custom names (output state kept from the RTC snapshot)\n", namedCount);
+    } else {
+        LOG_PRINTF("[EEPROM] Loaded %d active outputs, %d custom names, %d blinking\n", loadedCount, namedCount, blinkingCount);
+    }
 }
 
 void saveAllOutputStates() {
     unsigned long startTime = millis();
-    Serial.println("[EEPROM] Saving all output states (batch operation)...");
+    Serial.println(F("[EEPROM] Saving all output states (batch operation)..."));
     
-    // Read current EEPROM data
-    EEPROM.get(0, eepromData);
-    
-    // Update all output states and brightness
+    // Update all output states and brightness, one commit
     for (int i = 0; i < MAX_OUTPUTS; i++) {
-        eepromData.outputStates[i] = outputStates[i];
-        eepromData.outputBrightness[i] = outputBrightness[i];
-        eepromData.outputIntervals[i] = outputIntervals[i];
+        putOutputState(i);
     }
-    
-    // Write back to EEPROM
-    EEPROM.put(0, eepromData);
     EEPROM.commit();
     
     unsigned long duration = millis() - startTime;
-    Serial.print("[EEPROM] Batch save complete: ");
+    Serial.print(F("[EEPROM] Batch save complete: "));
     Serial.print(MAX_OUTPUTS);
-    Serial.print(" outputs saved (");
+    Serial.print(F(" outputs saved ("));
     Serial.print(duration);
-    Serial.println("ms)");
+    Serial.println(F("ms)"));
 }
 
-void updateChasingLightGroups() {
-    unsigned long currentMillis = millis();
-    
-    for (int g = 0; g < MAX_CHASING_GROUPS; g++) {
-        ChasingGroup* group = &chasingGroups[g];
-        
-        if (!group->active || group->outputCount == 0) continue;
-        
-        // Check if it's time to step to next output
-        if (currentMillis - group->lastStepTime >= group->interval) {
-            // Turn off current output
-            uint8_t currentIdx = group->outputIndices[group->currentStep];
-            if (currentIdx < MAX_OUTPUTS) {
-                analogWrite(outputPins[currentIdx], 0);
-                Serial.print("[CHASING] Group ");
-                Serial.print(group->groupId);
-                Serial.print(" OFF: idx=");
-                Serial.print(currentIdx);
-                Serial.print(" GPIO=");
-                Serial.println(outputPins[currentIdx]);
+// Apply one queued command (consumer side of outputCommands). Returns the
+// part of the status it changed.
+StatusChange applyOutputCommand(const OutputCommand& command) {
+    rtcSnapshotDirty = true;
+    StatusChange change = StatusChange::none();
+    switch (command.type) {
+        case OutputCommandType::SetOutput:
+            for (uint8_t i = 0; i < command.outputCount; i++) {
+                executeOutputCommand(command.outputs[i], command.active, command.brightness);
+                change.add(StatusChange::output(command.outputs[i]));
             }
-            
-            // Move to next step
-            group->currentStep = (group->currentStep + 1) % group->outputCount;
-            group->lastStepTime = currentMillis;
-            
-            // Turn on next output (always, regardless of state)
-            uint8_t nextIdx = group->outputIndices[group->currentStep];
-            if (nextIdx < MAX_OUTPUTS) {
-                analogWrite(outputPins[nextIdx], outputBrightness[nextIdx]);
-                Serial.print("[CHASING] Group ");
-                Serial.print(group->groupId);
-                Serial.print(" ON: idx=");
-                Serial.print(nextIdx);
-                Serial.print(" GPIO=");
-                Serial.println(outputPins[nextIdx]);
+            saveOutputStates(command.outputs, command.outputCount);
+            break;
+        case OutputCommandType::SetInterval:
+            for (uint8_t i = 0; i < command.outputCount; i++) {
+                const uint8_t index = command.outputs[i];
+                setOutputInterval(index, command.interval);
+                LOG_PRINTF("[CMD] Output %d (GPIO %d) interval %ums\n", index, outputTable.pins[index], command.interval);
+                change.add(StatusChange::output(index));
             }
-        }
-    }
-}
-
-void updateBlinkingOutputs() {
-    unsigned long currentMillis = millis();
-    
-    for (int i = 0; i < MAX_OUTPUTS; i++) {
-        // Skip if output is part of a chasing group
-        if (outputChasingGroup[i] >= 0) continue;
-        
-        // Only process if output is active and has a blink interval set
-        if (outputStates[i] && outputIntervals[i] > 0) {
-            // Check if it's time to toggle
-            if (currentMillis - lastBlinkTime[i] >= outputIntervals[i]) {
-                lastBlinkTime[i] = currentMillis;
-                blinkState[i] = !blinkState[i];
-                
-                // Toggle the output
-                if (blinkState[i]) {
-                    analogWrite(outputPins[i], outputBrightness[i]);
-                } else {
-                    analogWrite(outputPins[i], 0);
+            saveOutputStates(command.outputs, command.outputCount);
+            break;
+        case OutputCommandType::CreateGroup:
+            createChasingGroup(command.target, command.outputs, command.outputCount, command.interval,
+                               command.name[0] ? command.name : nullptr);
+            change = StatusChange::groupMembership();
+            break;
+        case OutputCommandType::DeleteGroup:
+            deleteChasingGroup(command.target);
+            change = StatusChange::groupMembership();
+            break;
+        case OutputCommandType::RenameGroup:
+            for (int i = 0; i < MAX_CHASING_GROUPS; i++) {
+                if (chasingGroups[i].active && chasingGroups[i].groupId == command.target) {
+                    setChasingGroupName(chasingGroups[i], command.target, command.name);
+                    saveChasingGroups();
+                    LOG_PRINTF("[CHASING] Updated group %d name to '%s'\n", command.target, chasingGroups[i].name);
+                    return StatusChange::groups();
                 }
             }
-        } else if (outputStates[i] && outputIntervals[i] == 0) {
-            // No blinking - ensure output is solid on
-            if (!blinkState[i]) {
-                analogWrite(outputPins[i], outputBrightness[i]);
-                blinkState[i] = true;
-            }
-        }
+            LOG_PRINTF("[CHASING] Rename skipped, group %d no longer exists\n", command.target);
+            break;
+        case OutputCommandType::RenameOutput:
+            saveOutputName(command.target, command.name);
+            LOG_PRINTF("[CMD] Output %d (GPIO %d) renamed to '%s'\n", command.target, outputTable.pins[command.target],
+                       command.name);
+            return StatusChange::output(command.target);
     }
+    return change;
 }
 
-// Helper function to set group name safely
-static void setGroupName(ChasingGroup* group, uint8_t groupId, const char* groupName) {
-    if (groupName != nullptr && strlen(groupName) > 0) {
-        strncpy(group->name, groupName, MAX_NAME_LENGTH);
-        group->name[MAX_NAME_LENGTH] = '\0';
-    } else {
-        snprintf(group->name, MAX_NAME_LENGTH + 1, "Group %d", groupId);
-    }
+// Tick boundary: everything posted since the last tick takes effect together
+// and is published as one status version, once the whole batch is applied
+void applyOutputCommands() {
+    StatusChange changes = StatusChange::none();
+    outputCommands.drain([&changes](const OutputCommand& command) {
+        changes.add(applyOutputCommand(command));
+    });
+    if (!changes.empty()) markStatusChanged(changes);
 }
 
-// Helper function to find available group slot
-static int findGroupSlot(uint8_t groupId) {
-    // First, try to find existing group with same ID
-    for (int i = 0; i < MAX_CHASING_GROUPS; i++) {
-        if (chasingGroups[i].active && chasingGroups[i].groupId == groupId) {
-            return i;
-        }
+// Serial trace of every chase step
+static void logChasingStep(const ChasingGroup& group, uint8_t index, bool lit) {
+    Serial.print(F("[CHASING] Group "));
+    Serial.print(group.groupId);
+    Serial.print(lit ? F(" ON: idx=") : F(" OFF: idx="));
+    Serial.print(index);
+    Serial.print(F(" GPIO="));
+    Serial.println(outputTable.pins[index]);
+}
+
+void updateChasingLightGroups() {
+    if (stepChasingGroups(outputTable, outputDriver, chasingGroups, MAX_CHASING_GROUPS, millis(), logChasingStep)) {
+        rtcSnapshotDirty = true;
     }
-    
-    // If not found, find first inactive slot
-    for (int i = 0; i < MAX_CHASING_GROUPS; i++) {
-        if (!chasingGroups[i].active) {
-            return i;
-        }
+}
+
+void updateBlinkingOutputs() {
+    if (stepBlinkingOutputs(outputTable, outputDriver, millis())) {
+        rtcSnapshotDirty = true;
     }
-    
-    return -1; // No slot available
 }
 
 void createChasingGroup(uint8_t groupId, const uint8_t* outputIndices, uint8_t count, unsigned int intervalMs, const char* groupName) {
-    // Validate groupId (0 is invalid, max 255)
-    if (groupId == 0 || groupId > 255) {
-        Serial.print("[ERROR] Invalid groupId: ");
+    // Validate groupId (0 is invalid; the command table range-checks it to 1-255 before it is narrowed)
+    if (groupId == 0) {
+        Serial.print(F("[ERROR] Invalid groupId: "));
         Serial.print(groupId);
-        Serial.println(" (must be 1-255)");
+        Serial.println(F(" (must be 1-255)"));
         return;
     }
     
     // Validate output count
     if (count == 0) {
-        Serial.println("[ERROR] Cannot create group with 0 outputs");
+        Serial.println(F("[ERROR] Cannot create group with 0 outputs"));
         return;
     }
     if (count > MAX_OUTPUTS_PER_CHASING_GROUP) {
-        Serial.print("[ERROR] Too many outputs: ");
+        Serial.print(F("[ERROR] Too many outputs: "));
         Serial.print(count);
-        Serial.print(" (maximum: ");
+        Serial.print(F(" (maximum: "));
         Serial.print(MAX_OUTPUTS_PER_CHASING_GROUP);
-        Serial.println(")");
+        Serial.println(F(")"));
         return;
     }
     
     // Validate all output indices before proceeding
     for (uint8_t i = 0; i < count; i++) {
         if (outputIndices[i] >= MAX_OUTPUTS) {
-            Serial.print("[ERROR] Invalid output index at position ");
+            Serial.print(F("[ERROR] Invalid output index at position "));
             Serial.print(i);
-            Serial.print(": ");
+            Serial.print(F(": "));
             Serial.print(outputIndices[i]);
-            Serial.print(" (maximum: ");
+            Serial.print(F(" (maximum: "));
             Serial.print(MAX_OUTPUTS - 1);
-            Serial.println(")");
+            Serial.println(F(")"));
             return;
         }
     }
     
     // Validate interval
     if (intervalMs < MIN_CHASING_INTERVAL_MS) {
-        Serial.print("[ERROR] Interval too small: ");
+        Serial.print(F("[ERROR] Interval too small: "));
         Serial.print(intervalMs);
-        Serial.print("ms (minimum: ");
+        Serial.print(F("ms (minimum: "));
         Serial.print(MIN_CHASING_INTERVAL_MS);
-        Serial.println("ms)");
+        Serial.println(F("ms)"));
         return;
     }
     
     // Find available slot
-    const int groupSlot = findGroupSlot(groupId);
+    const int groupSlot = findChasingGroupSlot(chasingGroups, MAX_CHASING_GROUPS, groupId);
     if (groupSlot < 0 || groupSlot >= MAX_CHASING_GROUPS) {
-        Serial.println("[ERROR] No available chasing group slots");
+        Serial.println(F("[ERROR] No available chasing group slots"));
         return;
     }
     
     ChasingGroup* const group = &chasingGroups[groupSlot];
     
-    // Clear old group memberships for these outputs (before setting new ones)
-    for (uint8_t i = 0; i < count; i++) {
-        const uint8_t idx = outputIndices[i];
-        outputChasingGroup[idx] = -1;
-    }
-    
-    // Setup group structure
-    group->groupId = groupId;
-    group->active = true;
-    setGroupName(group, groupId, groupName);
-    group->outputCount = count;
-    group->interval = intervalMs;
-    group->currentStep = 0;
-    group->lastStepTime = millis();
-    
-    // Copy output indices and set group membership in single loop
-    for (uint8_t i = 0; i < count; i++) {
-        const uint8_t idx = outputIndices[i];
-        group->outputIndices[i] = idx;
-        outputChasingGroup[idx] = groupId;
-        outputStates[idx] = true; // Mark outputs as active
-    }
-    
-    // Initialize outputs: first on, rest off (combined loop)
-    for (uint8_t i = 0; i < count; i++) {
-        const uint8_t idx = outputIndices[i];
-        if (i == 0) {
-            analogWrite(outputPins[idx], outputBrightness[idx]);
-        } else {
-            analogWrite(outputPins[idx], 0);
-        }
-    }
+    startChasingGroup(outputTable, outputDriver, *group, groupId, outputIndices, count,
+                      static_cast<uint16_t>(intervalMs), groupName, millis());
     
     // Persist to EEPROM
     saveChasingGroups();
     
     // Log success with details
-    Serial.print("[CHASING] Group ");
+    Serial.print(F("[CHASING] Group "));
     Serial.print(groupId);
-    Serial.print(" '");
+    Serial.print(F(" '"));
     Serial.print(group->name);
-    Serial.print("' created: slot=");
+    Serial.print(F("' created: slot="));
     Serial.print(groupSlot);
-    Serial.print(", outputs=");
+    Serial.print(F(", outputs="));
     Serial.print(count);
-    Serial.print(", interval=");
+    Serial.print(F(", interval="));
     Serial.print(intervalMs);
-    Serial.println("ms");
+    Serial.println(F("ms"));
 }
 
 void deleteChasingGroup(uint8_t groupId) {
     for (int i = 0; i < MAX_CHASING_GROUPS; i++) {
         if (chasingGroups[i].groupId == groupId && chasingGroups[i].active) {
-            // Free outputs from group
-            for (int j = 0; j < chasingGroups[i].outputCount; j++) {
-                uint8_t idx = chasingGroups[i].outputIndices[j];
-                if (idx < MAX_OUTPUTS) {
-                    outputChasingGroup[idx] = -1;
-                    // Turn off output
-                    analogWrite(outputPins[idx], 0);
-                    outputStates[idx] = false;
-                }
-            }
-            
-            // Clear group
-            chasingGroups[i].active = false;
-            chasingGroups[i].outputCount = 0;
-            
+            // Free the outputs, switched off, and the slot
+            stopChasingGroup(outputTable, outputDriver, chasingGroups[i]);
             saveChasingGroups();
             
-            Serial.print("[CHASING] Group ");
+            Serial.print(F("[CHASING] Group "));
             Serial.print(groupId);
-            Serial.println(" deleted");
+            Serial.println(F(" deleted"));
             return;
         }
     }
     
-    Serial.print("[ERROR] Chasing group ");
+    Serial.print(F("[ERROR] Chasing group "));
     Serial.print(groupId);
-    Serial.println(" not found");
+    Serial.println(F(" not found"));
 }
 
 void setOutputInterval(int index, unsigned int intervalMs) {
     if (index < 0 || index >= MAX_OUTPUTS) {
-        Serial.println("[ERROR] Invalid output index for interval: " + String(index));
+        LOG_PRINTF("[ERROR] Invalid output index for interval: %d\n", index);
         return;
     }
     
-    outputIntervals[index] = intervalMs;
-    
-    // Reset blink timing
-    lastBlinkTime[index] = millis();
-    blinkState[index] = true;
+    // Restart blink timing; an active output starts with ON state (blinking or solid)
+    setOutputBlink(outputTable, outputDriver, static_cast<uint8_t>(index),
+                   static_cast<uint16_t>(intervalMs > 0xFFFF ? 0xFFFF : intervalMs), millis());
     
-    // If output is active and interval is set, start with ON state
-    if (outputStates[index]) {
+    if (outputTable.isOn(index)) {
         if (intervalMs > 0) {
-            analogWrite(outputPins[index], outputBrightness[index]);
-            Serial.println("[INTERVAL] Output " + String(index) + " (GPIO " + String(outputPins[index]) + ") set to blink every " + String(intervalMs) + "ms");
+            LOG_PRINTF("[INTERVAL] Output %d (GPIO %d) set to blink every %ums\n", index, outputTable.pins[index], intervalMs);
         } else {
-            analogWrite(outputPins[index], outputBrightness[index]);
-            Serial.println("[INTERVAL] Output " + String(index) + " (GPIO " + String(outputPins[index]) + ") blinking disabled (solid)");
+            LOG_PRINTF("[INTERVAL] Output %d (GPIO %d) blinking disabled (solid)\n", index, outputTable.pins[index]);
+        }
+    }
+}
+
+// HTTP transport: POST <httpPath> with a JSON body holding the command's
+// fields. Replies are formatted into the connection's own buffer, which stays
+// untouched until the response has been sent.
+char commandReplies[HTTP_MAX_CONNECTIONS][COMMAND_REPLY_SIZE];
+
+void handleCommandRequest(const HttpRequest& request, HttpResponse& response) {
+    const unsigned long startTime = millis();
+    const IPAddress& clientIP = request.remoteIP();
+    const TextView body = request.body(); // Points into the connection buffer, no copy
+    const CommandSpec* command = commandRouter.findByPath(request.path());
+    if (command == nullptr) {
+        response.send(404, "application/json", "{\"error\":\"Unknown command\"}");
+        return;
+    }
+    LOG_PRINTF("[WEB] POST %s from %d.%d.%d.%d (%u bytes)\n", command->httpPath,
+               clientIP[0], clientIP[1], clientIP[2], clientIP[3], static_cast<unsigned>(body.length));
+    
+    CommandResult result;
+    {
+        RequestJsonScope arenaScope(requestJsonAllocator);
+        JsonDocument doc(&requestJsonAllocator);
+        // Commands without fields ignore the body, which may be empty
+        if (command->fieldCount > 0 && !deserializeJsonRequest(body.data, body.length, doc, clientIP, command->httpPath)) {
+            traceCommand(TraceSource::Http, request.connectionId(), command, CommandResult::invalid("Invalid JSON"));
+            response.send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
+            return;
         }
+        result = commandRouter.dispatch(*command, JsonCommandInput(doc.as<JsonObjectConst>()));
     }
+    traceCommand(TraceSource::Http, request.connectionId(), command, result);
     
-    // Save to EEPROM
-    saveOutputState(index);
+    char* reply = commandReplies[request.connectionId()];
+    const size_t replyLength = formatCommandReply(reply, COMMAND_REPLY_SIZE, result);
+    LOG_PRINTF("[WEB] %s -> %u %s (%lums)\n", command->name, result.httpStatus(), reply, millis() - startTime);
+    response.send(result.httpStatus(), "application/json", reply, replyLength);
+}
+
+// GET /api/outputs body: output ID -> GPIO pin. Fixed by the build, so it is
+// formatted once and served from this buffer.
+char outputDirectory[outputDirectorySize(MAX_OUTPUTS)];
+size_t outputDirectoryLength = 0;
+
+// GET /api/metrics body: heap, loop and effect timing, traffic, engine
+// queue, pin driver, boot, station link, RTC snapshot, per-task, power and
+// flight recorder counters, sampled by load and soak tests
+// (scripts/loadgen.py). Formatted per request into one buffer; a request
+// arriving while it is still being sent gets 503.
+const size_t LOAD_METRICS_SIZE = 2048; // Counters of a board up for weeks; more answers 500
+const uint8_t EFFECT_TASK_INDEX = 0; // TASKS[0]
+char loadMetricsBody[LOAD_METRICS_SIZE];
+bool loadMetricsSending = false;
+
+// Append to the metrics body at 'at'; false once it no longer fits
+bool appendLoadMetrics(char* dest, size_t size, size_t& at, PGM_P format, ...) {
+    va_list args;
+    va_start(args, format);
+    const int length = vsnprintf_P(dest + at, size - at, format, args);
+    va_end(args);
+    if (length < 0 || static_cast<size_t>(length) >= size - at) return false;
+    at += static_cast<size_t>(length);
+    return true;
+}
+
+// Length of the body, 0 if it doesn't fit 'size'
+size_t formatLoadMetrics(char* dest, size_t size) {
+    const SchedulerStats& passes = scheduler.schedulerStats();
+    const TaskStats& effects = scheduler.stats(EFFECT_TASK_INDEX);
+    const CommandMetrics& commands = commandRouter.metrics();
+    const SpscQueueMetrics queue = outputCommands.metrics();
+    const WsQueueMetrics& wsQueue = wsClientQueues.metrics();
+    const OutputDriverMetrics pins = outputDriver.metrics();
+    const LinkMetrics& link = linkSupervisor.metrics();
+    const PowerMetrics& power = powerGovernor.metrics();
+    const FlightRecorderMetrics trace = flightRecorder.metrics();
+    size_t at = 0;
+    bool fits = appendLoadMetrics(dest, size, at, PSTR(
+        "{\"uptime\":%lu,\"version\":%u,"
+        "\"heap\":{\"free\":%u,\"maxBlock\":%u,\"minFree\":%u,\"minMaxBlock\":%u,\"level\":%u},"
+        "\"loop\":{\"passes\":%u,\"maxPassUs\":%u,\"overruns\":%u},"
+        "\"effects\":{\"runs\":%u,\"maxUs\":%u,\"maxGapMs\":%u,\"deadlineMisses\":%u},"
+        "\"commands\":{\"dispatched\":%u,\"rejected\":%u,\"queueDropped\":%u},"
+        "\"websocket\":{\"clients\":%u,\"framesSent\":%u,\"coalesced\":%u,\"slowDisconnects\":%u,\"rejected\":%u}"),
+        millis(), static_cast<unsigned>(statusVersion),
+        static_cast<unsigned>(ESP.getFreeHeap()), static_cast<unsigned>(ESP.getMaxFreeBlockSize()),
+        static_cast<unsigned>(admission.metrics().minFreeHeap), static_cast<unsigned>(admission.metrics().minMaxBlock),
+        static_cast<unsigned>(admission.level()),
+        static_cast<unsigned>(passes.passes), static_cast<unsigned>(passes.maxPassUs), static_cast<unsigned>(passes.overrunPasses),
+        static_cast<unsigned>(effects.runs), static_cast<unsigned>(effects.maxUs), static_cast<unsigned>(effects.maxGapMs),
+        static_cast<unsigned>(effects.deadlineMisses),
+        static_cast<unsigned>(commands.dispatched), static_cast<unsigned>(commands.rejected), static_cast<unsigned>(queue.dropped),
+        static_cast<unsigned>(wsClientQueues.connectedCount()), static_cast<unsigned>(wsQueue.framesSent),
+        static_cast<unsigned>(wsQueue.framesCoalesced), static_cast<unsigned>(wsQueue.slowDisconnects),
+        static_cast<unsigned>(wsQueue.rejectedClients));
+    fits = fits && appendLoadMetrics(dest, size, at, PSTR(
+        ",\"engine\":{\"queued\":%u,\"highWater\":%u,\"posted\":%u,\"applied\":%u}"),
+        queue.depth, queue.highWater, static_cast<unsigned>(queue.pushed), static_cast<unsigned>(queue.popped));
+    fits = fits && appendLoadMetrics(dest, size, at, PSTR(
+        ",\"pins\":{\"gpioWrites\":%u,\"pwmWrites\":%u,\"pwmDetaches\":%u,\"pwmPins\":%u}"),
+        static_cast<unsigned>(pins.gpioWrites), static_cast<unsigned>(pins.pwmWrites),
+        static_cast<unsigned>(pins.pwmDetaches), pins.pwmPins);
+    fits = fits && appendLoadMetrics(dest, size, at, PSTR(",\"boot\":{\"firstEffectMs\":%u,\"wifi\":\"%s\",\"linkUpMs\":%u}"),
+        static_cast<unsigned>(firstEffectTickMs), WifiBringup::stateName(wifiBringup.state()),
+        static_cast<unsigned>(wifiBringup.linkUpMs()));
+    fits = fits && appendLoadMetrics(dest, size, at, PSTR(
+        ",\"link\":{\"up\":%s,\"outages\":%u,\"lastOutageMs\":%u,\"longestOutageMs\":%u,\"totalOutageMs\":%u,"
+        "\"attempts\":%u,\"lastReconnectMs\":%u}"),
+        linkSupervisor.up() ? "true" : "false", static_cast<unsigned>(link.outages),
+        static_cast<unsigned>(link.lastOutageMs), static_cast<unsigned>(link.longestOutageMs),
+        static_cast<unsigned>(link.totalOutageMs), static_cast<unsigned>(link.attempts),
+        static_cast<unsigned>(link.lastReconnectMs));
+    fits = fits && appendLoadMetrics(dest, size, at, PSTR(
+        ",\"rtc\":{\"writes\":%u,\"lastWriteUs\":%u,\"warmRestored\":%s,\"restoreUs\":%u,\"restoreGapMs\":%u}"),
+        static_cast<unsigned>(rtcSnapshotWrites), static_cast<unsigned>(rtcSnapshotWriteUs),
+        warmRestored ? "true" : "false", static_cast<unsigned>(rtcRestoreUs), static_cast<unsigned>(rtcRestoreGapMs));
+    // Per task: [runs, avg us, max us, over budget, deferred, max gap ms, deadline misses]
+    fits = fits && appendLoadMetrics(dest, size, at, PSTR(",\"tasks\":{"));
+    for (uint8_t i = 0; fits && i < scheduler.count(); i++) {
+        const TaskStats& stats = scheduler.stats(i);
+        fits = appendLoadMetrics(dest, size, at, PSTR("%s\"%s\":[%u,%u,%u,%u,%u,%u,%u]"), i ? "," : "",
+                                 scheduler.task(i).name, static_cast<unsigned>(stats.runs),
+                                 static_cast<unsigned>(stats.runs ? stats.totalUs / stats.runs : 0),
+                                 static_cast<unsigned>(stats.maxUs), static_cast<unsigned>(stats.overBudget),
+                                 static_cast<unsigned>(stats.deferrals), static_cast<unsigned>(stats.maxGapMs),
+                                 static_cast<unsigned>(stats.deadlineMisses));
+    }
+    fits = fits && appendLoadMetrics(dest, size, at, PSTR("}"));
+    fits = fits && appendLoadMetrics(dest, size, at, PSTR(
+        ",\"power\":{\"mode\":\"%s\",\"cpuMHz\":%u,\"dutyPermille\":%u,\"idles\":%u,\"activityWakes\":%u,\"boosts\":%u,"
+        "\"awakeS\":%u,\"modemSleepS\":%u,\"lightSleepS\":%u}"),
+        IdleGovernor::modeName(powerGovernor.mode()), static_cast<unsigned>(ESP.getCpuFreqMHz()),
+        powerGovernor.dutyCyclePermille(millis()), static_cast<unsigned>(power.idles),
+        static_cast<unsigned>(power.activityWakes), static_cast<unsigned>(power.boosts),
+        static_cast<unsigned>(power.modeMs[0] / 1000), static_cast<unsigned>(power.modeMs[1] / 1000),
+        static_cast<unsigned>(power.modeMs[2] / 1000));
+    fits = fits && appendLoadMetrics(dest, size, at, PSTR(
+        ",\"trace\":{\"bytes\":%u,\"capacity\":%u,\"recorded\":%u,\"evicted\":%u,\"dropped\":%u,\"keyframes\":%u}"),
+        static_cast<unsigned>(trace.bytes), static_cast<unsigned>(flightRecorder.capacity()),
+        static_cast<unsigned>(trace.recorded), static_cast<unsigned>(trace.evicted),
+        static_cast<unsigned>(trace.dropped), static_cast<unsigned>(trace.keyframes));
+    fits = fits && appendLoadMetrics(dest, size, at, PSTR("}"));
+    return fits ? at : 0;
+}
+
+void releaseLoadMetrics(void*) {
+    loadMetricsSending = false;
+}
+
+// GET /api/trace body: the trace header, then the flight recorder's ring sent
+// in place. The ring is held (new records dropped) until the response is
+// released; a second download meanwhile gets 503.
+const size_t TRACE_COMMAND_NAMES_SIZE = 128;
+uint8_t traceHeader[TRACE_HEADER_FIXED_SIZE + MAX_OUTPUTS + TRACE_COMMAND_NAMES_SIZE];
+
+void releaseTrace(void*) {
+    flightRecorder.release();
 }
 
 void initializeWebServer() {
     if (!server) return;
     
-    // Serve minimal HTML page optimized for ESP8266 low RAM - send in chunks
-    server->on("/", HTTP_GET, []() {
-        server->setContentLength(CONTENT_LENGTH_UNKNOWN);
-        server->send(200, "text/html", "");
-        
-        // Header chunk
-        server->sendContent(F("<!DOCTYPE html><html lang='en'><head><meta charset='UTF-8'><meta name='viewport' content='width=device-width,initial-scale=1.0'>"));
-        server->sendContent(F("<link rel='icon' href='data:image/svg+xml,<svg xmlns=%22http://www.w3.org/2000/svg%22 viewBox=%220 0 100 100%22><text y=%22.9em%22 font-size=%2290%22>🚂</text></svg>'>"));
-        server->sendContent(F("<title>RailHub8266</title><style>"
-        ":root{--color-bg-primary:#0a0a0a;--color-bg-secondary:#141414;--color-bg-tertiary:#1a1a1a;--color-bg-card:#1c1c1c;--color-border:#2a2a2a;--color-border-hover:#3a3a3a;"
-        "--color-text-primary:#e8e8e8;--color-text-secondary:#a0a0a0;--color-text-muted:#707070;--color-accent:#6c9bcf;--color-accent-hover:#5a8bc0;--color-success:#4a9b6f;"
-        "--color-danger:#b85c5c;--color-warning:#c9a257;--font-primary:'Segoe UI',-apple-system,BlinkMacSystemFont,'Helvetica Neue',sans-serif}"
-        "*{margin:0;padding:0;box-sizing:border-box}body{font-family:var(--font-primary);background:var(--color-bg-primary);color:var(--color-text-primary);min-height:100vh;font-size:15px;line-height:1.6;letter-spacing:0.01em}"
-        ".card{background:#2a2a2a;border:1px solid #3a3a3a;padding:15px;margin-bottom:15px;border-radius:8px}"
-        ".container{max-width:1400px;margin:0 auto;padding:30px 40px}header{text-align:left;margin-bottom:50px;padding-bottom:25px;border-bottom:1px solid var(--color-border)}.header-content{margin-bottom:20px}"
-        "h1{font-size:2rem;margin-bottom:8px;font-weight:300;letter-spacing:0.03em}header p{font-size:0.95rem;color:var(--color-text-secondary);font-weight:300}"
-        "h2{font-size:1.2rem;margin-bottom:10px}"
-        ".language-selector{display:flex;gap:8px;flex-wrap:wrap;margin-top:16px}"
-        ".status{display:grid;grid-template-columns:repeat(auto-fit,minmax(140px,1fr));gap:10px;margin-bottom:20px}.stat{background:#333;padding:12px;text-align:center;border-radius:6px}"
-        ".value{font-size:2.2rem;font-weight:300;color:var(--color-accent);margin-bottom:8px;letter-spacing:-0.02em}.label{font-size:0.85rem;color:var(--color-text-secondary);font-weight:300;text-transform:uppercase;letter-spacing:0.05em}"
-        ".section-title{font-size:0.75rem;font-weight:400;text-transform:uppercase;letter-spacing:0.08em;color:var(--color-text-muted);margin-bottom:24px}"
-        ".outputs{display:grid;grid-template-columns:repeat(auto-fit,minmax(320px,1fr));gap:16px}.output{background:var(--color-bg-card);border:1px solid var(--color-border);padding:24px;transition:all 0.2s ease;display:flex;flex-direction:column;gap:10px}"
-        ".output:hover{border-color:var(--color-border-hover)}.output.on{border-left:2px solid var(--color-success)}.output.blinking{border-left:2px solid var(--color-warning)}.output.chasing{border-left:2px solid #9b59b6}"
-        ".output-header{display:flex;justify-content:space-between;align-items:center;gap:10px;margin-bottom:20px;padding-bottom:16px;border-bottom:1px solid var(--color-border)}"
-        ".output-name{font-size:1.1rem;font-weight:400;color:var(--color-text-primary);letter-spacing:0.02em;cursor:pointer;padding:4px 8px;border-radius:4px;transition:background 0.2s;word-break:break-word;flex:1}"
-        ".output-name:hover{background:var(--color-bg-tertiary)}.output-status{padding:5px 14px;font-size:0.7rem;font-weight:400;letter-spacing:0.08em;text-transform:uppercase;border:1px solid;background:transparent}"
-        ".output-status.on{color:var(--color-success);border-color:var(--color-success)}.output-status.off{color:var(--color-text-muted);border-color:var(--color-border)}"
-        ".output-controls{display:flex;flex-direction:column;gap:12px;width:100%}.output-info{display:flex;align-items:center;justify-content:space-between;font-size:0.85rem;color:var(--color-text-secondary);margin-bottom:20px}"
-        ".toggle{position:relative;width:44px;height:22px;background:var(--color-bg-tertiary);border:1px solid var(--color-border);cursor:pointer;transition:all 0.2s ease;flex-shrink:0}"
-        ".toggle.on{background:var(--color-accent);border-color:var(--color-accent)}.toggle::before{content:'';position:absolute;top:2px;left:2px;width:16px;height:16px;background:var(--color-text-primary);transition:transform 0.2s ease}"
-        ".toggle.on::before{transform:translateX(22px)}"
-        ".brightness{display:flex;align-items:center;gap:12px}.brightness-label{font-size:0.75rem;color:var(--color-text-muted);text-transform:uppercase;letter-spacing:0.05em;min-width:80px}"
-        ".brightness input{flex:1;height:2px;border-radius:0;background:var(--color-border);outline:none;-webkit-appearance:none;min-width:0;cursor:pointer}"
-        ".brightness input::-webkit-slider-thumb{-webkit-appearance:none;width:14px;height:14px;background:var(--color-text-primary);cursor:pointer;border-radius:0}"
-        ".brightness input::-moz-range-thumb{width:14px;height:14px;background:var(--color-text-primary);cursor:pointer;border:none;border-radius:0}"
-        ".brightness span{min-width:35px;text-align:right;font-size:0.85rem;color:var(--color-text-secondary)}"
-        ".interval{display:flex;align-items:center;gap:8px;flex-wrap:wrap}.interval-label{font-size:0.75rem;color:var(--color-text-muted);text-transform:uppercase;letter-spacing:0.05em;min-width:80px}"
-        ".interval input{width:100px;padding:6px 10px;background:rgba(255,255,255,0.03);border:1px solid var(--color-border);color:var(--color-text-primary);border-radius:4px;font-size:0.85rem;transition:all 0.2s ease;text-align:center}"
-        ".interval input:focus{outline:none;border-color:var(--color-accent);background:rgba(255,255,255,0.05)}.interval span{font-size:0.75rem;color:var(--color-text-muted)}"
-        "button{padding:11px 24px;border:1px solid var(--color-border);border-radius:2px;cursor:pointer;font-size:0.85rem;font-weight:400;letter-spacing:0.05em;transition:all 0.2s ease;text-transform:uppercase;background:transparent;color:var(--color-text-primary)}"
-        "button:hover{border-color:var(--color-border-hover);background:var(--color-bg-tertiary)}button:active{transform:scale(0.98)}button.primary{background:var(--color-accent);border-color:var(--color-accent)}"
-        "button.primary:hover{background:var(--color-accent-hover);border-color:var(--color-accent-hover)}button.processing{background:var(--color-success)!important;cursor:wait;transform:scale(1)!important}"
-        "button.processing::before{content:'✓ ';font-size:1.3rem;font-weight:bold}button.state-match{background:var(--color-success)!important;color:#fff;box-shadow:0 0 0 2px rgba(255,255,255,0.15) inset}"
-        "button:disabled{opacity:0.8;cursor:wait}button.delete{background:var(--color-danger);border-color:var(--color-danger)}button.delete:hover{background:#a84c4c}"
-        ".chasing-group{background:#3a2a4a;padding:12px;margin-bottom:10px;border-left:4px solid #9b59b6;border-radius:6px}"
-        ".chasing-group h3{font-size:1rem;margin-bottom:8px;color:#bb79d6;cursor:pointer;word-break:break-word;display:flex;align-items:center;gap:8px}"
-        ".chasing-group h3:hover{color:#d699f0}.chasing-group h3::before{content:'⚡';font-size:1.1rem}"
-        ".group-info{font-size:0.85rem;color:#b8b8b8;word-break:break-word;margin-bottom:10px;line-height:1.4}.group-controls{display:flex;gap:8px;flex-wrap:wrap;margin-top:10px}"
-        ".info{font-size:0.9rem;color:#999}.control-buttons{display:flex;flex-wrap:wrap;gap:5px}.toolbar{display:flex;gap:12px;margin-bottom:30px}"
-        ".tabs{display:flex;gap:5px;margin-bottom:40px;overflow-x:auto;-webkit-overflow-scrolling:touch;border-bottom:1px solid var(--color-border)}"
-        ".tab{background:transparent;border:none;color:var(--color-text-secondary);padding:14px 32px;border-radius:0;cursor:pointer;font-size:0.9rem;font-weight:300;letter-spacing:0.02em;transition:all 0.2s ease;border-bottom:2px solid transparent;text-transform:uppercase;white-space:nowrap;touch-action:manipulation}"
-        ".tab:hover{color:var(--color-text-primary)}.tab.active{font-weight:400;color:var(--color-text-primary);border-bottom-color:var(--color-accent);background:transparent}"
-        ".tab-content{display:none}.tab-content.active{display:block}main{min-height:500px}"
-        ".storage-bar{background:#333;height:24px;border-radius:3px;overflow:hidden;margin-top:8px;position:relative}"
-        ".storage-fill{background:linear-gradient(90deg,var(--color-success),var(--color-warning));height:100%;transition:width 0.3s}"
-        ".storage-text{position:absolute;top:3px;left:0;right:0;text-align:center;font-size:0.75rem;color:#fff;text-shadow:1px 1px 2px rgba(0,0,0,0.8)}"
-        "footer{text-align:center;padding:30px 20px;margin-top:60px;border-top:1px solid var(--color-border);color:var(--color-text-muted);font-size:0.85rem;font-weight:300}"
-        "@media (max-width:768px){.container{padding:20px}header{margin-bottom:30px}header h1{font-size:1.6rem}nav{overflow-x:auto}.tab{padding:14px 24px;white-space:nowrap}.outputs{grid-template-columns:1fr}.toolbar{flex-direction:column}.toolbar button{width:100%}}"
-        ".modal{display:none;position:fixed;top:0;left:0;width:100%;height:100%;background:rgba(0,0,0,0.8);z-index:1000;align-items:center;justify-content:center;padding:20px}"
-        ".modal.show{display:flex}"
-        ".modal-content{background:#2a2a3a;padding:20px;border-radius:12px;width:100%;max-width:400px;box-shadow:0 4px 20px rgba(0,0,0,0.5)}"
-        ".modal-header{font-size:1.2rem;font-weight:bold;margin-bottom:15px;color:#6c9bcf}"
-        ".modal-input{width:100%;padding:12px;background:#555;border:1px solid #666;color:#fff;border-radius:6px;font-size:1rem;margin-bottom:15px}"
-        ".modal-input:focus{outline:none;border-color:#6c9bcf}"
-        ".modal-buttons{display:flex;gap:10px;justify-content:flex-end;flex-wrap:wrap}"
-        ".modal-buttons button{min-width:80px;flex:1}"
-        ".modal-buttons .cancel{background:#666}"
-        ".modal-buttons .cancel:hover{background:#555}"
-        ".control-buttons{display:flex;flex-wrap:wrap;gap:5px}"
-        ".form-group{margin-bottom:15px}"
-        ".form-group label{display:block;margin-bottom:5px;color:#999;font-size:0.9rem}"
-        ".form-group input[type=number],.form-group input[type=text]{width:100%;max-width:200px;padding:8px;background:#555;border:1px solid #666;color:#fff;border-radius:4px;font-size:0.95rem}"
-        ".checkbox-grid{display:grid;grid-template-columns:repeat(auto-fill,minmax(120px,1fr));gap:8px;padding:8px;background:#333;border-radius:4px}"
-        ".checkbox-label{display:flex;align-items:center;gap:10px;padding:10px 12px;background:#444;border-radius:4px;cursor:pointer;transition:background 0.2s}"
-        ".checkbox-label:hover:not(.disabled){background:#505050}"
-        ".checkbox-label input[type=checkbox]{appearance:none;-webkit-appearance:none;cursor:pointer;width:20px;height:20px;margin:0;flex-shrink:0;background:#555;border:2px solid #666;border-radius:4px;transition:all 0.2s;display:flex;align-items:center;justify-content:center}"
-        ".checkbox-label input[type=checkbox]:checked{background:#6c9bcf;border-color:#6c9bcf}"
-        ".checkbox-label input[type=checkbox]:checked::before{content:'✓';color:#fff;font-size:14px;font-weight:bold;line-height:1}"
-        ".checkbox-label input[type=checkbox]:disabled{opacity:0.4;cursor:not-allowed}"
-        ".checkbox-label.disabled{opacity:0.5;cursor:not-allowed}"
-        ".checkbox-label span{line-height:1.3;word-break:break-word;font-size:0.9rem}"
-        ".no-groups{text-align:center;padding:20px;color:#666;font-style:italic}"
-        "@media(min-width:768px){.output{flex-direction:row}.output-header{flex:0 0 auto}.output-controls{width:auto;flex:1}}"
-        "@media(max-width:480px){body{padding:10px}.card{padding:12px}h1{font-size:1.3rem}h2{font-size:1.1rem}button{padding:8px 16px;font-size:0.9rem}.toggle{width:50px;height:28px}.toggle::after{width:24px;height:24px}.toggle.on::after{left:24px}.stat{padding:10px}.value{font-size:1.3rem}}"
-        "</style></head><body>"));
-        
-        // Modal dialog for name editing
-        server->sendContent(F("<div id='nameModal' class='modal'><div class='modal-content'>"
-        "<div class='modal-header' id='modalTitle' data-i18n='edit_name'>Edit Name</div>"
-        "<input type='text' id='modalInput' class='modal-input' maxlength='20' data-i18n-placeholder='enter_name' placeholder='Enter name...'>"
-        "<div class='modal-buttons'>"
-        "<button class='cancel' onclick='closeModal()' data-i18n='btn_cancel'>Cancel</button>"
-        "<button onclick='saveModalName()' data-i18n='btn_save'>Save</button>"
-        "</div></div></div>"));
-        
-        // Confirmation modal
-        server->sendContent(F("<div id='confirmModal' class='modal'><div class='modal-content'>"
-        "<div class='modal-header' id='confirmTitle' data-i18n='confirm'>Confirm</div>"
-        "<div id='confirmMessage' style='margin-bottom:20px;color:#ccc'></div>"
-        "<div class='modal-buttons'>"
-        "<button class='cancel' onclick='closeConfirm()' data-i18n='btn_cancel'>Cancel</button>"
-        "<button class='delete' onclick='confirmYes()' data-i18n='btn_delete'>Delete</button>"
-        "</div></div></div>"));
-        
-        // Alert modal
-        server->sendContent(F("<div id='alertModal' class='modal'><div class='modal-content'>"
-        "<div class='modal-header' id='alertTitle' data-i18n='alert'>Alert</div>"
-        "<div id='alertMessage' style='margin-bottom:20px;color:#ccc'></div>"
-        "<div class='modal-buttons'>"
-        "<button onclick='closeAlert()' data-i18n='btn_ok'>OK</button>"
-        "</div></div></div>"));
-        
-        // Modern header
-        server->sendContent(F("<div class='container'><header><div class='header-content'>"
-        "<h1>🚂 RailHub8266</h1><p>"));
-        server->sendContent(String(customDeviceName));
-        server->sendContent(F("</p>"
-        "<div class='language-selector'>"
-        "<select id='langSelect' onchange='changeLang(this.value)' style='padding:8px 12px;background:var(--color-bg-tertiary);border:1px solid var(--color-border);color:var(--color-text-primary);border-radius:4px;cursor:pointer;font-size:0.85rem;text-transform:uppercase;letter-spacing:0.05em'>"
-        "<option value='en'>English</option>"
-        "<option value='de'>Deutsch</option>"
-        "<option value='fr'>Français</option>"
-        "<option value='it'>Italiano</option>"
-        "<option value='zh'>中文</option>"
-        "<option value='hi'>हिन्दी</option>"
-        "</select></div></div></header>"
-        "<nav class='tabs'>"
-        "<button class='tab active' onclick='showTab(0)' data-i18n='tab_status'>Status</button>"
-        "<button class='tab' onclick='showTab(1)' data-i18n='tab_settings'>Settings</button>"
-        "</nav><main><div class='tab-content active' id='tab0'>"
-        "<h3 class='section-title' data-i18n='tab_status'>Device Status</h3><div class='status'>"
-        "<div class='stat'><div class='value' id='uptime'>-</div><div class='label' data-i18n='uptime'>Uptime</div></div>"
-        "<div class='stat'><div class='value' id='buildDate'>-</div><div class='label' data-i18n='build_date'>Build Date</div></div>"
-        "</div><h3 class='section-title' style='margin-top:40px'>Memory & Storage</h3><div style='max-width:800px'><div style='margin-bottom:25px'><div class='label' style='margin-bottom:8px' data-i18n='ram'>RAM (80 KB)</div>"
-        "<div class='storage-bar'><div class='storage-fill' id='ramFill' style='width:0%'></div>"
-        "<div class='storage-text' id='ramText'>-</div></div></div>"
-        "<div style='margin-bottom:25px'><div class='label' style='margin-bottom:8px' data-i18n='flash'>Program Flash (1 MB)</div>"
-        "<div class='storage-bar'><div class='storage-fill' id='storageFill' style='width:0%'></div>"
-        "<div class='storage-text' id='storageText'>-</div></div></div></div>"
-        "<h3 class='section-title' style='margin-top:40px' data-i18n='controls'>Controls</h3>"
-        "<div class='toolbar'><button id='btnAllOn' onclick='allOn()' class='primary' data-i18n='btn_all_on'>All ON</button><button id='btnAllOff' onclick='allOff()' class='primary' data-i18n='btn_all_off'>All OFF</button></div>"
-        "<div class='output' style='max-width:800px;margin-bottom:30px'><div class='output-header'><div class='output-name' data-i18n='master_brightness'>Master Brightness</div><div class='output-status on'>ALL</div></div>"
-        "<div class='brightness'><span class='brightness-label' data-i18n='master_brightness'>Brightness</span>"
-        "<input type='range' min='0' max='100' value='100' id='masterBrightness' oninput='this.nextElementSibling.textContent=this.value+\"%\"' onchange='setMasterBrightness(this.value)'>"
-        "<span>100%</span></div></div></div>"
-        "<div class='tab-content' id='tab1'><h3 class='section-title' data-i18n='chasing_groups'>Chasing Light Groups</h3>"
-        "<div style='background:var(--color-bg-card);border:1px solid var(--color-border);padding:20px;border-radius:6px;margin-bottom:20px'>"
-        "<div class='form-group'><label data-i18n='group_id'>Group ID:</label>"
-        "<input type='number' id='newGroupId' min='1' max='255' value='1'></div>"
-        "<div class='form-group'><label data-i18n='interval_ms'>Interval (ms):</label>"
-        "<input type='text' id='newGroupInterval' value='500'></div>"
-        "<div class='form-group'><label data-i18n='select_outputs'>Select Outputs (min. 2):</label>"
-        "<div id='outputSelector' class='checkbox-grid'></div></div>"
-        "<button onclick='createGroup()' class='primary' data-i18n='btn_create_group'>Create Group</button>"
-        "</div><div id='chasingGroups'></div>"
-        "<h3 class='section-title' style='margin-top:30px' data-i18n='outputs'>Outputs</h3><div class='outputs' id='outputs'></div></div></div>"));
-        
-        // JavaScript chunk with i18n
-        server->sendContent(F("<script>"
-        "const i18n={en:{tab_status:'Status',tab_settings:'Settings',uptime:'Uptime',build_date:'Build Date',ram:'RAM (80 KB)',flash:'Program Flash (1 MB)',controls:'Controls',btn_all_on:'All ON',btn_all_off:'All OFF',master_brightness:'Master Brightness:',chasing_groups:'Chasing Light Groups',group_id:'Group ID:',interval_ms:'Interval (ms):',select_outputs:'Select Outputs (min. 2):',btn_create_group:'Create Group',outputs:'Outputs',edit_name:'Edit Name',enter_name:'Enter name...',btn_cancel:'Cancel',btn_save:'Save',confirm:'Confirm',btn_delete:'Delete',alert:'Alert',btn_ok:'OK',delete_confirm:'Are you sure you want to delete this chasing group?',validation_error:'Validation Error',min_2_outputs:'Please select at least 2 outputs',group_id_range:'Group ID must be 1-255',interval_min:'Interval must be at least 50ms',error:'Error',outputs_label:'Outputs:',interval_label:'Interval:',no_groups:'No active groups'},"
-        "de:{tab_status:'Status',tab_settings:'Einstellungen',uptime:'Betriebszeit',build_date:'Build-Datum',ram:'RAM (80 KB)',flash:'Programm-Flash (1 MB)',controls:'Steuerung',btn_all_on:'Alle AN',btn_all_off:'Alle AUS',master_brightness:'Master-Helligkeit:',chasing_groups:'Lauflicht-Gruppen',group_id:'Gruppen-ID:',interval_ms:'Intervall (ms):',select_outputs:'Ausgänge wählen (mind. 2):',btn_create_group:'Gruppe erstellen',outputs:'Ausgänge',edit_name:'Name bearbeiten',enter_name:'Namen eingeben...',btn_cancel:'Abbrechen',btn_save:'Speichern',confirm:'Bestätigen',btn_delete:'Löschen',alert:'Hinweis',btn_ok:'OK',delete_confirm:'Möchten Sie diese Lauflicht-Gruppe wirklich löschen?',validation_error:'Validierungsfehler',min_2_outputs:'Bitte wählen Sie mindestens 2 Ausgänge',group_id_range:'Gruppen-ID muss zwischen 1-255 liegen',interval_min:'Intervall muss mindestens 50ms betragen',error:'Fehler',outputs_label:'Ausgänge:',interval_label:'Intervall:',no_groups:'Keine aktiven Gruppen'},"
-        "fr:{tab_status:'Statut',tab_settings:'Paramètres',uptime:'Temps de fonctionnement',build_date:'Date de compilation',ram:'RAM (80 Ko)',flash:'Flash programme (1 Mo)',controls:'Contrôles',btn_all_on:'Tout ACTIVER',btn_all_off:'Tout DÉSACTIVER',master_brightness:'Luminosité principale:',chasing_groups:'Groupes de poursuite',group_id:'ID de groupe:',interval_ms:'Intervalle (ms):',select_outputs:'Sélectionner sorties (min. 2):',btn_create_group:'Créer un groupe',outputs:'Sorties',edit_name:'Modifier le nom',enter_name:'Entrer le nom...',btn_cancel:'Annuler',btn_save:'Enregistrer',confirm:'Confirmer',btn_delete:'Supprimer',alert:'Alerte',btn_ok:'OK',delete_confirm:'Voulez-vous vraiment supprimer ce groupe?',validation_error:'Erreur de validation',min_2_outputs:'Veuillez sélectionner au moins 2 sorties',group_id_range:'L\\'ID doit être entre 1-255',interval_min:'L\\'intervalle doit être d\\'au moins 50ms',error:'Erreur',outputs_label:'Sorties:',interval_label:'Intervalle:',no_groups:'Aucun groupe actif'},"
-        "it:{tab_status:'Stato',tab_settings:'Impostazioni',uptime:'Tempo di attività',build_date:'Data di compilazione',ram:'RAM (80 KB)',flash:'Flash programma (1 MB)',controls:'Controlli',btn_all_on:'Tutto ACCESO',btn_all_off:'Tutto SPENTO',master_brightness:'Luminosità principale:',chasing_groups:'Gruppi di inseguimento',group_id:'ID gruppo:',interval_ms:'Intervallo (ms):',select_outputs:'Seleziona uscite (min. 2):',btn_create_group:'Crea gruppo',outputs:'Uscite',edit_name:'Modifica nome',enter_name:'Inserisci nome...',btn_cancel:'Annulla',btn_save:'Salva',confirm:'Conferma',btn_delete:'Elimina',alert:'Avviso',btn_ok:'OK',delete_confirm:'Sei sicuro di voler eliminare questo gruppo?',validation_error:'Errore di validazione',min_2_outputs:'Seleziona almeno 2 uscite',group_id_range:'L\\'ID deve essere tra 1-255',interval_min:'L\\'intervallo deve essere almeno 50ms',error:'Errore',outputs_label:'Uscite:',interval_label:'Intervallo:',no_groups:'Nessun gruppo attivo'},"
-        "zh:{tab_status:'状态',tab_settings:'设置',uptime:'运行时间',build_date:'构建日期',ram:'内存 (80 KB)',flash:'程序闪存 (1 MB)',controls:'控制',btn_all_on:'全部开启',btn_all_off:'全部关闭',master_brightness:'主亮度:',chasing_groups:'追逐灯光组',group_id:'组ID:',interval_ms:'间隔 (毫秒):',select_outputs:'选择输出 (最少2个):',btn_create_group:'创建组',outputs:'输出',edit_name:'编辑名称',enter_name:'输入名称...',btn_cancel:'取消',btn_save:'保存',confirm:'确认',btn_delete:'删除',alert:'提示',btn_ok:'确定',delete_confirm:'确定要删除此追逐灯光组吗？',validation_error:'验证错误',min_2_outputs:'请至少选择2个输出',group_id_range:'组ID必须在1-255之间',interval_min:'间隔必须至少为50毫秒',error:'错误',outputs_label:'输出:',interval_label:'间隔:',no_groups:'没有活动组'},"
-        "hi:{tab_status:'स्थिति',tab_settings:'सेटिंग्स',uptime:'अपटाइम',build_date:'बिल्ड तिथि',ram:'RAM (80 KB)',flash:'प्रोग्राम फ्लैश (1 MB)',controls:'नियंत्रण',btn_all_on:'सभी चालू',btn_all_off:'सभी बंद',master_brightness:'मुख्य चमक:',chasing_groups:'चेज़िंग लाइट समूह',group_id:'समूह ID:',interval_ms:'अंतराल (ms):',select_outputs:'आउटपुट चुनें (न्यूनतम 2):',btn_create_group:'समूह बनाएं',outputs:'आउटपुट',edit_name:'नाम संपादित करें',enter_name:'नाम दर्ज करें...',btn_cancel:'रद्द करें',btn_save:'सहेजें',confirm:'पुष्टि करें',btn_delete:'हटाएं',alert:'चेतावनी',btn_ok:'ठीक है',delete_confirm:'क्या आप वाकई इस समूह को हटाना चाहते हैं?',validation_error:'सत्यापन त्रुटि',min_2_outputs:'कृपया कम से कम 2 आउटपुट चुनें',group_id_range:'समूह ID 1-255 के बीच होनी चाहिए',interval_min:'अंतराल कम से कम 50ms होना चाहिए',error:'त्रुटि',outputs_label:'आउटपुट:',interval_label:'अंतराल:',no_groups:'कोई सक्रिय समूह नहीं'}};"
-        "let currentLang='en';"
-        "function changeLang(lang){currentLang=lang;localStorage.setItem('lang',lang);document.querySelectorAll('[data-i18n]').forEach(el=>{const key=el.getAttribute('data-i18n');if(i18n[lang]&&i18n[lang][key])el.textContent=i18n[lang][key];});document.querySelectorAll('[data-i18n-placeholder]').forEach(el=>{const key=el.getAttribute('data-i18n-placeholder');if(i18n[lang]&&i18n[lang][key])el.placeholder=i18n[lang][key];});}"
-        "function showTab(n){localStorage.setItem('activeTab',n);document.querySelectorAll('.tab').forEach((t,i)=>t.classList.toggle('active',i===n));"
-        "document.querySelectorAll('.tab-content').forEach((c,i)=>c.classList.toggle('active',i===n));}"
-        "let wsData=null;let bulkState=null;async function load(){let d;if(wsData){d=wsData;wsData=null;}else{try{const r=await fetch('/api/status');d=await r.json();}catch(err){console.error('[LOAD] Error:',err);return;}}if(!d)return;try{const activeEl=document.activeElement;const isFocused=activeEl&&activeEl.tagName==='INPUT'&&activeEl.type==='text'&&activeEl.closest('.interval');"
-        "const focusedPin=isFocused?activeEl.closest('.output')?.querySelector('.output-name')?.getAttribute('onclick')?.match(/\\d+/)?.[0]:null;"
-        "const cursorPos=isFocused?activeEl.selectionStart:null;const focusedVal=isFocused?activeEl.value:null;"
-        "const usedRam=80-(d.freeHeap/1024);const ramPct=Math.round((usedRam/80)*100);"
-        "document.getElementById('ramFill').style.width=ramPct+'%';"
-        "document.getElementById('ramText').textContent=usedRam.toFixed(1)+'KB / 80KB ('+ramPct+'%)';"
-        "const s=Math.floor(d.uptime/1000);let uptime;if(s<60)uptime=s+'s';else if(s<3600){const m=Math.floor(s/60);const rs=s%60;uptime=m+'m '+(rs>0?rs+'s':'');}else if(s<86400){const h=Math.floor(s/3600);const m=Math.floor((s%3600)/60);uptime=h+'h '+(m>0?m+'m':'');}else{const d=Math.floor(s/86400);const h=Math.floor((s%86400)/3600);uptime=d+'d '+(h>0?h+'h':'');}document.getElementById('uptime').textContent=uptime;"
-        "if(d.buildDate)document.getElementById('buildDate').textContent=d.buildDate;"
-        "if(d.flashUsed&&d.flashPartition){const pct=Math.round((d.flashUsed/d.flashPartition)*100);"
-        "document.getElementById('storageFill').style.width=pct+'%';"
-        "document.getElementById('storageText').textContent=(d.flashUsed/1024).toFixed(0)+'KB / '+(d.flashPartition/1024).toFixed(0)+'KB ('+pct+'%)';}"
-        "const sel=document.getElementById('outputSelector');"
-        "const checked=[];document.querySelectorAll('#outputSelector input:checked').forEach(cb=>checked.push(cb.value));"
-        "sel.innerHTML='';"
-        "d.outputs.forEach(out=>{"
-        "const lbl=document.createElement('label');lbl.className='checkbox-label';"
-        "if(out.chasingGroup>=0)lbl.classList.add('disabled');"
-        "const cb=document.createElement('input');cb.type='checkbox';cb.value=out.pin;cb.id='out_'+out.pin;"
-        "cb.disabled=out.chasingGroup>=0;"
-        "if(out.chasingGroup<0&&checked.includes(out.pin.toString()))cb.checked=true;"
-        "lbl.appendChild(cb);"
-        "const outName=out.name||'GPIO '+out.pin;"
-        "const span=document.createElement('span');span.textContent=outName;span.style.fontSize='0.85rem';"
-        "lbl.appendChild(span);"
-        "sel.appendChild(lbl);});"
-        "const cg=document.getElementById('chasingGroups');cg.innerHTML='';"
-        "if(d.chasingGroups&&d.chasingGroups.length>0){"
-        "d.chasingGroups.forEach(g=>{"
-        "const div=document.createElement('div');div.className='chasing-group';"
-        "const outNames=g.outputs.map(pin=>{const o=d.outputs.find(x=>x.pin===pin);return o?(o.name||'GPIO '+pin):'GPIO '+pin;}).join(', ');"
-        "div.innerHTML=`<h3 onclick='editGName(${g.groupId},\"${g.name}\")'>${g.name}</h3>"
-        "<div class='group-info'><strong>${i18n[currentLang].outputs_label}:</strong> ${outNames}<br><strong>${i18n[currentLang].interval_label}:</strong> ${g.interval}ms</div>"
-        "<div class='group-controls'><button class='delete' onclick='deleteGroup(${g.groupId})'>${i18n[currentLang].btn_delete} Group</button></div>`;"
-        "cg.appendChild(div);});}else{cg.innerHTML='<div class=\"no-groups\">'+i18n[currentLang].no_groups+'</div>';}"
-        "const o=document.getElementById('outputs');o.innerHTML='';"
-        "d.outputs.forEach((out,i)=>{"
-        "const div=document.createElement('div');"
-        "let cls='output'+(out.active?' on':'')+(out.interval>0?' blinking':'')+(out.chasingGroup>=0?' chasing':'');"
-        "div.className=cls;"
-        "let groupTag='';"
-        "if(out.chasingGroup>=0){const grp=d.chasingGroups.find(g=>g.groupId===out.chasingGroup);groupTag=grp?' ['+grp.name+']':' [G'+out.chasingGroup+']';}"
-        "div.innerHTML=`<div class='output-header'><div class='output-name' onclick='editOName(${out.pin},\"${out.name}\")'>${out.name || 'GPIO '+out.pin}${groupTag}</div>"
-        "<div class='toggle ${out.active?'on':''}' onclick='tog(${out.pin})'></div></div>"
-        "<div class='output-controls'><div class='brightness'><span class='brightness-label' data-i18n='brightness'>Brightness</span><input type='range' min='0' max='100' value='${out.brightness}' "
-        "oninput='this.nextElementSibling.textContent=this.value+\"%\"' onchange='setBright(${out.pin},this.value)'>"
-        "<span>${out.brightness}%</span></div>"
-        "<div class='interval'><span class='interval-label' data-i18n='interval_label'>Interval:</span><input type='text' value='${out.interval}' "
-        "onchange='setInt(${out.pin},this.value)' ${out.chasingGroup>=0?'disabled':''}><span>ms</span></div></div>`;"
-        "o.appendChild(div);});"
-        "if(focusedPin){const inputs=document.querySelectorAll('.interval input[type=text]');"
-        "inputs.forEach(inp=>{const pin=inp.closest('.output')?.querySelector('.output-name')?.getAttribute('onclick')?.match(/\\d+/)?.[0];"
-        "if(pin===focusedPin){inp.focus();if(cursorPos!==null){inp.setSelectionRange(cursorPos,cursorPos);inp.value=focusedVal||inp.value;}}});}"
-        "const btnOn=document.getElementById('btnAllOn');const btnOff=document.getElementById('btnAllOff');"
-        "const everyOn=d.outputs.length>0&&d.outputs.every(out=>out.active);"
-        "const everyOff=d.outputs.length>0&&d.outputs.every(out=>!out.active);"
-        "bulkState=everyOn?'on':everyOff?'off':null;"
-        "if(btnOn)btnOn.classList.toggle('state-match',bulkState==='on');"
-        "if(btnOff)btnOff.classList.toggle('state-match',bulkState==='off');"
-        "}catch(e){console.error(e);}}"));
-        
-        server->sendContent(F("async function tog(pin){try{const r=await fetch('/api/status');const d=await r.json();"
-        "const out=d.outputs.find(o=>o.pin===pin);await fetch('/api/control',{method:'POST',headers:{'Content-Type':'application/json'},"
-        "body:JSON.stringify({pin:pin,active:!out.active,brightness:out.brightness})});load();}catch(e){console.error(e);}}"));
-        
-        server->sendContent(F("async function setBright(pin,val){try{const r=await fetch('/api/status');const d=await r.json();"
-        "const out=d.outputs.find(o=>o.pin===pin);await fetch('/api/control',{method:'POST',headers:{'Content-Type':'application/json'},"
-        "body:JSON.stringify({pin:pin,active:out.active,brightness:parseInt(val)})});}catch(e){console.error(e);}}"));
-        
-        server->sendContent(F("async function setInt(pin,val){try{await fetch('/api/interval',{method:'POST',headers:{'Content-Type':'application/json'},"
-        "body:JSON.stringify({pin:pin,interval:parseInt(val)||0})});}catch(e){console.error(e);}}"));
-        
-        server->sendContent(F("let confirmCallback=null;function openConfirm(title,message,callback){"
-        "document.getElementById('confirmTitle').textContent=title;"
-        "document.getElementById('confirmMessage').textContent=message;"
-        "confirmCallback=callback;"
-        "document.getElementById('confirmModal').classList.add('show');}"
-        "function closeConfirm(){document.getElementById('confirmModal').classList.remove('show');confirmCallback=null;}"
-        "function confirmYes(){if(confirmCallback){confirmCallback();}closeConfirm();}"
-        "document.getElementById('confirmModal').addEventListener('click',e=>{"
-        "if(e.target.id==='confirmModal'){closeConfirm();}});"));
-        
-        server->sendContent(F("function showAlert(title,message){"
-        "document.getElementById('alertTitle').textContent=title;"
-        "document.getElementById('alertMessage').textContent=message;"
-        "document.getElementById('alertModal').classList.add('show');}"
-        "function closeAlert(){document.getElementById('alertModal').classList.remove('show');}"
-        "document.getElementById('alertModal').addEventListener('click',e=>{"
-        "if(e.target.id==='alertModal'){closeAlert();}});"));
-        
-        server->sendContent(F("async function deleteGroup(gid){"
-        "openConfirm(i18n[currentLang].confirm,i18n[currentLang].delete_confirm,async()=>{"
-        "try{await fetch('/api/chasing/delete',{method:'POST',headers:{'Content-Type':'application/json'},"
-        "body:JSON.stringify({groupId:gid})});load();}catch(e){console.error(e);}});}"));
-        
-        server->sendContent(F("let modalCallback=null;function openModal(title,currentVal,callback){"
-        "document.getElementById('modalTitle').textContent=title;"
-        "const input=document.getElementById('modalInput');"
-        "input.value=currentVal||'';"
-        "input.placeholder=i18n[currentLang].enter_name;"
-        "modalCallback=callback;"
-        "document.getElementById('nameModal').classList.add('show');"
-        "setTimeout(()=>input.focus(),100);}"
-        "function closeModal(){document.getElementById('nameModal').classList.remove('show');modalCallback=null;}"
-        "function saveModalName(){const val=document.getElementById('modalInput').value.trim();"
-        "if(modalCallback){modalCallback(val);}closeModal();}"
-        "document.getElementById('modalInput').addEventListener('keydown',e=>{"
-        "if(e.key==='Enter'){saveModalName();}else if(e.key==='Escape'){closeModal();}});"
-        "document.getElementById('nameModal').addEventListener('click',e=>{"
-        "if(e.target.id==='nameModal'){closeModal();}});"));
-        
-        server->sendContent(F("async function editGName(gid,oldName){"
-        "openModal(i18n[currentLang].edit_name,oldName,async(name)=>{"
-        "if(name===oldName)return;"
-        "const finalName=name.trim()||'Group '+gid;"
-        "try{await fetch('/api/chasing/name',{method:'POST',headers:{'Content-Type':'application/json'},"
-        "body:JSON.stringify({groupId:gid,name:finalName})});load();}catch(e){showAlert(i18n[currentLang].error,e.toString());console.error(e);}});}"));
-        
-        server->sendContent(F("async function editOName(pin,oldName){"
-        "openModal(i18n[currentLang].edit_name,oldName||'GPIO '+pin,async(name)=>{"
-        "const finalName=name.trim();"
-        "if(finalName===(oldName||'GPIO '+pin))return;"
-        "try{await fetch('/api/name',{method:'POST',headers:{'Content-Type':'application/json'},"
-        "body:JSON.stringify({pin:pin,name:finalName})});load();}catch(e){showAlert(i18n[currentLang].error,e.toString());console.error(e);}});}"));
-        
-        server->sendContent(F("async function createGroup(){try{"
-        "const gid=parseInt(document.getElementById('newGroupId').value);"
-        "const interval=parseInt(document.getElementById('newGroupInterval').value);"
-        "const outputs=[];"
-        "document.querySelectorAll('#outputSelector input[type=checkbox]:checked').forEach(cb=>outputs.push(parseInt(cb.value)));"
-        "if(outputs.length<2){showAlert(i18n[currentLang].validation_error,i18n[currentLang].min_2_outputs);return;}"
-        "if(gid<1||gid>255){showAlert(i18n[currentLang].validation_error,i18n[currentLang].group_id_range);return;}"
-        "if(interval<50){showAlert(i18n[currentLang].validation_error,i18n[currentLang].interval_min);return;}"
-        "await fetch('/api/chasing/create',{method:'POST',headers:{'Content-Type':'application/json'},"
-        "body:JSON.stringify({groupId:gid,interval:interval,outputs:outputs})});"
-        "document.getElementById('newGroupId').value=parseInt(gid)+1;load();}catch(e){showAlert(i18n[currentLang].error,e.toString());console.error(e);}}"));;
-        
-        server->sendContent(F("let isProcessing=false;async function allOn(){const btn=document.getElementById('btnAllOn');if(isProcessing)return;isProcessing=true;"
-        "bulkState='on';btn.classList.add('processing');btn.disabled=true;try{const r=await fetch('/api/status');const d=await r.json();"
-        "for(const o of d.outputs){await fetch('/api/control',{method:'POST',headers:{'Content-Type':'application/json'},"
-        "body:JSON.stringify({pin:o.pin,active:true,brightness:100})});}"
-        "await new Promise(r=>setTimeout(r,300));load();}catch(e){console.error(e);load();}finally{"
-        "btn.classList.remove('processing');btn.disabled=false;isProcessing=false;}}"));
-        
-        server->sendContent(F("async function allOff(){const btn=document.getElementById('btnAllOff');if(isProcessing)return;isProcessing=true;"
-        "bulkState='off';btn.classList.add('processing');btn.disabled=true;try{const r=await fetch('/api/status');const d=await r.json();"
-        "for(const o of d.outputs){await fetch('/api/control',{method:'POST',headers:{'Content-Type':'application/json'},"
-        "body:JSON.stringify({pin:o.pin,active:false,brightness:0})});}"
-        "await new Promise(r=>setTimeout(r,300));load();}catch(e){console.error(e);load();}finally{"
-        "btn.classList.remove('processing');btn.disabled=false;isProcessing=false;}}"));
-        
-        server->sendContent(F("async function setMasterBrightness(val){try{const r=await fetch('/api/status');const d=await r.json();"
-        "for(const o of d.outputs){if(o.active){await fetch('/api/control',{method:'POST',headers:{'Content-Type':'application/json'},"
-        "body:JSON.stringify({pin:o.pin,active:true,brightness:parseInt(val)})});}}}catch(e){console.error(e);}}"));
-        
-        server->sendContent(F("let ws;function connectWS(){const wsUrl='ws://'+window.location.hostname+':81';"
-        "ws=new WebSocket(wsUrl);ws.onopen=()=>{console.log('[WS] Connected');};"
-        "ws.onmessage=(e)=>{try{wsData=JSON.parse(e.data);if(!isProcessing){load();}}catch(err){console.error('[WS] Parse error:',err);}};"
-        "ws.onerror=(e)=>{console.error('[WS] Error:',e);};"
-        "ws.onclose=()=>{console.log('[WS] Disconnected, reconnecting...');setTimeout(connectWS,2000);}};"
-        "const savedTab=localStorage.getItem('activeTab');if(savedTab!==null){showTab(parseInt(savedTab));}"
-        "const savedLang=localStorage.getItem('lang')||'en';changeLang(savedLang);document.getElementById('langSelect').value=savedLang;"
-        "load().then(()=>connectWS());</script>"
-        "<footer style='text-align:center;padding:30px 20px;margin-top:60px;border-top:1px solid var(--color-border);color:var(--color-text-muted);font-size:0.85rem;letter-spacing:0.5px;'>Made with ❤️ by innoMO</footer>"
-        "</body></html>"));
-        server->sendContent("");  // End chunked transfer
-    });
+    // Serve the control page straight from flash (see web_ui.cpp)
+    server->on("/", HttpMethod::Get, [](const HttpRequest&, HttpResponse& response) {
+        response.begin(200, "text/html");
+        response.add_P(WEB_UI_PAGE_HEAD, WEB_UI_PAGE_HEAD_LENGTH);
+        response.add(customDeviceName);
+        response.add_P(WEB_UI_PAGE_TAIL, WEB_UI_PAGE_TAIL_LENGTH);
+    }, HttpRouteClass::NonEssential);
     
     // API endpoint for status
-    server->on("/api/status", HTTP_GET, []() {
-        unsigned long startTime = millis();
-        IPAddress clientIP = server->client().remoteIP();
-        Serial.print("[WEB] GET /api/status from ");
-        Serial.println(clientIP.toString());
-        
-        JsonDocument doc;
-        serializeStatusToJson(doc);
-        doc["flashTotal"] = ESP.getFlashChipSize(); // Additional field for API
-        
-        String response;
-        serializeJson(doc, response);
-        
-        unsigned long duration = millis() - startTime;
-        Serial.print("[WEB] Status response: ");
-        Serial.print(response.length());
-        Serial.print(" bytes, ");
-        Serial.print(duration);
-        Serial.println("ms");
-        
-        server->send(200, "application/json", response);
-    });
-    
-    // API endpoint for updating output name
-    server->on("/api/name", HTTP_POST, []() {
-        unsigned long startTime = millis();
-        IPAddress clientIP = server->client().remoteIP();
-        String body = server->arg("plain");
-        Serial.print("[WEB] POST /api/name from ");
-        Serial.print(clientIP.toString());
-        Serial.print(" (");
-        Serial.print(body.length());
-        Serial.println(" bytes)");
-        
-        JsonDocument doc;
-        if (!deserializeJsonRequest(body, doc, clientIP, "/api/name")) {
-            server->send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
-            return;
-        }
-        
-        int pin = doc["pin"];
-        String name = doc["name"].as<String>();
-        
-        Serial.print("[WEB] Name update request: GPIO ");
-        Serial.print(pin);
-        Serial.print(" -> '");
-        Serial.print(name);
-        Serial.println("'");
-        
-        int outputIndex = findOutputIndexByPin(pin);
-        
-        if (outputIndex >= 0) {
-            saveOutputName(outputIndex, name);
-            unsigned long duration = millis() - startTime;
-            Serial.print("[WEB] Name update complete (");
-            Serial.print(duration);
-            Serial.println("ms)");
-            broadcastStatus();
-            server->send(200, "application/json", "{\"success\":true}");
-        } else {
-            Serial.print("[ERROR] GPIO pin not found: ");
-            Serial.println(pin);
-            server->send(404, "application/json", "{\"error\":\"Output not found\"}");
-        }
-    });
-    
-    // API endpoint for updating output blink interval
-    server->on("/api/interval", HTTP_POST, []() {
+    server->on("/api/status", HttpMethod::Get, [](const HttpRequest& request, HttpResponse& response) {
         unsigned long startTime = millis();
-        IPAddress clientIP = server->client().remoteIP();
-        String body = server->arg("plain");
-        Serial.print("[WEB] POST /api/interval from ");
-        Serial.print(clientIP.toString());
-        Serial.print(" (");
-        Serial.print(body.length());
-        Serial.println(" bytes)");
-        
-        JsonDocument doc;
-        if (!deserializeJsonRequest(body, doc, clientIP, "/api/interval")) {
-            server->send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
+        const IPAddress& clientIP = request.remoteIP();
+        Serial.print(F("[WEB] GET /api/status from "));
+        Serial.println(clientIP);
+        
+        // Client's copy is still current: 304 without touching a snapshot
+        char etag[STATUS_ETAG_SIZE];
+        formatStatusETag(etag, sizeof(etag), statusVersion);
+        const TextView ifNoneMatch = request.header("If-None-Match");
+        if (!ifNoneMatch.empty() && httpETagMatches(ifNoneMatch, etag)) {
+            statusNotModified++;
+            response.begin(304, "application/json");
+            response.setHeaders(statusResponseHeaders(etag));
             return;
         }
         
-        int pin = doc["pin"];
-        unsigned int interval = doc["interval"];
-        
-        Serial.print("[WEB] Interval update request: GPIO ");
-        Serial.print(pin);
-        Serial.print(" -> ");
-        Serial.print(interval);
-        Serial.println("ms");
-        
-        int outputIndex = findOutputIndexByPin(pin);
-        
-        if (outputIndex >= 0) {
-            setOutputInterval(outputIndex, interval);
-            unsigned long duration = millis() - startTime;
-            Serial.print("[WEB] Interval update complete (");
-            Serial.print(duration);
-            Serial.println("ms)");
-            broadcastStatus();
-            server->send(200, "application/json", "{\"success\":true}");
-        } else {
-            Serial.print("[ERROR] GPIO pin not found: ");
-            Serial.println(pin);
-            server->send(404, "application/json", "{\"error\":\"Output not found\"}");
+        // Serialized only if the state changed since the last snapshot; while
+        // every slot is still being sent the previous snapshot is served
+        if (!statusSnapshots.isCurrent(statusVersion)) {
+            buildStatusSnapshot(startTime);
         }
-    });
-    
-    // API endpoint for control
-    server->on("/api/control", HTTP_POST, []() {
-        unsigned long startTime = millis();
-        IPAddress clientIP = server->client().remoteIP();
-        String body = server->arg("plain");
-        Serial.print("[WEB] POST /api/control from ");
-        Serial.print(clientIP.toString());
-        Serial.print(" (");
-        Serial.print(body.length());
-        Serial.println(" bytes)");
-        
-        JsonDocument doc;
-        if (!deserializeJsonRequest(body, doc, clientIP, "/api/control")) {
-            server->send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
+        StatusSnapshot* snapshot = statusSnapshots.acquire();
+        if (snapshot == nullptr) {
+            response.send(500, "application/json", "{\"error\":\"Status too large\"}");
             return;
         }
         
-        int pin = doc["pin"];
-        bool active = doc["active"];
-        int brightness = doc["brightness"] | 100;
-        
-        Serial.print("[WEB] Control request: GPIO ");
-        Serial.print(pin);
-        Serial.print(" -> ");
-        Serial.print(active ? "ON" : "OFF");
-        Serial.print(" @ ");
-        Serial.print(brightness);
-        Serial.println("%");
-        
-        executeOutputCommand(pin, active, brightness);
-        
         unsigned long duration = millis() - startTime;
-        Serial.print("[WEB] Control complete (");
+        Serial.print(F("[WEB] Status response: "));
+        Serial.print(snapshot->length);
+        Serial.print(F(" bytes, "));
         Serial.print(duration);
-        Serial.println("ms)");
-        
-        server->send(200, "application/json", "{\"status\":\"ok\"}");
-    });
-    
-    // API endpoint for creating chasing group
-    server->on("/api/chasing/create", HTTP_POST, []() {
-        const unsigned long startTime = millis();
-        const IPAddress clientIP = server->client().remoteIP();
-        const String body = server->arg("plain");
-        
-        Serial.print("[WEB] POST /api/chasing/create from ");
-        Serial.print(clientIP.toString());
-        Serial.print(" (");
-        Serial.print(body.length());
-        Serial.println(" bytes)");
-        
-        JsonDocument doc;
-        if (!deserializeJsonRequest(body, doc, clientIP, "/api/chasing/create")) {
-            server->send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
-            return;
-        }
-        
-        // Validate and extract groupId
-        if (!doc["groupId"].is<uint8_t>()) {
-            Serial.println("[ERROR] Missing or invalid groupId in request");
-            server->send(400, "application/json", "{\"error\":\"Missing or invalid groupId\"}");
-            return;
-        }
-        const uint8_t groupId = doc["groupId"].as<uint8_t>();
-        if (groupId == 0 || groupId > 255) {
-            Serial.print("[ERROR] GroupId out of range: ");
-            Serial.println(groupId);
-            server->send(400, "application/json", "{\"error\":\"GroupId must be 1-255\"}");
-            return;
-        }
-        
-        // Validate and extract interval
-        if (!doc["interval"].is<unsigned int>()) {
-            Serial.println("[ERROR] Missing or invalid interval in request");
-            server->send(400, "application/json", "{\"error\":\"Missing or invalid interval\"}");
+        Serial.println(F("ms"));
+        
+        // Streamed straight from the snapshot; it stays immutable until released
+        formatStatusETag(etag, sizeof(etag), snapshot->version);
+        response.send(200, "application/json", snapshot->data, snapshot->length);
+        response.setHeaders(statusResponseHeaders(etag));
+        response.onRelease(releaseStatusSnapshot, snapshot);
+    }, HttpRouteClass::NonEssential);
+    
+    // Output directory: which GPIO each output ID drives
+    outputDirectoryLength = formatOutputDirectory(outputDirectory, sizeof(outputDirectory), OUTPUT_PINS, MAX_OUTPUTS);
+    server->on("/api/outputs", HttpMethod::Get, [](const HttpRequest&, HttpResponse& response) {
+        response.send(200, "application/json", outputDirectory, outputDirectoryLength);
+    }, HttpRouteClass::Essential);
+    
+    // Counters for load tests; no heap, so it is served at every admission level
+    server->on("/api/metrics", HttpMethod::Get, [](const HttpRequest&, HttpResponse& response) {
+        if (loadMetricsSending) {
+            response.send(503, "application/json", "{\"error\":\"Busy, retry\"}");
             return;
         }
-        const unsigned int interval = doc["interval"].as<unsigned int>();
-        if (interval < MIN_CHASING_INTERVAL_MS) {
-            Serial.print("[ERROR] Interval too small: ");
-            Serial.print(interval);
-            Serial.print("ms (minimum: ");
-            Serial.print(MIN_CHASING_INTERVAL_MS);
-            Serial.println("ms)");
-            server->send(400, "application/json", "{\"error\":\"Interval must be at least 50ms\"}");
+        const size_t length = formatLoadMetrics(loadMetricsBody, sizeof(loadMetricsBody));
+        if (length == 0) {
+            response.send(500, "application/json", "{\"error\":\"Metrics too large\"}");
             return;
         }
-        
-        // Validate and extract outputs array
-        if (!doc["outputs"].is<JsonArray>()) {
-            Serial.println("[ERROR] Missing or invalid outputs array in request");
-            server->send(400, "application/json", "{\"error\":\"Missing or invalid outputs array\"}");
+        loadMetricsSending = true;
+        response.send(200, "application/json", loadMetricsBody, length);
+        response.setHeaders("Cache-Control: no-cache\r\n");
+        response.onRelease(releaseLoadMetrics);
+    }, HttpRouteClass::Essential);
+    
+    // Input trace for the host replay (test/test_trace_replay.cpp)
+    server->on("/api/trace", HttpMethod::Get, [](const HttpRequest&, HttpResponse& response) {
+        if (!flightRecorder.enabled()) {
+            response.send(404, "application/json", "{\"error\":\"Flight recorder disabled (FLIGHT_RECORDER_SIZE 0)\"}");
             return;
         }
-        const JsonArray outputs = doc["outputs"];
-        const size_t outputCount = outputs.size();
-        
-        if (outputCount == 0) {
-            Serial.println("[ERROR] Empty outputs array");
-            server->send(400, "application/json", "{\"error\":\"At least one output required\"}");
+        if (flightRecorder.held()) {
+            response.send(503, "application/json", "{\"error\":\"Busy, retry\"}");
             return;
         }
-        if (outputCount > MAX_OUTPUTS_PER_CHASING_GROUP) {
-            Serial.print("[ERROR] Too many outputs: ");
-            Serial.print(outputCount);
-            Serial.print(" (maximum: ");
-            Serial.print(MAX_OUTPUTS_PER_CHASING_GROUP);
-            Serial.println(")");
-            server->send(400, "application/json", "{\"error\":\"Too many outputs (max 8)\"}");
+        const size_t headerLength = formatTraceHeader(traceHeader, sizeof(traceHeader), flightRecorder, OUTPUT_PINS,
+                                                      MAX_OUTPUTS, MAX_CHASING_GROUPS, COMMAND_COUNT,
+                                                      [](uint8_t i) { return COMMANDS[i].name; }, millis());
+        if (headerLength == 0) {
+            response.send(500, "application/json", "{\"error\":\"Trace header too long\"}");
             return;
         }
-        
-        // Extract optional group name
-        const char* groupName = doc["name"].is<const char*>() ? doc["name"].as<const char*>() : nullptr;
-        
-        // Convert output pins to indices with validation
-        uint8_t outputIndices[MAX_OUTPUTS_PER_CHASING_GROUP];
-        uint8_t validCount = 0;
-        
-        for (size_t i = 0; i < outputCount; i++) {
-            if (!outputs[i].is<int>()) {
-                Serial.print("[ERROR] Invalid output type at index ");
-                Serial.println(i);
-                server->send(400, "application/json", "{\"error\":\"Invalid output format\"}");
-                return;
-            }
-            
-            const int pin = outputs[i].as<int>();
-            const int outputIndex = findOutputIndexByPin(pin);
-            
-            if (outputIndex < 0 || outputIndex >= MAX_OUTPUTS) {
-                Serial.print("[ERROR] Invalid GPIO pin: ");
-                Serial.println(pin);
-                server->send(400, "application/json", "{\"error\":\"Invalid GPIO pin\"}");
-                return;
-            }
-            
-            // Check for duplicate pins
-            for (uint8_t j = 0; j < validCount; j++) {
-                if (outputIndices[j] == static_cast<uint8_t>(outputIndex)) {
-                    Serial.print("[ERROR] Duplicate GPIO pin: ");
-                    Serial.println(pin);
-                    server->send(400, "application/json", "{\"error\":\"Duplicate GPIO pin\"}");
-                    return;
-                }
-            }
-            
-            outputIndices[validCount++] = static_cast<uint8_t>(outputIndex);
+        flightRecorder.hold();
+        response.begin(200, "application/octet-stream");
+        response.add(reinterpret_cast<const char*>(traceHeader), headerLength);
+        for (uint8_t i = 0; i < 2; i++) {
+            const uint8_t* records;
+            const size_t length = flightRecorder.span(i, records);
+            response.add(reinterpret_cast<const char*>(records), length);
         }
-        
-        // Final validation: ensure all outputs were converted
-        if (validCount != outputCount) {
-            Serial.print("[ERROR] Failed to convert all outputs: ");
-            Serial.print(validCount);
-            Serial.print("/");
-            Serial.println(outputCount);
-            server->send(400, "application/json", "{\"error\":\"Failed to process all outputs\"}");
+        response.setHeaders("Cache-Control: no-cache\r\n");
+        response.onRelease(releaseTrace);
+    }, HttpRouteClass::Essential);
+    
+    // Server-Sent Events: a status event on every state change over one
+    // long-lived response, for clients that can't speak WebSocket.
+    // Takes the subscription query (?sections=&outputs=&groups=); ?telemetry=1
+    // also delivers the periodic telemetry snapshots.
+    server->on("/api/events", HttpMethod::Get, [](const HttpRequest& request, HttpResponse& response) {
+        const IPAddress& clientIP = request.remoteIP();
+        const uint8_t id = request.connectionId();
+        const unsigned long now = millis();
+        
+        // Same admission stage as new WebSocket clients
+        if (!admission.admitWebSocketClient()) {
+            LOG_PRINTF("[ADMISSION] Rejecting event stream from %d.%d.%d.%d (low memory)\n", clientIP[0], clientIP[1], clientIP[2], clientIP[3]);
+            response.send(503, "application/json", "{\"error\":\"Low memory, retry later\"}");
             return;
         }
-        
-        // Create the chasing group
-        createChasingGroup(groupId, outputIndices, validCount, interval, groupName);
-        
-        const unsigned long duration = millis() - startTime;
-        Serial.print("[WEB] Chasing group created successfully: ID=");
-        Serial.print(groupId);
-        Serial.print(", outputs=");
-        Serial.print(validCount);
-        Serial.print(", interval=");
-        Serial.print(interval);
-        Serial.print("ms (");
-        Serial.print(duration);
-        Serial.println("ms)");
-        
-        server->send(200, "application/json", "{\"success\":true}");
-    });
-    
-    // API endpoint for deleting chasing group
-    server->on("/api/chasing/delete", HTTP_POST, []() {
-        IPAddress clientIP = server->client().remoteIP();
-        String body = server->arg("plain");
-        Serial.print("[WEB] POST /api/chasing/delete from ");
-        Serial.println(clientIP.toString());
-        
-        JsonDocument doc;
-        if (!deserializeJsonRequest(body, doc, clientIP, "/api/chasing/delete")) {
-            server->send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
+        if (!subscribeStatus(eventStreams[id].subscriber, request.query(), false)) {
+            response.send(400, "application/json", "{\"error\":\"Invalid subscription\"}");
             return;
         }
-        
-        uint8_t groupId = doc["groupId"];
-        deleteChasingGroup(groupId);
-        
-        server->send(200, "application/json", "{\"success\":true}");
-    });
-    
-    // API endpoint for updating chasing group name
-    server->on("/api/chasing/name", HTTP_POST, []() {
-        IPAddress clientIP = server->client().remoteIP();
-        String body = server->arg("plain");
-        Serial.print("[WEB] POST /api/chasing/name from ");
-        Serial.println(clientIP.toString());
-        
-        JsonDocument doc;
-        if (!deserializeJsonRequest(body, doc, clientIP, "/api/chasing/name")) {
-            server->send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
+        if (!sseClientQueues.connect(id, now)) { // Starts pending: the current status goes out first
+            LOG_PRINTF("[SSE] Rejecting stream from %d.%d.%d.%d (%u streams open)\n", clientIP[0], clientIP[1], clientIP[2], clientIP[3], static_cast<unsigned>(SSE_MAX_STREAMS));
+            unsubscribeStatus(eventStreams[id].subscriber);
+            response.send(503, "application/json", "{\"error\":\"Too many event streams\"}");
             return;
         }
-        
-        uint8_t groupId = doc["groupId"];
-        const char* newName = doc["name"];
-        
-        // If name is empty or null, use default "Group X"
-        char finalName[MAX_NAME_LENGTH + 1];
-        if (newName == nullptr || strlen(newName) == 0) {
-            snprintf(finalName, sizeof(finalName), "Group %d", groupId);
-        } else {
-            strncpy(finalName, newName, MAX_NAME_LENGTH);
-            finalName[MAX_NAME_LENGTH] = '\0';
-        }
-        
-        // Find and update group
-        bool found = false;
-        for (int i = 0; i < MAX_CHASING_GROUPS; i++) {
-            if (chasingGroups[i].active && chasingGroups[i].groupId == groupId) {
-                strncpy(chasingGroups[i].name, finalName, MAX_NAME_LENGTH);
-                chasingGroups[i].name[MAX_NAME_LENGTH] = '\0';
-                saveChasingGroups();
-                found = true;
-                Serial.print("[CHASING] Updated group ");
-                Serial.print(groupId);
-                Serial.print(" name to '");
-                Serial.print(finalName);
-                Serial.println("'");
-                break;
-            }
-        }
-        
-        if (found) {
-            broadcastStatus();
-            server->send(200, "application/json", "{\"success\":true}");
-        } else {
-            server->send(404, "application/json", "{\"error\":\"Group not found\"}");
-        }
-    });
-    
-    // API endpoint to reset saved states
-    server->on("/api/reset", HTTP_POST, []() {
-        IPAddress clientIP = server->client().remoteIP();
-        Serial.print("[WEB] POST /api/reset from ");
-        Serial.println(clientIP.toString());
-        Serial.println("[EEPROM] Resetting all saved states...");
-        Serial.print("[EEPROM] Free heap before reset: ");
-        Serial.print(ESP.getFreeHeap());
-        Serial.println(" bytes");
-        
-        // Clear EEPROM data
-        for (int i = 0; i < EEPROM_SIZE; i++) {
-            EEPROM.write(i, 0xFF);
-        }
-        EEPROM.commit();
-        
-        Serial.println("[EEPROM] All saved states cleared!");
-        Serial.print("[EEPROM] Free heap after reset: ");
-        Serial.print(ESP.getFreeHeap());
-        Serial.println(" bytes");
-        
-        server->send(200, "application/json", "{\"status\":\"reset_complete\"}");
-    });
+        eventStreams[id].lastWriteMs = now;
+        LOG_PRINTF("[SSE] Stream #%u opened from %d.%d.%d.%d (status class %u%s)\n", id, clientIP[0], clientIP[1], clientIP[2], clientIP[3],
+                   eventStreams[id].subscriber.classIndex, eventStreams[id].subscriber.telemetry ? ", with telemetry" : "");
+        
+        static char retryField[24];
+        snprintf(retryField, sizeof(retryField), "retry: %u\n\n", static_cast<unsigned>(SSE_RETRY_MS));
+        response.beginStream("text/event-stream");
+        response.setHeaders("Cache-Control: no-cache\r\n");
+        response.add(retryField);
+        response.onRelease(closeEventStream, &eventStreams[id]);
+    }, HttpRouteClass::NonEssential);
+    
+    // Command endpoints: POST <httpPath> for every entry of COMMANDS
+    for (uint8_t i = 0; i < COMMAND_COUNT; i++) {
+        server->on(COMMANDS[i].httpPath, HttpMethod::Post, handleCommandRequest,
+                   COMMANDS[i].essential ? HttpRouteClass::Essential : HttpRouteClass::NonEssential);
+    }
     
     server->begin();
-    Serial.println("[WEB] Web server started on port 80");
-    Serial.println("[WEB] Available endpoints:");
-    Serial.println("[WEB]   GET  /                   - Main control interface");
-    Serial.println("[WEB]   GET  /api/status         - System and output status");
-    Serial.println("[WEB]   POST /api/control        - Control output state/brightness");
-    Serial.println("[WEB]   POST /api/name           - Update output name");
-    Serial.println("[WEB]   POST /api/interval       - Set output blink interval");
-    Serial.println("[WEB]   POST /api/chasing/create - Create chasing light group");
-    Serial.println("[WEB]   POST /api/chasing/delete - Delete chasing light group");
-    Serial.println("[WEB]   POST /api/reset          - Reset all saved preferences");
+    LOG_PRINTF("[WEB] Web server started on port %d (%d connections, %d byte request buffers)\n",
+               HTTP_PORT, HTTP_MAX_CONNECTIONS, HTTP_REQUEST_BUFFER_SIZE);
+    Serial.println(F("[WEB] Available endpoints:"));
+    Serial.println(F("[WEB]   GET  /                   - Main control interface"));
+    Serial.println(F("[WEB]   GET  /api/status         - System and output status"));
+    Serial.println(F("[WEB]   GET  /api/outputs        - Output IDs and their GPIO pins"));
+    Serial.println(F("[WEB]   GET  /api/events         - Status event stream (SSE)"));
+    Serial.println(F("[WEB]   GET  /api/metrics        - Heap, loop and traffic counters"));
+    Serial.println(F("[WEB]   GET  /api/trace          - Flight recorder input trace (binary)"));
+    for (uint8_t i = 0; i < COMMAND_COUNT; i++) {
+        LOG_PRINTF("[WEB]   POST %-19s - %s command\n", COMMANDS[i].httpPath, COMMANDS[i].name);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,366 @@
+#include <Arduino.h>
+#include "web_ui.h"
+
+// Control page served on GET /. Kept in flash and streamed from there by the
+// HTTP server, split around the device name (the only dynamic part) so the
+// response has a known Content-Length and never needs a RAM copy.
+
+const char WEB_UI_PAGE_HEAD[] PROGMEM =
+    // Header chunk
+    "<!DOCTYPE html><html lang='en'><head><meta charset='UTF-8'><meta name='viewport' content='width=device-width,initial-scale=1.0'>"
+    "<link rel='icon' href='data:image/svg+xml,<svg xmlns=%22http://www.w3.org/2000/svg%22 viewBox=%220 0 100 100%22><text y=%22.9em%22 font-size=%2290%22>🚂</text></svg>'>"
+    "<title>RailHub8266</title><style>"
+    ":root{--color-bg-primary:#0a0a0a;--color-bg-secondary:#141414;--color-bg-tertiary:#1a1a1a;--color-bg-card:#1c1c1c;--color-border:#2a2a2a;--color-border-hover:#3a3a3a;"
+    "--color-text-primary:#e8e8e8;--color-text-secondary:#a0a0a0;--color-text-muted:#707070;--color-accent:#6c9bcf;--color-accent-hover:#5a8bc0;--color-success:#4a9b6f;"
+    "--color-danger:#b85c5c;--color-warning:#c9a257;--font-primary:'Segoe UI',-apple-system,BlinkMacSystemFont,'Helvetica Neue',sans-serif}"
+    "*{margin:0;padding:0;box-sizing:border-box}body{font-family:var(--font-primary);background:var(--color-bg-primary);color:var(--color-text-primary);min-height:100vh;font-size:15px;line-height:1.6;letter-spacing:0.01em}"
+    ".card{background:#2a2a2a;border:1px solid #3a3a3a;padding:15px;margin-bottom:15px;border-radius:8px}"
+    ".container{max-width:1400px;margin:0 auto;padding:30px 40px}header{text-align:left;margin-bottom:50px;padding-bottom:25px;border-bottom:1px solid var(--color-border)}.header-content{margin-bottom:20px}"
+    "h1{font-size:2rem;margin-bottom:8px;font-weight:300;letter-spacing:0.03em}header p{font-size:0.95rem;color:var(--color-text-secondary);font-weight:300}"
+    "h2{font-size:1.2rem;margin-bottom:10px}"
+    ".language-selector{display:flex;gap:8px;flex-wrap:wrap;margin-top:16px}"
+    ".status{display:grid;grid-template-columns:repeat(auto-fit,minmax(140px,1fr));gap:10px;margin-bottom:20px}.stat{background:#333;padding:12px;text-align:center;border-radius:6px}"
+    ".value{font-size:2.2rem;font-weight:300;color:var(--color-accent);margin-bottom:8px;letter-spacing:-0.02em}.label{font-size:0.85rem;color:var(--color-text-secondary);font-weight:300;text-transform:uppercase;letter-spacing:0.05em}"
+    ".section-title{font-size:0.75rem;font-weight:400;text-transform:uppercase;letter-spacing:0.08em;color:var(--color-text-muted);margin-bottom:24px}"
+    ".outputs{display:grid;grid-template-columns:repeat(auto-fit,minmax(320px,1fr));gap:16px}.output{background:var(--color-bg-card);border:1px solid var(--color-border);padding:24px;transition:all 0.2s ease;display:flex;flex-direction:column;gap:10px}"
+    ".output:hover{border-color:var(--color-border-hover)}.output.on{border-left:2px solid var(--color-success)}.output.blinking{border-left:2px solid var(--color-warning)}.output.chasing{border-left:2px solid #9b59b6}"
+    ".output-header{display:flex;justify-content:space-between;align-items:center;gap:10px;margin-bottom:20px;padding-bottom:16px;border-bottom:1px solid var(--color-border)}"
+    ".output-name{font-size:1.1rem;font-weight:400;color:var(--color-text-primary);letter-spacing:0.02em;cursor:pointer;padding:4px 8px;border-radius:4px;transition:background 0.2s;word-break:break-word;flex:1}"
+    ".output-name:hover{background:var(--color-bg-tertiary)}.output-status{padding:5px 14px;font-size:0.7rem;font-weight:400;letter-spacing:0.08em;text-transform:uppercase;border:1px solid;background:transparent}"
+    ".output-status.on{color:var(--color-success);border-color:var(--color-success)}.output-status.off{color:var(--color-text-muted);border-color:var(--color-border)}"
+    ".output-controls{display:flex;flex-direction:column;gap:12px;width:100%}.output-info{display:flex;align-items:center;justify-content:space-between;font-size:0.85rem;color:var(--color-text-secondary);margin-bottom:20px}"
+    ".toggle{position:relative;width:44px;height:22px;background:var(--color-bg-tertiary);border:1px solid var(--color-border);cursor:pointer;transition:all 0.2s ease;flex-shrink:0}"
+    ".toggle.on{background:var(--color-accent);border-color:var(--color-accent)}.toggle::before{content:'';position:absolute;top:2px;left:2px;width:16px;height:16px;background:var(--color-text-primary);transition:transform 0.2s ease}"
+    ".toggle.on::before{transform:translateX(22px)}"
+    ".brightness{display:flex;align-items:center;gap:12px}.brightness-label{font-size:0.75rem;color:var(--color-text-muted);text-transform:uppercase;letter-spacing:0.05em;min-width:80px}"
+    ".brightness input{flex:1;height:2px;border-radius:0;background:var(--color-border);outline:none;-webkit-appearance:none;min-width:0;cursor:pointer}"
+    ".brightness input::-webkit-slider-thumb{-webkit-appearance:none;width:14px;height:14px;background:var(--color-text-primary);cursor:pointer;border-radius:0}"
+    ".brightness input::-moz-range-thumb{width:14px;height:14px;background:var(--color-text-primary);cursor:pointer;border:none;border-radius:0}"
+    ".brightness span{min-width:35px;text-align:right;font-size:0.85rem;color:var(--color-text-secondary)}"
+    ".interval{display:flex;align-items:center;gap:8px;flex-wrap:wrap}.interval-label{font-size:0.75rem;color:var(--color-text-muted);text-transform:uppercase;letter-spacing:0.05em;min-width:80px}"
+    ".interval input{width:100px;padding:6px 10px;background:rgba(255,255,255,0.03);border:1px solid var(--color-border);color:var(--color-text-primary);border-radius:4px;font-size:0.85rem;transition:all 0.2s ease;text-align:center}"
+    ".interval input:focus{outline:none;border-color:var(--color-accent);background:rgba(255,255,255,0.05)}.interval span{font-size:0.75rem;color:var(--color-text-muted)}"
+    "button{padding:11px 24px;border:1px solid var(--color-border);border-radius:2px;cursor:pointer;font-size:0.85rem;font-weight:400;letter-spacing:0.05em;transition:all 0.2s ease;text-transform:uppercase;background:transparent;color:var(--color-text-primary)}"
+    "button:hover{border-color:var(--color-border-hover);background:var(--color-bg-tertiary)}button:active{transform:scale(0.98)}button.primary{background:var(--color-accent);border-color:var(--color-accent)}"
+    "button.primary:hover{background:var(--color-accent-hover);border-color:var(--color-accent-hover)}button.processing{background:var(--color-success)!important;cursor:wait;transform:scale(1)!important}"
+    "button.processing::before{content:'✓ ';font-size:1.3rem;font-weight:bold}button.state-match{background:var(--color-success)!important;color:#fff;box-shadow:0 0 0 2px rgba(255,255,255,0.15) inset}"
+    "button:disabled{opacity:0.8;cursor:wait}button.delete{background:var(--color-danger);border-color:var(--color-danger)}button.delete:hover{background:#a84c4c}"
+    ".chasing-group{background:#3a2a4a;padding:12px;margin-bottom:10px;border-left:4px solid #9b59b6;border-radius:6px}"
+    ".chasing-group h3{font-size:1rem;margin-bottom:8px;color:#bb79d6;cursor:pointer;word-break:break-word;display:flex;align-items:center;gap:8px}"
+    ".chasing-group h3:hover{color:#d699f0}.chasing-group h3::before{content:'⚡';font-size:1.1rem}"
+    ".group-info{font-size:0.85rem;color:#b8b8b8;word-break:break-word;margin-bottom:10px;line-height:1.4}.group-controls{display:flex;gap:8px;flex-wrap:wrap;margin-top:10px}"
+    ".info{font-size:0.9rem;color:#999}.control-buttons{display:flex;flex-wrap:wrap;gap:5px}.toolbar{display:flex;gap:12px;margin-bottom:30px}"
+    ".tabs{display:flex;gap:5px;margin-bottom:40px;overflow-x:auto;-webkit-overflow-scrolling:touch;border-bottom:1px solid var(--color-border)}"
+    ".tab{background:transparent;border:none;color:var(--color-text-secondary);padding:14px 32px;border-radius:0;cursor:pointer;font-size:0.9rem;font-weight:300;letter-spacing:0.02em;transition:all 0.2s ease;border-bottom:2px solid transparent;text-transform:uppercase;white-space:nowrap;touch-action:manipulation}"
+    ".tab:hover{color:var(--color-text-primary)}.tab.active{font-weight:400;color:var(--color-text-primary);border-bottom-color:var(--color-accent);background:transparent}"
+    ".tab-content{display:none}.tab-content.active{display:block}main{min-height:500px}"
+    ".storage-bar{background:#333;height:24px;border-radius:3px;overflow:hidden;margin-top:8px;position:relative}"
+    ".storage-fill{background:linear-gradient(90deg,var(--color-success),var(--color-warning));height:100%;transition:width 0.3s}"
+    ".storage-text{position:absolute;top:3px;left:0;right:0;text-align:center;font-size:0.75rem;color:#fff;text-shadow:1px 1px 2px rgba(0,0,0,0.8)}"
+    "footer{text-align:center;padding:30px 20px;margin-top:60px;border-top:1px solid var(--color-border);color:var(--color-text-muted);font-size:0.85rem;font-weight:300}"
+    "@media (max-width:768px){.container{padding:20px}header{margin-bottom:30px}header h1{font-size:1.6rem}nav{overflow-x:auto}.tab{padding:14px 24px;white-space:nowrap}.outputs{grid-template-columns:1fr}.toolbar{flex-direction:column}.toolbar button{width:100%}}"
+    ".modal{display:none;position:fixed;top:0;left:0;width:100%;height:100%;background:rgba(0,0,0,0.8);z-index:1000;align-items:center;justify-content:center;padding:20px}"
+    ".modal.show{display:flex}"
+    ".modal-content{background:#2a2a3a;padding:20px;border-radius:12px;width:100%;max-width:400px;box-shadow:0 4px 20px rgba(0,0,0,0.5)}"
+    ".modal-header{font-size:1.2rem;font-weight:bold;margin-bottom:15px;color:#6c9bcf}"
+    ".modal-input{width:100%;padding:12px;background:#555;border:1px solid #666;color:#fff;border-radius:6px;font-size:1rem;margin-bottom:15px}"
+    ".modal-input:focus{outline:none;border-color:#6c9bcf}"
+    ".modal-buttons{display:flex;gap:10px;justify-content:flex-end;flex-wrap:wrap}"
+    ".modal-buttons button{min-width:80px;flex:1}"
+    ".modal-buttons .cancel{background:#666}"
+    ".modal-buttons .cancel:hover{background:#555}"
+    ".control-buttons{display:flex;flex-wrap:wrap;gap:5px}"
+    ".form-group{margin-bottom:15px}"
+    ".form-group label{display:block;margin-bottom:5px;color:#999;font-size:0.9rem}"
+    ".form-group input[type=number],.form-group input[type=text]{width:100%;max-width:200px;padding:8px;background:#555;border:1px solid #666;color:#fff;border-radius:4px;font-size:0.95rem}"
+    ".checkbox-grid{display:grid;grid-template-columns:repeat(auto-fill,minmax(120px,1fr));gap:8px;padding:8px;background:#333;border-radius:4px}"
+    ".checkbox-label{display:flex;align-items:center;gap:10px;padding:10px 12px;background:#444;border-radius:4px;cursor:pointer;transition:background 0.2s}"
+    ".checkbox-label:hover:not(.disabled){background:#505050}"
+    ".checkbox-label input[type=checkbox]{appearance:none;-webkit-appearance:none;cursor:pointer;width:20px;height:20px;margin:0;flex-shrink:0;background:#555;border:2px solid #666;border-radius:4px;transition:all 0.2s;display:flex;align-items:center;justify-content:center}"
+    ".checkbox-label input[type=checkbox]:checked{background:#6c9bcf;border-color:#6c9bcf}"
+    ".checkbox-label input[type=checkbox]:checked::before{content:'✓';color:#fff;font-size:14px;font-weight:bold;line-height:1}"
+    ".checkbox-label input[type=checkbox]:disabled{opacity:0.4;cursor:not-allowed}"
+    ".checkbox-label.disabled{opacity:0.5;cursor:not-allowed}"
+    ".checkbox-label span{line-height:1.3;word-break:break-word;font-size:0.9rem}"
+    ".no-groups{text-align:center;padding:20px;color:#666;font-style:italic}"
+    "@media(min-width:768px){.output{flex-direction:row}.output-header{flex:0 0 auto}.output-controls{width:auto;flex:1}}"
+    "@media(max-width:480px){body{padding:10px}.card{padding:12px}h1{font-size:1.3rem}h2{font-size:1.1rem}button{padding:8px 16px;font-size:0.9rem}.toggle{width:50px;height:28px}.toggle::after{width:24px;height:24px}.toggle.on::after{left:24px}.stat{padding:10px}.value{font-size:1.3rem}}"
+    "</style></head><body>"
+    // Modal dialog for name editing
+    "<div id='nameModal' class='modal'><div class='modal-content'>"
+    "<div class='modal-header' id='modalTitle' data-i18n='edit_name'>Edit Name</div>"
+    "<input type='text' id='modalInput' class='modal-input' maxlength='20' data-i18n-placeholder='enter_name' placeholder='Enter name...'>"
+    "<div class='modal-buttons'>"
+    "<button class='cancel' onclick='closeModal()' data-i18n='btn_cancel'>Cancel</button>"
+    "<button onclick='saveModalName()' data-i18n='btn_save'>Save</button>"
+    "</div></div></div>"
+    // Confirmation modal
+    "<div id='confirmModal' class='modal'><div class='modal-content'>"
+    "<div class='modal-header' id='confirmTitle' data-i18n='confirm'>Confirm</div>"
+    "<div id='confirmMessage' style='margin-bottom:20px;color:#ccc'></div>"
+    "<div class='modal-buttons'>"
+    "<button class='cancel' onclick='closeConfirm()' data-i18n='btn_cancel'>Cancel</button>"
+    "<button class='delete' onclick='confirmYes()' data-i18n='btn_delete'>Delete</button>"
+    "</div></div></div>"
+    // Alert modal
+    "<div id='alertModal' class='modal'><div class='modal-content'>"
+    "<div class='modal-header' id='alertTitle' data-i18n='alert'>Alert</div>"
+    "<div id='alertMessage' style='margin-bottom:20px;color:#ccc'></div>"
+    "<div class='modal-buttons'>"
+    "<button onclick='closeAlert()' data-i18n='btn_ok'>OK</button>"
+    "</div></div></div>"
+    // Modern header
+    "<div class='container'><header><div class='header-content'>"
+    "<h1>🚂 RailHub8266</h1><p>";
+
+const char WEB_UI_PAGE_TAIL[] PROGMEM =
+    "</p>"
+    "<div class='language-selector'>"
+    "<select id='langSelect' onchange='changeLang(this.value)' style='padding:8px 12px;background:var(--color-bg-tertiary);border:1px solid var(--color-border);color:var(--color-text-primary);border-radius:4px;cursor:pointer;font-size:0.85rem;text-transform:uppercase;letter-spacing:0.05em'>"
+    "<option value='en'>English</option>"
+    "<option value='de'>Deutsch</option>"
+    "<option value='fr'>Français</option>"
+    "<option value='it'>Italiano</option>"
+    "<option value='zh'>中文</option>"
+    "<option value='hi'>हिन्दी</option>"
+    "</select></div></div></header>"
+    "<nav class='tabs'>"
+    "<button class='tab active' onclick='showTab(0)' data-i18n='tab_status'>Status</button>"
+    "<button class='tab' onclick='showTab(1)' data-i18n='tab_settings'>Settings</button>"
+    "</nav><main><div class='tab-content active' id='tab0'>"
+    "<h3 class='section-title' data-i18n='tab_status'>Device Status</h3><div class='status'>"
+    "<div class='stat'><div class='value' id='uptime'>-</div><div class='label' data-i18n='uptime'>Uptime</div></div>"
+    "<div class='stat'><div class='value' id='buildDate'>-</div><div class='label' data-i18n='build_date'>Build Date</div></div>"
+    "</div><h3 class='section-title' style='margin-top:40px'>Memory & Storage</h3><div style='max-width:800px'><div style='margin-bottom:25px'><div class='label' style='margin-bottom:8px' data-i18n='ram'>RAM (80 KB)</div>"
+    "<div class='storage-bar'><div class='storage-fill' id='ramFill' style='width:0%'></div>"
+    "<div class='storage-text' id='ramText'>-</div></div></div>"
+    "<div style='margin-bottom:25px'><div class='label' style='margin-bottom:8px' data-i18n='flash'>Program Flash (1 MB)</div>"
+    "<div class='storage-bar'><div class='storage-fill' id='storageFill' style='width:0%'></div>"
+    "<div class='storage-text' id='storageText'>-</div></div></div></div>"
+    "<h3 class='section-title' style='margin-top:40px' data-i18n='controls'>Controls</h3>"
+    "<div class='toolbar'><button id='btnAllOn' onclick='allOn()' class='primary' data-i18n='btn_all_on'>All ON</button><button id='btnAllOff' onclick='allOff()' class='primary' data-i18n='btn_all_off'>All OFF</button></div>"
+    "<div class='output' style='max-width:800px;margin-bottom:30px'><div class='output-header'><div class='output-name' data-i18n='master_brightness'>Master Brightness</div><div class='output-status on'>ALL</div></div>"
+    "<div class='brightness'><span class='brightness-label' data-i18n='master_brightness'>Brightness</span>"
+    "<input type='range' min='0' max='100' value='100' id='masterBrightness' oninput='this.nextElementSibling.textContent=this.value+\"%\"' onchange='setMasterBrightness(this.value)'>"
+    "<span>100%</span></div></div></div>"
+    "<div class='tab-content' id='tab1'><h3 class='section-title' data-i18n='chasing_groups'>Chasing Light Groups</h3>"
+    "<div style='background:var(--color-bg-card);border:1px solid var(--color-border);padding:20px;border-radius:6px;margin-bottom:20px'>"
+    "<div class='form-group'><label data-i18n='group_id'>Group ID:</label>"
+    "<input type='number' id='newGroupId' min='1' max='255' value='1'></div>"
+    "<div class='form-group'><label data-i18n='interval_ms'>Interval (ms):</label>"
+    "<input type='text' id='newGroupInterval' value='500'></div>"
+    "<div class='form-group'><label data-i18n='select_outputs'>Select Outputs (min. 2):</label>"
+    "<div id='outputSelector' class='checkbox-grid'></div></div>"
+    "<button onclick='createGroup()' class='primary' data-i18n='btn_create_group'>Create Group</button>"
+    "</div><div id='chasingGroups'></div>"
+    "<h3 class='section-title' style='margin-top:30px' data-i18n='outputs'>Outputs</h3><div class='outputs' id='outputs'></div></div></div>"
+    // JavaScript chunk with i18n
+    "<script>"
+    "const i18n={en:{tab_status:'Status',tab_settings:'Settings',uptime:'Uptime',build_date:'Build Date',ram:'RAM (80 KB)',flash:'Program Flash (1 MB)',controls:'Controls',btn_all_on:'All ON',btn_all_off:'All OFF',master_brightness:'Master Brightness:',chasing_groups:'Chasing Light Groups',group_id:'Group ID:',interval_ms:'Interval (ms):',select_outputs:'Select Outputs (min. 2):',btn_create_group:'Create Group',outputs:'Outputs',edit_name:'Edit Name',enter_name:'Enter name...',btn_cancel:'Cancel',btn_save:'Save',confirm:'Confirm',btn_delete:'Delete',alert:'Alert',btn_ok:'OK',delete_confirm:'Are you sure you want to delete this chasing group?',validation_error:'Validation Error',min_2_outputs:'Please select at least 2 outputs',group_id_range:'Group ID must be 1-255',interval_min:'Interval must be at least 50ms',error:'Error',outputs_label:'Outputs:',interval_label:'Interval:',no_groups:'No active groups'},"
+    "de:{tab_status:'Status',tab_settings:'Einstellungen',uptime:'Betriebszeit',build_date:'Build-Datum',ram:'RAM (80 KB)',flash:'Programm-Flash (1 MB)',controls:'Steuerung',btn_all_on:'Alle AN',btn_all_off:'Alle AUS',master_brightness:'Master-Helligkeit:',chasing_groups:'Lauflicht-Gruppen',group_id:'Gruppen-ID:',interval_ms:'Intervall (ms):',select_outputs:'Ausgänge wählen (mind. 2):',btn_create_group:'Gruppe erstellen',outputs:'Ausgänge',edit_name:'Name bearbeiten',enter_name:'Namen eingeben...',btn_cancel:'Abbrechen',btn_save:'Speichern',confirm:'Bestätigen',btn_delete:'Löschen',alert:'Hinweis',btn_ok:'OK',delete_confirm:'Möchten Sie diese Lauflicht-Gruppe wirklich löschen?',validation_error:'Validierungsfehler',min_2_outputs:'Bitte wählen Sie mindestens 2 Ausgänge',group_id_range:'Gruppen-ID muss zwischen 1-255 liegen',interval_min:'Intervall muss mindestens 50ms betragen',error:'Fehler',outputs_label:'Ausgänge:',interval_label:'Intervall:',no_groups:'Keine aktiven Gruppen'},"
+    "fr:{tab_status:'Statut',tab_settings:'Paramètres',uptime:'Temps de fonctionnement',build_date:'Date de compilation',ram:'RAM (80 Ko)',flash:'Flash programme (1 Mo)',controls:'Contrôles',btn_all_on:'Tout ACTIVER',btn_all_off:'Tout DÉSACTIVER',master_brightness:'Luminosité principale:',chasing_groups:'Groupes de poursuite',group_id:'ID de groupe:',interval_ms:'Intervalle (ms):',select_outputs:'Sélectionner sorties (min. 2):',btn_create_group:'Créer un groupe',outputs:'Sorties',edit_name:'Modifier le nom',enter_name:'Entrer le nom...',btn_cancel:'Annuler',btn_save:'Enregistrer',confirm:'Confirmer',btn_delete:'Supprimer',alert:'Alerte',btn_ok:'OK',delete_confirm:'Voulez-vous vraiment supprimer ce groupe?',validation_error:'Erreur de validation',min_2_outputs:'Veuillez sélectionner au moins 2 sorties',group_id_range:'L\\'ID doit être entre 1-255',interval_min:'L\\'intervalle doit être d\\'au moins 50ms',error:'Erreur',outputs_label:'Sorties:',interval_label:'Intervalle:',no_groups:'Aucun groupe actif'},"
+    "it:{tab_status:'Stato',tab_settings:'Impostazioni',uptime:'Tempo di attività',build_date:'Data di compilazione',ram:'RAM (80 KB)',flash:'Flash programma (1 MB)',controls:'Controlli',btn_all_on:'Tutto ACCESO',btn_all_off:'Tutto SPENTO',master_brightness:'Luminosità principale:',chasing_groups:'Gruppi di inseguimento',group_id:'ID gruppo:',interval_ms:'Intervallo (ms):',select_outputs:'Seleziona uscite (min. 2):',btn_create_group:'Crea gruppo',outputs:'Uscite',edit_name:'Modifica nome',enter_name:'Inserisci nome...',btn_cancel:'Annulla',btn_save:'Salva',confirm:'Conferma',btn_delete:'Elimina',alert:'Avviso',btn_ok:'OK',delete_confirm:'Sei sicuro di voler eliminare questo gruppo?',validation_error:'Errore di validazione',min_2_outputs:'Seleziona almeno 2 uscite',group_id_range:'L\\'ID deve essere tra 1-255',interval_min:'L\\'intervallo deve essere almeno 50ms',error:'Errore',outputs_label:'Uscite:',interval_label:'Intervallo:',no_groups:'Nessun gruppo attivo'},"
+    "zh:{tab_status:'状态',tab_settings:'设置',uptime:'运行时间',build_date:'构建日期',ram:'内存 (80 KB)',flash:'程序闪存 (1 MB)',controls:'控制',btn_all_on:'全部开启',btn_all_off:'全部关闭',master_brightness:'主亮度:',chasing_groups:'追逐灯光组',group_id:'组ID:',interval_ms:'间隔 (毫秒):',select_outputs:'选择输出 (最少2个):',btn_create_group:'创建组',outputs:'输出',edit_name:'编辑名称',enter_name:'输入名称...',btn_cancel:'取消',btn_save:'保存',confirm:'确认',btn_delete:'删除',alert:'提示',btn_ok:'确定',delete_confirm:'确定要删除此追逐灯光组吗？',validation_error:'验证错误',min_2_outputs:'请至少选择2个输出',group_id_range:'组ID必须在1-255之间',interval_min:'间隔必须至少为50毫秒',error:'错误',outputs_label:'输出:',interval_label:'间隔:',no_groups:'没有活动组'},"
+    "hi:{tab_status:'स्थिति',tab_settings:'सेटिंग्स',uptime:'अपटाइम',build_date:'बिल्ड तिथि',ram:'RAM (80 KB)',flash:'प्रोग्राम फ्लैश (1 MB)',controls:'नियंत्रण',btn_all_on:'सभी चालू',btn_all_off:'सभी बंद',master_brightness:'मुख्य चमक:',chasing_groups:'चेज़िंग लाइट समूह',group_id:'समूह ID:',interval_ms:'अंतराल (ms):',select_outputs:'आउटपुट चुनें (न्यूनतम 2):',btn_create_group:'समूह बनाएं',outputs:'आउटपुट',edit_name:'नाम संपादित करें',enter_name:'नाम दर्ज करें...',btn_cancel:'रद्द करें',btn_save:'सहेजें',confirm:'पुष्टि करें',btn_delete:'हटाएं',alert:'चेतावनी',btn_ok:'ठीक है',delete_confirm:'क्या आप वाकई इस समूह को हटाना चाहते हैं?',validation_error:'सत्यापन त्रुटि',min_2_outputs:'कृपया कम से कम 2 आउटपुट चुनें',group_id_range:'समूह ID 1-255 के बीच होनी चाहिए',interval_min:'अंतराल कम से कम 50ms होना चाहिए',error:'त्रुटि',outputs_label:'आउटपुट:',interval_label:'अंतराल:',no_groups:'कोई सक्रिय समूह नहीं'}};"
+    "let currentLang='en';"
+    "function changeLang(lang){currentLang=lang;localStorage.setItem('lang',lang);document.querySelectorAll('[data-i18n]').forEach(el=>{const key=el.getAttribute('data-i18n');if(i18n[lang]&&i18n[lang][key])el.textContent=i18n[lang][key];});document.querySelectorAll('[data-i18n-placeholder]').forEach(el=>{const key=el.getAttribute('data-i18n-placeholder');if(i18n[lang]&&i18n[lang][key])el.placeholder=i18n[lang][key];});}"
+    "function showTab(n){localStorage.setItem('activeTab',n);document.querySelectorAll('.tab').forEach((t,i)=>t.classList.toggle('active',i===n));"
+    "document.querySelectorAll('.tab-content').forEach((c,i)=>c.classList.toggle('active',i===n));}"
+    "let wsData=null;let lastStatus=null;let wsFresh=false;let bulkState=null;async function load(){let d;if(wsData){d=wsData;wsData=null;}else{try{const r=await fetch('/api/status');d=await r.json();}catch(err){console.error('[LOAD] Error:',err);return;}}if(!d)return;lastStatus=d;try{const activeEl=document.activeElement;const isFocused=activeEl&&activeEl.tagName==='INPUT'&&activeEl.type==='text'&&activeEl.closest('.interval');"
+    "const focusedPin=isFocused?activeEl.closest('.output')?.querySelector('.output-name')?.getAttribute('onclick')?.match(/\\d+/)?.[0]:null;"
+    "const cursorPos=isFocused?activeEl.selectionStart:null;const focusedVal=isFocused?activeEl.value:null;"
+    "const usedRam=80-(d.freeHeap/1024);const ramPct=Math.round((usedRam/80)*100);"
+    "document.getElementById('ramFill').style.width=ramPct+'%';"
+    "document.getElementById('ramText').textContent=usedRam.toFixed(1)+'KB / 80KB ('+ramPct+'%)';"
+    "const s=Math.floor(d.uptime/1000);let uptime;if(s<60)uptime=s+'s';else if(s<3600){const m=Math.floor(s/60);const rs=s%60;uptime=m+'m '+(rs>0?rs+'s':'');}else if(s<86400){const h=Math.floor(s/3600);const m=Math.floor((s%3600)/60);uptime=h+'h '+(m>0?m+'m':'');}else{const d=Math.floor(s/86400);const h=Math.floor((s%86400)/3600);uptime=d+'d '+(h>0?h+'h':'');}document.getElementById('uptime').textContent=uptime;"
+    "if(d.buildDate)document.getElementById('buildDate').textContent=d.buildDate;"
+    "if(d.flashUsed&&d.flashPartition){const pct=Math.round((d.flashUsed/d.flashPartition)*100);"
+    "document.getElementById('storageFill').style.width=pct+'%';"
+    "document.getElementById('storageText').textContent=(d.flashUsed/1024).toFixed(0)+'KB / '+(d.flashPartition/1024).toFixed(0)+'KB ('+pct+'%)';}"
+    "const sel=document.getElementById('outputSelector');"
+    "const checked=[];document.querySelectorAll('#outputSelector input:checked').forEach(cb=>checked.push(cb.value));"
+    "sel.innerHTML='';"
+    "d.outputs.forEach(out=>{"
+    "const lbl=document.createElement('label');lbl.className='checkbox-label';"
+    "if(out.chasingGroup>=0)lbl.classList.add('disabled');"
+    "const cb=document.createElement('input');cb.type='checkbox';cb.value=out.pin;cb.id='out_'+out.pin;"
+    "cb.disabled=out.chasingGroup>=0;"
+    "if(out.chasingGroup<0&&checked.includes(out.pin.toString()))cb.checked=true;"
+    "lbl.appendChild(cb);"
+    "const outName=out.name||'GPIO '+out.pin;"
+    "const span=document.createElement('span');span.textContent=outName;span.style.fontSize='0.85rem';"
+    "lbl.appendChild(span);"
+    "sel.appendChild(lbl);});"
+    "const cg=document.getElementById('chasingGroups');cg.innerHTML='';"
+    "if(d.chasingGroups&&d.chasingGroups.length>0){"
+    "d.chasingGroups.forEach(g=>{"
+    "const div=document.createElement('div');div.className='chasing-group';"
+    "const outNames=g.outputs.map(pin=>{const o=d.outputs.find(x=>x.pin===pin);return o?(o.name||'GPIO '+pin):'GPIO '+pin;}).join(', ');"
+    "div.innerHTML=`<h3 onclick='editGName(${g.groupId},\"${g.name}\")'>${g.name}</h3>"
+    "<div class='group-info'><strong>${i18n[currentLang].outputs_label}:</strong> ${outNames}<br><strong>${i18n[currentLang].interval_label}:</strong> ${g.interval}ms</div>"
+    "<div class='group-controls'><button class='delete' onclick='deleteGroup(${g.groupId})'>${i18n[currentLang].btn_delete} Group</button></div>`;"
+    "cg.appendChild(div);});}else{cg.innerHTML='<div class=\"no-groups\">'+i18n[currentLang].no_groups+'</div>';}"
+    "const o=document.getElementById('outputs');o.innerHTML='';"
+    "d.outputs.forEach((out,i)=>{"
+    "const div=document.createElement('div');"
+    "let cls='output'+(out.active?' on':'')+(out.interval>0?' blinking':'')+(out.chasingGroup>=0?' chasing':'');"
+    "div.className=cls;"
+    "let groupTag='';"
+    "if(out.chasingGroup>=0){const grp=d.chasingGroups.find(g=>g.groupId===out.chasingGroup);groupTag=grp?' ['+grp.name+']':' [G'+out.chasingGroup+']';}"
+    "div.innerHTML=`<div class='output-header'><div class='output-name' onclick='editOName(${out.pin},\"${out.name}\")'>${out.name || 'GPIO '+out.pin}${groupTag}</div>"
+    "<div class='toggle ${out.active?'on':''}' onclick='tog(${out.pin})'></div></div>"
+    "<div class='output-controls'><div class='brightness'><span class='brightness-label' data-i18n='brightness'>Brightness</span><input type='range' min='0' max='100' value='${out.brightness}' "
+    "oninput='this.nextElementSibling.textContent=this.value+\"%\"' onchange='setBright(${out.pin},this.value)'>"
+    "<span>${out.brightness}%</span></div>"
+    "<div class='interval'><span class='interval-label' data-i18n='interval_label'>Interval:</span><input type='text' value='${out.interval}' "
+    "onchange='setInt(${out.pin},this.value)' ${out.chasingGroup>=0?'disabled':''}><span>ms</span></div></div>`;"
+    "o.appendChild(div);});"
+    "if(focusedPin){const inputs=document.querySelectorAll('.interval input[type=text]');"
+    "inputs.forEach(inp=>{const pin=inp.closest('.output')?.querySelector('.output-name')?.getAttribute('onclick')?.match(/\\d+/)?.[0];"
+    "if(pin===focusedPin){inp.focus();if(cursorPos!==null){inp.setSelectionRange(cursorPos,cursorPos);inp.value=focusedVal||inp.value;}}});}"
+    "const btnOn=document.getElementById('btnAllOn');const btnOff=document.getElementById('btnAllOff');"
+    "const everyOn=d.outputs.length>0&&d.outputs.every(out=>out.active);"
+    "const everyOff=d.outputs.length>0&&d.outputs.every(out=>!out.active);"
+    "bulkState=everyOn?'on':everyOff?'off':null;"
+    "if(btnOn)btnOn.classList.toggle('state-match',bulkState==='on');"
+    "if(btnOff)btnOff.classList.toggle('state-match',bulkState==='off');"
+    "}catch(e){console.error(e);}}"
+    "async function currentStatus(){if(wsFresh&&lastStatus)return lastStatus;try{const r=await fetch('/api/status');"
+    "if(r.ok){lastStatus=await r.json();}}catch(e){console.error(e);}return lastStatus;}"
+    "async function tog(pin){try{const d=await currentStatus();const out=d&&d.outputs.find(o=>o.pin===pin);if(!out)return;"
+    "await fetch('/api/control',{method:'POST',headers:{'Content-Type':'application/json'},"
+    "body:JSON.stringify({pin:pin,active:!out.active,brightness:out.brightness})});load();}catch(e){console.error(e);}}"
+    "async function setBright(pin,val){try{const d=await currentStatus();const out=d&&d.outputs.find(o=>o.pin===pin);if(!out)return;"
+    "await fetch('/api/control',{method:'POST',headers:{'Content-Type':'application/json'},"
+    "body:JSON.stringify({pin:pin,active:out.active,brightness:parseInt(val)})});}catch(e){console.error(e);}}"
+    "async function setInt(pin,val){try{await fetch('/api/interval',{method:'POST',headers:{'Content-Type':'application/json'},"
+    "body:JSON.stringify({pin:pin,interval:parseInt(val)||0})});}catch(e){console.error(e);}}"
+    "let confirmCallback=null;function openConfirm(title,message,callback){"
+    "document.getElementById('confirmTitle').textContent=title;"
+    "document.getElementById('confirmMessage').textContent=message;"
+    "confirmCallback=callback;"
+    "document.getElementById('confirmModal').classList.add('show');}"
+    "function closeConfirm(){document.getElementById('confirmModal').classList.remove('show');confirmCallback=null;}"
+    "function confirmYes(){if(confirmCallback){confirmCallback();}closeConfirm();}"
+    "document.getElementById('confirmModal').addEventListener('click',e=>{"
+    "if(e.target.id==='confirmModal'){closeConfirm();}});"
+    "function showAlert(title,message){"
+    "document.getElementById('alertTitle').textContent=title;"
+    "document.getElementById('alertMessage').textContent=message;"
+    "document.getElementById('alertModal').classList.add('show');}"
+    "function closeAlert(){document.getElementById('alertModal').classList.remove('show');}"
+    "document.getElementById('alertModal').addEventListener('click',e=>{"
+    "if(e.target.id==='alertModal'){closeAlert();}});"
+    "async function deleteGroup(gid){"
+    "openConfirm(i18n[currentLang].confirm,i18n[currentLang].delete_confirm,async()=>{"
+    "try{await fetch('/api/chasing/delete',{method:'POST',headers:{'Content-Type':'application/json'},"
+    "body:JSON.stringify({groupId:gid})});load();}catch(e){console.error(e);}});}"
+    "let modalCallback=null;function openModal(title,currentVal,callback){"
+    "document.getElementById('modalTitle').textContent=title;"
+    "const input=document.getElementById('modalInput');"
+    "input.value=currentVal||'';"
+    "input.placeholder=i18n[currentLang].enter_name;"
+    "modalCallback=callback;"
+    "document.getElementById('nameModal').classList.add('show');"
+    "setTimeout(()=>input.focus(),100);}"
+    "function closeModal(){document.getElementById('nameModal').classList.remove('show');modalCallback=null;}"
+    "function saveModalName(){const val=document.getElementById('modalInput').value.trim();"
+    "if(modalCallback){modalCallback(val);}closeModal();}"
+    "document.getElementById('modalInput').addEventListener('keydown',e=>{"
+    "if(e.key==='Enter'){saveModalName();}else if(e.key==='Escape'){closeModal();}});"
+    "document.getElementById('nameModal').addEventListener('click',e=>{"
+    "if(e.target.id==='nameModal'){closeModal();}});"
+    "async function editGName(gid,oldName){"
+    "openModal(i18n[currentLang].edit_name,oldName,async(name)=>{"
+    "if(name===oldName)return;"
+    "const finalName=name.trim()||'Group '+gid;"
+    "try{await fetch('/api/chasing/name',{method:'POST',headers:{'Content-Type':'application/json'},"
+    "body:JSON.stringify({groupId:gid,name:finalName})});load();}catch(e){showAlert(i18n[currentLang].error,e.toString());console.error(e);}});}"
+    "async function editOName(pin,oldName){"
+    "openModal(i18n[currentLang].edit_name,oldName||'GPIO '+pin,async(name)=>{"
+    "const finalName=name.trim();"
+    "if(finalName===(oldName||'GPIO '+pin))return;"
+    "try{await fetch('/api/name',{method:'POST',headers:{'Content-Type':'application/json'},"
+    "body:JSON.stringify({pin:pin,name:finalName})});load();}catch(e){showAlert(i18n[currentLang].error,e.toString());console.error(e);}});}"
+    "async function createGroup(){try{"
+    "const gid=parseInt(document.getElementById('newGroupId').value);"
+    "const interval=parseInt(document.getElementById('newGroupInterval').value);"
+    "const outputs=[];"
+    "document.querySelectorAll('#outputSelector input[type=checkbox]:checked').forEach(cb=>outputs.push(parseInt(cb.value)));"
+    "if(outputs.length<2){showAlert(i18n[currentLang].validation_error,i18n[currentLang].min_2_outputs);return;}"
+    "if(gid<1||gid>255){showAlert(i18n[currentLang].validation_error,i18n[currentLang].group_id_range);return;}"
+    "if(interval<50){showAlert(i18n[currentLang].validation_error,i18n[currentLang].interval_min);return;}"
+    "await fetch('/api/chasing/create',{method:'POST',headers:{'Content-Type':'application/json'},"
+    "body:JSON.stringify({groupId:gid,interval:interval,outputs:outputs})});"
+    "document.getElementById('newGroupId').value=parseInt(gid)+1;load();}catch(e){showAlert(i18n[currentLang].error,e.toString());console.error(e);}}"
+    "let isProcessing=false;async function allOn(){const btn=document.getElementById('btnAllOn');if(isProcessing)return;isProcessing=true;"
+    "bulkState='on';btn.classList.add('processing');btn.disabled=true;try{const d=await currentStatus();"
+    "for(const o of (d?d.outputs:[])){await fetch('/api/control',{method:'POST',headers:{'Content-Type':'application/json'},"
+    "body:JSON.stringify({pin:o.pin,active:true,brightness:100})});}"
+    "await new Promise(r=>setTimeout(r,300));load();}catch(e){console.error(e);load();}finally{"
+    "btn.classList.remove('processing');btn.disabled=false;isProcessing=false;}}"
+    "async function allOff(){const btn=document.getElementById('btnAllOff');if(isProcessing)return;isProcessing=true;"
+    "bulkState='off';btn.classList.add('processing');btn.disabled=true;try{const d=await currentStatus();"
+    "for(const o of (d?d.outputs:[])){await fetch('/api/control',{method:'POST',headers:{'Content-Type':'application/json'},"
+    "body:JSON.stringify({pin:o.pin,active:false,brightness:0})});}"
+    "await new Promise(r=>setTimeout(r,300));load();}catch(e){console.error(e);load();}finally{"
+    "btn.classList.remove('processing');btn.disabled=false;isProcessing=false;}}"
+    "async function setMasterBrightness(val){try{const d=await currentStatus();"
+    "for(const o of (d?d.outputs:[])){if(o.active){await fetch('/api/control',{method:'POST',headers:{'Content-Type':'application/json'},"
+    "body:JSON.stringify({pin:o.pin,active:true,brightness:parseInt(val)})});}}}catch(e){console.error(e);}}"
+    "let ws;function connectWS(){const wsUrl='ws://'+window.location.hostname+':81';"
+    "ws=new WebSocket(wsUrl);ws.onopen=()=>{console.log('[WS] Connected');};"
+    "ws.onmessage=(e)=>{try{wsData=JSON.parse(e.data);wsFresh=true;if(!isProcessing){load();}}catch(err){console.error('[WS] Parse error:',err);}};"
+    "ws.onerror=(e)=>{console.error('[WS] Error:',e);};"
+    "ws.onclose=()=>{wsFresh=false;console.log('[WS] Disconnected, reconnecting...');setTimeout(connectWS,2000);}};"
+    "const savedTab=localStorage.getItem('activeTab');if(savedTab!==null){showTab(parseInt(savedTab));}"
+    "const savedLang=localStorage.getItem('lang')||'en';changeLang(savedLang);document.getElementById('langSelect').value=savedLang;"
+    "load().then(()=>connectWS());</script>"
+    "<footer style='text-align:center;padding:30px 20px;margin-top:60px;border-top:1px solid var(--color-border);color:var(--color-text-muted);font-size:0.85rem;letter-spacing:0.5px;'>Made with ❤️ by innoMO</footer>"
+    "</body></html>";
+
+// WiFiManager portal stylesheet, matching the control page. WiFiManager
+// reads it with plain string functions, so the firmware copies it to the
+// heap while the portal runs instead of keeping it in RAM all the time.
+const char PORTAL_HEAD_ELEMENT[] PROGMEM =
+    "<style>"
+    ":root{--color-bg-primary:#0a0a0a;--color-bg-secondary:#141414;--color-bg-tertiary:#1a1a1a;--color-bg-card:#1c1c1c;--color-border:#2a2a2a;--color-border-hover:#3a3a3a;"
+    "--color-text-primary:#e8e8e8;--color-text-secondary:#a0a0a0;--color-text-muted:#707070;--color-accent:#6c9bcf;--color-accent-hover:#5a8bc0;--color-success:#4a9b6f;"
+    "--color-danger:#b85c5c;--color-warning:#c9a257;--font-primary:'Segoe UI',-apple-system,BlinkMacSystemFont,'Helvetica Neue',sans-serif}"
+    "*{margin:0;padding:0;box-sizing:border-box}"
+    "body{font-family:var(--font-primary);background:var(--color-bg-primary);color:var(--color-text-primary);min-height:100vh;font-size:15px;line-height:1.6;letter-spacing:0.01em}"
+    "h1{font-size:2rem;margin-bottom:8px;font-weight:300;letter-spacing:0.03em;color:var(--color-text-primary)}"
+    "h2{font-size:1.2rem;margin-bottom:10px;color:var(--color-text-primary);font-weight:400}"
+    "h3{font-size:1rem;margin-bottom:10px;color:var(--color-text-primary);font-weight:400}"
+    "form{background:var(--color-bg-card);border:1px solid var(--color-border);padding:24px;border-radius:8px;margin:20px 0}"
+    "label{display:block;margin-bottom:8px;color:var(--color-text-secondary);font-size:0.9rem;font-weight:400}"
+    "input[type='text'],input[type='password'],input[type='number'],select{width:100%;padding:11px 14px;background:rgba(255,255,255,0.03);border:1px solid var(--color-border);color:var(--color-text-primary);border-radius:4px;font-size:0.9rem;font-family:var(--font-primary);transition:all 0.2s ease;box-sizing:border-box}"
+    "input[type='text']:focus,input[type='password']:focus,input[type='number']:focus,select:focus{outline:none;border-color:var(--color-accent);background:rgba(255,255,255,0.05)}"
+    "button,input[type='submit']{padding:11px 24px;border:1px solid var(--color-border);border-radius:2px;cursor:pointer;font-size:0.85rem;font-weight:400;letter-spacing:0.05em;transition:all 0.2s ease;text-transform:uppercase;background:transparent;color:var(--color-text-primary);font-family:var(--font-primary)}"
+    "button:hover,input[type='submit']:hover{border-color:var(--color-border-hover);background:var(--color-bg-tertiary)}"
+    "button:active,input[type='submit']:active{transform:scale(0.98)}"
+    "input[type='submit'],button[type='submit']{background:var(--color-accent);border-color:var(--color-accent);color:#fff}"
+    "input[type='submit']:hover,button[type='submit']:hover{background:var(--color-accent-hover);border-color:var(--color-accent-hover)}"
+    ".form-group{margin-bottom:20px}"
+    ".form-row{display:flex;gap:12px;margin-bottom:20px}"
+    ".form-row .form-group{flex:1;margin-bottom:0}"
+    "p{color:var(--color-text-secondary);font-size:0.9rem;line-height:1.6;margin-bottom:15px}"
+    "a{color:var(--color-accent);text-decoration:none;transition:color 0.2s}"
+    "a:hover{color:var(--color-accent-hover)}"
+    ".wifi-list{background:var(--color-bg-secondary);border:1px solid var(--color-border);border-radius:4px;padding:8px;max-height:300px;overflow-y:auto;margin-bottom:20px}"
+    ".wifi-item{padding:12px;margin:4px 0;background:var(--color-bg-tertiary);border:1px solid var(--color-border);border-radius:4px;cursor:pointer;transition:all 0.2s}"
+    ".wifi-item:hover{background:var(--color-bg-card);border-color:var(--color-border-hover)}"
+    ".wifi-item strong{color:var(--color-text-primary);display:block;margin-bottom:4px}"
+    ".wifi-item small{color:var(--color-text-muted);font-size:0.8rem}"
+    "table{width:100%;border-collapse:collapse;margin:20px 0}"
+    "table td,table th{padding:12px;text-align:left;border-bottom:1px solid var(--color-border);color:var(--color-text-primary)}"
+    "table th{color:var(--color-text-secondary);font-weight:400;text-transform:uppercase;font-size:0.75rem;letter-spacing:0.05em}"
+    ".msg{background:var(--color-bg-tertiary);border:1px solid var(--color-border);padding:15px;border-radius:4px;margin:15px 0;color:var(--color-text-primary)}"
+    ".msg.error{background:rgba(184,92,92,0.1);border-color:var(--color-danger);color:var(--color-danger)}"
+    ".msg.success{background:rgba(74,155,111,0.1);border-color:var(--color-success);color:var(--color-success)}"
+    "@media (max-width:768px){form{padding:16px}input[type='text'],input[type='password'],input[type='number'],select{font-size:16px}.form-row{flex-direction:column;gap:0}}"
+    "</style>";
+
+const size_t WEB_UI_PAGE_HEAD_LENGTH = sizeof(WEB_UI_PAGE_HEAD) - 1;
+const size_t WEB_UI_PAGE_TAIL_LENGTH = sizeof(WEB_UI_PAGE_TAIL) - 1;
+const size_t PORTAL_HEAD_ELEMENT_LENGTH = sizeof(PORTAL_HEAD_ELEMENT) - 1;
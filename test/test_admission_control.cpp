@@ -0,0 +1,249 @@
+#ifdef NATIVE_BUILD
+#include <unity.h>
+#include <cstdio>
+#include <cstdint>
+
+#include "admission_control.h"
+
+// =============================================================================
+// HELPERS
+// =============================================================================
+
+// Same staging as config.h
+static AdmissionThresholds testThresholds() {
+    AdmissionThresholds thresholds = {
+        {16384, 12288, 9216},
+        {6144, 4096, 3072},
+        2048,
+        4
+    };
+    return thresholds;
+}
+
+// Coarse device model: one heap counter, largest block = half of the free heap
+// (typical for a fragmented ESP8266 heap). Costs are rough on-device figures.
+#define SIM_BASE_FREE_HEAP 40000
+#define SIM_WS_CLIENT_COST 3000      // Per connected WebSocket client (buffers + PCB)
+#define SIM_CONTROL_REQUEST_COST 600 // Transient, /api/control
+#define SIM_STATUS_REQUEST_COST 2600 // Transient, /api/status
+#define SIM_BROADCAST_COST 400       // Transient, per connected client
+#define SIM_MAX_WS_CLIENTS 8
+#define SIM_DURATION_MS 12000
+
+struct SimResult {
+    uint32_t allocationFailures;
+    uint32_t controlAttempts;
+    uint32_t controlServed;
+    uint32_t statusServed;
+    uint32_t broadcasts;
+    uint32_t effectSteps;
+    uint32_t wsClients;
+    int32_t minFreeHeap;
+    uint32_t firstTickAtLevel[ADMISSION_LEVEL_COUNT];
+};
+
+struct SimHeap {
+    int32_t freeHeap;
+    int32_t minFreeHeap;
+    uint32_t failures;
+
+    bool allocate(int32_t bytes) {
+        if (bytes > freeHeap / 2) { // Must fit the largest free block
+            failures++;
+            return false;
+        }
+        freeHeap -= bytes;
+        if (freeHeap < minFreeHeap) minFreeHeap = freeHeap;
+        return true;
+    }
+    void release(int32_t bytes) { freeHeap += bytes; }
+    uint32_t maxBlock() const { return freeHeap > 0 ? static_cast<uint32_t>(freeHeap / 2) : 0; }
+};
+
+// One simulated loop() per millisecond: WebSocket clients keep arriving, the
+// UI alternates control and status requests, and a background consumer eats
+// 16KB of heap between t=1s and t=6s, returning it at t=9s.
+static SimResult runSimulation(AdmissionController* controller) {
+    SimHeap heap = {SIM_BASE_FREE_HEAP, SIM_BASE_FREE_HEAP, 0};
+    SimResult result = {};
+    for (uint8_t i = 0; i < ADMISSION_LEVEL_COUNT; i++) result.firstTickAtLevel[i] = UINT32_MAX;
+    int32_t starved = 0;
+    unsigned long lastBroadcast = 0;
+
+    for (unsigned long now = 0; now < SIM_DURATION_MS; now++) {
+        // Memory starvation
+        if (now >= 1000 && now < 6000 && now % 5 == 0 && heap.allocate(16)) starved += 16;
+        if (now == 9000) {
+            heap.release(starved);
+            starved = 0;
+        }
+
+        if (controller && now % 100 == 0) {
+            const AdmissionLevel level = controller->update(static_cast<uint32_t>(heap.freeHeap), heap.maxBlock());
+            if (result.firstTickAtLevel[level] == UINT32_MAX) result.firstTickAtLevel[level] = now;
+        }
+
+        // New WebSocket client every 400ms
+        if (now % 400 == 0 && result.wsClients < SIM_MAX_WS_CLIENTS) {
+            const bool admitted = controller == nullptr || controller->admitWebSocketClient();
+            if (admitted && heap.allocate(SIM_WS_CLIENT_COST)) result.wsClients++;
+        }
+
+        // UI traffic: control request, then status request
+        if (now % 50 == 0) {
+            result.controlAttempts++;
+            if ((controller == nullptr || controller->admitRequest(true)) && heap.allocate(SIM_CONTROL_REQUEST_COST)) {
+                heap.release(SIM_CONTROL_REQUEST_COST);
+                result.controlServed++;
+            }
+        } else if (now % 50 == 25) {
+            if ((controller == nullptr || controller->admitRequest(false)) && heap.allocate(SIM_STATUS_REQUEST_COST)) {
+                heap.release(SIM_STATUS_REQUEST_COST);
+                result.statusServed++;
+            }
+        }
+
+        // Status broadcast
+        const unsigned long interval = controller ? controller->broadcastInterval(500) : 500;
+        if (now - lastBroadcast >= interval && result.wsClients > 0) {
+            const int32_t cost = SIM_BROADCAST_COST * static_cast<int32_t>(result.wsClients);
+            if (heap.allocate(cost)) {
+                heap.release(cost);
+                result.broadcasts++;
+            }
+            lastBroadcast = now;
+        }
+
+        // Effects never allocate and never wait for admission
+        if (now % 50 == 0) result.effectSteps++;
+    }
+    result.allocationFailures = heap.failures;
+    result.minFreeHeap = heap.minFreeHeap;
+    return result;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// =============================================================================
+// UNIT TESTS
+// =============================================================================
+
+void test_admission_levelsEscalateInOrder(void) {
+    AdmissionController controller(testThresholds());
+    TEST_ASSERT_EQUAL(AdmissionNormal, controller.update(30000, 20000));
+    TEST_ASSERT_EQUAL(AdmissionRejectWebSocket, controller.update(16000, 12000));
+    TEST_ASSERT_EQUAL(AdmissionShedNonEssential, controller.update(12000, 8000));
+    TEST_ASSERT_EQUAL(AdmissionThrottleBroadcast, controller.update(9000, 6000));
+    TEST_ASSERT_EQUAL(3, controller.metrics().escalations);
+}
+
+void test_admission_maxBlockAloneEscalates(void) {
+    AdmissionController controller(testThresholds());
+    TEST_ASSERT_EQUAL(AdmissionShedNonEssential, controller.update(30000, 4000)); // Plenty free, but fragmented
+}
+
+void test_admission_hysteresisPreventsFlapping(void) {
+    AdmissionController controller(testThresholds());
+    controller.update(16000, 12000);
+    TEST_ASSERT_EQUAL(AdmissionRejectWebSocket, controller.update(16500, 12000)); // Above threshold, inside margin
+    TEST_ASSERT_EQUAL(AdmissionRejectWebSocket, controller.update(18000, 12000));
+    TEST_ASSERT_EQUAL(AdmissionNormal, controller.update(18432, 12000));
+    TEST_ASSERT_EQUAL(1, controller.metrics().escalations);
+}
+
+void test_admission_relaxesOneStageAtATime(void) {
+    AdmissionController controller(testThresholds());
+    controller.update(8000, 4000);
+    TEST_ASSERT_EQUAL(AdmissionThrottleBroadcast, controller.level());
+    TEST_ASSERT_EQUAL(AdmissionShedNonEssential, controller.update(12000, 6000));
+}
+
+void test_admission_shedDecisionsAreCounted(void) {
+    AdmissionController controller(testThresholds());
+    TEST_ASSERT_TRUE(controller.admitWebSocketClient());
+    TEST_ASSERT_TRUE(controller.admitRequest(false));
+
+    controller.update(15000, 10000);
+    TEST_ASSERT_FALSE(controller.admitWebSocketClient());
+    TEST_ASSERT_TRUE(controller.admitRequest(false));
+    TEST_ASSERT_EQUAL(500, controller.broadcastInterval(500));
+
+    controller.update(8000, 2000);
+    TEST_ASSERT_FALSE(controller.admitRequest(false));
+    TEST_ASSERT_TRUE(controller.admitRequest(true)); // Output control is never shed
+    TEST_ASSERT_TRUE(controller.throttlingBroadcasts());
+    TEST_ASSERT_EQUAL(2000, controller.broadcastInterval(500));
+    controller.recordDeferredBroadcast();
+
+    const AdmissionMetrics& metrics = controller.metrics();
+    TEST_ASSERT_EQUAL(1, metrics.webSocketRejected);
+    TEST_ASSERT_EQUAL(1, metrics.requestsShed);
+    TEST_ASSERT_EQUAL(1, metrics.broadcastsDeferred);
+    TEST_ASSERT_EQUAL(8000, metrics.minFreeHeap);
+    TEST_ASSERT_EQUAL(2000, metrics.minMaxBlock);
+}
+
+// Without admission control the starved heap runs out and requests fail
+void test_simulation_withoutAdmissionFails(void) {
+    const SimResult result = runSimulation(nullptr);
+    printf("  no admission: failures=%u control=%u/%u status=%u ws=%u minFree=%d\n",
+           result.allocationFailures, result.controlServed, result.controlAttempts,
+           result.statusServed, result.wsClients, result.minFreeHeap);
+    TEST_ASSERT_GREATER_THAN(0, result.allocationFailures);
+    TEST_ASSERT_TRUE(result.controlServed < result.controlAttempts);
+}
+
+// With admission control the same starvation sheds load in priority order and
+// every output control request and effect step still goes through
+void test_simulation_admissionShedsInOrder(void) {
+    AdmissionController controller(testThresholds());
+    const SimResult result = runSimulation(&controller);
+    const AdmissionMetrics& metrics = controller.metrics();
+    printf("  admission: failures=%u control=%u/%u status=%u ws=%u minFree=%d "
+           "wsRejected=%u shed=%u\n",
+           result.allocationFailures, result.controlServed, result.controlAttempts,
+           result.statusServed, result.wsClients, result.minFreeHeap,
+           metrics.webSocketRejected, metrics.requestsShed);
+
+    // A throttled broadcast can still miss a block at the very bottom, but
+    // the failure count collapses and no output control request is lost
+    const SimResult baseline = runSimulation(nullptr);
+    TEST_ASSERT_LESS_THAN(baseline.allocationFailures / 10, result.allocationFailures);
+    TEST_ASSERT_EQUAL(result.controlAttempts, result.controlServed);
+    TEST_ASSERT_EQUAL(SIM_DURATION_MS / 50, result.effectSteps);
+
+    // Stages were reached in order
+    TEST_ASSERT_TRUE(result.firstTickAtLevel[AdmissionRejectWebSocket] != UINT32_MAX);
+    TEST_ASSERT_TRUE(result.firstTickAtLevel[AdmissionShedNonEssential] != UINT32_MAX);
+    TEST_ASSERT_TRUE(result.firstTickAtLevel[AdmissionRejectWebSocket] <= result.firstTickAtLevel[AdmissionShedNonEssential]);
+    TEST_ASSERT_GREATER_THAN(0, metrics.webSocketRejected);
+    TEST_ASSERT_GREATER_THAN(0, metrics.requestsShed);
+
+    // Heap recovered at t=9s: requests and broadcasts are back to normal, only
+    // new WebSocket clients stay refused while eight of them hold ~24KB
+    TEST_ASSERT_EQUAL(AdmissionRejectWebSocket, controller.level());
+}
+
+// =============================================================================
+// MAIN TEST RUNNER
+// =============================================================================
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    // Controller
+    RUN_TEST(test_admission_levelsEscalateInOrder);
+    RUN_TEST(test_admission_maxBlockAloneEscalates);
+    RUN_TEST(test_admission_hysteresisPreventsFlapping);
+    RUN_TEST(test_admission_relaxesOneStageAtATime);
+    RUN_TEST(test_admission_shedDecisionsAreCounted);
+
+    // Memory starvation simulation
+    RUN_TEST(test_simulation_withoutAdmissionFails);
+    RUN_TEST(test_simulation_admissionShedsInOrder);
+
+    return UNITY_END();
+}
+
+#endif // NATIVE_BUILD
@@ -0,0 +1,521 @@
+#ifdef NATIVE_BUILD
+#include <unity.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "command_router.h"
+#include "config.h"
+#include "effect_engine.h"
+#include "output_driver.h"
+#include "output_table.h"
+#include "rtc_snapshot.h"
+#include "status_snapshot.h"
+#include "status_subscription.h"
+#include "ws_client_queue.h"
+
+#if defined(__has_include)
+#if __has_include(<ArduinoJson.h>)
+#include "json_arena.h"
+#include "status_json.h"
+#define BENCH_HAVE_ARDUINOJSON 1
+#endif
+#endif
+
+// Hot path benchmarks with regression thresholds.
+// Every benchmark times one operation of a firmware hot path through the
+// functions main.cpp calls (only the SDK and library calls around them are
+// left out) and divides the result by the time of a fixed reference workload
+// measured in the same run.
+// That relative cost carries over between machines far better than
+// nanoseconds do; host timing still says little about the ESP itself.
+// The results go to bench_results.json (RAILHUB_BENCH_RESULTS overrides the
+// path) and are compared against test/benchmark_baseline.json
+// (RAILHUB_BENCH_BASELINE): a benchmark more than its tolerance slower than
+// the baseline fails. The results file has the baseline's format, so after a
+// deliberate change copying it over the baseline records the new costs.
+
+// =============================================================================
+// HELPERS
+// =============================================================================
+
+// Same pins as LED_PINS in config.h; the wide table is the OutputTable maximum
+static const uint8_t FIRMWARE_PINS[7] = {4, 5, 12, 13, 14, 16, 2};
+static const uint8_t WIDE_PINS[32] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+                                      16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31};
+static constexpr uint8_t ROUTER_PINS[] = {4, 5, 12, 13, 14, 16, 2};
+static constexpr OutputPinMap ROUTER_OUTPUTS = makeOutputPinMap(ROUTER_PINS);
+
+// Firmware sizes (main.cpp, config.h)
+static const uint8_t BENCH_CHASING_GROUPS = 4;
+static const uint8_t BENCH_PER_GROUP = 8;
+static const uint8_t BENCH_NAME_LENGTH = 20;
+static const uint8_t BENCH_WS_CLIENTS = 5;       // WEBSOCKETS_SERVER_CLIENT_MAX
+static const size_t BENCH_STATUS_BUFFER = 2304;  // STATUS_JSON_BUFFER_SIZE
+static const size_t BENCH_WS_HEADER_SIZE = 4;    // WS_FRAME_HEADER_SIZE
+
+static const char* const DEFAULT_BASELINE_PATH = "test/benchmark_baseline.json";
+static const char* const DEFAULT_RESULTS_PATH = "bench_results.json";
+static const double DEFAULT_TOLERANCE = 0.5;     // New benchmarks: 50 % slower fails
+static const unsigned SAMPLES = 7;               // Best of, against scheduler noise
+static const double SAMPLE_NS = 5e6;             // Target duration of one sample
+
+// Relative costs shift with the optimization level: a baseline recorded
+// with other settings is not compared against and never fails the run. The
+// native_bench environment builds at -Og and says so with BENCH_BUILD_OG, as
+// no compiler macro tells -Og from -O2.
+#if defined(BENCH_BUILD_OG)
+static const char* const BENCH_BUILD = "Og";
+#elif defined(__OPTIMIZE__)
+static const char* const BENCH_BUILD = "optimized";
+#else
+static const char* const BENCH_BUILD = "unoptimized";
+#endif
+
+// Keeps the compiler from dropping the timed work
+static volatile uint32_t benchSink = 0;
+
+// Host stand-in for the pin hardware: only counts
+struct CountingPins {
+    static uint32_t writes;
+    static void pwm(uint8_t, uint8_t) { writes++; }
+    static void detachPwm(uint8_t) { writes++; }
+    static void set(uint8_t) { writes++; }
+    static void clear(uint8_t) { writes++; }
+};
+uint32_t CountingPins::writes = 0;
+
+// Output engine state as in main.cpp, for Count outputs; pin writes counted
+template <uint8_t Count>
+struct Engine {
+    typedef OutputTable<Count, BENCH_NAME_LENGTH> Table;
+
+    Table table;
+    OutputDriver<CountingPins, Count> driver;
+    ChasingGroup groups[BENCH_CHASING_GROUPS];
+
+    explicit Engine(const uint8_t (&pins)[Count]) : table(pins), driver(pins) {
+        memset(groups, 0, sizeof(groups));
+    }
+
+    // updateBlinkingOutputs()
+    void blinkTick(uint32_t now) { stepBlinkingOutputs(table, driver, now); }
+
+    // updateChasingLightGroups(), without the serial trace
+    void chaseTick(uint32_t now) {
+        stepChasingGroups(table, driver, groups, BENCH_CHASING_GROUPS, now, [](const ChasingGroup&, uint8_t, bool) {});
+    }
+
+    // Every free output blinking with 'intervalMs'
+    void blinkAll(uint16_t intervalMs) {
+        for (uint8_t i = 0; i < Count; i++) {
+            table.setOn(i, true);
+            table.interval[i] = intervalMs;
+            table.brightness[i] = static_cast<uint8_t>(i & 1 ? 255 : 128); // Half of them dimmed
+        }
+    }
+
+    // 'groupCount' groups of up to BENCH_PER_GROUP consecutive outputs
+    void chaseAll(uint8_t groupCount, uint16_t intervalMs) {
+        uint8_t next = 0;
+        for (uint8_t g = 0; g < groupCount && g < BENCH_CHASING_GROUPS; g++) {
+            ChasingGroup& group = groups[g];
+            group.groupId = static_cast<uint8_t>(g + 1);
+            group.active = true;
+            snprintf(group.name, sizeof(group.name), "Group %u", static_cast<unsigned>(group.groupId));
+            group.interval = intervalMs;
+            group.outputCount = 0;
+            while (group.outputCount < BENCH_PER_GROUP && next < Count) {
+                group.outputIndices[group.outputCount++] = next;
+                table.setOn(next, true);
+                table.group[next] = group.groupId;
+                next++;
+            }
+        }
+    }
+};
+
+typedef EffectSnapshot<7, BENCH_CHASING_GROUPS, BENCH_PER_GROUP> BenchSnapshot;
+
+// RTC clock as system_rtc_clock_cali_proc() reports it: 6.5 us per tick
+const uint32_t BENCH_RTC_PERIOD_Q12 = 26624;
+const uint32_t BENCH_RTC_TICKS_PER_MS = 154;
+
+// Command table as in main.cpp, handlers only count
+static uint32_t handled = 0;
+
+static CommandResult countHandler(const CommandArgs& args) {
+    handled += args.listCount;
+    return CommandResult::ok();
+}
+
+static const CommandField CONTROL_FIELDS[] = {
+    {"pin", CommandFieldType::Outputs, true, 1, 7, 0},
+    {"active", CommandFieldType::Boolean, true, 0, 1, 0},
+    {"brightness", CommandFieldType::Integer, false, 0, 100, 100}
+};
+
+static const CommandField INTERVAL_FIELDS[] = {
+    {"pin", CommandFieldType::Outputs, true, 1, 7, 0},
+    {"interval", CommandFieldType::Integer, true, 0, 65535, 0}
+};
+
+static const CommandField CHASING_CREATE_FIELDS[] = {
+    {"groupId", CommandFieldType::Integer, true, 1, 255, 0},
+    {"interval", CommandFieldType::Integer, true, 50, 65535, 0},
+    {"outputs", CommandFieldType::Outputs, true, 1, 8, 0},
+    {"name", CommandFieldType::Text, false, 0, 0, 0}
+};
+
+static const CommandSpec COMMANDS[] = {
+    {"control", "/api/control", countHandler, COMMAND_FIELDS(CONTROL_FIELDS), true},
+    {"interval", "/api/interval", countHandler, COMMAND_FIELDS(INTERVAL_FIELDS), true},
+    {"chasing/create", "/api/chasing/create", countHandler, COMMAND_FIELDS(CHASING_CREATE_FIELDS), true},
+    {"reset", "/api/reset", countHandler, nullptr, 0, true}
+};
+
+#ifdef BENCH_HAVE_ARDUINOJSON
+// serializeStatusToJson() for the outputs and chasingGroups sections (device
+// and diagnostics read the ESP SDK), rendered like renderStatusJson()
+typedef JsonArenaAllocator<6912> BenchJsonAllocator; // JSON_STATUS_ARENA_SIZE
+static BenchJsonAllocator benchJsonAllocator;
+
+template <uint8_t Count>
+static size_t renderStatus(const Engine<Count>& engine, uint32_t version, char* dest, size_t size) {
+    JsonArenaScope<6912> arenaScope(benchJsonAllocator);
+    JsonDocument doc(&benchJsonAllocator);
+    doc["version"] = version;
+    const StatusSubscription all = StatusSubscription::all();
+    serializeOutputsToJson(doc["outputs"].to<JsonArray>(), engine.table, all);
+    serializeChasingGroupsToJson(doc["chasingGroups"].to<JsonArray>(), engine.table, engine.groups, BENCH_CHASING_GROUPS, all);
+    if (doc.overflowed() || measureJson(doc) >= size) return 0;
+    return serializeJson(doc, dest, size);
+}
+#endif
+
+// Fixed integer workload every benchmark is measured against
+static uint32_t referenceWork(uint32_t seed) {
+    for (uint8_t i = 0; i < 64; i++) {
+        seed = seed * 1664525UL + 1013904223UL;
+        seed ^= seed >> 13;
+    }
+    return seed;
+}
+
+// Best-of-SAMPLES time of one call of 'body', in ns
+template <typename Body>
+static double measureNs(Body body) {
+    typedef std::chrono::steady_clock Clock;
+    uint32_t iterations = 1;
+    for (;;) {
+        const Clock::time_point start = Clock::now();
+        for (uint32_t i = 0; i < iterations; i++) body(i);
+        const double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        if (ns >= SAMPLE_NS / 10 || iterations >= (1UL << 28)) {
+            const double perCall = ns / iterations;
+            iterations = perCall > 0 ? static_cast<uint32_t>(SAMPLE_NS / perCall) + 1 : iterations;
+            break;
+        }
+        iterations *= 2;
+    }
+    double best = 0;
+    for (unsigned sample = 0; sample < SAMPLES; sample++) {
+        const Clock::time_point start = Clock::now();
+        for (uint32_t i = 0; i < iterations; i++) body(i);
+        const double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations;
+        if (sample == 0 || ns < best) best = ns;
+    }
+    return best;
+}
+
+struct BenchResult {
+    const char* name;
+    double nsPerOp;
+    double relative;          // nsPerOp / reference
+    double tolerance;
+    bool hasBaseline;
+    double baselineRelative;
+};
+
+static const uint8_t MAX_RESULTS = 16;
+static BenchResult results[MAX_RESULTS];
+static uint8_t resultCount = 0;
+static double referenceNs = 0;
+static std::string baselineText;
+static bool baselineLoaded = false;
+static bool baselineSameBuild = false;
+
+static const char* envOr(const char* name, const char* fallback) {
+    const char* value = getenv(name);
+    return value != nullptr && value[0] != '\0' ? value : fallback;
+}
+
+static bool readFile(const char* path, std::string& text) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) return false;
+    char buffer[512];
+    size_t length;
+    text.clear();
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) text.append(buffer, length);
+    fclose(file);
+    return true;
+}
+
+// Number after "key": inside the baseline entry of 'name' (one object per
+// benchmark, as written by writeResults())
+static bool baselineValue(const char* name, const char* key, double& value) {
+    const std::string entryKey = std::string("\"") + name + "\":";
+    const size_t entry = baselineText.find(entryKey);
+    if (entry == std::string::npos) return false;
+    const size_t end = baselineText.find('}', entry);
+    const size_t field = baselineText.find(std::string("\"") + key + "\":", entry);
+    if (field == std::string::npos || field > end) return false;
+    const char* number = baselineText.c_str() + field + strlen(key) + 3;
+    char* parsed = nullptr;
+    value = strtod(number, &parsed);
+    return parsed != number;
+}
+
+// Record a benchmark and fail if it regressed past its tolerance
+static void report(const char* name, double nsPerOp) {
+    TEST_ASSERT_TRUE(referenceNs > 0);
+    TEST_ASSERT_TRUE(resultCount < MAX_RESULTS);
+    BenchResult& result = results[resultCount++];
+    result.name = name;
+    result.nsPerOp = nsPerOp;
+    result.relative = nsPerOp / referenceNs;
+    result.tolerance = DEFAULT_TOLERANCE;
+    baselineValue(name, "tolerance", result.tolerance);
+    result.hasBaseline = baselineSameBuild && baselineValue(name, "relative", result.baselineRelative);
+
+    if (!result.hasBaseline) {
+        printf("  %-28s %10.1f ns/op  %8.3f x ref  (no baseline)\n", name, nsPerOp, result.relative);
+        return;
+    }
+    const double change = result.relative / result.baselineRelative - 1.0;
+    printf("  %-28s %10.1f ns/op  %8.3f x ref  baseline %8.3f  %+6.1f%% (limit %+.0f%%)\n", name, nsPerOp,
+           result.relative, result.baselineRelative, change * 100, result.tolerance * 100);
+    if (change > result.tolerance) {
+        char message[160];
+        snprintf(message, sizeof(message), "%s regressed %.1f%% (tolerance %.0f%%)", name, change * 100,
+                 result.tolerance * 100);
+        TEST_FAIL_MESSAGE(message);
+    }
+}
+
+void setUp(void) {
+    CountingPins::writes = 0;
+    handled = 0;
+}
+void tearDown(void) {}
+
+// =============================================================================
+// UNIT TESTS
+// =============================================================================
+
+// Runs first: the reference workload and the baseline
+void test_reference(void) {
+    baselineLoaded = readFile(envOr("RAILHUB_BENCH_BASELINE", DEFAULT_BASELINE_PATH), baselineText);
+    uint32_t seed = 1;
+    referenceNs = measureNs([&seed](uint32_t) { seed = referenceWork(seed); });
+    benchSink = seed;
+    const std::string buildKey = std::string("\"build\": \"") + BENCH_BUILD + "\"";
+    baselineSameBuild = baselineLoaded && baselineText.find(buildKey) != std::string::npos;
+    printf("  reference workload %.1f ns, %s build, baseline %s\n", referenceNs, BENCH_BUILD,
+           !baselineLoaded ? "missing (recording only)" :
+           baselineSameBuild ? "loaded" : "from another build (not compared)");
+    TEST_ASSERT_TRUE(referenceNs > 0);
+}
+
+// Serial console line: split, tokenize, validate, dispatch
+void test_commandParse(void) {
+    const TextView line = TextView::fromCString("control pin=4,5,12 active=on brightness=50");
+    uint32_t fields = 0;
+    report("command_parse", measureNs([&](uint32_t) {
+        TextView name;
+        TextView arguments;
+        splitCommandLine(line, name, arguments);
+        const KeyValueCommandInput input(arguments);
+        int32_t brightness = 0;
+        fields += input.integer("brightness", brightness) == CommandInputStatus::Ok ? static_cast<uint32_t>(brightness) : 0;
+    }));
+    benchSink = fields;
+    TEST_ASSERT_TRUE(fields > 0);
+}
+
+void test_commandDispatch(void) {
+    CommandRouter router(COMMANDS, sizeof(COMMANDS) / sizeof(COMMANDS[0]), ROUTER_OUTPUTS);
+    const TextView control = TextView::fromCString("control pin=4,5,12 active=on brightness=50");
+    const TextView create = TextView::fromCString("chasing/create groupId=1 interval=200 ids=0-6 name=Station");
+    report("command_dispatch", measureNs([&](uint32_t i) {
+        TextView name;
+        TextView arguments;
+        splitCommandLine(i & 1 ? create : control, name, arguments);
+        const KeyValueCommandInput input(arguments);
+        router.dispatch(name, input);
+    }));
+    TEST_ASSERT_EQUAL(0, router.metrics().rejected);
+    TEST_ASSERT_TRUE(handled > 0);
+}
+
+// One engine tick with every output blinking and toggling (worst case)
+void test_blinkTick(void) {
+    Engine<7> firmware(FIRMWARE_PINS);
+    firmware.blinkAll(1);
+    report("blink_tick_7", measureNs([&](uint32_t i) { firmware.blinkTick(i + 1); }));
+    TEST_ASSERT_TRUE(CountingPins::writes > 0);
+
+    Engine<32> wide(WIDE_PINS);
+    wide.blinkAll(1);
+    report("blink_tick_32", measureNs([&](uint32_t i) { wide.blinkTick(i + 1); }));
+}
+
+// One engine tick with every chasing group stepping
+void test_chaseTick(void) {
+    Engine<7> firmware(FIRMWARE_PINS);
+    firmware.chaseAll(1, 1);
+    report("chase_tick_1x7", measureNs([&](uint32_t i) { firmware.chaseTick(i + 1); }));
+    TEST_ASSERT_TRUE(CountingPins::writes > 0);
+
+    Engine<32> wide(WIDE_PINS);
+    wide.chaseAll(BENCH_CHASING_GROUPS, 1);
+    report("chase_tick_4x8", measureNs([&](uint32_t i) {
+        wide.chaseTick(i + 1);
+        wide.blinkTick(i + 1); // The engine runs both every tick; grouped outputs are skipped
+    }));
+}
+
+// RTC snapshot: capture + CRC, and validate + restore in phase
+void test_persistence(void) {
+    Engine<7> engine(FIRMWARE_PINS);
+    engine.blinkAll(500);
+    engine.chaseAll(1, 200);
+    static BenchSnapshot snapshot;
+    memset(&snapshot, 0, sizeof(snapshot));
+    report("snapshot_encode", measureNs([&](uint32_t i) {
+        const uint32_t now = 10000 + i;
+        captureEffectSnapshot(snapshot, engine.table, engine.groups, BENCH_CHASING_GROUPS, now,
+                              now * BENCH_RTC_TICKS_PER_MS, BENCH_RTC_PERIOD_Q12);
+    }));
+    TEST_ASSERT_TRUE(snapshot.valid());
+
+    Engine<7> restored(FIRMWARE_PINS);
+    uint32_t restores = 0;
+    uint32_t gapMs = 0;
+    const uint32_t rtcAfterReset = snapshot.rtcTime + 250 * BENCH_RTC_TICKS_PER_MS;
+    report("snapshot_decode", measureNs([&](uint32_t i) {
+        restores += restoreEffectSnapshot(snapshot, restored.table, restored.groups, BENCH_CHASING_GROUPS, 20000 + i,
+                                          rtcAfterReset, gapMs) ? 1 : 0;
+    }));
+    benchSink = restores;
+    TEST_ASSERT_TRUE(restores > 0);
+    TEST_ASSERT_TRUE(gapMs >= 240 && gapMs <= 260);
+    TEST_ASSERT_EQUAL(engine.table.on, restored.table.on);
+}
+
+// Status change to WebSocket frames: snapshot slot, per-client queues, and
+// each pending client's frame (header + payload) written out as sendTXT()
+// would
+void test_wsFrames(void) {
+    typedef SnapshotStore<BENCH_STATUS_BUFFER, 2> Store;
+    static Store store;
+    WsClientQueues<BENCH_WS_CLIENTS> queues(3000, 4);
+    for (uint8_t num = 0; num < 4; num++) queues.connect(num, 0);
+    static char status[1100];
+    memset(status, 'x', sizeof(status));
+    static uint8_t tx[BENCH_STATUS_BUFFER + BENCH_WS_HEADER_SIZE];
+    uint32_t frames = 0;
+
+    report("ws_frame_fanout_4", measureNs([&](uint32_t i) {
+        Store::Snapshot* snapshot = store.beginBuild();
+        memcpy(snapshot->data, status, sizeof(status));
+        store.publish(snapshot, sizeof(status), i, i);
+        const StatusChange change = StatusChange::output(static_cast<uint8_t>(i % 7));
+        const StatusSubscription all = StatusSubscription::all();
+        for (uint8_t num = 0; num < BENCH_WS_CLIENTS; num++) {
+            if (all.wants(change, true)) queues.publish(num, i);
+        }
+        const Store::Snapshot* current = store.current();
+        for (uint8_t num = 0; num < BENCH_WS_CLIENTS; num++) {
+            if (queues.poll(num, WS_TCP_SEND_BUFFER, current->length + BENCH_WS_HEADER_SIZE, i) != WsClientQueues<BENCH_WS_CLIENTS>::Send) {
+                continue;
+            }
+            tx[0] = 0x81;                                      // FIN, text
+            tx[1] = 126;                                       // 16-bit length follows
+            tx[2] = static_cast<uint8_t>(current->length >> 8);
+            tx[3] = static_cast<uint8_t>(current->length);
+            memcpy(tx + BENCH_WS_HEADER_SIZE, current->data, current->length);
+            queues.markSent(num, i);
+            frames++;
+        }
+    }));
+    benchSink = tx[BENCH_WS_HEADER_SIZE + 7];
+    TEST_ASSERT_TRUE(frames > 0);
+    TEST_ASSERT_EQUAL(0, queues.metrics().slowDisconnects);
+}
+
+void test_statusSerialize(void) {
+#ifdef BENCH_HAVE_ARDUINOJSON
+    Engine<7> engine(FIRMWARE_PINS);
+    engine.blinkAll(500);
+    engine.chaseAll(1, 200);
+    for (uint8_t i = 0; i < 7; i++) snprintf(engine.table.names[i], BENCH_NAME_LENGTH + 1, "Signal %u", i);
+    static char buffer[BENCH_STATUS_BUFFER];
+    size_t length = 0;
+    report("status_serialize", measureNs([&](uint32_t i) { length = renderStatus(engine, i, buffer, sizeof(buffer)); }));
+    TEST_ASSERT_TRUE(length > 0);
+#else
+    TEST_IGNORE_MESSAGE("ArduinoJson not on the include path");
+#endif
+}
+
+// Runs last: the results file, in the baseline's format
+void test_writeResults(void) {
+    const char* path = envOr("RAILHUB_BENCH_RESULTS", DEFAULT_RESULTS_PATH);
+    FILE* file = fopen(path, "w");
+    TEST_ASSERT_NOT_NULL(file);
+    fprintf(file, "{\n  \"build\": \"%s\",\n  \"reference_ns\": %.2f,\n  \"benchmarks\": {\n", BENCH_BUILD, referenceNs);
+    for (uint8_t i = 0; i < resultCount; i++) {
+        fprintf(file, "    \"%s\": {\"ns_per_op\": %.1f, \"relative\": %.4f, \"tolerance\": %.2f}%s\n",
+                results[i].name, results[i].nsPerOp, results[i].relative, results[i].tolerance,
+                i + 1 < resultCount ? "," : "");
+    }
+    fprintf(file, "  }\n}\n");
+    fclose(file);
+    printf("  %u results written to %s\n", static_cast<unsigned>(resultCount), path);
+    TEST_ASSERT_TRUE(resultCount > 0);
+}
+
+// =============================================================================
+// MAIN TEST RUNNER
+// =============================================================================
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_reference);
+
+    // Commands
+    RUN_TEST(test_commandParse);
+    RUN_TEST(test_commandDispatch);
+
+    // Output engine
+    RUN_TEST(test_blinkTick);
+    RUN_TEST(test_chaseTick);
+
+    // Persistence
+    RUN_TEST(test_persistence);
+
+    // Status
+    RUN_TEST(test_wsFrames);
+    RUN_TEST(test_statusSerialize);
+
+    RUN_TEST(test_writeResults);
+
+    return UNITY_END();
+}
+
+#endif // NATIVE_BUILD
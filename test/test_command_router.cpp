@@ -0,0 +1,387 @@
+#ifdef NATIVE_BUILD
+#include <unity.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "command_router.h"
+
+// =============================================================================
+// HELPERS
+// =============================================================================
+
+// Same pins as LED_PINS in config.h
+static constexpr uint8_t TEST_PINS[] = {4, 5, 12, 13, 14, 16, 2};
+static constexpr OutputPinMap TEST_OUTPUTS = makeOutputPinMap(TEST_PINS);
+
+// Last arguments a handler saw
+static CommandArgs lastArgs;
+static int handlerCalls = 0;
+
+static CommandResult recordArgs(const CommandArgs& args) {
+    lastArgs = args;
+    handlerCalls++;
+    return CommandResult::ok();
+}
+
+static CommandResult controlHandler(const CommandArgs& args) {
+    recordArgs(args);
+    return CommandResult::ok("ok");
+}
+
+static CommandResult groupHandler(const CommandArgs& args) {
+    recordArgs(args);
+    if (args.number(0) != 1) return CommandResult::notFound("Group not found", "groupId");
+    return CommandResult::ok();
+}
+
+// Mirrors the firmware's command tables
+static const CommandField CONTROL_FIELDS[] = {
+    {"pin", CommandFieldType::Outputs, true, 1, 7, 0},
+    {"active", CommandFieldType::Boolean, true, 0, 1, 0},
+    {"brightness", CommandFieldType::Integer, false, 0, 100, 100}
+};
+
+static const CommandField CHASING_CREATE_FIELDS[] = {
+    {"groupId", CommandFieldType::Integer, true, 1, 255, 0},
+    {"interval", CommandFieldType::Integer, true, 50, 65535, 0},
+    {"outputs", CommandFieldType::Outputs, true, 1, 8, 0},
+    {"name", CommandFieldType::Text, false, 0, 0, 0}
+};
+
+static const CommandField NAME_FIELDS[] = {
+    {"pin", CommandFieldType::Output, true, 0, 0, 0},
+    {"name", CommandFieldType::Text, false, 0, 0, 0}
+};
+
+static const CommandField CHASING_NAME_FIELDS[] = {
+    {"groupId", CommandFieldType::Integer, true, 1, 255, 0},
+    {"name", CommandFieldType::Text, false, 0, 0, 0}
+};
+
+static const CommandSpec COMMANDS[] = {
+    {"control", "/api/control", controlHandler, COMMAND_FIELDS(CONTROL_FIELDS), true},
+    {"name", "/api/name", recordArgs, COMMAND_FIELDS(NAME_FIELDS), false},
+    {"chasing/create", "/api/chasing/create", recordArgs, COMMAND_FIELDS(CHASING_CREATE_FIELDS), true},
+    {"chasing/name", "/api/chasing/name", groupHandler, COMMAND_FIELDS(CHASING_NAME_FIELDS), false},
+    {"reset", "/api/reset", recordArgs, nullptr, 0, true}
+};
+
+static CommandRouter makeRouter() {
+    return CommandRouter(COMMANDS, sizeof(COMMANDS) / sizeof(COMMANDS[0]), TEST_OUTPUTS);
+}
+
+// Dispatch a serial console line
+static CommandResult run(CommandRouter& router, const char* line) {
+    TextView name;
+    TextView arguments;
+    splitCommandLine(TextView::fromCString(line), name, arguments);
+    const KeyValueCommandInput input(arguments);
+    TEST_ASSERT_TRUE(input.valid());
+    return router.dispatch(name, input);
+}
+
+static void assertError(const CommandResult& result, uint16_t httpStatus, const char* message, const char* field) {
+    TEST_ASSERT_FALSE(result.succeeded());
+    TEST_ASSERT_EQUAL(httpStatus, result.httpStatus());
+    TEST_ASSERT_EQUAL_STRING(message, result.message);
+    if (field == nullptr) {
+        TEST_ASSERT_NULL(result.field);
+    } else {
+        TEST_ASSERT_EQUAL_STRING(field, result.field);
+    }
+}
+
+// Typed input as a JSON body delivers it (a number where a string belongs, ...)
+class FixedInput : public CommandInput {
+public:
+    CommandInputStatus integerStatus = CommandInputStatus::Missing;
+    CommandInputStatus textStatus = CommandInputStatus::Missing;
+
+    CommandInputStatus integer(const char*, int32_t& value) const override {
+        value = 4;
+        return integerStatus;
+    }
+    CommandInputStatus boolean(const char*, bool& value) const override {
+        value = true;
+        return CommandInputStatus::Ok;
+    }
+    CommandInputStatus text(const char*, TextView& value) const override {
+        value = TextView::fromCString("  Yard  ");
+        return textStatus;
+    }
+    CommandInputStatus integers(const char*, int32_t*, uint8_t, uint8_t&) const override {
+        return CommandInputStatus::Invalid;
+    }
+};
+
+void setUp(void) {
+    memset(&lastArgs, 0, sizeof(lastArgs));
+    handlerCalls = 0;
+}
+void tearDown(void) {}
+
+// =============================================================================
+// UNIT TESTS
+// =============================================================================
+
+void test_keyValue_splitsPairsAndQuotes(void) {
+    const KeyValueCommandInput input(TextView::fromCString(" pin=4  active=on name=\"Yard lights\" outputs=4,5,12"));
+    TEST_ASSERT_TRUE(input.valid());
+
+    int32_t number = 0;
+    TEST_ASSERT_EQUAL(CommandInputStatus::Ok, input.integer("pin", number));
+    TEST_ASSERT_EQUAL(4, number);
+    bool flag = false;
+    TEST_ASSERT_EQUAL(CommandInputStatus::Ok, input.boolean("active", flag));
+    TEST_ASSERT_TRUE(flag);
+    TextView text;
+    TEST_ASSERT_EQUAL(CommandInputStatus::Ok, input.text("name", text));
+    TEST_ASSERT_TRUE(text.equals("Yard lights"));
+    int32_t values[2];
+    uint8_t count = 0;
+    TEST_ASSERT_EQUAL(CommandInputStatus::Ok, input.integers("outputs", values, 2, count));
+    TEST_ASSERT_EQUAL(3, count); // Full length, even past the capacity
+    TEST_ASSERT_EQUAL(5, values[1]);
+
+    TEST_ASSERT_EQUAL(CommandInputStatus::Missing, input.integer("interval", number));
+    TEST_ASSERT_EQUAL(CommandInputStatus::Invalid, input.integer("name", number));
+    TEST_ASSERT_EQUAL(CommandInputStatus::Invalid, input.boolean("pin", flag));
+}
+
+void test_keyValue_rejectsMalformedLines(void) {
+    TEST_ASSERT_FALSE(KeyValueCommandInput(TextView::fromCString("pin 4")).valid());
+    TEST_ASSERT_FALSE(KeyValueCommandInput(TextView::fromCString("name=\"unterminated")).valid());
+    TEST_ASSERT_FALSE(KeyValueCommandInput(TextView::fromCString("a=1 b=2 c=3 d=4 e=5 f=6 g=7")).valid());
+    TEST_ASSERT_TRUE(KeyValueCommandInput(TextView()).valid());
+
+    int32_t number = 0;
+    TEST_ASSERT_FALSE(parseCommandInteger(TextView::fromCString("-"), number));
+    TEST_ASSERT_FALSE(parseCommandInteger(TextView::fromCString("1234567890"), number));
+    TEST_ASSERT_TRUE(parseCommandInteger(TextView::fromCString("-12"), number));
+    TEST_ASSERT_EQUAL(-12, number);
+}
+
+void test_dispatch_validatesAndAppliesDefaults(void) {
+    CommandRouter router = makeRouter();
+    const CommandResult result = run(router, "control pin=13 active=1");
+    TEST_ASSERT_TRUE(result.succeeded());
+    TEST_ASSERT_EQUAL_STRING("ok", result.message);
+    TEST_ASSERT_EQUAL(1, handlerCalls);
+    TEST_ASSERT_EQUAL(1, lastArgs.number(0));   // One output...
+    TEST_ASSERT_EQUAL(1, lastArgs.listCount);
+    TEST_ASSERT_EQUAL(3, lastArgs.list[0]);     // ...GPIO 13, output ID 3
+    TEST_ASSERT_TRUE(lastArgs.flag(1));
+    TEST_ASSERT_FALSE(lastArgs.has(2));
+    TEST_ASSERT_EQUAL(100, lastArgs.number(2)); // Default brightness
+}
+
+void test_dispatch_reportsFieldErrors(void) {
+    CommandRouter router = makeRouter();
+    assertError(run(router, "control active=1"), 400, "Missing field", "pin");
+    assertError(run(router, "control pin=15 active=1"), 404, "Output not found", "pin");
+    assertError(run(router, "control pin=4 active=maybe"), 400, "Invalid value", "active");
+    assertError(run(router, "control pin=4 active=1 brightness=101"), 400, "Out of range", "brightness");
+    assertError(run(router, "chasing/create groupId=0 interval=100 outputs=4"), 400, "Out of range", "groupId");
+    assertError(run(router, "chasing/create groupId=1 interval=49 outputs=4"), 400, "Out of range", "interval");
+    assertError(run(router, "lights pin=4"), 404, "Unknown command", nullptr);
+    TEST_ASSERT_EQUAL(0, handlerCalls);
+
+    const CommandMetrics& metrics = router.metrics();
+    TEST_ASSERT_EQUAL(0, metrics.dispatched);
+    TEST_ASSERT_EQUAL(6, metrics.rejected);
+    TEST_ASSERT_EQUAL(1, metrics.unknown);
+}
+
+void test_dispatch_outputPinLists(void) {
+    CommandRouter router = makeRouter();
+    TEST_ASSERT_TRUE(run(router, "chasing/create groupId=2 interval=200 outputs=4,5,2 name=\"  Yard \"").succeeded());
+    TEST_ASSERT_EQUAL(3, lastArgs.listCount);
+    TEST_ASSERT_EQUAL(0, lastArgs.list[0]);
+    TEST_ASSERT_EQUAL(1, lastArgs.list[1]);
+    TEST_ASSERT_EQUAL(6, lastArgs.list[2]);
+    TEST_ASSERT_EQUAL_STRING("Yard", lastArgs.text(3));
+
+    assertError(run(router, "chasing/create groupId=2 interval=200 outputs=4,5,4"), 400, "Duplicate GPIO pin", "outputs");
+    assertError(run(router, "chasing/create groupId=2 interval=200 outputs=4,15"), 400, "Invalid GPIO pin", "outputs");
+    assertError(run(router, "chasing/create groupId=2 interval=200 outputs=4,5,12,13,14,16,2,4,5"), 400,
+                "Wrong number of outputs", "outputs");
+    assertError(run(router, "chasing/create groupId=2 interval=200 outputs=4,x"), 400, "Invalid value", "outputs");
+}
+
+void test_dispatch_outputIds(void) {
+    CommandRouter router = makeRouter();
+    TEST_ASSERT_TRUE(run(router, "name id=6 name=Porch").succeeded());
+    TEST_ASSERT_EQUAL(6, lastArgs.number(0));
+    TEST_ASSERT_TRUE(run(router, "name pin=2 name=Porch").succeeded()); // Same output by GPIO
+    TEST_ASSERT_EQUAL(6, lastArgs.number(0));
+    TEST_ASSERT_TRUE(run(router, "control id=3 active=1").succeeded());
+    TEST_ASSERT_EQUAL(1, lastArgs.listCount);
+    TEST_ASSERT_EQUAL(3, lastArgs.list[0]);
+
+    assertError(run(router, "name id=7"), 404, "Output not found", "id");
+    assertError(run(router, "name id=x"), 400, "Invalid value", "id");
+    assertError(run(router, "control id=9 active=1"), 404, "Output not found", "id");
+    assertError(run(router, "name"), 400, "Missing field", "pin");
+}
+
+void test_dispatch_bulkAddressing(void) {
+    CommandRouter router = makeRouter();
+    TEST_ASSERT_TRUE(run(router, "control ids=0-2,6 active=0").succeeded());
+    TEST_ASSERT_EQUAL(4, lastArgs.listCount);
+    TEST_ASSERT_EQUAL(2, lastArgs.list[2]);
+    TEST_ASSERT_EQUAL(6, lastArgs.list[3]);
+
+    TEST_ASSERT_TRUE(run(router, "control mask=127 active=1").succeeded()); // Every output
+    TEST_ASSERT_EQUAL(7, lastArgs.listCount);
+    TEST_ASSERT_EQUAL(6, lastArgs.list[6]);
+
+    // Chase order follows the list; a descending range runs backwards
+    TEST_ASSERT_TRUE(run(router, "chasing/create groupId=3 interval=100 ids=5-3").succeeded());
+    TEST_ASSERT_EQUAL(3, lastArgs.listCount);
+    TEST_ASSERT_EQUAL(5, lastArgs.list[0]);
+    TEST_ASSERT_EQUAL(3, lastArgs.list[2]);
+
+    assertError(run(router, "control ids=0-7 active=1"), 400, "Wrong number of outputs", "ids");
+    assertError(run(router, "control ids=5,7 active=1"), 400, "Invalid output id", "ids");
+    assertError(run(router, "control ids=7 active=1"), 404, "Output not found", "ids");
+    assertError(run(router, "control ids=1,1 active=1"), 400, "Duplicate output id", "ids");
+    assertError(run(router, "control ids=1-x active=1"), 400, "Invalid value", "ids");
+    assertError(run(router, "control mask=128 active=1"), 404, "Output not found", "mask");
+    assertError(run(router, "control mask=384 active=1"), 400, "Invalid output id", "mask");
+    assertError(run(router, "control mask=0 active=1"), 400, "Wrong number of outputs", "mask");
+    assertError(run(router, "control mask=-1 active=1"), 400, "Invalid value", "mask");
+}
+
+void test_outputPinMap_compileTimeTable(void) {
+    static_assert(TEST_OUTPUTS.idOf(13) == 3, "Built at compile time");
+    static_assert(outputPinsValid(TEST_PINS), "Test pins are distinct and on the chip");
+    static constexpr uint8_t DUPLICATE_PINS[] = {4, 5, 4};
+    static constexpr uint8_t OFF_CHIP_PINS[] = {4, 17};
+    static_assert(!outputPinsValid(DUPLICATE_PINS), "Duplicates are refused");
+    static_assert(!outputPinsValid(OFF_CHIP_PINS), "GPIO 17 doesn't exist");
+
+    for (uint8_t id = 0; id < 7; id++) {
+        TEST_ASSERT_EQUAL(id, TEST_OUTPUTS.idOf(TEST_PINS[id]));
+    }
+    TEST_ASSERT_EQUAL(-1, TEST_OUTPUTS.idOf(0));
+    TEST_ASSERT_EQUAL(-1, TEST_OUTPUTS.idOf(15));
+    TEST_ASSERT_EQUAL(-1, TEST_OUTPUTS.idOf(-1));
+    TEST_ASSERT_EQUAL(-1, TEST_OUTPUTS.idOf(255));
+    TEST_ASSERT_TRUE(TEST_OUTPUTS.validId(6));
+    TEST_ASSERT_FALSE(TEST_OUTPUTS.validId(7));
+
+    char directory[outputDirectorySize(7)];
+    const size_t length = formatOutputDirectory(directory, sizeof(directory), TEST_PINS, 7);
+    TEST_ASSERT_EQUAL(strlen(directory), length);
+    TEST_ASSERT_EQUAL(0, strcmp("{\"outputs\":[{\"id\":0,\"pin\":4},{\"id\":1,\"pin\":5},{\"id\":2,\"pin\":12},"
+                                "{\"id\":3,\"pin\":13},{\"id\":4,\"pin\":14},{\"id\":5,\"pin\":16},{\"id\":6,\"pin\":2}]}",
+                                directory));
+    TEST_ASSERT_EQUAL(0, formatOutputDirectory(directory, 20, TEST_PINS, 7)); // Too small: nothing
+}
+
+void test_dispatch_textAndTypeErrors(void) {
+    CommandRouter router = makeRouter();
+    const CommandSpec* chasingName = router.findByPath(TextView::fromCString("/api/chasing/name"));
+    TEST_ASSERT_NOT_NULL(chasingName);
+    TEST_ASSERT_FALSE(chasingName->essential);
+
+    FixedInput input;
+    input.integerStatus = CommandInputStatus::Ok;   // groupId 4
+    assertError(router.dispatch(*chasingName, input), 404, "Group not found", "groupId");
+    TEST_ASSERT_EQUAL_STRING("", lastArgs.text(1)); // Absent name is empty
+    TEST_ASSERT_FALSE(lastArgs.has(1));
+
+    input.textStatus = CommandInputStatus::Ok;
+    router.dispatch(*chasingName, input);
+    TEST_ASSERT_EQUAL_STRING("Yard", lastArgs.text(1));
+
+    input.textStatus = CommandInputStatus::Invalid; // e.g. "name": 5
+    assertError(router.dispatch(*chasingName, input), 400, "Invalid value", "name");
+    input.integerStatus = CommandInputStatus::Invalid;
+    assertError(router.dispatch(*chasingName, input), 400, "Invalid value", "groupId");
+
+    // No fields: any input will do
+    TEST_ASSERT_TRUE(run(router, "reset").succeeded());
+}
+
+void test_formatReply(void) {
+    char reply[COMMAND_REPLY_SIZE];
+    formatCommandReply(reply, sizeof(reply), CommandResult::ok());
+    TEST_ASSERT_EQUAL_STRING("{\"success\":true}", reply);
+    formatCommandReply(reply, sizeof(reply), CommandResult::ok("reset_complete"));
+    TEST_ASSERT_EQUAL_STRING("{\"status\":\"reset_complete\"}", reply);
+    formatCommandReply(reply, sizeof(reply), CommandResult::invalid("Out of range", "groupId"));
+    TEST_ASSERT_EQUAL_STRING("{\"error\":\"Out of range\",\"field\":\"groupId\"}", reply);
+    const size_t length = formatCommandReply(reply, sizeof(reply), CommandResult::unavailable("Low memory, retry later"));
+    TEST_ASSERT_EQUAL_STRING("{\"error\":\"Low memory, retry later\"}", reply);
+    TEST_ASSERT_EQUAL(strlen(reply), length);
+    TEST_ASSERT_EQUAL(503, CommandResult::unavailable("x").httpStatus());
+
+    // Too long for the buffer: a fixed reply, never cut-off JSON or an overflow
+    char message[COMMAND_REPLY_SIZE];
+    memset(message, 'x', sizeof(message) - 1);
+    message[sizeof(message) - 1] = '\0';
+    TEST_ASSERT_EQUAL(26, formatCommandReply(reply, sizeof(reply), CommandResult::invalid(message, "groupId")));
+    TEST_ASSERT_EQUAL_STRING("{\"error\":\"Command failed\"}", reply);
+    TEST_ASSERT_EQUAL(16, formatCommandReply(reply, sizeof(reply), CommandResult::ok(message)));
+    TEST_ASSERT_EQUAL_STRING("{\"success\":true}", reply);
+    char small[8];
+    TEST_ASSERT_EQUAL(0, formatCommandReply(small, sizeof(small), CommandResult::ok()));
+    TEST_ASSERT_EQUAL_STRING("", small);
+}
+
+// Parse + validate + dispatch cost of a typical control command; printed for
+// comparison across changes, not asserted (host timing says little about the ESP)
+void test_dispatch_benchmark(void) {
+    CommandRouter router = makeRouter();
+    const TextView name = TextView::fromCString("control");
+    const TextView arguments = TextView::fromCString("pin=14 active=on brightness=50");
+    const unsigned iterations = 200000;
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < iterations; i++) {
+        const KeyValueCommandInput input(arguments);
+        router.dispatch(name, input);
+    }
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    TEST_ASSERT_EQUAL(iterations, router.metrics().dispatched);
+    TEST_ASSERT_EQUAL(4, lastArgs.list[0]);
+    TEST_ASSERT_EQUAL(50, lastArgs.number(2));
+    printf("  control dispatch: %.0f ns/command over %u commands\n", ns / iterations, iterations);
+}
+
+// =============================================================================
+// MAIN TEST RUNNER
+// =============================================================================
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    // Console input
+    RUN_TEST(test_keyValue_splitsPairsAndQuotes);
+    RUN_TEST(test_keyValue_rejectsMalformedLines);
+
+    // Validation and dispatch
+    RUN_TEST(test_dispatch_validatesAndAppliesDefaults);
+    RUN_TEST(test_dispatch_reportsFieldErrors);
+    RUN_TEST(test_dispatch_outputPinLists);
+    RUN_TEST(test_dispatch_outputIds);
+    RUN_TEST(test_dispatch_bulkAddressing);
+    RUN_TEST(test_dispatch_textAndTypeErrors);
+
+    // Output addressing
+    RUN_TEST(test_outputPinMap_compileTimeTable);
+
+    // Replies
+    RUN_TEST(test_formatReply);
+
+    // Performance
+    RUN_TEST(test_dispatch_benchmark);
+
+    return UNITY_END();
+}
+
+#endif // NATIVE_BUILD
@@ -0,0 +1,293 @@
+#ifdef NATIVE_BUILD
+#include <unity.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "flight_recorder.h"
+
+// =============================================================================
+// HELPERS
+// =============================================================================
+
+static const uint8_t TEST_PINS[7] = {4, 5, 12, 13, 14, 16, 2};
+static const char* const TEST_COMMANDS[] = {"control", "interval", "chasing/create"};
+
+static const char* testCommandName(uint8_t index) { return TEST_COMMANDS[index]; }
+
+// What GET /api/trace sends: header, then both spans of the ring
+template <size_t Capacity>
+static std::vector<uint8_t> download(const FlightRecorder<Capacity>& recorder, uint32_t nowMs) {
+    uint8_t header[128];
+    const size_t headerLength = formatTraceHeader(header, sizeof(header), recorder, TEST_PINS, 7, 4, 3,
+                                                  testCommandName, nowMs);
+    std::vector<uint8_t> trace(header, header + headerLength);
+    for (uint8_t i = 0; i < 2; i++) {
+        const uint8_t* data;
+        const size_t length = recorder.span(i, data);
+        trace.insert(trace.end(), data, data + length);
+    }
+    return trace;
+}
+
+static uint32_t countRecords(const std::vector<uint8_t>& trace, TraceEvent event) {
+    TraceReader reader;
+    TEST_ASSERT_TRUE(reader.open(trace.data(), trace.size()));
+    TraceRecord record;
+    uint32_t count = 0;
+    while (reader.next(record)) {
+        if (record.event == event) count++;
+    }
+    TEST_ASSERT_FALSE(reader.malformed());
+    return count;
+}
+
+static OutputCommand makeCommand(OutputCommandType type, uint8_t target) {
+    OutputCommand command;
+    memset(&command, 0, sizeof(command));
+    command.type = type;
+    command.target = target;
+    return command;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// =============================================================================
+// UNIT TESTS
+// =============================================================================
+
+void test_trace_roundTrip(void) {
+    FlightRecorder<512> recorder;
+    const uint8_t address[4] = {192, 168, 1, 20};
+    TEST_ASSERT_TRUE(recorder.recordConnect(1000, 2, address));
+    TEST_ASSERT_TRUE(recorder.recordCommand(1003, TraceSource::WebSocket, 2, 1, 0));
+    TEST_ASSERT_TRUE(recorder.recordOverrun(1150, 120000));
+    TEST_ASSERT_TRUE(recorder.recordDisconnect(400000, 2)); // Delta needs three LEB128 bytes
+
+    const std::vector<uint8_t> trace = download(recorder, 400010);
+    TraceReader reader;
+    TEST_ASSERT_TRUE(reader.open(trace.data(), trace.size()));
+    TEST_ASSERT_EQUAL(7, reader.outputs());
+    TEST_ASSERT_EQUAL(4, reader.groups());
+    TEST_ASSERT_EQUAL(CHASING_GROUP_MAX_OUTPUTS, reader.outputsPerGroup());
+    TEST_ASSERT_EQUAL(16, reader.pins()[5]);
+    TEST_ASSERT_EQUAL_STRING("chasing/create", reader.commandName(2));
+    TEST_ASSERT_EQUAL_STRING("?", reader.commandName(TRACE_UNKNOWN_COMMAND));
+    TEST_ASSERT_EQUAL(1000, reader.firstMs());
+    TEST_ASSERT_EQUAL(400010, reader.endMs());
+    TEST_ASSERT_EQUAL(4, reader.recorded());
+
+    TraceRecord record;
+    TEST_ASSERT_TRUE(reader.next(record));
+    TEST_ASSERT_EQUAL(static_cast<int>(TraceEvent::ClientConnect), static_cast<int>(record.event));
+    TEST_ASSERT_EQUAL(1000, record.timeMs);
+    TEST_ASSERT_EQUAL(5, record.length);
+    TEST_ASSERT_EQUAL(168, record.payload[2]);
+
+    TEST_ASSERT_TRUE(reader.next(record));
+    TEST_ASSERT_EQUAL(static_cast<int>(TraceEvent::Command), static_cast<int>(record.event));
+    TEST_ASSERT_EQUAL(1003, record.timeMs);
+    TEST_ASSERT_EQUAL((1 << 6) | 2, record.payload[0]);
+    TEST_ASSERT_EQUAL(1, record.payload[1]);
+
+    TEST_ASSERT_TRUE(reader.next(record));
+    TEST_ASSERT_EQUAL(1150, record.timeMs);
+    TEST_ASSERT_EQUAL(120000, getTraceU32(record.payload));
+
+    TEST_ASSERT_TRUE(reader.next(record));
+    TEST_ASSERT_EQUAL(static_cast<int>(TraceEvent::ClientDisconnect), static_cast<int>(record.event));
+    TEST_ASSERT_EQUAL(400000, record.timeMs);
+
+    TEST_ASSERT_FALSE(reader.next(record));
+    TEST_ASSERT_FALSE(reader.malformed());
+}
+
+void test_ring_evictsOldestWhole(void) {
+    FlightRecorder<64> recorder;
+    for (uint32_t i = 0; i < 40; i++) {
+        TEST_ASSERT_TRUE(recorder.recordOverrun(1000 + i * 10, i));
+        TEST_ASSERT_TRUE(recorder.size() <= 64);
+    }
+    const FlightRecorderMetrics metrics = recorder.metrics();
+    TEST_ASSERT_EQUAL(40, metrics.recorded);
+    TEST_ASSERT_TRUE(metrics.evicted > 0);
+
+    // What is left is the newest records, intact and with their own times
+    const std::vector<uint8_t> trace = download(recorder, 2000);
+    TraceReader reader;
+    TEST_ASSERT_TRUE(reader.open(trace.data(), trace.size()));
+    TraceRecord record;
+    uint32_t expected = metrics.evicted;
+    while (reader.next(record)) {
+        TEST_ASSERT_EQUAL(1000 + expected * 10, record.timeMs);
+        TEST_ASSERT_EQUAL(expected, getTraceU32(record.payload));
+        expected++;
+    }
+    TEST_ASSERT_FALSE(reader.malformed());
+    TEST_ASSERT_EQUAL(40, expected);
+}
+
+void test_ring_spansCoverWrap(void) {
+    FlightRecorder<64> recorder;
+    for (uint32_t i = 0; i < 10; i++) recorder.recordOverrun(i, i);
+    const uint8_t* first;
+    const uint8_t* second;
+    const size_t firstLength = recorder.span(0, first);
+    const size_t secondLength = recorder.span(1, second);
+    TEST_ASSERT_EQUAL(recorder.size(), firstLength + secondLength);
+    TEST_ASSERT_TRUE(secondLength > 0); // Ten 7-byte records have wrapped a 64-byte ring
+    TEST_ASSERT_EQUAL(static_cast<int>(TraceEvent::PassOverrun), first[0]);
+}
+
+void test_keyframe_cadence(void) {
+    FlightRecorder<256> recorder;
+    const uint8_t state[40] = {0};
+    TEST_ASSERT_TRUE(recorder.keyframeDue()); // None yet
+    recorder.record(TraceEvent::Keyframe, 0, state, sizeof(state));
+    TEST_ASSERT_FALSE(recorder.keyframeDue());
+
+    uint32_t now = 0;
+    while (!recorder.keyframeDue()) recorder.recordOverrun(++now, 5000);
+    TEST_ASSERT_TRUE(recorder.metrics().bytes >= 40 + 128);
+    TEST_ASSERT_EQUAL(1, recorder.metrics().keyframes);
+}
+
+// Keyframes on the firmware's cadence (due checked once per event, as the
+// effect task checks it once per tick): every dump holds at least one
+void test_keyframe_alwaysInRing(void) {
+    FlightRecorder<1024> recorder;
+    uint8_t state[128];
+    memset(state, 0x5A, sizeof(state)); // 1/8 of the ring
+    OutputCommand command = makeCommand(OutputCommandType::CreateGroup, 3);
+    command.interval = 200;
+    command.outputCount = 8;
+    strcpy(command.name, "Platform lights");
+
+    for (uint32_t i = 0; i < 500; i++) {
+        if (recorder.keyframeDue()) recorder.record(TraceEvent::Keyframe, i, state, sizeof(state));
+        recorder.recordCommand(i, TraceSource::Http, 1, 3, 0);
+        recorder.recordOutputCommand(i, command);
+        TEST_ASSERT_TRUE(countRecords(download(recorder, i), TraceEvent::Keyframe) >= 1);
+    }
+    TEST_ASSERT_TRUE(recorder.metrics().evicted > 0);
+}
+
+void test_hold_dropsUntilRelease(void) {
+    FlightRecorder<128> recorder;
+    recorder.recordDisconnect(10, 1);
+    recorder.hold();
+    TEST_ASSERT_FALSE(recorder.recordDisconnect(20, 2));
+    TEST_ASSERT_FALSE(recorder.keyframeDue());
+    TEST_ASSERT_EQUAL(1, recorder.metrics().dropped);
+    TEST_ASSERT_EQUAL(1, recorder.metrics().recorded);
+    recorder.release();
+    TEST_ASSERT_TRUE(recorder.recordDisconnect(30, 3));
+    TEST_ASSERT_EQUAL(2, countRecords(download(recorder, 40), TraceEvent::ClientDisconnect));
+}
+
+void test_disabled_recordsNothing(void) {
+    FlightRecorder<0> recorder;
+    TEST_ASSERT_FALSE(FlightRecorder<0>::enabled());
+    TEST_ASSERT_FALSE(recorder.recordDisconnect(10, 1));
+    TEST_ASSERT_FALSE(recorder.keyframeDue());
+    TEST_ASSERT_EQUAL(0, recorder.size());
+    TEST_ASSERT_EQUAL(0, countRecords(download(recorder, 20), TraceEvent::ClientDisconnect));
+}
+
+void test_outputCommand_roundTrip(void) {
+    OutputCommand commands[6];
+    commands[0] = makeCommand(OutputCommandType::SetOutput, 0);
+    commands[0].active = true;
+    commands[0].brightness = 55;
+    commands[0].outputCount = 2;
+    commands[0].outputs[0] = 3;
+    commands[0].outputs[1] = 6;
+    commands[1] = makeCommand(OutputCommandType::SetInterval, 0);
+    commands[1].interval = 65535;
+    commands[1].outputCount = 1;
+    commands[1].outputs[0] = 2;
+    commands[2] = makeCommand(OutputCommandType::CreateGroup, 200);
+    commands[2].interval = 75;
+    commands[2].outputCount = 8;
+    for (uint8_t i = 0; i < 8; i++) commands[2].outputs[i] = static_cast<uint8_t>(7 - i);
+    strcpy(commands[2].name, "Twenty characters!!!");
+    commands[3] = makeCommand(OutputCommandType::DeleteGroup, 200);
+    commands[4] = makeCommand(OutputCommandType::RenameGroup, 9);
+    commands[5] = makeCommand(OutputCommandType::RenameOutput, 6);
+    strcpy(commands[5].name, "Yard");
+
+    const uint8_t expectedLength[6] = {3 + 1 + 2, 3 + 2 + 1 + 1, TRACE_MAX_OUTPUT_COMMAND, 3, 3 + 1, 3 + 1 + 4};
+    for (uint8_t c = 0; c < 6; c++) {
+        uint8_t payload[TRACE_MAX_OUTPUT_COMMAND];
+        const uint8_t length = encodeOutputCommand(commands[c], payload);
+        TEST_ASSERT_EQUAL(expectedLength[c], length);
+        OutputCommand decoded;
+        TEST_ASSERT_TRUE(decodeOutputCommand(payload, length, decoded));
+        TEST_ASSERT_EQUAL(0, memcmp(&commands[c], &decoded, sizeof(decoded)));
+        if (length > 3) TEST_ASSERT_FALSE(decodeOutputCommand(payload, static_cast<uint8_t>(length - 1), decoded));
+    }
+
+    const uint8_t unknownType[3] = {7, 0, 0};
+    OutputCommand decoded;
+    TEST_ASSERT_FALSE(decodeOutputCommand(unknownType, 3, decoded));
+    const uint8_t tooManyOutputs[4] = {static_cast<uint8_t>(OutputCommandType::SetOutput), 0, 0, 9};
+    TEST_ASSERT_FALSE(decodeOutputCommand(tooManyOutputs, 4, decoded));
+}
+
+void test_reader_rejectsDamagedTraces(void) {
+    FlightRecorder<256> recorder;
+    recorder.recordOverrun(5, 5000);
+    recorder.recordOverrun(9, 6000);
+    std::vector<uint8_t> trace = download(recorder, 10);
+    TraceReader reader;
+
+    std::vector<uint8_t> damaged = trace;
+    damaged[3] = TRACE_VERSION + 1;
+    TEST_ASSERT_FALSE(reader.open(damaged.data(), damaged.size()));
+    TEST_ASSERT_FALSE(reader.open(trace.data(), 20));
+
+    // Cut inside the last record: the header's byte count no longer matches
+    TEST_ASSERT_FALSE(reader.open(trace.data(), trace.size() - 2));
+
+    // A record whose length runs past the end
+    damaged = trace;
+    damaged[damaged.size() - 6] = 200;
+    TEST_ASSERT_TRUE(reader.open(damaged.data(), damaged.size()));
+    TraceRecord record;
+    TEST_ASSERT_TRUE(reader.next(record));
+    TEST_ASSERT_FALSE(reader.next(record));
+    TEST_ASSERT_TRUE(reader.malformed());
+}
+
+void test_header_tooSmallBuffer(void) {
+    FlightRecorder<128> recorder;
+    uint8_t header[TRACE_HEADER_FIXED_SIZE + 7];
+    TEST_ASSERT_EQUAL(0, formatTraceHeader(header, sizeof(header), recorder, TEST_PINS, 7, 4, 3, testCommandName, 0));
+    TEST_ASSERT_EQUAL(sizeof(header), formatTraceHeader(header, sizeof(header), recorder, TEST_PINS, 7, 4, 0,
+                                                        testCommandName, 0));
+}
+
+// =============================================================================
+// MAIN TEST RUNNER
+// =============================================================================
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_trace_roundTrip);
+    RUN_TEST(test_ring_evictsOldestWhole);
+    RUN_TEST(test_ring_spansCoverWrap);
+    RUN_TEST(test_keyframe_cadence);
+    RUN_TEST(test_keyframe_alwaysInRing);
+    RUN_TEST(test_hold_dropsUntilRelease);
+    RUN_TEST(test_disabled_recordsNothing);
+    RUN_TEST(test_outputCommand_roundTrip);
+    RUN_TEST(test_reader_rejectsDamagedTraces);
+    RUN_TEST(test_header_tooSmallBuffer);
+
+    return UNITY_END();
+}
+
+#endif // NATIVE_BUILD
@@ -0,0 +1,326 @@
+#ifdef NATIVE_BUILD
+#include <unity.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <new>
+
+#include "text_buffer.h"
+#include "bump_arena.h"
+
+// =============================================================================
+// Simulated ESP8266 heap
+// =============================================================================
+// First-fit allocator over a 48KB arena (roughly the free heap after WiFi and
+// the WebSocket server are up). Global operator new/delete are routed through
+// it so the soak test can observe allocation count and the largest free
+// block, which is what actually fails first on the device (TR-1).
+
+#define SIM_HEAP_SIZE (48 * 1024)
+#define SIM_HEAP_ALIGN 8
+
+struct SimBlock {
+    uint32_t size;  // Payload size in bytes
+    uint32_t used;
+};
+
+static uint8_t simHeap[SIM_HEAP_SIZE] __attribute__((aligned(SIM_HEAP_ALIGN)));
+static bool simHeapReady = false;
+static unsigned long simAllocationCount = 0;
+
+static SimBlock* simFirstBlock() { return reinterpret_cast<SimBlock*>(simHeap); }
+
+static SimBlock* simNextBlock(SimBlock* block) {
+    uint8_t* next = reinterpret_cast<uint8_t*>(block) + sizeof(SimBlock) + block->size;
+    return next < simHeap + SIM_HEAP_SIZE ? reinterpret_cast<SimBlock*>(next) : nullptr;
+}
+
+static void simHeapInit() {
+    SimBlock* first = simFirstBlock();
+    first->size = SIM_HEAP_SIZE - sizeof(SimBlock);
+    first->used = 0;
+    simHeapReady = true;
+}
+
+static void* simMalloc(size_t size) {
+    if (!simHeapReady) simHeapInit();
+    size = (size + SIM_HEAP_ALIGN - 1) & ~static_cast<size_t>(SIM_HEAP_ALIGN - 1);
+    for (SimBlock* block = simFirstBlock(); block; block = simNextBlock(block)) {
+        if (block->used || block->size < size) continue;
+        if (block->size >= size + sizeof(SimBlock) + SIM_HEAP_ALIGN) {
+            SimBlock* rest = reinterpret_cast<SimBlock*>(reinterpret_cast<uint8_t*>(block) + sizeof(SimBlock) + size);
+            rest->size = block->size - size - sizeof(SimBlock);
+            rest->used = 0;
+            block->size = size;
+        }
+        block->used = 1;
+        simAllocationCount++;
+        return reinterpret_cast<uint8_t*>(block) + sizeof(SimBlock);
+    }
+    return nullptr;
+}
+
+// Header of the block whose payload starts at 'ptr', addressed from the arena
+// base (stepping back from the caller's pointer leaves its object)
+static SimBlock* simBlockOf(void* ptr) {
+    const uintptr_t offset = reinterpret_cast<uintptr_t>(ptr) - reinterpret_cast<uintptr_t>(simHeap);
+    return reinterpret_cast<SimBlock*>(simHeap + offset - sizeof(SimBlock));
+}
+
+static void simFree(void* ptr) {
+    if (!ptr) return;
+    SimBlock* block = simBlockOf(ptr);
+    block->used = 0;
+    // Coalesce adjacent free blocks
+    for (SimBlock* b = simFirstBlock(); b; b = simNextBlock(b)) {
+        SimBlock* next = simNextBlock(b);
+        while (!b->used && next && !next->used) {
+            b->size += sizeof(SimBlock) + next->size;
+            next = simNextBlock(b);
+        }
+    }
+}
+
+static size_t simMaxFreeBlock() {
+    if (!simHeapReady) simHeapInit();
+    size_t largest = 0;
+    for (SimBlock* block = simFirstBlock(); block; block = simNextBlock(block)) {
+        if (!block->used && block->size > largest) largest = block->size;
+    }
+    return largest;
+}
+
+void* operator new(size_t size) {
+    void* ptr = simMalloc(size);
+    if (!ptr) throw std::bad_alloc();
+    return ptr;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* ptr) noexcept { simFree(ptr); }
+void operator delete[](void* ptr) noexcept { simFree(ptr); }
+void operator delete(void* ptr, size_t) noexcept { simFree(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { simFree(ptr); }
+
+// =============================================================================
+// Request path under test (mirrors the firmware's fixed-buffer handlers)
+// =============================================================================
+
+#define MAX_OUTPUTS 7
+#define MAX_NAME_LENGTH 20
+#define SOAK_REQUESTS 100000UL
+
+static char outputNames[MAX_OUTPUTS][MAX_NAME_LENGTH + 1];
+static char logLineBuffer[160];
+static char statusJsonBuffer[512];
+
+static BumpArena<3072> requestArena;
+
+static const char* const requestNames[] = {
+    "  Station Lamp  ", "Signal A", "", "   ", "Platform 2 - very long name exceeding limit",
+    "\tYard\r\n", "Depot", "Bridge Lights", "x",
+};
+static const size_t requestNameCount = sizeof(requestNames) / sizeof(requestNames[0]);
+
+// POST /api/name: trim into the fixed name table, log, re-serialize status
+static size_t handleNameRequest(unsigned long requestNumber) {
+    const int index = static_cast<int>(requestNumber % MAX_OUTPUTS);
+    const char* body = requestNames[requestNumber % requestNameCount];
+    const uint8_t lastOctet = static_cast<uint8_t>(requestNumber % 250 + 2);
+
+    char clientIP[IPV4_TEXT_SIZE];
+    formatIPv4(clientIP, sizeof(clientIP), 192, 168, 4, lastOctet);
+
+    // Same allocation pattern ArduinoJson uses while parsing: one slot pool,
+    // a growing string copy, then shrink-to-fit before the document is used
+    const size_t mark = requestArena.mark();
+    void* pool = requestArena.allocate(2048);
+    char* name = static_cast<char*>(requestArena.allocate(8));
+    name = static_cast<char*>(requestArena.reallocate(name, strlen(body) + 1));
+    strcpy(name, body);
+    pool = requestArena.reallocate(pool, 64);
+    if (pool == nullptr || name == nullptr) return 0;
+    copyTrimmed(outputNames[index], sizeof(outputNames[index]), name);
+    requestArena.rewind(mark);
+
+    snprintf(logLineBuffer, sizeof(logLineBuffer), "[EEPROM] Saved name for Output %d from %s: '%s'\n",
+             index, clientIP, outputNames[index]);
+
+    size_t length = 0;
+    for (int i = 0; i < MAX_OUTPUTS; i++) {
+        length += snprintf(statusJsonBuffer + length, sizeof(statusJsonBuffer) - length,
+                           "%s{\"pin\":%d,\"name\":\"%s\"}", i == 0 ? "[" : ",", i, outputNames[i]);
+    }
+    length += snprintf(statusJsonBuffer + length, sizeof(statusJsonBuffer) - length, "]");
+    return length;
+}
+
+// =============================================================================
+// UNIT TESTS
+// =============================================================================
+
+void setUp(void) {
+    memset(outputNames, 0, sizeof(outputNames));
+    requestArena.reset();
+}
+
+void tearDown(void) {
+}
+
+void test_copyTrimmed_stripsWhitespace(void) {
+    char buf[MAX_NAME_LENGTH + 1];
+    TEST_ASSERT_EQUAL(12, copyTrimmed(buf, sizeof(buf), "  Station Lamp  "));
+    TEST_ASSERT_EQUAL_STRING("Station Lamp", buf);
+    TEST_ASSERT_EQUAL(0, copyTrimmed(buf, sizeof(buf), " \t\r\n"));
+    TEST_ASSERT_EQUAL_STRING("", buf);
+    TEST_ASSERT_EQUAL(0, copyTrimmed(buf, sizeof(buf), static_cast<const char*>(nullptr)));
+}
+
+void test_copyTrimmed_truncatesToBuffer(void) {
+    char buf[MAX_NAME_LENGTH + 1];
+    TEST_ASSERT_EQUAL(MAX_NAME_LENGTH, copyTrimmed(buf, sizeof(buf), "Platform 2 - very long name exceeding limit"));
+    TEST_ASSERT_EQUAL_STRING("Platform 2 - very lo", buf);
+}
+
+void test_copyTrimmed_keepsUtf8Whole(void) {
+    char buf[MAX_NAME_LENGTH + 1];
+    // "\xC3\xBC" (2 bytes) would straddle the 20-byte limit: left out whole
+    TEST_ASSERT_EQUAL(19, copyTrimmed(buf, sizeof(buf), "Bahnhof Nord Gleis \xC3\xBC"));
+    TEST_ASSERT_EQUAL_STRING("Bahnhof Nord Gleis ", buf);
+    // "\xE2\x82\xAC" (3 bytes) starting at byte 18
+    TEST_ASSERT_EQUAL(18, copyTrimmed(buf, sizeof(buf), "Fahrpreis in Euro \xE2\x82\xAC 3"));
+    TEST_ASSERT_EQUAL_STRING("Fahrpreis in Euro ", buf);
+    // Ends exactly at the limit: kept
+    TEST_ASSERT_EQUAL(20, copyTrimmed(buf, sizeof(buf), "Bahnhof Nord Gleis\xC3\xBC 2"));
+    TEST_ASSERT_EQUAL_STRING("Bahnhof Nord Gleis\xC3\xBC", buf);
+}
+
+void test_formatIPv4(void) {
+    char buf[IPV4_TEXT_SIZE];
+    TEST_ASSERT_EQUAL_STRING("192.168.4.1", formatIPv4(buf, sizeof(buf), 192, 168, 4, 1));
+    TEST_ASSERT_EQUAL_STRING("0.0.0.0", formatIPv4(buf, sizeof(buf), 0, 0, 0, 0));
+    TEST_ASSERT_EQUAL_STRING("255.255.255.255", formatIPv4(buf, sizeof(buf), 255, 255, 255, 255));
+}
+
+void test_bumpArena_allocatesAligned(void) {
+    BumpArena<256> arena;
+    void* a = arena.allocate(3);
+    void* b = arena.allocate(5);
+    TEST_ASSERT_NOT_NULL(a);
+    TEST_ASSERT_NOT_NULL(b);
+    TEST_ASSERT_EQUAL(0, reinterpret_cast<uintptr_t>(a) % BumpArena<256>::ALIGNMENT);
+    TEST_ASSERT_EQUAL(0, reinterpret_cast<uintptr_t>(b) % BumpArena<256>::ALIGNMENT);
+    TEST_ASSERT_TRUE(static_cast<uint8_t*>(b) >= static_cast<uint8_t*>(a) + 3);
+}
+
+void test_bumpArena_exhaustionFails(void) {
+    BumpArena<64> arena;
+    TEST_ASSERT_NULL(arena.allocate(128));
+    TEST_ASSERT_EQUAL(1, arena.failures());
+    TEST_ASSERT_EQUAL(0, arena.used());
+}
+
+void test_bumpArena_reallocateLastBlockInPlace(void) {
+    BumpArena<256> arena;
+    char* s = static_cast<char*>(arena.allocate(8));
+    strcpy(s, "abc");
+    char* grown = static_cast<char*>(arena.reallocate(s, 100));
+    TEST_ASSERT_TRUE(grown == s);
+    TEST_ASSERT_EQUAL_STRING("abc", grown);
+    char* shrunk = static_cast<char*>(arena.reallocate(grown, 4));
+    TEST_ASSERT_TRUE(shrunk == s);
+    TEST_ASSERT_LESS_THAN(100, arena.used());
+}
+
+void test_bumpArena_reallocateOlderBlockCopies(void) {
+    BumpArena<256> arena;
+    char* first = static_cast<char*>(arena.allocate(8));
+    strcpy(first, "first");
+    arena.allocate(8);
+    char* moved = static_cast<char*>(arena.reallocate(first, 32));
+    TEST_ASSERT_NOT_NULL(moved);
+    TEST_ASSERT_TRUE(moved != first);
+    TEST_ASSERT_EQUAL_STRING("first", moved);
+}
+
+void test_bumpArena_deallocateAndRewind(void) {
+    BumpArena<256> arena;
+    const size_t mark = arena.mark();
+    arena.allocate(16);
+    void* last = arena.allocate(16);
+    const size_t usedBefore = arena.used();
+    arena.deallocate(last);
+    TEST_ASSERT_LESS_THAN(usedBefore, arena.used());
+    arena.rewind(mark);
+    TEST_ASSERT_EQUAL(0, arena.used());
+    TEST_ASSERT_EQUAL(usedBefore, arena.highWater());
+}
+
+// Sanity check for the heap model: String-style concatenation interleaved with
+// a long-lived allocation must show up as a shrinking max free block.
+void test_simulatedHeap_detectsFragmentation(void) {
+    const size_t before = simMaxFreeBlock();
+    char* retained[64];
+    for (int i = 0; i < 64; i++) {
+        char* line = new char[48 + (i % 5) * 16];
+        retained[i] = new char[24];
+        delete[] line;
+    }
+    const size_t fragmented = simMaxFreeBlock();
+    for (int i = 0; i < 64; i++) {
+        delete[] retained[i];
+    }
+    TEST_ASSERT_LESS_THAN(before, fragmented);
+    TEST_ASSERT_EQUAL(before, simMaxFreeBlock());
+}
+
+void test_soak_requestPathHasNoHeapTraffic(void) {
+    // Long-lived allocation standing in for the WebSocket server's client buffers
+    char* wsClientBuffer = new char[2048];
+    const size_t maxBlockBefore = simMaxFreeBlock();
+    const unsigned long allocationsBefore = simAllocationCount;
+
+    size_t checksum = 0;
+    for (unsigned long request = 0; request < SOAK_REQUESTS; request++) {
+        checksum += handleNameRequest(request);
+        if (request % 10000 == 0) {
+            TEST_ASSERT_EQUAL(maxBlockBefore, simMaxFreeBlock());
+        }
+    }
+
+    TEST_ASSERT_EQUAL(allocationsBefore, simAllocationCount);
+    TEST_ASSERT_EQUAL(maxBlockBefore, simMaxFreeBlock());
+    TEST_ASSERT_GREATER_THAN(0, checksum);
+    TEST_ASSERT_EQUAL(0, requestArena.used());
+    TEST_ASSERT_EQUAL(0, requestArena.failures());
+    delete[] wsClientBuffer;
+}
+
+// =============================================================================
+// MAIN TEST RUNNER
+// =============================================================================
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    // Fixed-buffer text helpers
+    RUN_TEST(test_copyTrimmed_stripsWhitespace);
+    RUN_TEST(test_copyTrimmed_truncatesToBuffer);
+    RUN_TEST(test_copyTrimmed_keepsUtf8Whole);
+    RUN_TEST(test_formatIPv4);
+
+    // Static JSON arena
+    RUN_TEST(test_bumpArena_allocatesAligned);
+    RUN_TEST(test_bumpArena_exhaustionFails);
+    RUN_TEST(test_bumpArena_reallocateLastBlockInPlace);
+    RUN_TEST(test_bumpArena_reallocateOlderBlockCopies);
+    RUN_TEST(test_bumpArena_deallocateAndRewind);
+    
+    // Heap soak
+    RUN_TEST(test_simulatedHeap_detectsFragmentation);
+    RUN_TEST(test_soak_requestPathHasNoHeapTraffic);
+
+    return UNITY_END();
+}
+
+#endif // NATIVE_BUILD
@@ -0,0 +1,276 @@
+#ifdef NATIVE_BUILD
+#include <unity.h>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#include "http_parser.h"
+#include "http_keepalive.h"
+
+// =============================================================================
+// HELPERS
+// =============================================================================
+
+typedef HttpRequestParser<512> TestParser;
+typedef HttpRequestParser<512, 64> CappedTestParser; // Body cap below the buffer size
+
+// Feed text into the parser in chunks of at most 'chunk' bytes, the way
+// WiFiClient::read() hands data over on the device.
+template <typename Parser>
+static typename Parser::State feed(Parser& parser, const char* text, size_t chunk = 1024) {
+    typename Parser::State state = parser.state();
+    size_t remaining = strlen(text);
+    while (remaining > 0) {
+        size_t count = remaining < chunk ? remaining : chunk;
+        if (count > parser.writableSpace()) count = parser.writableSpace();
+        if (count == 0) break;
+        memcpy(parser.writePtr(), text, count);
+        state = parser.commit(count);
+        text += count;
+        remaining -= count;
+    }
+    return state;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// =============================================================================
+// UNIT TESTS
+// =============================================================================
+
+void test_parser_simpleGet(void) {
+    TestParser parser;
+    TEST_ASSERT_EQUAL(TestParser::Complete, feed(parser, "GET /api/status HTTP/1.1\r\nHost: railhub\r\n\r\n"));
+    TEST_ASSERT(parser.method() == HttpMethod::Get);
+    TEST_ASSERT_TRUE(parser.path().equals("/api/status"));
+    TEST_ASSERT_TRUE(parser.query().empty());
+    TEST_ASSERT_TRUE(parser.header("host").equals("railhub"));
+    TEST_ASSERT_EQUAL(0, parser.contentLength());
+    TEST_ASSERT_TRUE(parser.keepAlive());
+}
+
+void test_parser_splitsQuery(void) {
+    TestParser parser;
+    feed(parser, "GET /api/events?outputs=3 HTTP/1.1\r\n\r\n");
+    TEST_ASSERT_TRUE(parser.path().equals("/api/events"));
+    TEST_ASSERT_TRUE(parser.query().equals("outputs=3"));
+}
+
+void test_parser_postBodyByteByByte(void) {
+    TestParser parser;
+    const char* request =
+        "POST /api/name HTTP/1.1\r\n"
+        "Content-Type: application/json\r\n"
+        "Content-Length: 15\r\n"
+        "\r\n"
+        "{\"name\":\"Yard\"}";
+    TEST_ASSERT_EQUAL(TestParser::Complete, feed(parser, request, 1));
+    TEST_ASSERT(parser.method() == HttpMethod::Post);
+    TEST_ASSERT_EQUAL(15, parser.contentLength());
+    TEST_ASSERT_EQUAL(15, parser.body().length);
+    TEST_ASSERT_EQUAL_MEMORY("{\"name\":\"Yard\"}", parser.body().data, 15);
+}
+
+void test_parser_waitsForFullBody(void) {
+    TestParser parser;
+    TEST_ASSERT_EQUAL(TestParser::ReadingBody, feed(parser, "POST /api/control HTTP/1.1\r\nContent-Length: 10\r\n\r\n12345"));
+    TEST_ASSERT_EQUAL(TestParser::Complete, feed(parser, "67890"));
+}
+
+void test_parser_connectionHeader(void) {
+    TestParser parser;
+    feed(parser, "GET / HTTP/1.1\r\nConnection: close\r\n\r\n");
+    TEST_ASSERT_FALSE(parser.keepAlive());
+
+    parser.reset();
+    feed(parser, "GET / HTTP/1.0\r\n\r\n");
+    TEST_ASSERT_EQUAL(0, parser.versionMinor());
+    TEST_ASSERT_FALSE(parser.keepAlive());
+
+    parser.reset();
+    feed(parser, "GET / HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n");
+    TEST_ASSERT_TRUE(parser.keepAlive());
+}
+
+void test_parser_pipelinedRequests(void) {
+    TestParser parser;
+    feed(parser,
+         "POST /api/interval HTTP/1.1\r\nContent-Length: 4\r\n\r\nabcd"
+         "GET /api/status HTTP/1.1\r\n\r\n"
+         "GET /");
+    TEST_ASSERT_EQUAL(TestParser::Complete, parser.state());
+    TEST_ASSERT_TRUE(parser.path().equals("/api/interval"));
+    TEST_ASSERT_EQUAL_MEMORY("abcd", parser.body().data, 4);
+
+    parser.nextRequest();
+    TEST_ASSERT_EQUAL(TestParser::Complete, parser.state());
+    TEST_ASSERT_TRUE(parser.path().equals("/api/status"));
+
+    parser.nextRequest();
+    TEST_ASSERT_EQUAL(TestParser::ReadingHead, parser.state());
+    TEST_ASSERT_TRUE(parser.hasBufferedData());
+    TEST_ASSERT_EQUAL(TestParser::Complete, feed(parser, " HTTP/1.1\r\n\r\n"));
+    TEST_ASSERT_TRUE(parser.path().equals("/"));
+
+    parser.nextRequest();
+    TEST_ASSERT_FALSE(parser.hasBufferedData());
+}
+
+void test_parser_rejectsMalformedRequests(void) {
+    TestParser parser;
+    TEST_ASSERT_EQUAL(TestParser::Failed, feed(parser, "GARBAGE\r\n\r\n"));
+    TEST_ASSERT_EQUAL(400, parser.errorStatus());
+
+    parser.reset();
+    TEST_ASSERT_EQUAL(TestParser::Failed, feed(parser, "DELETE /api/reset HTTP/1.1\r\n\r\n"));
+    TEST_ASSERT_EQUAL(501, parser.errorStatus());
+
+    parser.reset();
+    TEST_ASSERT_EQUAL(TestParser::Failed, feed(parser, "GET / HTTP/2.0\r\n\r\n"));
+    TEST_ASSERT_EQUAL(505, parser.errorStatus());
+
+    parser.reset();
+    TEST_ASSERT_EQUAL(TestParser::Failed, feed(parser, "POST / HTTP/1.1\r\nContent-Length: 12x\r\n\r\n"));
+    TEST_ASSERT_EQUAL(400, parser.errorStatus());
+
+    parser.reset();
+    TEST_ASSERT_EQUAL(TestParser::Failed, feed(parser, "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"));
+    TEST_ASSERT_EQUAL(501, parser.errorStatus());
+}
+
+void test_parser_rejectsOversizedBody(void) {
+    TestParser parser;
+    TEST_ASSERT_EQUAL(TestParser::Failed, feed(parser, "POST /api/control HTTP/1.1\r\nContent-Length: 4096\r\n\r\n"));
+    TEST_ASSERT_EQUAL(413, parser.errorStatus());
+}
+
+// The cap applies to the declared length: refused before any body byte is read
+void test_parser_bodyCapCheckedBeforeBody(void) {
+    CappedTestParser parser;
+    TEST_ASSERT_EQUAL(CappedTestParser::Failed, feed(parser, "POST /api/control HTTP/1.1\r\nContent-Length: 65\r\n\r\n"));
+    TEST_ASSERT_EQUAL(413, parser.errorStatus());
+    TEST_ASSERT_EQUAL(0, parser.writableSpace()); // Nothing more is read from the client
+
+    parser.reset();
+    feed(parser, "POST /api/control HTTP/1.1\r\nContent-Length: 64\r\n\r\n");
+    TEST_ASSERT_EQUAL(CappedTestParser::ReadingBody, parser.state());
+    char body[65];
+    memset(body, ' ', 64);
+    body[64] = '\0';
+    TEST_ASSERT_EQUAL(CappedTestParser::Complete, feed(parser, body));
+    TEST_ASSERT_EQUAL(64, parser.body().length);
+}
+
+void test_parser_rejectsOversizedHead(void) {
+    TestParser parser;
+    feed(parser, "GET / HTTP/1.1\r\nCookie: ");
+    char filler[64];
+    memset(filler, 'x', sizeof(filler) - 1);
+    filler[sizeof(filler) - 1] = '\0';
+    TestParser::State state = parser.state();
+    for (int i = 0; i < 16 && state != TestParser::Failed; i++) {
+        state = feed(parser, filler);
+    }
+    TEST_ASSERT_EQUAL(TestParser::Failed, state);
+    TEST_ASSERT_EQUAL(431, parser.errorStatus());
+    TEST_ASSERT_EQUAL(0, parser.writableSpace());
+}
+
+void test_parser_queryParams(void) {
+    const TextView query = TextView::fromCString("telemetry=1&outputs=3,4&flag&empty=");
+    TextView value;
+    TEST_ASSERT_TRUE(httpQueryParam(query, "telemetry", value));
+    TEST_ASSERT_TRUE(value.equals("1"));
+    TEST_ASSERT_TRUE(httpQueryParam(query, "outputs", value));
+    TEST_ASSERT_TRUE(value.equals("3,4"));
+    TEST_ASSERT_TRUE(httpQueryParam(query, "flag", value));
+    TEST_ASSERT_TRUE(value.empty());
+    TEST_ASSERT_TRUE(httpQueryParam(query, "empty", value));
+    TEST_ASSERT_TRUE(value.empty());
+    TEST_ASSERT_FALSE(httpQueryParam(query, "tele", value));   // Prefix of another name
+    TEST_ASSERT_FALSE(httpQueryParam(query, "missing", value));
+    TEST_ASSERT_FALSE(httpQueryParam(TextView(), "telemetry", value));
+}
+
+void test_parser_etagMatching(void) {
+    const char* etag = "W/\"1a2b3c4d-42\"";
+    TEST_ASSERT_TRUE(httpETagMatches(TextView::fromCString("W/\"1a2b3c4d-42\""), etag));
+    TEST_ASSERT_TRUE(httpETagMatches(TextView::fromCString("\"1a2b3c4d-42\""), etag)); // Weak comparison
+    TEST_ASSERT_TRUE(httpETagMatches(TextView::fromCString("\"x\", W/\"1a2b3c4d-42\""), etag));
+    TEST_ASSERT_TRUE(httpETagMatches(TextView::fromCString("*"), etag));
+    TEST_ASSERT_FALSE(httpETagMatches(TextView::fromCString("W/\"1a2b3c4d-41\""), etag));
+    TEST_ASSERT_FALSE(httpETagMatches(TextView::fromCString("W/\"1a2b3c4d-4\""), etag));
+    TEST_ASSERT_FALSE(httpETagMatches(TextView(), etag));
+}
+
+void test_keepAlive_policy(void) {
+    HttpKeepAliveLimits limits;
+    limits.maxRequestsPerConnection = 100;
+    limits.maxIdleConnections = 2;
+    limits.lowHeapBytes = 8192;
+
+    TEST_ASSERT_TRUE(httpKeepConnection(true, true, 1, 0, 20000, limits));
+    TEST_ASSERT_FALSE(httpKeepConnection(false, true, 1, 0, 20000, limits));   // Client asked to close
+    TEST_ASSERT_FALSE(httpKeepConnection(true, false, 1, 0, 20000, limits));   // Unparseable request
+    TEST_ASSERT_FALSE(httpKeepConnection(true, true, 100, 0, 20000, limits));  // Request budget used up
+    TEST_ASSERT_FALSE(httpKeepConnection(true, true, 1, 2, 20000, limits));    // Idle pool full
+    TEST_ASSERT_FALSE(httpKeepConnection(true, true, 1, 0, 8191, limits));     // Memory pressure
+}
+
+void test_keepAlive_reclaimUnderPressure(void) {
+    HttpKeepAliveLimits limits;
+    limits.maxRequestsPerConnection = 100;
+    limits.maxIdleConnections = 2;
+    limits.lowHeapBytes = 8192;
+
+    TEST_ASSERT_FALSE(httpReclaimIdle(8192, limits));
+    TEST_ASSERT_TRUE(httpReclaimIdle(8191, limits));
+}
+
+// Request sequence of one kept-alive connection: the buffer is reused and
+// every request is parsed from the same fixed storage.
+void test_keepAlive_connectionReuse(void) {
+    TestParser parser;
+    for (int i = 0; i < 50; i++) {
+        TEST_ASSERT_EQUAL(TestParser::Complete, feed(parser, "GET /api/status HTTP/1.1\r\nHost: railhub\r\n\r\n", 7));
+        TEST_ASSERT_TRUE(parser.keepAlive());
+        parser.nextRequest();
+        TEST_ASSERT_FALSE(parser.hasBufferedData());
+    }
+}
+
+// =============================================================================
+// MAIN TEST RUNNER
+// =============================================================================
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    // Request parsing
+    RUN_TEST(test_parser_simpleGet);
+    RUN_TEST(test_parser_splitsQuery);
+    RUN_TEST(test_parser_postBodyByteByByte);
+    RUN_TEST(test_parser_waitsForFullBody);
+    RUN_TEST(test_parser_connectionHeader);
+    RUN_TEST(test_parser_pipelinedRequests);
+    RUN_TEST(test_parser_queryParams);
+
+    // Error handling
+    RUN_TEST(test_parser_rejectsMalformedRequests);
+    RUN_TEST(test_parser_rejectsOversizedBody);
+    RUN_TEST(test_parser_bodyCapCheckedBeforeBody);
+    RUN_TEST(test_parser_rejectsOversizedHead);
+
+    // Conditional requests
+    RUN_TEST(test_parser_etagMatching);
+
+    // Keep-alive
+    RUN_TEST(test_keepAlive_policy);
+    RUN_TEST(test_keepAlive_reclaimUnderPressure);
+    RUN_TEST(test_keepAlive_connectionReuse);
+
+    return UNITY_END();
+}
+
+#endif // NATIVE_BUILD
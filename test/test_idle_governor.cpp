@@ -0,0 +1,204 @@
+#ifdef NATIVE_BUILD
+#include <unity.h>
+#include <cstdint>
+#include <cstdio>
+
+#include "idle_governor.h"
+
+// =============================================================================
+// HELPERS
+// =============================================================================
+
+// Same policy as config.h (POWER_*)
+static const PowerPolicy TEST_POLICY = {3000, 2000, 2000, 100, true};
+static const PowerPolicy NO_LIGHT_SLEEP = {3000, 2000, 2000, 100, false};
+
+static PowerInputs quiet() {
+    PowerInputs inputs;
+    inputs.networkBusy = false;
+    inputs.effectsRunning = false;
+    inputs.pwmActive = false;
+    inputs.passUs = 200;
+    inputs.nextEffectMs = NO_EFFECT_DEADLINE;
+    return inputs;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// =============================================================================
+// UNIT TESTS
+// =============================================================================
+
+void test_awakeUntilQuiet(void) {
+    IdleGovernor governor(TEST_POLICY);
+    PowerPlan plan = governor.update(0, quiet());
+    TEST_ASSERT_EQUAL(PowerMode::Awake, plan.mode);
+    TEST_ASSERT_EQUAL(0, plan.idleMs);
+    plan = governor.update(2999, quiet());
+    TEST_ASSERT_EQUAL(PowerMode::Awake, plan.mode);
+    plan = governor.update(3000, quiet());
+    TEST_ASSERT_EQUAL(PowerMode::LightSleep, plan.mode);
+    TEST_ASSERT_EQUAL(100, plan.idleMs);
+}
+
+void test_networkKeepsAwake(void) {
+    IdleGovernor governor(TEST_POLICY);
+    PowerInputs inputs = quiet();
+    inputs.networkBusy = true;
+    for (uint32_t now = 0; now < 10000; now += 10) {
+        TEST_ASSERT_EQUAL(PowerMode::Awake, governor.update(now, inputs).mode);
+    }
+    inputs.networkBusy = false;
+    TEST_ASSERT_EQUAL(PowerMode::Awake, governor.update(12000, inputs).mode);
+    TEST_ASSERT_EQUAL(PowerMode::LightSleep, governor.update(12990, inputs).mode);
+}
+
+void test_effectsChooseModemSleep(void) {
+    IdleGovernor governor(TEST_POLICY);
+    PowerInputs inputs = quiet();
+    inputs.effectsRunning = true;
+    inputs.nextEffectMs = 40;
+    governor.update(0, inputs);
+    PowerPlan plan = governor.update(3000, inputs);
+    TEST_ASSERT_EQUAL(PowerMode::ModemSleep, plan.mode);
+    TEST_ASSERT_EQUAL(40, plan.idleMs);  // Wakes for the next step
+
+    inputs.effectsRunning = false;
+    inputs.pwmActive = true;             // Dimmed output, steady
+    TEST_ASSERT_EQUAL(PowerMode::ModemSleep, governor.update(3040, inputs).mode);
+
+    IdleGovernor noLight(NO_LIGHT_SLEEP);
+    noLight.update(0, quiet());
+    TEST_ASSERT_EQUAL(PowerMode::ModemSleep, noLight.update(3000, quiet()).mode);
+}
+
+void test_boostUnderLoad(void) {
+    IdleGovernor governor(TEST_POLICY);
+    PowerInputs inputs = quiet();
+    TEST_ASSERT_FALSE(governor.update(0, inputs).boost);
+    inputs.passUs = 6000;                // Status rebuild with clients attached
+    TEST_ASSERT_TRUE(governor.update(100, inputs).boost);
+    inputs.passUs = 200;
+    TEST_ASSERT_TRUE(governor.update(2099, inputs).boost);
+    TEST_ASSERT_FALSE(governor.update(2100, inputs).boost);
+    inputs.passUs = 6000;
+    governor.update(2200, inputs);
+    TEST_ASSERT_EQUAL(2, governor.metrics().boosts);
+    TEST_ASSERT_EQUAL(PowerMode::Awake, governor.mode()); // Load is activity
+}
+
+void test_activityWakes(void) {
+    IdleGovernor governor(TEST_POLICY);
+    PowerInputs inputs = quiet();
+    governor.update(0, inputs);
+    governor.update(3000, inputs);
+    TEST_ASSERT_EQUAL(PowerMode::LightSleep, governor.mode());
+    inputs.networkBusy = true;           // A tablet connects
+    TEST_ASSERT_EQUAL(PowerMode::Awake, governor.update(3100, inputs).mode);
+    TEST_ASSERT_EQUAL(1, governor.metrics().activityWakes);
+    TEST_ASSERT_EQUAL(3000, governor.metrics().modeMs[0]);
+    TEST_ASSERT_EQUAL(100, governor.metrics().modeMs[2]);
+}
+
+void test_dutyCycle(void) {
+    IdleGovernor governor(TEST_POLICY);
+    governor.update(0, quiet());
+    governor.idled(750);
+    TEST_ASSERT_EQUAL(250, governor.dutyCyclePermille(1000));
+    TEST_ASSERT_EQUAL(1, governor.metrics().idles);
+    TEST_ASSERT_EQUAL(1000, governor.dutyCyclePermille(0));
+}
+
+void test_millisWrap(void) {
+    IdleGovernor governor(TEST_POLICY);
+    const uint32_t start = 0xFFFFF000UL;
+    governor.update(start, quiet());
+    TEST_ASSERT_EQUAL(PowerMode::Awake, governor.update(start + 2999, quiet()).mode);
+    TEST_ASSERT_EQUAL(PowerMode::LightSleep, governor.update(start + 3000, quiet()).mode);
+}
+
+// Ten simulated minutes: a tablet connected for the first two, then a
+// 500 ms blink on an idle layout for five, then everything off. A loop()
+// pass costs 300 us; idling follows the plan. Blink steps must never be late.
+void test_simulatedEvening(void) {
+    IdleGovernor governor(TEST_POLICY);
+    const uint32_t tabletUntilMs = 120000;
+    const uint32_t blinkUntilMs = 420000;
+    const uint32_t endMs = 600000;
+    const uint32_t passUs = 300;
+
+    uint64_t nowUs = 0;
+    uint32_t nextToggleMs = 500;
+    uint32_t lateToggles = 0;
+    uint32_t maxLateMs = 0;
+    uint32_t awakeDutyAtTabletEnd = 0;
+    uint32_t idlesAtBlinkEnd = 0;
+    while (nowUs / 1000 < endMs) {
+        uint32_t now = static_cast<uint32_t>(nowUs / 1000);
+        const bool blinking = now < blinkUntilMs;
+        if (blinking && now >= nextToggleMs) {
+            if (now - nextToggleMs > 1) lateToggles++;
+            if (now - nextToggleMs > maxLateMs) maxLateMs = now - nextToggleMs;
+            nextToggleMs += 500;
+        }
+        nowUs += passUs;
+        now = static_cast<uint32_t>(nowUs / 1000);
+
+        PowerInputs inputs = quiet();
+        inputs.networkBusy = now < tabletUntilMs;
+        inputs.effectsRunning = blinking;
+        inputs.passUs = passUs;
+        inputs.nextEffectMs = blinking ? (nextToggleMs > now ? nextToggleMs - now : 0) : NO_EFFECT_DEADLINE;
+        const PowerPlan plan = governor.update(now, inputs);
+        if (plan.idleMs) {
+            nowUs += static_cast<uint64_t>(plan.idleMs) * 1000;
+            governor.idled(plan.idleMs);
+        }
+        if (awakeDutyAtTabletEnd == 0 && now >= tabletUntilMs) awakeDutyAtTabletEnd = governor.dutyCyclePermille(now);
+        if (idlesAtBlinkEnd == 0 && now >= blinkUntilMs) idlesAtBlinkEnd = governor.metrics().idles;
+    }
+
+    const PowerMetrics& metrics = governor.metrics();
+    const unsigned duty = governor.dutyCyclePermille(endMs);
+    printf("  10 min: duty cycle %u.%u%% (tablet phase %u.%u%%), %u wakes (%u by the end of the blink), "
+           "awake %u s, modem-sleep %u s, light-sleep %u s, blink late by at most %u ms\n",
+           duty / 10, duty % 10,
+           static_cast<unsigned>(awakeDutyAtTabletEnd / 10), static_cast<unsigned>(awakeDutyAtTabletEnd % 10),
+           static_cast<unsigned>(metrics.idles), static_cast<unsigned>(idlesAtBlinkEnd),
+           static_cast<unsigned>(metrics.modeMs[0] / 1000), static_cast<unsigned>(metrics.modeMs[1] / 1000),
+           static_cast<unsigned>(metrics.modeMs[2] / 1000), static_cast<unsigned>(maxLateMs));
+
+    TEST_ASSERT_EQUAL(1000, awakeDutyAtTabletEnd);             // Never idles with a client
+    TEST_ASSERT_EQUAL(0, lateToggles);
+    TEST_ASSERT_TRUE(metrics.modeMs[1] >= 290000);             // Blink phase in modem sleep
+    TEST_ASSERT_TRUE(metrics.modeMs[2] >= 175000);             // Dark layout in light sleep
+    TEST_ASSERT_TRUE(duty < 250);                              // Awake a fifth of the time, busy only then
+    TEST_ASSERT_TRUE(metrics.idles < 10000);                   // ~2 wakes per toggle, 10 per second when dark
+}
+
+// =============================================================================
+// MAIN TEST RUNNER
+// =============================================================================
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    // Modes
+    RUN_TEST(test_awakeUntilQuiet);
+    RUN_TEST(test_networkKeepsAwake);
+    RUN_TEST(test_effectsChooseModemSleep);
+    RUN_TEST(test_activityWakes);
+    RUN_TEST(test_millisWrap);
+
+    // CPU frequency and duty cycle
+    RUN_TEST(test_boostUnderLoad);
+    RUN_TEST(test_dutyCycle);
+
+    // Simulated evening
+    RUN_TEST(test_simulatedEvening);
+
+    return UNITY_END();
+}
+
+#endif // NATIVE_BUILD
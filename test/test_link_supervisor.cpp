@@ -0,0 +1,204 @@
+#ifdef NATIVE_BUILD
+#include <unity.h>
+#include <cstdint>
+#include <cstdio>
+
+#include "link_supervisor.h"
+
+// =============================================================================
+// HELPERS
+// =============================================================================
+
+// Same policy as config.h (WIFI_RECONNECT_*)
+static const LinkBackoffPolicy TEST_POLICY = {1000, 60000, 15000, 25};
+static const LinkBackoffPolicy NO_JITTER = {1000, 60000, 15000, 0};
+
+// xorshift32: deterministic stand-in for ESP.random()
+static uint32_t rngState = 1;
+static uint32_t nextRandom() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+void setUp(void) {
+    rngState = 2463534242UL;
+}
+void tearDown(void) {}
+
+// =============================================================================
+// UNIT TESTS
+// =============================================================================
+
+void test_backoff_doublesUpToCap(void) {
+    TEST_ASSERT_EQUAL(1000, linkBackoffDelayMs(NO_JITTER, 1, 12345));
+    TEST_ASSERT_EQUAL(2000, linkBackoffDelayMs(NO_JITTER, 2, 12345));
+    TEST_ASSERT_EQUAL(4000, linkBackoffDelayMs(NO_JITTER, 3, 12345));
+    TEST_ASSERT_EQUAL(32000, linkBackoffDelayMs(NO_JITTER, 6, 12345));
+    TEST_ASSERT_EQUAL(60000, linkBackoffDelayMs(NO_JITTER, 7, 12345));
+    TEST_ASSERT_EQUAL(60000, linkBackoffDelayMs(NO_JITTER, 255, 12345));
+}
+
+void test_backoff_jitterBounds(void) {
+    uint32_t low = UINT32_MAX;
+    uint32_t high = 0;
+    for (int i = 0; i < 10000; i++) {
+        const uint32_t delay = linkBackoffDelayMs(TEST_POLICY, 3, nextRandom());
+        if (delay < low) low = delay;
+        if (delay > high) high = delay;
+    }
+    printf("  4000 ms +/- 25%%: %u-%u ms over 10000 draws\n", static_cast<unsigned>(low), static_cast<unsigned>(high));
+    TEST_ASSERT_TRUE(low >= 3000);
+    TEST_ASSERT_TRUE(high <= 5000);
+    TEST_ASSERT_TRUE(low < 3100);   // The spread is actually used
+    TEST_ASSERT_TRUE(high > 4900);
+    TEST_ASSERT_EQUAL(3000, linkBackoffDelayMs(TEST_POLICY, 3, 0));
+    TEST_ASSERT_EQUAL(5000, linkBackoffDelayMs(TEST_POLICY, 3, 2000));
+}
+
+void test_idleUntilBegin(void) {
+    LinkSupervisor link(TEST_POLICY);
+    TEST_ASSERT_EQUAL(LinkAction::None, link.update(0, false, 0));
+    TEST_ASSERT_EQUAL(LinkState::Idle, link.state());
+    link.begin();
+    TEST_ASSERT_TRUE(link.up());
+    TEST_ASSERT_EQUAL(LinkAction::None, link.update(10, true, 0));
+}
+
+void test_lostThenReconnectAtOnce(void) {
+    LinkSupervisor link(TEST_POLICY);
+    link.begin();
+    TEST_ASSERT_EQUAL(LinkAction::Lost, link.update(1000, false, 0));
+    TEST_ASSERT_EQUAL(LinkAction::Reconnect, link.update(1001, false, 0));
+    TEST_ASSERT_EQUAL(LinkState::Attempting, link.state());
+    TEST_ASSERT_EQUAL(LinkAction::None, link.update(5000, false, 0));
+    TEST_ASSERT_EQUAL(LinkAction::Restored, link.update(5001, true, 0));
+
+    const LinkMetrics& metrics = link.metrics();
+    TEST_ASSERT_EQUAL(1, metrics.outages);
+    TEST_ASSERT_EQUAL(1, metrics.attempts);
+    TEST_ASSERT_EQUAL(4001, metrics.lastOutageMs);
+    TEST_ASSERT_EQUAL(4000, metrics.lastReconnectMs);
+    TEST_ASSERT_TRUE(link.up());
+}
+
+void test_failedAttemptsBackOff(void) {
+    LinkSupervisor link(NO_JITTER);
+    link.begin();
+    link.update(0, false, 0);
+    TEST_ASSERT_EQUAL(LinkAction::Reconnect, link.update(0, false, 0));
+    TEST_ASSERT_EQUAL(LinkAction::None, link.update(14999, false, 0));
+    TEST_ASSERT_EQUAL(LinkAction::EndAttempt, link.update(15000, false, 0));
+    TEST_ASSERT_EQUAL(1, link.failures());
+    TEST_ASSERT_EQUAL(1000, link.nextAttemptInMs(15000));
+
+    TEST_ASSERT_EQUAL(LinkAction::None, link.update(15999, false, 0));
+    TEST_ASSERT_EQUAL(LinkAction::Reconnect, link.update(16000, false, 0));
+    TEST_ASSERT_EQUAL(LinkAction::EndAttempt, link.update(31000, false, 0));
+    TEST_ASSERT_EQUAL(2000, link.nextAttemptInMs(31000)); // Doubled
+    TEST_ASSERT_EQUAL(2, link.metrics().attempts);
+}
+
+void test_restoredWhileWaiting(void) {
+    LinkSupervisor link(NO_JITTER);
+    link.begin();
+    link.update(0, false, 0);
+    link.update(0, false, 0);
+    link.update(15000, false, 0); // EndAttempt
+    TEST_ASSERT_EQUAL(LinkAction::Restored, link.update(15500, true, 0));
+    TEST_ASSERT_EQUAL(15500, link.metrics().lastOutageMs);
+    TEST_ASSERT_EQUAL(0, link.metrics().lastReconnectMs);
+    TEST_ASSERT_EQUAL(0, link.failures());
+}
+
+void test_outageMetricsAccumulate(void) {
+    LinkSupervisor link(TEST_POLICY);
+    link.begin();
+    link.update(0, false, 0);
+    link.update(0, false, 0);
+    link.update(2000, true, 0);
+    link.update(10000, false, 0);
+    link.update(10000, false, 0);
+    link.update(15000, true, 0);
+
+    const LinkMetrics& metrics = link.metrics();
+    TEST_ASSERT_EQUAL(2, metrics.outages);
+    TEST_ASSERT_EQUAL(5000, metrics.lastOutageMs);
+    TEST_ASSERT_EQUAL(5000, metrics.longestOutageMs);
+    TEST_ASSERT_EQUAL(7000, metrics.totalOutageMs);
+}
+
+void test_millisWrap(void) {
+    LinkSupervisor link(NO_JITTER);
+    link.begin();
+    const uint32_t start = 0xFFFFFF00UL; // The attempt and the pause run across the wrap
+    link.update(start, false, 0);
+    link.update(start, false, 0);
+    TEST_ASSERT_EQUAL(LinkAction::EndAttempt, link.update(start + 15000, false, 0));
+    TEST_ASSERT_EQUAL(LinkAction::None, link.update(start + 15500, false, 0));
+    TEST_ASSERT_EQUAL(LinkAction::Reconnect, link.update(start + 16000, false, 0));
+}
+
+// Access point off for 5 minutes, one loop() pass per 10 ms: the attempts
+// thin out instead of hammering the radio, and the link comes back on the
+// first attempt after the access point does
+void test_simulatedOutage(void) {
+    LinkSupervisor link(TEST_POLICY);
+    link.begin();
+    const uint32_t apDownMs = 60000;
+    const uint32_t apUpMs = apDownMs + 300000;
+    const uint32_t associateMs = 3000; // Attempt start -> link once the AP is back
+
+    bool linked = true;
+    bool attempting = false;
+    uint32_t attemptStartMs = 0;
+    uint32_t restoredAtMs = 0;
+    for (uint32_t now = 0; now < apUpMs + 120000 && restoredAtMs == 0; now += 10) {
+        if (now >= apDownMs && now < apUpMs) linked = false;
+        else if (attempting && now >= apUpMs && now - attemptStartMs >= associateMs) linked = true;
+        switch (link.update(now, linked, nextRandom())) {
+            case LinkAction::Reconnect: attempting = true; attemptStartMs = now; break;
+            case LinkAction::EndAttempt: attempting = false; break;
+            case LinkAction::Restored: restoredAtMs = now; break;
+            default: break;
+        }
+    }
+
+    const LinkMetrics& metrics = link.metrics();
+    printf("  AP down 300 s: %u attempts, link back %u ms after the AP, outage %u ms, reconnect %u ms\n",
+           static_cast<unsigned>(metrics.attempts), static_cast<unsigned>(restoredAtMs - apUpMs),
+           static_cast<unsigned>(metrics.lastOutageMs), static_cast<unsigned>(metrics.lastReconnectMs));
+    TEST_ASSERT_TRUE(restoredAtMs > 0);
+    TEST_ASSERT_EQUAL(1, metrics.outages);
+    TEST_ASSERT_TRUE(metrics.attempts <= 12); // Flat 1 s pauses would make ~19 attempts in 5 minutes
+    TEST_ASSERT_TRUE(metrics.lastReconnectMs >= associateMs);
+    TEST_ASSERT_TRUE(restoredAtMs - apUpMs <= 60000 * 5 / 4 + 15000 + associateMs); // One capped pause at most
+}
+
+// =============================================================================
+// MAIN TEST RUNNER
+// =============================================================================
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    // Backoff
+    RUN_TEST(test_backoff_doublesUpToCap);
+    RUN_TEST(test_backoff_jitterBounds);
+
+    // Supervision
+    RUN_TEST(test_idleUntilBegin);
+    RUN_TEST(test_lostThenReconnectAtOnce);
+    RUN_TEST(test_failedAttemptsBackOff);
+    RUN_TEST(test_restoredWhileWaiting);
+    RUN_TEST(test_outageMetricsAccumulate);
+    RUN_TEST(test_millisWrap);
+
+    // Simulated outage
+    RUN_TEST(test_simulatedOutage);
+
+    return UNITY_END();
+}
+
+#endif // NATIVE_BUILD
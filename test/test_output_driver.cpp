@@ -0,0 +1,185 @@
+#ifdef NATIVE_BUILD
+#include <unity.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "output_driver.h"
+
+// =============================================================================
+// HELPERS
+// =============================================================================
+
+// Same pins as LED_PINS in config.h
+static const uint8_t TEST_PINS[7] = {4, 5, 12, 13, 14, 16, 2};
+
+// Host stand-in for the pin hardware: records every call in order and keeps
+// the simulated pin levels and waveform state
+struct RecordingPins {
+    enum Call : uint8_t { Pwm, Detach, Set, Clear };
+    struct Entry {
+        Call call;
+        uint8_t pin;
+        uint8_t duty;
+    };
+
+    static const uint16_t MAX_ENTRIES = 64;
+    static Entry log[MAX_ENTRIES];
+    static uint16_t count;
+    static uint32_t calls[4];
+    static bool level[17];
+    static bool waveform[17];
+
+    static void reset() {
+        count = 0;
+        memset(calls, 0, sizeof(calls));
+        memset(level, 0, sizeof(level));
+        memset(waveform, 0, sizeof(waveform));
+    }
+    static void record(Call call, uint8_t pin, uint8_t duty) {
+        calls[call]++;
+        if (count < MAX_ENTRIES) {
+            log[count].call = call;
+            log[count].pin = pin;
+            log[count].duty = duty;
+        }
+        count++;
+    }
+
+    static void pwm(uint8_t pin, uint8_t duty) {
+        record(Pwm, pin, duty);
+        waveform[pin] = true;
+    }
+    static void detachPwm(uint8_t pin) {
+        record(Detach, pin, 0);
+        waveform[pin] = false;
+    }
+    static void set(uint8_t pin) {
+        TEST_ASSERT_FALSE(waveform[pin]); // A register write on a PWM pin would be overridden
+        record(Set, pin, 255);
+        level[pin] = true;
+    }
+    static void clear(uint8_t pin) {
+        TEST_ASSERT_FALSE(waveform[pin]);
+        record(Clear, pin, 0);
+        level[pin] = false;
+    }
+};
+
+RecordingPins::Entry RecordingPins::log[RecordingPins::MAX_ENTRIES];
+uint16_t RecordingPins::count = 0;
+uint32_t RecordingPins::calls[4];
+bool RecordingPins::level[17];
+bool RecordingPins::waveform[17];
+
+typedef OutputDriver<RecordingPins, 7> TestDriver;
+
+static void assertCall(uint16_t index, RecordingPins::Call call, uint8_t pin) {
+    TEST_ASSERT_TRUE(index < RecordingPins::count);
+    TEST_ASSERT_EQUAL(call, RecordingPins::log[index].call);
+    TEST_ASSERT_EQUAL(pin, RecordingPins::log[index].pin);
+}
+
+void setUp(void) {
+    RecordingPins::reset();
+}
+void tearDown(void) {}
+
+// =============================================================================
+// UNIT TESTS
+// =============================================================================
+
+void test_fullDuty_usesRegistersOnly(void) {
+    TestDriver driver(TEST_PINS);
+    driver.write(0, 255);
+    driver.write(0, 0);
+    driver.write(5, 255); // GPIO 16 goes through the same path
+
+    TEST_ASSERT_EQUAL(3, RecordingPins::count);
+    assertCall(0, RecordingPins::Set, 4);
+    assertCall(1, RecordingPins::Clear, 4);
+    assertCall(2, RecordingPins::Set, 16);
+    TEST_ASSERT_EQUAL(0, RecordingPins::calls[RecordingPins::Pwm]);
+    TEST_ASSERT_TRUE(RecordingPins::level[16]);
+    TEST_ASSERT_EQUAL(3, driver.metrics().gpioWrites);
+}
+
+void test_dimmed_usesPwmAndDetachesWhenFull(void) {
+    TestDriver driver(TEST_PINS);
+    driver.write(2, 128);
+    TEST_ASSERT_TRUE(driver.onPwm(2));
+    TEST_ASSERT_TRUE(RecordingPins::waveform[12]);
+    driver.write(2, 64); // Still dimmed: the waveform is only updated
+    driver.write(2, 255);
+
+    assertCall(0, RecordingPins::Pwm, 12);
+    TEST_ASSERT_EQUAL(128, RecordingPins::log[0].duty);
+    assertCall(1, RecordingPins::Pwm, 12);
+    assertCall(2, RecordingPins::Detach, 12);
+    assertCall(3, RecordingPins::Set, 12);
+    TEST_ASSERT_FALSE(driver.onPwm(2));
+    TEST_ASSERT_FALSE(RecordingPins::waveform[12]);
+
+    // Off from PWM detaches too; afterwards it's registers only
+    driver.write(3, 10);
+    driver.write(3, 0);
+    driver.write(3, 255);
+    TEST_ASSERT_EQUAL(2, RecordingPins::calls[RecordingPins::Detach]);
+
+    const OutputDriverMetrics metrics = driver.metrics();
+    TEST_ASSERT_EQUAL(3, metrics.pwmWrites);
+    TEST_ASSERT_EQUAL(2, metrics.pwmDetaches);
+    TEST_ASSERT_EQUAL(3, metrics.gpioWrites);
+    TEST_ASSERT_EQUAL(0, metrics.pwmPins);
+}
+
+void test_pwmPinsCounted(void) {
+    TestDriver driver(TEST_PINS);
+    driver.write(0, 200);
+    driver.write(6, 1);
+    driver.write(4, 255);
+    TEST_ASSERT_EQUAL(2, driver.metrics().pwmPins);
+    TEST_ASSERT_FALSE(driver.onPwm(4));
+}
+
+// Simulated engine run: a blinking output at 100% and one at 50% for 1000
+// toggles each. Only the dimmed one may touch the waveform generator.
+void test_simulatedBlink_backendCalls(void) {
+    TestDriver driver(TEST_PINS);
+    bool lit = false;
+    for (int toggle = 0; toggle < 1000; toggle++) {
+        lit = !lit;
+        driver.write(0, lit ? 255 : 0);   // 100% blink
+        driver.write(1, lit ? 128 : 0);   // 50% blink
+    }
+
+    const OutputDriverMetrics metrics = driver.metrics();
+    printf("  1000 toggles each at 100%% and 50%%: %u register writes, %u PWM writes, %u detaches\n",
+           static_cast<unsigned>(metrics.gpioWrites), static_cast<unsigned>(metrics.pwmWrites),
+           static_cast<unsigned>(metrics.pwmDetaches));
+    TEST_ASSERT_EQUAL(500, metrics.pwmWrites);   // Dimmed half of the 50% blink
+    TEST_ASSERT_EQUAL(500, metrics.pwmDetaches); // Its off half leaves PWM each time
+    TEST_ASSERT_EQUAL(1500, metrics.gpioWrites); // 1000 for the 100% blink, 500 for the 50% one
+    TEST_ASSERT_FALSE(RecordingPins::waveform[4]);
+    TEST_ASSERT_FALSE(RecordingPins::level[4]); // Ends off after an even number of toggles
+}
+
+// =============================================================================
+// MAIN TEST RUNNER
+// =============================================================================
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    // Backend selection
+    RUN_TEST(test_fullDuty_usesRegistersOnly);
+    RUN_TEST(test_dimmed_usesPwmAndDetachesWhenFull);
+    RUN_TEST(test_pwmPinsCounted);
+
+    // Simulated engine
+    RUN_TEST(test_simulatedBlink_backendCalls);
+
+    return UNITY_END();
+}
+
+#endif // NATIVE_BUILD
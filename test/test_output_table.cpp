@@ -0,0 +1,125 @@
+#ifdef NATIVE_BUILD
+#include <unity.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "output_table.h"
+
+// =============================================================================
+// HELPERS
+// =============================================================================
+
+// Same pins as LED_PINS in config.h
+static const uint8_t TEST_PINS[7] = {4, 5, 12, 13, 14, 16, 2};
+typedef OutputTable<7, 20> TestTable;
+
+// The parallel arrays the table replaces, with ESP8266 type widths
+// (int, unsigned int and unsigned long are all 32 bits there)
+struct LegacyOutputState {
+    int32_t outputPins[7];
+    bool outputStates[7];
+    int32_t outputBrightness[7];
+    char outputNames[7][21];
+    uint32_t outputIntervals[7];
+    uint32_t lastBlinkTime[7];
+    bool blinkState[7];
+    int8_t outputChasingGroup[7];
+};
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// =============================================================================
+// UNIT TESTS
+// =============================================================================
+
+void test_table_defaults(void) {
+    const TestTable table(TEST_PINS);
+    TEST_ASSERT_EQUAL(7, TestTable::size());
+    TEST_ASSERT_EQUAL(0, table.on);
+    TEST_ASSERT_EQUAL(0, table.onCount());
+    for (uint8_t i = 0; i < 7; i++) {
+        TEST_ASSERT_EQUAL(TEST_PINS[i], table.pins[i]);
+        TEST_ASSERT_EQUAL(255, table.brightness[i]);
+        TEST_ASSERT_FALSE(table.inGroup(i));
+        TEST_ASSERT_EQUAL(0, table.interval[i]);
+        TEST_ASSERT_EQUAL_STRING("", table.names[i]);
+    }
+}
+
+void test_table_flagBitsets(void) {
+    TestTable table(TEST_PINS);
+    table.setOn(0, true);
+    table.setOn(6, true);
+    TEST_ASSERT_EQUAL(0x41, table.on);
+    TEST_ASSERT_EQUAL(2, table.onCount());
+    TEST_ASSERT_TRUE(table.isOn(6));
+    TEST_ASSERT_FALSE(table.isOn(5));
+
+    table.setOn(0, false);
+    TEST_ASSERT_EQUAL(0x40, table.on);
+
+    TEST_ASSERT_TRUE(table.toggleLit(3));
+    TEST_ASSERT_FALSE(table.toggleLit(3));
+    table.setLit(2, true);
+    TEST_ASSERT_TRUE(table.isLit(2));
+    TEST_ASSERT_FALSE(table.isOn(2)); // Independent bitsets
+}
+
+void test_table_groups(void) {
+    TestTable table(TEST_PINS);
+    table.group[4] = 200; // Group ids above 127 (int8_t used to wrap them)
+    TEST_ASSERT_TRUE(table.inGroup(4));
+    table.group[4] = TestTable::NO_GROUP;
+    TEST_ASSERT_FALSE(table.inGroup(4));
+}
+
+void test_table_maskWidthFollowsCount(void) {
+    TEST_ASSERT_EQUAL(1, sizeof(OutputTable<8, 20>::Mask));
+    TEST_ASSERT_EQUAL(2, sizeof(OutputTable<9, 20>::Mask));
+    TEST_ASSERT_EQUAL(4, sizeof(OutputTable<32, 20>::Mask));
+
+    OutputTable<32, 4>::Mask mask = 0;
+    const uint8_t pins[32] = {0};
+    OutputTable<32, 4> wide(pins);
+    wide.setOn(31, true);
+    mask = wide.on;
+    TEST_ASSERT_EQUAL(0x80000000UL, mask);
+    TEST_ASSERT_EQUAL(1, wide.onCount());
+}
+
+// RAM report: table vs the parallel arrays it replaced; the engine-hot part
+// is everything before the names
+void test_table_ramReport(void) {
+    const size_t tableBytes = sizeof(TestTable);
+    const size_t hotBytes = offsetof(TestTable, names);
+    const size_t legacyBytes = sizeof(LegacyOutputState);
+    printf("  output state: %u bytes (engine-hot %u) vs %u bytes in parallel arrays\n",
+           static_cast<unsigned>(tableBytes), static_cast<unsigned>(hotBytes), static_cast<unsigned>(legacyBytes));
+
+    TEST_ASSERT_TRUE(tableBytes < legacyBytes);
+    // What the blink/chase tick touches is half what it used to be spread over
+    TEST_ASSERT_TRUE(hotBytes * 2 <= legacyBytes - sizeof(LegacyOutputState::outputNames));
+}
+
+// =============================================================================
+// MAIN TEST RUNNER
+// =============================================================================
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    // Table contents
+    RUN_TEST(test_table_defaults);
+    RUN_TEST(test_table_flagBitsets);
+    RUN_TEST(test_table_groups);
+    RUN_TEST(test_table_maskWidthFollowsCount);
+
+    // Footprint
+    RUN_TEST(test_table_ramReport);
+
+    return UNITY_END();
+}
+
+#endif // NATIVE_BUILD
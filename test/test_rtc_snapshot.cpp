@@ -0,0 +1,159 @@
+#ifdef NATIVE_BUILD
+#include <unity.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "rtc_snapshot.h"
+
+// =============================================================================
+// HELPERS
+// =============================================================================
+
+// Same sizes as the firmware (MAX_OUTPUTS, MAX_CHASING_GROUPS, MAX_OUTPUTS_PER_CHASING_GROUP)
+typedef EffectSnapshot<7, 4, 8> TestSnapshot;
+
+// RTC user memory the firmware may use: 512 bytes minus the 128 the OTA
+// bootloader keeps at the start
+static const size_t RTC_USER_BYTES_FREE = 512 - 128;
+
+static TestSnapshot filledSnapshot() {
+    TestSnapshot snapshot;
+    memset(&snapshot, 0, sizeof(snapshot));
+    snapshot.rtcTime = 1000;
+    snapshot.rtcPeriodQ12 = 5 << 12;
+    snapshot.on = 0x43;
+    snapshot.lit = 0x01;
+    for (uint8_t i = 0; i < 7; i++) snapshot.brightness[i] = 255;
+    snapshot.interval[0] = 500;
+    snapshot.toggleAgeMs[0] = 120;
+    snapshot.groups[0].groupId = 9;
+    snapshot.groups[0].outputCount = 3;
+    snapshot.groups[0].currentStep = 2;
+    snapshot.groups[0].interval = 250;
+    snapshot.groups[0].outputIndices[0] = 3;
+    snapshot.groups[0].outputIndices[1] = 4;
+    snapshot.groups[0].outputIndices[2] = 5;
+    snapshot.groups[0].stepAgeMs = 100;
+    snapshot.seal();
+    return snapshot;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// =============================================================================
+// UNIT TESTS
+// =============================================================================
+
+void test_crc32_knownValue(void) {
+    TEST_ASSERT_EQUAL(0xCBF43926UL, snapshotCrc32("123456789", 9)); // IEEE check value
+    TEST_ASSERT_EQUAL(0, snapshotCrc32("", 0));
+}
+
+void test_snapshot_sealedIsValid(void) {
+    const TestSnapshot snapshot = filledSnapshot();
+    TEST_ASSERT_TRUE(snapshot.valid());
+    TEST_ASSERT_EQUAL(TestSnapshot::MAGIC, snapshot.magic);
+}
+
+void test_snapshot_rejectsCorruption(void) {
+    TestSnapshot snapshot = filledSnapshot();
+    snapshot.groups[0].currentStep = 1;          // One byte changed
+    TEST_ASSERT_FALSE(snapshot.valid());
+
+    snapshot = filledSnapshot();
+    snapshot.toggleAgeMs[6] ^= 0x80000000UL;     // Last field, one bit
+    TEST_ASSERT_FALSE(snapshot.valid());
+
+    snapshot = filledSnapshot();
+    snapshot.invalidate();
+    TEST_ASSERT_FALSE(snapshot.valid());
+
+    // Power-on contents of RTC memory
+    memset(&snapshot, 0xA5, sizeof(snapshot));
+    TEST_ASSERT_FALSE(snapshot.valid());
+}
+
+void test_snapshot_layoutTagged(void) {
+    TEST_ASSERT_TRUE(TestSnapshot::MAGIC != (EffectSnapshot<8, 4, 8>::MAGIC));
+    TEST_ASSERT_TRUE(TestSnapshot::MAGIC != (EffectSnapshot<7, 5, 8>::MAGIC));
+    TEST_ASSERT_TRUE(TestSnapshot::MAGIC != (EffectSnapshot<7, 4, 6>::MAGIC));
+}
+
+void test_snapshot_fitsRtcMemory(void) {
+    printf("  snapshot: %u bytes of %u free RTC user memory\n", static_cast<unsigned>(sizeof(TestSnapshot)),
+           static_cast<unsigned>(RTC_USER_BYTES_FREE));
+    TEST_ASSERT_TRUE(sizeof(TestSnapshot) <= RTC_USER_BYTES_FREE);
+    TEST_ASSERT_EQUAL(0, sizeof(TestSnapshot) % 4); // RTC memory is written in 32-bit words
+}
+
+void test_rtcElapsed(void) {
+    // 5.5 us per tick
+    const uint32_t period = (11 << 12) / 2;
+    TEST_ASSERT_EQUAL(550, rtcElapsedMs(1000, 101000, period));
+    TEST_ASSERT_EQUAL(550, rtcElapsedMs(0xFFFFFFFFUL - 49999, 50000, period)); // Across the wrap
+}
+
+void test_continuePhase(void) {
+    EffectPhase phase = continuePhase(120, 500);
+    TEST_ASSERT_EQUAL(0, phase.steps);
+    TEST_ASSERT_EQUAL(120, phase.intoStepMs);
+
+    phase = continuePhase(120 + 1730, 500);        // 1.73 s reset downtime
+    TEST_ASSERT_EQUAL(3, phase.steps);
+    TEST_ASSERT_EQUAL(350, phase.intoStepMs);
+
+    phase = continuePhase(5000, 0);                // Steady
+    TEST_ASSERT_EQUAL(0, phase.steps);
+    TEST_ASSERT_EQUAL(0, phase.intoStepMs);
+}
+
+// Simulated warm restart: a blink (500 ms) and a 3-output chase (250 ms)
+// run uninterrupted as the reference; the restored copy must be at the same
+// point of both cycles once it resumes
+void test_simulatedWarmRestart_phaseContinues(void) {
+    const uint32_t captureMs = 10120;   // Reference clock at the last snapshot
+    const uint32_t downtimeMs = 1730;   // Snapshot -> restore, from the RTC clock
+    const TestSnapshot snapshot = filledSnapshot();
+
+    // Reference: last toggle at 10000 (lit), last chase step at 10020 (step 2)
+    const uint32_t resumeMs = captureMs + downtimeMs;
+    const bool referenceLit = ((resumeMs - 10000) / 500) % 2 == 0; // Lit after the toggle at 10000
+    const uint8_t referenceStep = static_cast<uint8_t>((2 + (resumeMs - 10020) / 250) % 3);
+
+    const EffectPhase blink = continuePhase(snapshot.toggleAgeMs[0] + downtimeMs, snapshot.interval[0]);
+    const bool restoredLit = ((snapshot.lit & 1) != 0) != ((blink.steps & 1) != 0);
+    const EffectPhase chase = continuePhase(snapshot.groups[0].stepAgeMs + downtimeMs, snapshot.groups[0].interval);
+    const uint8_t restoredStep =
+        static_cast<uint8_t>((snapshot.groups[0].currentStep + chase.steps) % snapshot.groups[0].outputCount);
+
+    TEST_ASSERT_EQUAL(referenceLit, restoredLit);
+    TEST_ASSERT_EQUAL(referenceStep, restoredStep);
+    TEST_ASSERT_EQUAL((resumeMs - 10000) % 500, blink.intoStepMs);
+    TEST_ASSERT_EQUAL((resumeMs - 10020) % 250, chase.intoStepMs);
+}
+
+// =============================================================================
+// MAIN TEST RUNNER
+// =============================================================================
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    // Integrity
+    RUN_TEST(test_crc32_knownValue);
+    RUN_TEST(test_snapshot_sealedIsValid);
+    RUN_TEST(test_snapshot_rejectsCorruption);
+    RUN_TEST(test_snapshot_layoutTagged);
+    RUN_TEST(test_snapshot_fitsRtcMemory);
+
+    // Phase continuation
+    RUN_TEST(test_rtcElapsed);
+    RUN_TEST(test_continuePhase);
+    RUN_TEST(test_simulatedWarmRestart_phaseContinues);
+
+    return UNITY_END();
+}
+
+#endif // NATIVE_BUILD
@@ -0,0 +1,170 @@
+#ifdef NATIVE_BUILD
+#include <unity.h>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+
+#include "spsc_queue.h"
+
+// =============================================================================
+// HELPERS
+// =============================================================================
+
+// Stand-in for OutputCommand: big enough that a torn copy would show up as
+// a payload that doesn't match its sequence number
+struct TestCommand {
+    uint32_t sequence;
+    uint8_t payload[27];
+};
+
+static TestCommand makeCommand(uint32_t sequence) {
+    TestCommand command;
+    command.sequence = sequence;
+    for (uint8_t i = 0; i < sizeof(command.payload); i++) {
+        command.payload[i] = static_cast<uint8_t>(sequence * 31 + i);
+    }
+    return command;
+}
+
+static bool intact(const TestCommand& command) {
+    for (uint8_t i = 0; i < sizeof(command.payload); i++) {
+        if (command.payload[i] != static_cast<uint8_t>(command.sequence * 31 + i)) return false;
+    }
+    return true;
+}
+
+typedef SpscQueue<TestCommand, 8> TestQueue;
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// =============================================================================
+// UNIT TESTS
+// =============================================================================
+
+void test_queue_fifoAndFull(void) {
+    TestQueue queue;
+    TEST_ASSERT_TRUE(queue.empty());
+    for (uint32_t i = 0; i < 8; i++) {
+        TEST_ASSERT_TRUE(queue.push(makeCommand(i)));
+    }
+    TEST_ASSERT_FALSE(queue.push(makeCommand(8))); // Full: refused, nothing overwritten
+
+    TestCommand command;
+    for (uint32_t i = 0; i < 8; i++) {
+        TEST_ASSERT_TRUE(queue.pop(command));
+        TEST_ASSERT_EQUAL(i, command.sequence);
+    }
+    TEST_ASSERT_FALSE(queue.pop(command));
+
+    const SpscQueueMetrics metrics = queue.metrics();
+    TEST_ASSERT_EQUAL(8, metrics.pushed);
+    TEST_ASSERT_EQUAL(1, metrics.dropped);
+    TEST_ASSERT_EQUAL(8, metrics.popped);
+    TEST_ASSERT_EQUAL(0, metrics.depth);
+    TEST_ASSERT_EQUAL(8, metrics.highWater);
+}
+
+void test_queue_wrapsAround(void) {
+    TestQueue queue;
+    TestCommand command;
+    for (uint32_t i = 0; i < 100; i++) {
+        TEST_ASSERT_TRUE(queue.push(makeCommand(i)));
+        TEST_ASSERT_TRUE(queue.push(makeCommand(i + 1000)));
+        TEST_ASSERT_TRUE(queue.pop(command));
+        TEST_ASSERT_EQUAL(i, command.sequence);
+        TEST_ASSERT_TRUE(queue.pop(command));
+        TEST_ASSERT_EQUAL(i + 1000, command.sequence);
+    }
+    TEST_ASSERT_EQUAL(2, queue.metrics().highWater);
+}
+
+void test_drain_appliesOnlyTheBatchAtTickStart(void) {
+    TestQueue queue;
+    queue.push(makeCommand(1));
+    queue.push(makeCommand(2));
+
+    uint32_t applied[8];
+    uint8_t count = 0;
+    TEST_ASSERT_EQUAL(2, queue.drain([&](const TestCommand& command) {
+        applied[count++] = command.sequence;
+        queue.push(makeCommand(command.sequence + 10)); // Posted mid-tick
+    }));
+    TEST_ASSERT_EQUAL(2, count);
+    TEST_ASSERT_EQUAL(1, applied[0]);
+    TEST_ASSERT_EQUAL(2, applied[1]);
+
+    // The commands posted during the first drain make up the next tick
+    count = 0;
+    TEST_ASSERT_EQUAL(2, queue.drain([&](const TestCommand& command) { applied[count++] = command.sequence; }));
+    TEST_ASSERT_EQUAL(11, applied[0]);
+    TEST_ASSERT_EQUAL(12, applied[1]);
+    TEST_ASSERT_TRUE(queue.empty());
+}
+
+// Producer and consumer on separate threads: every accepted command arrives
+// exactly once, in order and intact; refused ones are counted as dropped and
+// posted again, as a client would retry after a 503
+void test_stress_producerConsumerThreads(void) {
+    static TestQueue queue;
+    const uint32_t commands = 500000;
+    std::atomic<bool> producerDone(false);
+
+    std::thread producer([&]() {
+        for (uint32_t sequence = 0; sequence < commands; sequence++) {
+            while (!queue.push(makeCommand(sequence))) std::this_thread::yield();
+        }
+        producerDone.store(true, std::memory_order_release);
+    });
+
+    uint32_t expected = 0;
+    uint32_t outOfOrder = 0;
+    uint32_t torn = 0;
+    uint32_t ticks = 0;
+    for (;;) {
+        const bool done = producerDone.load(std::memory_order_acquire);
+        const uint8_t applied = queue.drain([&](const TestCommand& command) {
+            if (command.sequence != expected) outOfOrder++;
+            if (!intact(command)) torn++;
+            expected = command.sequence + 1;
+        });
+        if (applied > 0) ticks++;
+        else if (done) break;
+        else std::this_thread::yield();
+    }
+    producer.join();
+
+    const SpscQueueMetrics metrics = queue.metrics();
+    printf("  %u commands over %u ticks: %u dropped while full, high water %u\n",
+           static_cast<unsigned>(commands), static_cast<unsigned>(ticks),
+           static_cast<unsigned>(metrics.dropped), metrics.highWater);
+
+    TEST_ASSERT_EQUAL(0, outOfOrder);
+    TEST_ASSERT_EQUAL(0, torn);
+    TEST_ASSERT_EQUAL(commands, expected);
+    TEST_ASSERT_EQUAL(commands, metrics.pushed);
+    TEST_ASSERT_EQUAL(commands, metrics.popped);
+    TEST_ASSERT_EQUAL(0, metrics.depth);
+    TEST_ASSERT_TRUE(metrics.highWater <= 8);
+}
+
+// =============================================================================
+// MAIN TEST RUNNER
+// =============================================================================
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    // Ring behaviour
+    RUN_TEST(test_queue_fifoAndFull);
+    RUN_TEST(test_queue_wrapsAround);
+    RUN_TEST(test_drain_appliesOnlyTheBatchAtTickStart);
+
+    // Concurrency
+    RUN_TEST(test_stress_producerConsumerThreads);
+
+    return UNITY_END();
+}
+
+#endif // NATIVE_BUILD
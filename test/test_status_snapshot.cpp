@@ -0,0 +1,132 @@
+#ifdef NATIVE_BUILD
+#include <unity.h>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#include "status_snapshot.h"
+
+// =============================================================================
+// HELPERS
+// =============================================================================
+
+typedef SnapshotStore<128, 2> TestStore;
+
+// Stand-in for buildStatusSnapshot(): renders the state version as the document
+static const TestStore::Snapshot* build(TestStore& store, uint32_t version, unsigned long now) {
+    TestStore::Snapshot* snapshot = store.beginBuild();
+    if (snapshot == nullptr) return nullptr;
+    const int length = snprintf(snapshot->data, sizeof(snapshot->data), "{\"version\":%u}", static_cast<unsigned>(version));
+    store.publish(snapshot, static_cast<size_t>(length), version, now);
+    return snapshot;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// =============================================================================
+// UNIT TESTS
+// =============================================================================
+
+void test_snapshot_emptyStore(void) {
+    TestStore store;
+    TEST_ASSERT_NULL(store.current());
+    TEST_ASSERT_NULL(store.acquire());
+    TEST_ASSERT_FALSE(store.isCurrent(1));
+}
+
+void test_snapshot_publishMakesCurrent(void) {
+    TestStore store;
+    const TestStore::Snapshot* first = build(store, 1, 100);
+    TEST_ASSERT_NOT_NULL(first);
+    TEST_ASSERT_TRUE(first == store.current());
+    TEST_ASSERT_TRUE(store.isCurrent(1));
+    TEST_ASSERT_FALSE(store.isCurrent(2));
+    TEST_ASSERT_EQUAL_STRING("{\"version\":1}", first->data);
+    TEST_ASSERT_EQUAL(100, first->builtAtMs);
+
+    // Double buffering: the next build never overwrites the current snapshot
+    const TestStore::Snapshot* second = build(store, 2, 200);
+    TEST_ASSERT_TRUE(second != first);
+    TEST_ASSERT_EQUAL_STRING("{\"version\":1}", first->data);
+}
+
+// A snapshot an HTTP response is still sending is never rebuilt underneath it
+void test_snapshot_readersPinSlots(void) {
+    TestStore store;
+    build(store, 1, 0);
+    TestStore::Snapshot* reading = store.acquire();
+    TEST_ASSERT_EQUAL(1, store.readers());
+
+    build(store, 2, 10); // Goes into the other slot
+    TEST_ASSERT_EQUAL_STRING("{\"version\":1}", reading->data);
+
+    // Slot 1 is read, slot 2 is current: no room for version 3 yet
+    TEST_ASSERT_NULL(build(store, 3, 20));
+    TEST_ASSERT_TRUE(store.isCurrent(2));
+
+    store.release(reading);
+    TEST_ASSERT_EQUAL(0, store.readers());
+    TEST_ASSERT_NOT_NULL(build(store, 3, 30));
+    TEST_ASSERT_TRUE(store.isCurrent(3));
+}
+
+void test_snapshot_releaseIsIdempotentPerReader(void) {
+    TestStore store;
+    build(store, 1, 0);
+    TestStore::Snapshot* a = store.acquire();
+    TestStore::Snapshot* b = store.acquire();
+    TEST_ASSERT_TRUE(a == b);
+    TEST_ASSERT_EQUAL(2, store.readers());
+    store.release(a);
+    store.release(b);
+    store.release(b); // Extra release must not underflow
+    TEST_ASSERT_EQUAL(0, store.readers());
+    TEST_ASSERT_EQUAL(2, store.metrics().served);
+}
+
+// One state change serves any number of clients: the document is rendered
+// once and every WebSocket frame / HTTP response references the same bytes
+void test_snapshot_serializeOncePerChange(void) {
+    TestStore store;
+    uint32_t stateVersion = 1;
+    uint32_t renders = 0;
+    const uint8_t httpPollsPerChange = 10;
+
+    for (int change = 0; change < 20; change++) {
+        stateVersion++;
+        if (!store.isCurrent(stateVersion) && build(store, stateVersion, change) != nullptr) renders++; // Broadcast
+        for (uint8_t i = 0; i < httpPollsPerChange; i++) {
+            if (!store.isCurrent(stateVersion) && build(store, stateVersion, change) != nullptr) renders++;
+            TestStore::Snapshot* snapshot = store.acquire();
+            TEST_ASSERT_EQUAL(stateVersion, snapshot->version);
+            store.release(snapshot);
+        }
+    }
+    printf("  20 changes, %u polls each: %u renders, %u responses served\n",
+           httpPollsPerChange, renders, store.metrics().served);
+    TEST_ASSERT_EQUAL(20, renders);
+    TEST_ASSERT_EQUAL(20, store.metrics().builds);
+    TEST_ASSERT_EQUAL(20 * httpPollsPerChange, store.metrics().served);
+}
+
+// =============================================================================
+// MAIN TEST RUNNER
+// =============================================================================
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    // Snapshot store
+    RUN_TEST(test_snapshot_emptyStore);
+    RUN_TEST(test_snapshot_publishMakesCurrent);
+    RUN_TEST(test_snapshot_readersPinSlots);
+    RUN_TEST(test_snapshot_releaseIsIdempotentPerReader);
+
+    // Sharing
+    RUN_TEST(test_snapshot_serializeOncePerChange);
+
+    return UNITY_END();
+}
+
+#endif // NATIVE_BUILD
@@ -0,0 +1,185 @@
+#ifdef NATIVE_BUILD
+#include <unity.h>
+#include <cstdint>
+#include <cstring>
+
+#include "status_subscription.h"
+
+// =============================================================================
+// HELPERS
+// =============================================================================
+
+// Same pins as LED_PINS in config.h
+static constexpr uint8_t TEST_PINS[] = {4, 5, 12, 13, 14, 16, 2};
+static constexpr OutputPinMap TEST_OUTPUTS = makeOutputPinMap(TEST_PINS);
+
+static bool parse(const char* query, StatusSubscription& subscription, bool& telemetry, bool defaultTelemetry = true) {
+    return parseStatusSubscription(TextView::fromCString(query), TEST_OUTPUTS,
+                                   defaultTelemetry, subscription, telemetry);
+}
+
+static StatusSubscription parsed(const char* query) {
+    StatusSubscription subscription;
+    bool telemetry = false;
+    TEST_ASSERT_TRUE(parse(query, subscription, telemetry));
+    return subscription;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// =============================================================================
+// UNIT TESTS
+// =============================================================================
+
+void test_parse_emptyQueryIsFullDocument(void) {
+    StatusSubscription subscription;
+    bool telemetry = false;
+    TEST_ASSERT_TRUE(parse("", subscription, telemetry));
+    TEST_ASSERT_TRUE(subscription.isFull());
+    TEST_ASSERT_TRUE(telemetry);
+
+    TEST_ASSERT_TRUE(parse("", subscription, telemetry, false));
+    TEST_ASSERT_FALSE(telemetry);
+    TEST_ASSERT_TRUE(parse("telemetry=1", subscription, telemetry, false));
+    TEST_ASSERT_TRUE(telemetry);
+    TEST_ASSERT_TRUE(subscription.isFull());
+}
+
+void test_parse_sectionsOutputsAndGroups(void) {
+    const StatusSubscription subscription = parsed("sections=outputs,groups&outputs=5,13&groups=2");
+    TEST_ASSERT_EQUAL(StatusSectionOutputs | StatusSectionGroups, subscription.sections);
+    TEST_ASSERT_FALSE(subscription.includes(StatusSectionDevice));
+    TEST_ASSERT_FALSE(subscription.includesOutput(0)); // GPIO 4
+    TEST_ASSERT_TRUE(subscription.includesOutput(1));  // GPIO 5
+    TEST_ASSERT_TRUE(subscription.includesOutput(3));  // GPIO 13
+    TEST_ASSERT_TRUE(subscription.includesGroup(2));
+    TEST_ASSERT_FALSE(subscription.includesGroup(3));
+    TEST_ASSERT_FALSE(subscription.isFull());
+}
+
+void test_parse_outputsById(void) {
+    const StatusSubscription subscription = parsed("sections=outputs&ids=0-2,5");
+    TEST_ASSERT_TRUE(subscription.includesOutput(0));
+    TEST_ASSERT_TRUE(subscription.includesOutput(2));
+    TEST_ASSERT_FALSE(subscription.includesOutput(3));
+    TEST_ASSERT_TRUE(subscription.includesOutput(5));
+    TEST_ASSERT_TRUE(parsed("ids=1,3").sameDocument(parsed("outputs=5,13")));
+    TEST_ASSERT_TRUE(parsed("ids=0&outputs=5").sameDocument(parsed("ids=0,1"))); // Both: union
+    TEST_ASSERT_TRUE(parsed("ids=6-0").isFull());
+
+    StatusSubscription rejected;
+    bool telemetry = false;
+    TEST_ASSERT_FALSE(parse("ids=7", rejected, telemetry));  // Only 7 outputs
+    TEST_ASSERT_FALSE(parse("ids=1-", rejected, telemetry));
+    TEST_ASSERT_FALSE(parse("ids=", rejected, telemetry));
+}
+
+void test_parse_rejectsMalformedFilters(void) {
+    StatusSubscription subscription;
+    bool telemetry = false;
+    TEST_ASSERT_FALSE(parse("sections=outputs,lights", subscription, telemetry));
+    TEST_ASSERT_FALSE(parse("sections=", subscription, telemetry));
+    TEST_ASSERT_FALSE(parse("outputs=15", subscription, telemetry));     // Not an output pin
+    TEST_ASSERT_FALSE(parse("outputs=5x", subscription, telemetry));
+    TEST_ASSERT_FALSE(parse("groups=0", subscription, telemetry));
+    TEST_ASSERT_FALSE(parse("groups=1,2,3,4,5", subscription, telemetry)); // More than STATUS_MAX_GROUP_FILTER
+    TEST_ASSERT_FALSE(parse("telemetry=yes", subscription, telemetry));
+}
+
+void test_parse_normalizesEquivalentFilters(void) {
+    // Every output listed is the same document as no output filter
+    TEST_ASSERT_TRUE(parsed("outputs=2,4,5,12,13,14,16").isFull());
+    // Order and duplicates don't matter
+    TEST_ASSERT_TRUE(parsed("groups=3,2,2").sameDocument(parsed("groups=2,3")));
+    TEST_ASSERT_TRUE(parsed("sections=groups,outputs").sameDocument(parsed("sections=outputs,groups")));
+    TEST_ASSERT_FALSE(parsed("outputs=4").sameDocument(parsed("outputs=5")));
+}
+
+void test_wants_onlyRelevantChanges(void) {
+    const StatusSubscription output5 = parsed("sections=outputs&outputs=5");
+    TEST_ASSERT_TRUE(output5.wants(StatusChange::output(1), false));
+    TEST_ASSERT_FALSE(output5.wants(StatusChange::output(0), false));
+    TEST_ASSERT_FALSE(output5.wants(StatusChange::groups(), false));
+    TEST_ASSERT_TRUE(output5.wants(StatusChange::groupMembership(), false)); // chasingGroup field
+    TEST_ASSERT_FALSE(output5.wants(StatusChange::telemetry(), true));     // Nothing to refresh
+
+    const StatusSubscription device = parsed("sections=device");
+    TEST_ASSERT_FALSE(device.wants(StatusChange::output(1), true));
+    TEST_ASSERT_TRUE(device.wants(StatusChange::telemetry(), true));
+    TEST_ASSERT_FALSE(device.wants(StatusChange::telemetry(), false));
+
+    const StatusSubscription all = StatusSubscription::all();
+    TEST_ASSERT_TRUE(all.wants(StatusChange::output(6), false));
+    TEST_ASSERT_TRUE(all.wants(StatusChange::groups(), false));
+}
+
+void test_change_accumulates(void) {
+    StatusChange change = StatusChange::none();
+    TEST_ASSERT_TRUE(change.empty());
+    change.add(StatusChange::output(0));
+    change.add(StatusChange::output(3));
+    TEST_ASSERT_EQUAL(StatusSectionOutputs, change.sections);
+    TEST_ASSERT_EQUAL(0x09, change.outputs);
+    TEST_ASSERT_FALSE(change.telemetryOnly);
+
+    change.add(StatusChange::telemetry()); // A state change also carries fresh telemetry
+    TEST_ASSERT_FALSE(change.telemetryOnly);
+    TEST_ASSERT_FALSE(parsed("sections=outputs&outputs=12").wants(change, false));
+    TEST_ASSERT_TRUE(parsed("sections=outputs&outputs=13").wants(change, false));
+}
+
+void test_classes_shareAndRelease(void) {
+    SubscriptionClasses<3> classes;
+    TEST_ASSERT_EQUAL(1, classes.activeCount()); // Full document always
+
+    TEST_ASSERT_EQUAL(0, classes.acquire(StatusSubscription::all()));
+    const uint8_t outputs = classes.acquire(parsed("sections=outputs"));
+    TEST_ASSERT_EQUAL(1, outputs);
+    TEST_ASSERT_EQUAL(outputs, classes.acquire(parsed("sections=outputs")));
+    const uint8_t groups = classes.acquire(parsed("sections=groups"));
+    TEST_ASSERT_EQUAL(2, groups);
+    TEST_ASSERT_EQUAL(3, classes.activeCount());
+
+    // Table full: falls back to the full document
+    TEST_ASSERT_EQUAL(0, classes.acquire(parsed("sections=device")));
+
+    classes.release(groups);
+    TEST_ASSERT_FALSE(classes.active(groups));
+    TEST_ASSERT_EQUAL(groups, classes.acquire(parsed("sections=device")));
+    TEST_ASSERT_EQUAL(StatusSectionDevice, classes.subscription(groups).sections);
+
+    classes.release(outputs);
+    TEST_ASSERT_TRUE(classes.active(outputs)); // Second client still subscribed
+    classes.release(outputs);
+    TEST_ASSERT_FALSE(classes.active(outputs));
+    classes.release(outputs);                  // Never underflows
+    classes.release(SubscriptionClasses<3>::NO_CLASS);
+    TEST_ASSERT_TRUE(classes.active(0));
+}
+
+// =============================================================================
+// MAIN TEST RUNNER
+// =============================================================================
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    // Query parsing
+    RUN_TEST(test_parse_emptyQueryIsFullDocument);
+    RUN_TEST(test_parse_sectionsOutputsAndGroups);
+    RUN_TEST(test_parse_outputsById);
+    RUN_TEST(test_parse_rejectsMalformedFilters);
+    RUN_TEST(test_parse_normalizesEquivalentFilters);
+
+    // Change routing
+    RUN_TEST(test_wants_onlyRelevantChanges);
+    RUN_TEST(test_change_accumulates);
+
+    // Subscription classes
+    RUN_TEST(test_classes_shareAndRelease);
+
+    return UNITY_END();
+}
+
+#endif // NATIVE_BUILD
@@ -0,0 +1,221 @@
+#ifdef NATIVE_BUILD
+#include <unity.h>
+#include <cstdint>
+#include <cstdio>
+
+#include "task_scheduler.h"
+
+// =============================================================================
+// HELPERS
+// =============================================================================
+
+// Simulated clock: tasks advance it by their run time. Both readings wrap
+// independently, like millis() and micros().
+static uint64_t simUs = 0;
+
+struct SimClock {
+    static uint32_t nowMs() { return static_cast<uint32_t>(simUs / 1000); }
+    static uint32_t nowUs() { return static_cast<uint32_t>(simUs); }
+};
+
+typedef TaskScheduler<SimClock, 8> TestScheduler;
+
+static const uint32_t PASS_BUDGET_US = 4000;
+static const uint8_t MAX_DEFERRALS = 8;
+
+// Run cost of each task, set per test
+static uint32_t effectCostUs = 0;
+static uint32_t networkCostUs = 0;
+static uint32_t telemetryCostUs = 0;
+
+static uint32_t effectRuns = 0;
+static uint32_t networkRuns = 0;
+static uint32_t telemetryRuns = 0;
+
+static void effectTask() { effectRuns++; simUs += effectCostUs; }
+static void networkTask() { networkRuns++; simUs += networkCostUs; }
+static void telemetryTask() { telemetryRuns++; simUs += telemetryCostUs; }
+
+// Same shape as the firmware table: effects high, network medium, telemetry low
+static const TaskSpec TEST_TASKS[] = {
+    {"telemetry", telemetryTask, TaskPriority::Low, 0, 0, 2000},
+    {"network", networkTask, TaskPriority::Medium, 0, 0, 3000},
+    {"effects", effectTask, TaskPriority::High, 0, 20, 1000},
+};
+static const uint8_t TEST_TASK_COUNT = sizeof(TEST_TASKS) / sizeof(TEST_TASKS[0]);
+
+void setUp(void) {
+    simUs = 0;
+    effectCostUs = networkCostUs = telemetryCostUs = 100;
+    effectRuns = networkRuns = telemetryRuns = 0;
+}
+void tearDown(void) {}
+
+// =============================================================================
+// UNIT TESTS
+// =============================================================================
+
+void test_runsByPriority(void) {
+    static uint8_t order[3];
+    static uint8_t position;
+    struct Record {
+        static void high() { order[position++] = 0; }
+        static void medium() { order[position++] = 1; }
+        static void low() { order[position++] = 2; }
+    };
+    const TaskSpec tasks[] = {
+        {"low", Record::low, TaskPriority::Low, 0, 0, 100},
+        {"medium", Record::medium, TaskPriority::Medium, 0, 0, 100},
+        {"high", Record::high, TaskPriority::High, 0, 0, 100},
+    };
+    position = 0;
+    TestScheduler scheduler(tasks, 3, PASS_BUDGET_US, MAX_DEFERRALS);
+    scheduler.runPass();
+    TEST_ASSERT_EQUAL(3, position);
+    TEST_ASSERT_EQUAL(0, order[0]);
+    TEST_ASSERT_EQUAL(1, order[1]);
+    TEST_ASSERT_EQUAL(2, order[2]);
+}
+
+void test_periodLimitsRuns(void) {
+    const TaskSpec tasks[] = {{"effects", effectTask, TaskPriority::High, 100, 0, 1000}};
+    TestScheduler scheduler(tasks, 1, PASS_BUDGET_US, MAX_DEFERRALS);
+    for (int i = 0; i < 1000; i++) scheduler.runPass(); // 100 ms of passes at 100 us
+    TEST_ASSERT_EQUAL(1, effectRuns);
+    simUs = 100000;
+    scheduler.runPass();
+    TEST_ASSERT_EQUAL(2, effectRuns);
+}
+
+void test_runTimeAndBudget(void) {
+    TestScheduler scheduler(TEST_TASKS, TEST_TASK_COUNT, PASS_BUDGET_US, MAX_DEFERRALS);
+    scheduler.runPass();
+    effectCostUs = 1500; // Over its 1000 us budget
+    scheduler.runPass();
+
+    const TaskStats& stats = scheduler.stats(2);
+    TEST_ASSERT_EQUAL(2, stats.runs);
+    TEST_ASSERT_EQUAL(1600, stats.totalUs);
+    TEST_ASSERT_EQUAL(1500, stats.maxUs);
+    TEST_ASSERT_EQUAL(1, stats.overBudget);
+    TEST_ASSERT_EQUAL(0, scheduler.stats(1).overBudget);
+}
+
+void test_deadlineMisses(void) {
+    TestScheduler scheduler(TEST_TASKS, TEST_TASK_COUNT, PASS_BUDGET_US, MAX_DEFERRALS);
+    scheduler.runPass();
+    simUs += 20000;     // Exactly the 20 ms deadline
+    scheduler.runPass();
+    TEST_ASSERT_EQUAL(0, scheduler.stats(2).deadlineMisses);
+    simUs += 25000;     // One long pass elsewhere
+    scheduler.runPass();
+    TEST_ASSERT_EQUAL(1, scheduler.stats(2).deadlineMisses);
+    TEST_ASSERT_TRUE(scheduler.stats(2).maxGapMs >= 25);
+    TEST_ASSERT_EQUAL(0, scheduler.stats(0).deadlineMisses); // No deadline set
+}
+
+void test_idleNotAGap(void) {
+    TestScheduler scheduler(TEST_TASKS, TEST_TASK_COUNT, PASS_BUDGET_US, MAX_DEFERRALS);
+    scheduler.runPass();
+    simUs += 45000;     // Idled until the next effect step
+    scheduler.idled(45);
+    scheduler.runPass();
+    TEST_ASSERT_EQUAL(0, scheduler.stats(2).deadlineMisses);
+    TEST_ASSERT_TRUE(scheduler.stats(2).maxGapMs < 20);
+    simUs += 25000;     // Busy elsewhere: still a miss
+    scheduler.runPass();
+    TEST_ASSERT_EQUAL(1, scheduler.stats(2).deadlineMisses);
+}
+
+void test_highNeverDeferred(void) {
+    effectCostUs = 5000; // Uses the whole pass budget by itself
+    TestScheduler scheduler(TEST_TASKS, TEST_TASK_COUNT, PASS_BUDGET_US, MAX_DEFERRALS);
+    for (int i = 0; i < 100; i++) scheduler.runPass();
+    TEST_ASSERT_EQUAL(100, effectRuns);
+    TEST_ASSERT_EQUAL(0, scheduler.stats(2).deferrals);
+    TEST_ASSERT_TRUE(scheduler.stats(1).deferrals > 0);
+    TEST_ASSERT_TRUE(scheduler.schedulerStats().overrunPasses > 0);
+}
+
+void test_millisWrap(void) {
+    const TaskSpec tasks[] = {{"effects", effectTask, TaskPriority::High, 50, 0, 1000}};
+    TestScheduler scheduler(tasks, 1, PASS_BUDGET_US, MAX_DEFERRALS);
+    const uint64_t start = 0xFFFFFFF0ULL * 1000; // 16 ms before millis() wraps
+    simUs = start;
+    scheduler.runPass();
+    simUs = start + 40000;
+    scheduler.runPass();
+    TEST_ASSERT_EQUAL(1, effectRuns);
+    simUs = start + 50000;
+    scheduler.runPass();
+    TEST_ASSERT_EQUAL(2, effectRuns);
+}
+
+// Overload: the effect tick and the network task together take more than
+// the pass budget on every pass. The effect tick still runs every pass, and
+// the deferred tasks still run at least once every MAX_DEFERRALS + 1 passes.
+void test_simulatedOverload_fairness(void) {
+    effectCostUs = 800;
+    networkCostUs = 3500;     // A burst of HTTP and WebSocket traffic
+    telemetryCostUs = 1200;   // Status document rebuild
+    TestScheduler scheduler(TEST_TASKS, TEST_TASK_COUNT, PASS_BUDGET_US, MAX_DEFERRALS);
+
+    const uint32_t passes = 5000;
+    uint32_t lastNetworkPass = 0;
+    uint32_t lastTelemetryPass = 0;
+    uint32_t longestNetworkWait = 0;
+    uint32_t longestTelemetryWait = 0;
+    for (uint32_t pass = 1; pass <= passes; pass++) {
+        const uint32_t networkBefore = networkRuns;
+        const uint32_t telemetryBefore = telemetryRuns;
+        scheduler.runPass();
+        if (networkRuns != networkBefore) {
+            if (pass - lastNetworkPass > longestNetworkWait) longestNetworkWait = pass - lastNetworkPass;
+            lastNetworkPass = pass;
+        }
+        if (telemetryRuns != telemetryBefore) {
+            if (pass - lastTelemetryPass > longestTelemetryWait) longestTelemetryWait = pass - lastTelemetryPass;
+            lastTelemetryPass = pass;
+        }
+    }
+
+    const TaskStats& effects = scheduler.stats(2);
+    const SchedulerStats& totals = scheduler.schedulerStats();
+    printf("  overload, %u passes: effects %u runs (max gap %u ms), network %u runs (longest wait %u passes), "
+           "telemetry %u runs (longest wait %u passes), max pass %u us\n",
+           static_cast<unsigned>(passes), static_cast<unsigned>(effects.runs), static_cast<unsigned>(effects.maxGapMs),
+           static_cast<unsigned>(networkRuns), static_cast<unsigned>(longestNetworkWait),
+           static_cast<unsigned>(telemetryRuns), static_cast<unsigned>(longestTelemetryWait),
+           static_cast<unsigned>(totals.maxPassUs));
+
+    TEST_ASSERT_EQUAL(passes, effects.runs);
+    TEST_ASSERT_EQUAL(0, effects.deadlineMisses);   // Worst pass: 800 + 3500 + 1200 us
+    TEST_ASSERT_TRUE(longestNetworkWait <= MAX_DEFERRALS + 1u);
+    TEST_ASSERT_TRUE(longestTelemetryWait <= MAX_DEFERRALS + 1u);
+    TEST_ASSERT_TRUE(telemetryRuns >= passes / (MAX_DEFERRALS + 1u)); // Low priority is slowed, not starved
+    TEST_ASSERT_TRUE(networkRuns > telemetryRuns);  // Medium gets the spare budget first
+}
+
+// =============================================================================
+// MAIN TEST RUNNER
+// =============================================================================
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    // Ordering and timing
+    RUN_TEST(test_runsByPriority);
+    RUN_TEST(test_periodLimitsRuns);
+    RUN_TEST(test_runTimeAndBudget);
+    RUN_TEST(test_deadlineMisses);
+    RUN_TEST(test_idleNotAGap);
+    RUN_TEST(test_millisWrap);
+
+    // Load
+    RUN_TEST(test_highNeverDeferred);
+    RUN_TEST(test_simulatedOverload_fairness);
+
+    return UNITY_END();
+}
+
+#endif // NATIVE_BUILD
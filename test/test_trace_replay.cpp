@@ -0,0 +1,460 @@
+#ifdef NATIVE_BUILD
+#include <unity.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "trace_replay.h"
+
+// Trace replay against a simulated device: the test device runs the engine
+// functions of effect_engine.h on 1 ms loop passes like main.cpp, records
+// its inputs into a FlightRecorder and logs every pin write. Replaying the
+// downloaded trace has to reproduce those writes at the same times.
+//
+// Replaying a trace from a board: download it with
+//   curl -o trace.bin http://railhub.local/api/trace
+// and run this test with RAILHUB_TRACE=trace.bin. The replay prints its
+// statistics and the host time it took. RAILHUB_REPLAY_OUTPUT=<file> also
+// writes every pin write as "time_ms,gpio,duty" lines.
+
+// =============================================================================
+// HELPERS
+// =============================================================================
+
+// Firmware sizes (config.h, main.cpp)
+static const uint8_t TEST_PINS[7] = {4, 5, 12, 13, 14, 16, 2};
+static const uint8_t TEST_GROUPS = 4;
+static const char* const TEST_COMMANDS[] = {"control", "name", "interval", "chasing/create", "chasing/delete"};
+
+typedef TraceReplay<7, TEST_GROUPS> FirmwareReplay;
+typedef FirmwareReplay::Keyframe DeviceSnapshot;
+static_assert(sizeof(DeviceSnapshot) <= 255, "A keyframe must fit one record");
+
+struct PinWrite {
+    uint32_t timeMs;
+    uint8_t pin;
+    uint8_t duty;
+
+    bool operator==(const PinWrite& other) const {
+        return timeMs == other.timeMs && pin == other.pin && duty == other.duty;
+    }
+};
+
+// The device's pins: writes logged with the device clock
+struct DevicePins {
+    static std::vector<PinWrite>* log;
+    static uint32_t nowMs;
+    static void pwm(uint8_t pin, uint8_t duty) { add(pin, duty); }
+    static void detachPwm(uint8_t) {}
+    static void set(uint8_t pin) { add(pin, 255); }
+    static void clear(uint8_t pin) { add(pin, 0); }
+    static void add(uint8_t pin, uint8_t duty) {
+        PinWrite write = {nowMs, pin, duty};
+        log->push_back(write);
+    }
+};
+std::vector<PinWrite>* DevicePins::log = nullptr;
+uint32_t DevicePins::nowMs = 0;
+
+// main.cpp's engine and recording, on a millisecond loop
+template <size_t RecorderSize>
+struct Device {
+    OutputTable<7, ENGINE_NAME_LENGTH> table;
+    OutputDriver<DevicePins, 7> driver;
+    ChasingGroup groups[TEST_GROUPS];
+    SpscQueue<OutputCommand, 8> queue;
+    FlightRecorder<RecorderSize> recorder;
+    std::vector<PinWrite> writes;
+    uint32_t nowMs;
+
+    Device() : table(TEST_PINS), driver(TEST_PINS), nowMs(0) {
+        memset(groups, 0, sizeof(groups));
+        DevicePins::log = &writes;
+        tick();
+    }
+
+    // A command handler posting to the engine (postOutputCommand())
+    void post(const OutputCommand& command, uint8_t commandIndex) {
+        TEST_ASSERT_TRUE(queue.push(command));
+        recorder.recordOutputCommand(nowMs, command);
+        recorder.recordCommand(nowMs, TraceSource::WebSocket, 0, commandIndex, 0);
+    }
+
+    // runEffectTask()
+    void tick() {
+        DevicePins::nowMs = nowMs;
+        queue.drain([this](const OutputCommand& command) { apply(command); });
+        stepChasingGroups(table, driver, groups, TEST_GROUPS, nowMs, [](const ChasingGroup&, uint8_t, bool) {});
+        stepBlinkingOutputs(table, driver, nowMs);
+        if (recorder.keyframeDue()) {
+            DeviceSnapshot snapshot;
+            memset(&snapshot, 0, sizeof(snapshot));
+            captureEffectState(snapshot, table, groups, TEST_GROUPS, nowMs);
+            snapshot.seal();
+            recorder.record(TraceEvent::Keyframe, nowMs, reinterpret_cast<const uint8_t*>(&snapshot), sizeof(snapshot));
+        }
+    }
+
+    // applyOutputCommand()
+    void apply(const OutputCommand& command) {
+        switch (command.type) {
+            case OutputCommandType::SetOutput:
+                for (uint8_t i = 0; i < command.outputCount; i++) {
+                    setOutputLevel(table, driver, command.outputs[i], command.active, brightnessDuty(command.brightness));
+                }
+                break;
+            case OutputCommandType::SetInterval:
+                for (uint8_t i = 0; i < command.outputCount; i++) {
+                    setOutputBlink(table, driver, command.outputs[i], command.interval, nowMs);
+                }
+                break;
+            case OutputCommandType::CreateGroup: {
+                const int slot = findChasingGroupSlot(groups, TEST_GROUPS, command.target);
+                startChasingGroup(table, driver, groups[slot], command.target, command.outputs, command.outputCount,
+                                  command.interval, command.name, nowMs);
+                break;
+            }
+            case OutputCommandType::DeleteGroup:
+                for (uint8_t g = 0; g < TEST_GROUPS; g++) {
+                    if (groups[g].active && groups[g].groupId == command.target) stopChasingGroup(table, driver, groups[g]);
+                }
+                break;
+            case OutputCommandType::RenameGroup:
+            case OutputCommandType::RenameOutput:
+                break;
+        }
+    }
+
+    // The pass at 'nowMs' ends after 'passMs' and the next one starts with
+    // its effect tick. Commands posted in between come from the handlers of
+    // the pass at 'nowMs', which run after its tick.
+    void endPass(uint32_t passMs = 1) {
+        nowMs += passMs;
+        if (passMs > 1) recorder.recordOverrun(nowMs, passMs * 1000);
+        tick();
+    }
+
+    void runUntil(uint32_t timeMs) {
+        while (nowMs < timeMs) endPass();
+    }
+
+    // GET /api/trace
+    std::vector<uint8_t> download() {
+        uint8_t header[128];
+        const size_t headerLength = formatTraceHeader(header, sizeof(header), recorder, TEST_PINS, 7, TEST_GROUPS, 5,
+                                                      [](uint8_t i) { return TEST_COMMANDS[i]; }, nowMs);
+        std::vector<uint8_t> trace(header, header + headerLength);
+        for (uint8_t i = 0; i < 2; i++) {
+            const uint8_t* data;
+            const size_t length = recorder.span(i, data);
+            trace.insert(trace.end(), data, data + length);
+        }
+        return trace;
+    }
+};
+
+static OutputCommand makeCommand(OutputCommandType type, uint8_t target) {
+    OutputCommand command;
+    memset(&command, 0, sizeof(command));
+    command.type = type;
+    command.target = target;
+    return command;
+}
+
+static OutputCommand controlCommand(uint8_t output, bool active, uint8_t brightness) {
+    OutputCommand command = makeCommand(OutputCommandType::SetOutput, 0);
+    command.active = active;
+    command.brightness = brightness;
+    command.outputCount = 1;
+    command.outputs[0] = output;
+    return command;
+}
+
+static OutputCommand chaseCommand(uint8_t groupId, uint16_t intervalMs) {
+    OutputCommand command = makeCommand(OutputCommandType::CreateGroup, groupId);
+    command.interval = intervalMs;
+    command.outputCount = 3;
+    command.outputs[0] = 0;
+    command.outputs[1] = 1;
+    command.outputs[2] = 2;
+    strcpy(command.name, "Yard");
+    return command;
+}
+
+// A chasing group, a blinking output and a dimmer slider, then a 250 ms pass
+template <size_t RecorderSize>
+static void runScenario(Device<RecorderSize>& device) {
+    device.runUntil(10);
+    const uint8_t address[4] = {192, 168, 1, 30};
+    device.recorder.recordConnect(device.nowMs, 0, address);
+    device.post(chaseCommand(1, 100), 3);
+    device.runUntil(20);
+    device.post(controlCommand(5, true, 40), 0);
+    device.runUntil(30);
+    OutputCommand blink = makeCommand(OutputCommandType::SetInterval, 0);
+    blink.interval = 300;
+    blink.outputCount = 1;
+    blink.outputs[0] = 5;
+    device.post(blink, 2);
+    for (uint32_t t = 100; t < 1500; t += 20) { // Slider on output 6
+        device.runUntil(t);
+        device.post(controlCommand(6, true, static_cast<uint8_t>((t / 20) % 101)), 0);
+    }
+    device.runUntil(1530);
+    device.endPass(250);                       // Stalls the blink toggle due at 1531 and the chase step due at 1611
+    device.runUntil(2000);
+    device.post(makeCommand(OutputCommandType::DeleteGroup, 1), 4);
+    device.runUntil(2500);
+    device.recorder.recordDisconnect(device.nowMs, 0);
+    device.runUntil(3000);
+}
+
+static void collectWrite(void* context, uint64_t timeUs, uint8_t pin, uint8_t duty) {
+    PinWrite write = {static_cast<uint32_t>(timeUs / 1000), pin, duty};
+    static_cast<std::vector<PinWrite>*>(context)->push_back(write);
+}
+
+static ReplayOptions collectingOptions(std::vector<PinWrite>& writes) {
+    ReplayOptions options = ReplayOptions::defaults();
+    options.onWrite = collectWrite;
+    options.context = &writes;
+    return options;
+}
+
+// The device's writes after 'startMs', when the replay has caught up with it
+static std::vector<PinWrite> writesAfter(const std::vector<PinWrite>& writes, uint32_t startMs) {
+    std::vector<PinWrite> after;
+    for (size_t i = 0; i < writes.size(); i++) {
+        if (writes[i].timeMs > startMs) after.push_back(writes[i]);
+    }
+    return after;
+}
+
+static bool readFile(const char* path, std::vector<uint8_t>& data) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) return false;
+    uint8_t chunk[4096];
+    size_t length;
+    while ((length = fread(chunk, 1, sizeof(chunk), file)) > 0) data.insert(data.end(), chunk, chunk + length);
+    fclose(file);
+    return true;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// =============================================================================
+// UNIT TESTS
+// =============================================================================
+
+void test_replay_reproducesOutputSequence(void) {
+    Device<4096> device;
+    runScenario(device);
+    const std::vector<uint8_t> trace = device.download();
+    TEST_ASSERT_EQUAL(0, device.recorder.metrics().evicted);
+
+    std::vector<PinWrite> replayed;
+    FirmwareReplay replay(collectingOptions(replayed));
+    TEST_ASSERT_TRUE(replay.run(trace.data(), trace.size()));
+    const ReplayStats& stats = replay.stats();
+    TEST_ASSERT_EQUAL(0, stats.skipped);
+    TEST_ASSERT_EQUAL(0, stats.startUs);
+    TEST_ASSERT_EQUAL(3000000ULL, stats.endUs);
+    TEST_ASSERT_EQUAL(74, stats.commands);
+    TEST_ASSERT_EQUAL(74, stats.outputCommands);
+    TEST_ASSERT_EQUAL(0, stats.invalidCommands);
+    TEST_ASSERT_EQUAL(1, stats.connects);
+    TEST_ASSERT_EQUAL(1, stats.maxClients);
+    TEST_ASSERT_EQUAL(0, stats.divergences);
+    TEST_ASSERT_EQUAL(0, stats.phaseDrifts);
+
+    // Every write after the keyframe, at the same millisecond
+    const std::vector<PinWrite> expected = writesAfter(device.writes, 0);
+    const std::vector<PinWrite> actual = writesAfter(replayed, 0);
+    TEST_ASSERT_EQUAL(expected.size(), actual.size());
+    TEST_ASSERT_TRUE(expected == actual);
+    TEST_ASSERT_FALSE(replay.group(0).active); // Deleted at 2000
+    TEST_ASSERT_TRUE(replay.table().isOn(6));
+}
+
+void test_replay_reproducesStall(void) {
+    Device<4096> device;
+    runScenario(device);
+    const std::vector<uint8_t> trace = device.download();
+
+    FirmwareReplay replay;
+    TEST_ASSERT_TRUE(replay.run(trace.data(), trace.size()));
+    const ReplayStats& stats = replay.stats();
+    TEST_ASSERT_EQUAL(1, stats.overruns);
+    TEST_ASSERT_EQUAL(250000, stats.maxOverrunUs);
+    TEST_ASSERT_EQUAL(250000, stats.maxTickGapUs);
+    // Both run at 1780, the first pass after the stall
+    TEST_ASSERT_EQUAL(1780 - 1531, stats.maxLateMs);
+    TEST_ASSERT_EQUAL(2, stats.lateSteps);
+    TEST_ASSERT_EQUAL(3000 - (1779 - 1531 + 1), stats.ticks); // Every ms from 1 to 3000 but 1531-1779
+}
+
+void test_replay_isDeterministic(void) {
+    Device<4096> device;
+    runScenario(device);
+    const std::vector<uint8_t> trace = device.download();
+
+    std::vector<PinWrite> first;
+    std::vector<PinWrite> second;
+    FirmwareReplay firstReplay(collectingOptions(first));
+    FirmwareReplay secondReplay(collectingOptions(second));
+    TEST_ASSERT_TRUE(firstReplay.run(trace.data(), trace.size()));
+    TEST_ASSERT_TRUE(secondReplay.run(trace.data(), trace.size()));
+    TEST_ASSERT_TRUE(first == second);
+    TEST_ASSERT_EQUAL(0, memcmp(&firstReplay.stats(), &secondReplay.stats(), sizeof(ReplayStats)));
+}
+
+// A ring that has wrapped: the replay starts at the oldest keyframe left and
+// matches the device from there, later keyframes included
+void test_replay_fromWrappedRing(void) {
+    Device<1536> device;
+    runScenario(device);
+    for (uint32_t t = 3020; t < 6000; t += 20) {
+        device.runUntil(t);
+        device.post(controlCommand(4, (t / 20) & 1, 80), 0);
+    }
+    TEST_ASSERT_TRUE(device.recorder.metrics().evicted > 0);
+    TEST_ASSERT_TRUE(device.recorder.metrics().keyframes > 2);
+    const std::vector<uint8_t> trace = device.download();
+
+    std::vector<PinWrite> replayed;
+    FirmwareReplay replay(collectingOptions(replayed));
+    TEST_ASSERT_TRUE(replay.run(trace.data(), trace.size()));
+    const ReplayStats& stats = replay.stats();
+    TEST_ASSERT_TRUE(stats.startUs > 0);
+    TEST_ASSERT_TRUE(stats.keyframes > 0);
+    TEST_ASSERT_EQUAL(0, stats.divergences);
+    TEST_ASSERT_EQUAL(0, stats.phaseDrifts);
+    const uint32_t startMs = static_cast<uint32_t>(stats.startUs / 1000);
+    TEST_ASSERT_TRUE(writesAfter(device.writes, startMs) == writesAfter(replayed, startMs));
+}
+
+// A keyframe that disagrees with the replay is reported
+void test_replay_detectsDivergence(void) {
+    Device<4096> device;
+    device.runUntil(50);
+    device.post(controlCommand(3, true, 100), 0);
+    device.runUntil(60);
+    // A change the trace doesn't explain, then a keyframe showing it
+    setOutputLevel(device.table, device.driver, 4, true, 255);
+    DeviceSnapshot snapshot;
+    memset(&snapshot, 0, sizeof(snapshot));
+    captureEffectState(snapshot, device.table, device.groups, TEST_GROUPS, device.nowMs);
+    snapshot.seal();
+    device.recorder.record(TraceEvent::Keyframe, device.nowMs, reinterpret_cast<const uint8_t*>(&snapshot),
+                           sizeof(snapshot));
+    device.runUntil(70);
+    const std::vector<uint8_t> trace = device.download();
+
+    FirmwareReplay replay;
+    TEST_ASSERT_TRUE(replay.run(trace.data(), trace.size()));
+    TEST_ASSERT_EQUAL(1, replay.stats().keyframes);
+    TEST_ASSERT_EQUAL(1, replay.stats().divergences);
+}
+
+void test_replay_refusesOtherBuilds(void) {
+    Device<1024> device;
+    device.runUntil(5);
+    const std::vector<uint8_t> trace = device.download();
+
+    TraceReplay<8, TEST_GROUPS> wider;
+    TEST_ASSERT_FALSE(wider.run(trace.data(), trace.size()));
+    TraceReplay<7, 2> fewerGroups;
+    TEST_ASSERT_FALSE(fewerGroups.run(trace.data(), trace.size()));
+
+    // No keyframe: nothing to start from
+    FlightRecorder<256> empty;
+    empty.recordDisconnect(1, 0);
+    uint8_t header[128];
+    const size_t headerLength = formatTraceHeader(header, sizeof(header), empty, TEST_PINS, 7, TEST_GROUPS, 0,
+                                                  [](uint8_t) { return ""; }, 2);
+    std::vector<uint8_t> noKeyframe(header, header + headerLength);
+    const uint8_t* data;
+    const size_t length = empty.span(0, data);
+    noKeyframe.insert(noKeyframe.end(), data, data + length);
+    FirmwareReplay replay;
+    TEST_ASSERT_FALSE(replay.run(noKeyframe.data(), noKeyframe.size()));
+    TEST_ASSERT_EQUAL(1, replay.stats().skipped);
+}
+
+// RAILHUB_TRACE=<file>: replay a trace downloaded from a board
+void test_replay_traceFile(void) {
+    const char* path = getenv("RAILHUB_TRACE");
+    if (path == nullptr) {
+        TEST_IGNORE_MESSAGE("RAILHUB_TRACE not set");
+        return;
+    }
+    std::vector<uint8_t> trace;
+    TEST_ASSERT_TRUE_MESSAGE(readFile(path, trace), "Cannot read RAILHUB_TRACE");
+
+    std::vector<PinWrite> writes;
+    typedef std::chrono::steady_clock Clock;
+    const Clock::time_point start = Clock::now();
+    FirmwareReplay replay(collectingOptions(writes));
+    const bool replayed = replay.run(trace.data(), trace.size());
+    const double hostMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    TEST_ASSERT_TRUE_MESSAGE(replayed, "Not a trace of this build, malformed, or without a keyframe");
+
+    const TraceReader& reader = replay.reader();
+    const ReplayStats& stats = replay.stats();
+    printf("  trace: %u records since boot, %u evicted, %u dropped; %u replayed (%u before the first keyframe)\n",
+           static_cast<unsigned>(reader.recorded()), static_cast<unsigned>(reader.evicted()),
+           static_cast<unsigned>(reader.dropped()), static_cast<unsigned>(stats.records),
+           static_cast<unsigned>(stats.skipped));
+    printf("  %.3f s of device time from %.3f s: %u commands (%u rejected), %u engine commands (%u invalid), "
+           "%u connects, %u disconnects, up to %u clients\n",
+           static_cast<double>(stats.endUs - stats.startUs) / 1e6, static_cast<double>(stats.startUs) / 1e6,
+           static_cast<unsigned>(stats.commands), static_cast<unsigned>(stats.rejected),
+           static_cast<unsigned>(stats.outputCommands), static_cast<unsigned>(stats.invalidCommands),
+           static_cast<unsigned>(stats.connects), static_cast<unsigned>(stats.disconnects), stats.maxClients);
+    printf("  loop: %u ticks, longest gap %u us, %u overruns (longest %u us)\n", static_cast<unsigned>(stats.ticks),
+           static_cast<unsigned>(stats.maxTickGapUs), static_cast<unsigned>(stats.overruns),
+           static_cast<unsigned>(stats.maxOverrunUs));
+    printf("  effects: %u steps, %u late (worst %u ms), %u pin writes; keyframes %u checked, %u diverged, "
+           "%u out of phase\n",
+           static_cast<unsigned>(stats.steps), static_cast<unsigned>(stats.lateSteps),
+           static_cast<unsigned>(stats.maxLateMs), static_cast<unsigned>(stats.pinWrites),
+           static_cast<unsigned>(stats.keyframes), static_cast<unsigned>(stats.divergences),
+           static_cast<unsigned>(stats.phaseDrifts));
+    printf("  host: %.2f ms (%.0f ns per tick)\n", hostMs, stats.ticks ? hostMs * 1e6 / stats.ticks : 0.0);
+
+    const char* outputPath = getenv("RAILHUB_REPLAY_OUTPUT");
+    if (outputPath != nullptr) {
+        FILE* file = fopen(outputPath, "w");
+        TEST_ASSERT_TRUE_MESSAGE(file != nullptr, "Cannot write RAILHUB_REPLAY_OUTPUT");
+        fprintf(file, "time_ms,gpio,duty\n");
+        for (size_t i = 0; i < writes.size(); i++) {
+            fprintf(file, "%u,%u,%u\n", static_cast<unsigned>(writes[i].timeMs), writes[i].pin, writes[i].duty);
+        }
+        fclose(file);
+        printf("  %u pin writes written to %s\n", static_cast<unsigned>(writes.size()), outputPath);
+    }
+}
+
+// =============================================================================
+// MAIN TEST RUNNER
+// =============================================================================
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_replay_reproducesOutputSequence);
+    RUN_TEST(test_replay_reproducesStall);
+    RUN_TEST(test_replay_isDeterministic);
+    RUN_TEST(test_replay_fromWrappedRing);
+    RUN_TEST(test_replay_detectsDivergence);
+    RUN_TEST(test_replay_refusesOtherBuilds);
+    RUN_TEST(test_replay_traceFile);
+
+    return UNITY_END();
+}
+
+#endif // NATIVE_BUILD
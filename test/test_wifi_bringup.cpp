@@ -0,0 +1,154 @@
+#ifdef NATIVE_BUILD
+#include <unity.h>
+#include <cstdint>
+#include <cstdio>
+
+#include "wifi_bringup.h"
+
+// =============================================================================
+// HELPERS
+// =============================================================================
+
+// Same timeouts as config.h (WIFI_CONNECT_TIMEOUT_MS, WIFIMANAGER_TIMEOUT)
+static const WifiBringupTimeouts TEST_TIMEOUTS = {30000, 300000};
+
+// Simulated boot: one loop() pass per millisecond. Each pass steps the
+// bring-up and then the effects, like loop() does; returns the pass on which
+// 'expected' was first requested, -1 if it never was
+static int32_t runUntil(WifiBringup& bringup, uint32_t startMs, uint32_t endMs, int32_t linkUpAtMs,
+                        WifiBringupAction expected, uint32_t& effectTicks) {
+    int32_t seenAt = -1;
+    for (uint32_t now = startMs; now < endMs; now++) {
+        const bool linked = linkUpAtMs >= 0 && now >= static_cast<uint32_t>(linkUpAtMs);
+        if (bringup.update(now, linked) == expected && seenAt < 0) seenAt = static_cast<int32_t>(now);
+        effectTicks++;
+    }
+    return seenAt;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// =============================================================================
+// UNIT TESTS
+// =============================================================================
+
+void test_savedCredentials_connect(void) {
+    WifiBringup bringup(TEST_TIMEOUTS);
+    TEST_ASSERT_EQUAL(WifiBringupState::Idle, bringup.state());
+    bringup.begin(100, true);
+    TEST_ASSERT_EQUAL(WifiBringupState::Connecting, bringup.state());
+
+    TEST_ASSERT_EQUAL(WifiBringupAction::None, bringup.update(2000, false));
+    TEST_ASSERT_EQUAL(WifiBringupAction::LinkUp, bringup.update(4100, true));
+    TEST_ASSERT_EQUAL(WifiBringupState::Connected, bringup.state());
+    TEST_ASSERT_TRUE(bringup.settled());
+    TEST_ASSERT_EQUAL(4000, bringup.linkUpMs());
+
+    // Settled: nothing more to start
+    TEST_ASSERT_EQUAL(WifiBringupAction::None, bringup.update(5000, true));
+}
+
+void test_noCredentials_opensPortalAtOnce(void) {
+    WifiBringup bringup(TEST_TIMEOUTS);
+    bringup.begin(0, false);
+    TEST_ASSERT_EQUAL(WifiBringupAction::StartPortal, bringup.update(1, false));
+    TEST_ASSERT_EQUAL(WifiBringupState::Portal, bringup.state());
+    TEST_ASSERT_FALSE(bringup.settled());
+}
+
+void test_connectTimeout_thenPortal_thenFallbackAp(void) {
+    WifiBringup bringup(TEST_TIMEOUTS);
+    bringup.begin(0, true);
+    TEST_ASSERT_EQUAL(WifiBringupAction::None, bringup.update(29999, false));
+    TEST_ASSERT_EQUAL(WifiBringupAction::StartPortal, bringup.update(30000, false));
+
+    // The portal timeout counts from when the portal opened
+    TEST_ASSERT_EQUAL(WifiBringupAction::None, bringup.update(329999, false));
+    TEST_ASSERT_EQUAL(WifiBringupAction::StartFallbackAp, bringup.update(330000, false));
+    TEST_ASSERT_EQUAL(WifiBringupState::FallbackAp, bringup.state());
+    TEST_ASSERT_TRUE(bringup.settled());
+    TEST_ASSERT_EQUAL(0, bringup.linkUpMs());
+
+    // A station link showing up later is left alone
+    TEST_ASSERT_EQUAL(WifiBringupAction::None, bringup.update(400000, true));
+}
+
+void test_linkUpWhilePortalOpen(void) {
+    WifiBringup bringup(TEST_TIMEOUTS);
+    bringup.begin(0, false);
+    bringup.update(0, false);
+    TEST_ASSERT_EQUAL(WifiBringupAction::LinkUp, bringup.update(90000, true));
+    TEST_ASSERT_EQUAL(WifiBringupState::Connected, bringup.state());
+    TEST_ASSERT_EQUAL(90000, bringup.linkUpMs());
+}
+
+void test_millisWrap(void) {
+    WifiBringup bringup(TEST_TIMEOUTS);
+    bringup.begin(0xFFFFF000UL, true);
+    TEST_ASSERT_EQUAL(WifiBringupAction::None, bringup.update(0x00001000UL, false)); // 8 s later
+    // 30 s after begin(), past the wrap
+    TEST_ASSERT_EQUAL(WifiBringupAction::StartPortal, bringup.update(0x00006530UL, false));
+}
+
+void test_stateNames(void) {
+    TEST_ASSERT_EQUAL_STRING("connecting", WifiBringup::stateName(WifiBringupState::Connecting));
+    TEST_ASSERT_EQUAL_STRING("portal", WifiBringup::stateName(WifiBringupState::Portal));
+    TEST_ASSERT_EQUAL_STRING("fallback-ap", WifiBringup::stateName(WifiBringupState::FallbackAp));
+    TEST_ASSERT_EQUAL_STRING("connected", WifiBringup::stateName(WifiBringupState::Connected));
+    TEST_ASSERT_EQUAL_STRING("idle", WifiBringup::stateName(WifiBringupState::Idle));
+}
+
+// Worst case boot: saved network gone, nobody opens the portal. The effects
+// step on every pass from the first one, all the way to the fallback AP.
+void test_simulatedBoot_effectsNeverStall(void) {
+    WifiBringup bringup(TEST_TIMEOUTS);
+    const uint32_t bootMs = 250; // setup() done
+    bringup.begin(bootMs, true);
+
+    uint32_t effectTicks = 0;
+    const int32_t portalAt = runUntil(bringup, bootMs, bootMs + 40000, -1, WifiBringupAction::StartPortal, effectTicks);
+    const int32_t fallbackAt = runUntil(bringup, bootMs + 40000, bootMs + 340000, -1,
+                                        WifiBringupAction::StartFallbackAp, effectTicks);
+    printf("  boot at %u ms: portal at %d ms, fallback AP at %d ms, %u effect ticks (one per pass)\n",
+           static_cast<unsigned>(bootMs), static_cast<int>(portalAt), static_cast<int>(fallbackAt),
+           static_cast<unsigned>(effectTicks));
+
+    TEST_ASSERT_EQUAL(bootMs + 30000, portalAt);
+    TEST_ASSERT_EQUAL(bootMs + 30000 + 300000, fallbackAt);
+    TEST_ASSERT_EQUAL(340000, effectTicks);
+}
+
+void test_simulatedBoot_linkUp(void) {
+    WifiBringup bringup(TEST_TIMEOUTS);
+    bringup.begin(250, true);
+    uint32_t effectTicks = 0;
+    const int32_t linkUpAt = runUntil(bringup, 250, 10000, 3250, WifiBringupAction::LinkUp, effectTicks);
+    TEST_ASSERT_EQUAL(3250, linkUpAt);
+    TEST_ASSERT_EQUAL(3000, bringup.linkUpMs());
+    TEST_ASSERT_EQUAL(9750, effectTicks);
+}
+
+// =============================================================================
+// MAIN TEST RUNNER
+// =============================================================================
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    // Transitions
+    RUN_TEST(test_savedCredentials_connect);
+    RUN_TEST(test_noCredentials_opensPortalAtOnce);
+    RUN_TEST(test_connectTimeout_thenPortal_thenFallbackAp);
+    RUN_TEST(test_linkUpWhilePortalOpen);
+    RUN_TEST(test_millisWrap);
+    RUN_TEST(test_stateNames);
+
+    // Simulated boot
+    RUN_TEST(test_simulatedBoot_effectsNeverStall);
+    RUN_TEST(test_simulatedBoot_linkUp);
+
+    return UNITY_END();
+}
+
+#endif // NATIVE_BUILD
@@ -0,0 +1,301 @@
+#ifdef NATIVE_BUILD
+#include <unity.h>
+#include <cstdio>
+#include <cstdint>
+
+#include "config.h"
+#include "ws_client_queue.h"
+
+// =============================================================================
+// HELPERS
+// =============================================================================
+
+typedef WsClientQueues<5> TestQueues;
+
+#define SIM_CLIENTS 3
+#define SIM_STALLED_CLIENT 1          // Middle slot, so clients on both sides are measured
+#define SIM_SEND_BUFFER WS_TCP_SEND_BUFFER // The firmware's TCP_SND_BUF
+#define SIM_FRAME_SIZE 1500           // Typical status document + frame header
+#define SIM_FAST_DRAIN_PER_MS 200     // Healthy client on good WiFi
+#define SIM_WRITE_TIMEOUT_MS 5000     // WiFiClient default timeout a blocking write waits for
+#define SIM_SLOW_CLIENT_TIMEOUT_MS 3000
+#define SIM_BROADCAST_INTERVAL_MS 500
+#define SIM_EFFECT_INTERVAL_MS 50
+#define SIM_DURATION_MS 20000
+
+// One WebSocket client: a TCP send buffer drained at a fixed rate
+struct SimClient {
+    bool connected;
+    uint32_t queued;
+    uint32_t drainPerMs;
+    unsigned long publishedAt;     // Pending status published at
+    bool awaiting;
+    unsigned long maxLatencyMs;    // Publish -> frame handed to TCP
+    uint32_t framesReceived;
+
+    uint32_t room() const { return connected ? SIM_SEND_BUFFER - queued : 0; }
+    void write(unsigned long now) {
+        queued += SIM_FRAME_SIZE;
+        framesReceived++;
+        if (awaiting && now - publishedAt > maxLatencyMs) maxLatencyMs = now - publishedAt;
+        awaiting = false;
+    }
+    void drain() { queued = queued > drainPerMs ? queued - drainPerMs : 0; }
+};
+
+struct SimResult {
+    unsigned long maxEffectGapMs;
+    uint32_t effectSteps;
+    unsigned long maxHealthyLatencyMs;
+    uint32_t healthyFrames;
+    bool stalledDisconnected;
+};
+
+static void initClients(SimClient* clients) {
+    for (uint8_t i = 0; i < SIM_CLIENTS; i++) {
+        clients[i].connected = true;
+        clients[i].queued = 0;
+        clients[i].drainPerMs = i == SIM_STALLED_CLIENT ? 0 : SIM_FAST_DRAIN_PER_MS;
+        clients[i].awaiting = false;
+        clients[i].maxLatencyMs = 0;
+        clients[i].framesReceived = 0;
+    }
+}
+
+static void publish(SimClient* clients, unsigned long now) {
+    for (uint8_t i = 0; i < SIM_CLIENTS; i++) {
+        if (clients[i].connected && !clients[i].awaiting) {
+            clients[i].awaiting = true;
+            clients[i].publishedAt = now;
+        }
+    }
+}
+
+static SimResult collect(const SimClient* clients, unsigned long maxEffectGapMs, uint32_t effectSteps) {
+    SimResult result = {maxEffectGapMs, effectSteps, 0, 0, !clients[SIM_STALLED_CLIENT].connected};
+    for (uint8_t i = 0; i < SIM_CLIENTS; i++) {
+        if (i == SIM_STALLED_CLIENT) continue;
+        if (clients[i].maxLatencyMs > result.maxHealthyLatencyMs) result.maxHealthyLatencyMs = clients[i].maxLatencyMs;
+        result.healthyFrames += clients[i].framesReceived;
+    }
+    return result;
+}
+
+// Old behaviour: broadcastTXT() writes to every client in turn and a write
+// into a full send buffer waits until it drains or times out. The simulated
+// clock advances while loop() is stuck in there.
+static SimResult runBlockingBroadcast() {
+    SimClient clients[SIM_CLIENTS];
+    initClients(clients);
+    unsigned long lastBroadcast = 0;
+    unsigned long lastEffect = 0;
+    unsigned long maxEffectGap = 0;
+    uint32_t effectSteps = 0;
+
+    unsigned long now = 0;
+    while (now < SIM_DURATION_MS) {
+        if (now - lastBroadcast >= SIM_BROADCAST_INTERVAL_MS) {
+            lastBroadcast = now;
+            publish(clients, now);
+            for (uint8_t i = 0; i < SIM_CLIENTS; i++) {
+                unsigned long waited = 0;
+                while (clients[i].room() < SIM_FRAME_SIZE && waited < SIM_WRITE_TIMEOUT_MS) {
+                    for (uint8_t j = 0; j < SIM_CLIENTS; j++) clients[j].drain();
+                    now++;
+                    waited++;
+                }
+                if (clients[i].room() >= SIM_FRAME_SIZE) clients[i].write(now);
+            }
+        }
+        if (now - lastEffect >= SIM_EFFECT_INTERVAL_MS) {
+            if (now - lastEffect > maxEffectGap) maxEffectGap = now - lastEffect;
+            lastEffect = now;
+            effectSteps++;
+        }
+        for (uint8_t j = 0; j < SIM_CLIENTS; j++) clients[j].drain();
+        now++;
+    }
+    return collect(clients, maxEffectGap, effectSteps);
+}
+
+// New behaviour: publish marks clients pending, the pump writes only where
+// the whole frame fits and drops clients that stay backed up
+static SimResult runQueuedBroadcast(TestQueues& queues) {
+    SimClient clients[SIM_CLIENTS];
+    initClients(clients);
+    for (uint8_t i = 0; i < SIM_CLIENTS; i++) queues.connect(i, 0);
+    publish(clients, 0);
+    unsigned long lastBroadcast = 0;
+    unsigned long lastEffect = 0;
+    unsigned long maxEffectGap = 0;
+    uint32_t effectSteps = 0;
+
+    for (unsigned long now = 0; now < SIM_DURATION_MS; now++) {
+        if (now - lastBroadcast >= SIM_BROADCAST_INTERVAL_MS) {
+            lastBroadcast = now;
+            publish(clients, now);
+            queues.publish(now);
+        }
+        for (uint8_t i = 0; i < SIM_CLIENTS; i++) {
+            switch (queues.poll(i, clients[i].room(), SIM_FRAME_SIZE, now)) {
+                case TestQueues::Send:
+                    clients[i].write(now);
+                    queues.markSent(i, now);
+                    break;
+                case TestQueues::Drop:
+                    clients[i].connected = false;
+                    break;
+                default:
+                    break;
+            }
+        }
+        if (now - lastEffect >= SIM_EFFECT_INTERVAL_MS) {
+            if (now - lastEffect > maxEffectGap) maxEffectGap = now - lastEffect;
+            lastEffect = now;
+            effectSteps++;
+        }
+        for (uint8_t j = 0; j < SIM_CLIENTS; j++) clients[j].drain();
+    }
+    return collect(clients, maxEffectGap, effectSteps);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// =============================================================================
+// UNIT TESTS
+// =============================================================================
+
+void test_queue_newClientStartsPending(void) {
+    TestQueues queues(3000);
+    TEST_ASSERT_TRUE(queues.connect(0, 100));
+    TEST_ASSERT_TRUE(queues.anyPending());
+    TEST_ASSERT_EQUAL(TestQueues::Send, queues.poll(0, SIM_SEND_BUFFER, 1500, 100));
+    queues.markSent(0, 100);
+    TEST_ASSERT_FALSE(queues.anyPending());
+    TEST_ASSERT_EQUAL(TestQueues::Idle, queues.poll(0, SIM_SEND_BUFFER, 1500, 101));
+}
+
+void test_queue_latestStateWins(void) {
+    TestQueues queues(3000);
+    queues.connect(0, 0);
+    TEST_ASSERT_EQUAL(TestQueues::Wait, queues.poll(0, 100, 1500, 10));
+    queues.publish(500);
+    queues.publish(1000);
+    TEST_ASSERT_EQUAL(2, queues.metrics().framesCoalesced);
+
+    // One frame - the newest - once the buffer drains
+    TEST_ASSERT_EQUAL(TestQueues::Send, queues.poll(0, SIM_SEND_BUFFER, 1500, 1200));
+    queues.markSent(0, 1200);
+    TEST_ASSERT_EQUAL(TestQueues::Idle, queues.poll(0, SIM_SEND_BUFFER, 1500, 1201));
+    TEST_ASSERT_EQUAL(1, queues.metrics().framesSent);
+    TEST_ASSERT_EQUAL(1200, queues.metrics().maxBacklogMs);
+}
+
+void test_queue_dropsClientPastDeadline(void) {
+    TestQueues queues(3000);
+    queues.connect(2, 0);
+    queues.publish(500); // Coalesced: the deadline runs from the oldest unsent state
+    TEST_ASSERT_EQUAL(TestQueues::Wait, queues.poll(2, 0, 1500, 2999));
+    TEST_ASSERT_EQUAL(TestQueues::Drop, queues.poll(2, 0, 1500, 3000));
+    TEST_ASSERT_FALSE(queues.isConnected(2));
+    TEST_ASSERT_EQUAL(1, queues.metrics().slowDisconnects);
+    TEST_ASSERT_EQUAL(TestQueues::Idle, queues.poll(2, 0, 1500, 3001));
+}
+
+// Event streams subscribe to some snapshots only: publishing to one client
+// leaves the others alone
+void test_queue_publishToOneClient(void) {
+    TestQueues queues(3000);
+    queues.connect(0, 0);
+    queues.connect(1, 0);
+    queues.markSent(0, 0);
+    queues.markSent(1, 0);
+    queues.publish(1, 100);
+    TEST_ASSERT_EQUAL(TestQueues::Idle, queues.poll(0, SIM_SEND_BUFFER, 1500, 100));
+    TEST_ASSERT_EQUAL(TestQueues::Send, queues.poll(1, SIM_SEND_BUFFER, 1500, 100));
+    queues.publish(4, 100); // Not connected: ignored
+    TEST_ASSERT_EQUAL(TestQueues::Idle, queues.poll(4, SIM_SEND_BUFFER, 1500, 100));
+}
+
+// A filtered frame is sized on its own: it goes out as soon as it fits,
+// even while a full snapshot would not
+void test_queue_pendingClientSizedByOwnFrame(void) {
+    TestQueues queues(3000);
+    queues.connect(0, 0);
+    TEST_ASSERT_TRUE(queues.pending(0));
+    TEST_ASSERT_FALSE(queues.pending(1));
+    TEST_ASSERT_EQUAL(TestQueues::Wait, queues.poll(0, 600, 1500, 10));
+    TEST_ASSERT_EQUAL(TestQueues::Send, queues.poll(0, 600, 400, 10));
+    queues.markSent(0, 10);
+    TEST_ASSERT_FALSE(queues.pending(0));
+    TEST_ASSERT_FALSE(queues.pending(7)); // Out of range
+}
+
+void test_queue_maxClients(void) {
+    TestQueues queues(3000, 2);
+    TEST_ASSERT_TRUE(queues.connect(0, 0));
+    TEST_ASSERT_TRUE(queues.connect(3, 0));
+    TEST_ASSERT_FALSE(queues.connect(1, 0));
+    TEST_ASSERT_EQUAL(2, queues.connectedCount());
+    TEST_ASSERT_EQUAL(1, queues.metrics().rejectedClients);
+
+    queues.disconnect(0);
+    TEST_ASSERT_TRUE(queues.connect(1, 0));
+    TEST_ASSERT_FALSE(queues.connect(5, 0)); // Out of range
+}
+
+// A blocking broadcast into a stalled socket freezes the loop: effects skip
+// steps and the client behind the stalled one waits for the write timeout
+void test_simulation_blockingBroadcastStalls(void) {
+    const SimResult result = runBlockingBroadcast();
+    printf("  blocking: maxEffectGap=%lums effectSteps=%u healthyLatency=%lums healthyFrames=%u\n",
+           result.maxEffectGapMs, result.effectSteps, result.maxHealthyLatencyMs, result.healthyFrames);
+    TEST_ASSERT_GREATER_OR_EQUAL(SIM_WRITE_TIMEOUT_MS, result.maxEffectGapMs);
+    TEST_ASSERT_GREATER_OR_EQUAL(SIM_WRITE_TIMEOUT_MS, result.maxHealthyLatencyMs);
+}
+
+// With per-client queues the stalled socket costs nothing: effects keep their
+// cadence, healthy clients get every status immediately and the stalled one
+// is dropped at the deadline
+void test_simulation_stalledClientIsolated(void) {
+    TestQueues queues(SIM_SLOW_CLIENT_TIMEOUT_MS);
+    const SimResult result = runQueuedBroadcast(queues);
+    const WsQueueMetrics& metrics = queues.metrics();
+    printf("  queued: maxEffectGap=%lums effectSteps=%u healthyLatency=%lums healthyFrames=%u "
+           "coalesced=%u slowDisconnects=%u\n",
+           result.maxEffectGapMs, result.effectSteps, result.maxHealthyLatencyMs, result.healthyFrames,
+           metrics.framesCoalesced, metrics.slowDisconnects);
+
+    TEST_ASSERT_EQUAL(SIM_EFFECT_INTERVAL_MS, result.maxEffectGapMs);
+    TEST_ASSERT_EQUAL(SIM_DURATION_MS / SIM_EFFECT_INTERVAL_MS - 1, result.effectSteps); // First step at t=50ms
+    TEST_ASSERT_EQUAL(0, result.maxHealthyLatencyMs);
+    TEST_ASSERT_EQUAL(2 * (SIM_DURATION_MS / SIM_BROADCAST_INTERVAL_MS), result.healthyFrames);
+    TEST_ASSERT_TRUE(result.stalledDisconnected);
+    TEST_ASSERT_EQUAL(1, metrics.slowDisconnects);
+    TEST_ASSERT_FALSE(queues.isConnected(SIM_STALLED_CLIENT));
+}
+
+// =============================================================================
+// MAIN TEST RUNNER
+// =============================================================================
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    // Queue state
+    RUN_TEST(test_queue_newClientStartsPending);
+    RUN_TEST(test_queue_latestStateWins);
+    RUN_TEST(test_queue_dropsClientPastDeadline);
+    RUN_TEST(test_queue_publishToOneClient);
+    RUN_TEST(test_queue_pendingClientSizedByOwnFrame);
+    RUN_TEST(test_queue_maxClients);
+
+    // Stalled client simulation
+    RUN_TEST(test_simulation_blockingBroadcastStalls);
+    RUN_TEST(test_simulation_stalledClientIsolated);
+
+    return UNITY_END();
+}
+
+#endif // NATIVE_BUILD